@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include "dns_name.h"
 #include "dns_answer.h"
+#include "dns_error.h"
 #include "dns_hexstring.h"
 
 bool dns_answer_init(dns_answer_t *answer)
@@ -43,7 +44,7 @@ bool dns_answer_set_name(dns_answer_t *answer, const char *name)
         return false;
     }
 
-    size_t rname_len = strlen(name) + 1;
+    size_t rname_len = strlen(name) + 2;
     char  *rname     = (char *)malloc(rname_len);
     if (NULL == rname) {
         return false;
@@ -129,13 +130,13 @@ bool dns_answer_set_ttl(dns_answer_t *answer, uint32_t ttl)
 bool dns_answer_set_data(dns_answer_t *answer, const uint8_t *data, uint16_t length)
 {
     if (NULL == answer || NULL == data || length < 1) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return false;
     }
 
     uint8_t *rdata = (uint8_t *)malloc(length);
     if (NULL == rdata) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
         return false;
     }
     memcpy(rdata, data, length);
@@ -226,7 +227,7 @@ uint32_t dns_answer_length(const dns_answer_t *answer)
 bool dns_answer_equal(const dns_answer_t *answer1, const dns_answer_t *answer2)
 {
     if (NULL == answer1 || NULL == answer2) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return false;
     }
 
@@ -237,7 +238,6 @@ bool dns_answer_equal(const dns_answer_t *answer1, const dns_answer_t *answer2)
     || dns_answer_length(answer1) != dns_answer_length(answer2)
     || memcmp(answer1->rdata, answer2->rdata, answer1->rlength) != 0
     || strcmp(answer1->rname, answer2->rname) != 0) {
-        printf("%s, %d\n", __func__, __LINE__);
         return false;
     }
 
@@ -247,19 +247,32 @@ bool dns_answer_equal(const dns_answer_t *answer1, const dns_answer_t *answer2)
 bool dns_answer_copy(dns_answer_t *dst, const dns_answer_t *src)
 {
     if (NULL == dst || NULL == src) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    if (NULL == src->rname) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return false;
     }
 
     dns_answer_clear(dst);
     dst->rname = strdup(src->rname);
+    if (NULL == dst->rname) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
     dst->rtype = src->rtype;
     dst->rclass = src->rclass;
     dst->rttl = src->rttl;
     dst->rlength = src->rlength;
+    if (0 == src->rlength) {
+        return true;
+    }
+
     dst->rdata = (uint8_t *)malloc(src->rlength);
     if (NULL == dst->rdata) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
         dns_answer_clear(dst);
         return false;
     }
@@ -271,14 +284,14 @@ bool dns_answer_copy(dns_answer_t *dst, const dns_answer_t *src)
 int dns_answer_serialize(const dns_answer_t *answer, uint8_t *buf, size_t buf_size)
 {
     if (NULL == answer || NULL == buf) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return 0;
     }
 
     int name_len = strlen(answer->rname);
     int answer_len = dns_answer_length(answer);
     if (buf_size < answer_len) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
         return 0;
     }
 
@@ -302,29 +315,284 @@ int dns_answer_serialize(const dns_answer_t *answer, uint8_t *buf, size_t buf_si
     return ptr - buf;
 }
 
+/**
+ * @brief 把资源数据写入报文，NS/CNAME/PTR/MX/SOA等类型中的名称可以压缩
+ * @return int 写入的字节数，失败返回-1
+ */
+static int dns_answer_pack_rdata(const dns_answer_t *answer, dns_name_table_t *table, uint8_t *msg, size_t msg_size, size_t offset)
+{
+    const uint8_t *rdata   = answer->rdata;
+    size_t         rlength = answer->rlength;
+
+    if (rlength > 0 && NULL == rdata) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    int    names  = 0;
+    size_t prefix = 0;  // 名称之前的定长字段
+    size_t fixed  = 0;  // 名称之后的定长字段
+    switch (answer->rtype) {
+    case DNS_TYPE_SOA:
+        names = 2;
+        fixed = 20;
+        break;
+    case DNS_TYPE_MINFO:
+        names = 2;
+        break;
+    case DNS_TYPE_MX:
+        names  = 1;
+        prefix = 2;
+        break;
+    default:
+        names = dns_type_rdata_has_name(answer->rtype) ? 1 : 0;
+        break;
+    }
+
+    if (NULL == table || 0 == names) {
+        if (offset + rlength > msg_size) {
+            dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+            return -1;
+        }
+        if (rlength > 0) {
+            memcpy(msg + offset, rdata, rlength);
+        }
+        return rlength;
+    }
+
+    if (prefix + fixed > rlength) {
+        dns_error_raise(DNS_ERROR_RDATA);
+        return -1;
+    }
+    if (offset + prefix > msg_size) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return -1;
+    }
+    memcpy(msg + offset, rdata, prefix);
+
+    size_t src = prefix;
+    size_t dst = offset + prefix;
+    for (int i = 0; i < names; i++) {
+        // 存储的名称是以0结尾的编码格式，不能越过资源数据的末尾
+        if (src >= rlength || NULL == memchr(rdata + src, 0, rlength - src)) {
+            dns_error_raise(DNS_ERROR_RDATA);
+            return -1;
+        }
+
+        int name_len = dns_name_pack(table, (const char *)rdata + src, msg, msg_size, dst);
+        if (name_len < 1) {
+            return -1;
+        }
+        src += strlen((const char *)rdata + src) + 1;
+        dst += name_len;
+    }
+
+    if (src + fixed != rlength) {
+        dns_error_raise(DNS_ERROR_RDATA);
+        return -1;
+    }
+    if (dst + fixed > msg_size) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return -1;
+    }
+    memcpy(msg + dst, rdata + src, fixed);
+    dst += fixed;
+
+    return dst - offset;
+}
+
+int dns_answer_pack(const dns_answer_t *answer, dns_name_table_t *table, uint8_t *msg, size_t msg_size, size_t offset)
+{
+    if (NULL == answer || NULL == answer->rname || NULL == msg) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    int name_len = dns_name_pack(table, answer->rname, msg, msg_size, offset);
+    if (name_len < 1) {
+        return 0;
+    }
+    if (offset + name_len + 10 > msg_size) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    uint8_t *ptr = msg + offset + name_len;
+    *(ptr++) = (answer->rtype   >> 8 ) & 0xFF;
+    *(ptr++) = (answer->rtype   >> 0 ) & 0xFF;
+    *(ptr++) = (answer->rclass  >> 8 ) & 0xFF;
+    *(ptr++) = (answer->rclass  >> 0 ) & 0xFF;
+    *(ptr++) = (answer->rttl    >> 24) & 0xFF;
+    *(ptr++) = (answer->rttl    >> 16) & 0xFF;
+    *(ptr++) = (answer->rttl    >> 8 ) & 0xFF;
+    *(ptr++) = (answer->rttl    >> 0 ) & 0xFF;
+
+    // 压缩后的资源数据长度要写完数据才知道
+    uint8_t *rlength = ptr;
+    ptr += 2;
+
+    int rdata_len = dns_answer_pack_rdata(answer, table, msg, msg_size, ptr - msg);
+    if (rdata_len < 0) {
+        return 0;
+    }
+    rlength[0] = (rdata_len >> 8) & 0xFF;
+    rlength[1] = (rdata_len >> 0) & 0xFF;
+    ptr += rdata_len;
+
+    return ptr - (msg + offset);
+}
+
 int dns_answer_deserialize(dns_answer_t *answer, const uint8_t *data, size_t data_len)
 {
-    if (NULL == answer || NULL == data) {
-        printf("%s, %d\n", __func__, __LINE__);
+    return dns_answer_unpack(answer, data, data_len, 0);
+}
+
+/**
+ * @brief 展开资源数据中的一个名称，追加到buf中（含结尾的0）
+ * @return bool 成功返回true，失败返回false
+ */
+static bool dns_answer_unpack_rdata_name(const uint8_t *msg, size_t end, size_t *pos, uint8_t *buf, size_t buf_size, size_t *buf_len)
+{
+    size_t name_len = 0;
+    int    wire_len = dns_name_unpack(msg, end, *pos, (char *)buf + *buf_len, buf_size - *buf_len, &name_len);
+    if (wire_len < 1) {
+        return false;
+    }
+
+    *pos     += wire_len;
+    *buf_len += name_len + 1;
+    return true;
+}
+
+int dns_answer_unpack_rdata(uint16_t rtype, const uint8_t *msg, size_t msg_len, size_t offset, uint16_t rlength, uint8_t *buf, size_t buf_size)
+{
+    if (NULL == msg || NULL == buf) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+    if (offset + rlength > msg_len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return -1;
+    }
+
+    size_t end     = offset + rlength;
+    size_t pos     = offset;
+    size_t buf_len = 0;
+    int    names   = 0;
+    size_t fixed   = 0;  // 名称之后的定长字段
+
+    switch (rtype) {
+    case DNS_TYPE_SOA:
+        names = 2;
+        fixed = 20;  // serial, refresh, retry, expire, minimum
+        break;
+    case DNS_TYPE_MINFO:
+        names = 2;
+        break;
+    case DNS_TYPE_MX:
+        // 2字节的preference在名称之前
+        if (rlength < 2) {
+            dns_error_raise(DNS_ERROR_RDATA);
+            return -1;
+        }
+        if (buf_size < 2) {
+            dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+            return -1;
+        }
+        memcpy(buf, msg + pos, 2);
+        pos     += 2;
+        buf_len += 2;
+        names    = 1;
+        break;
+    default:
+        if (dns_type_rdata_has_name(rtype)) {
+            names = 1;
+            break;
+        }
+        if (buf_size < rlength) {
+            dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+            return -1;
+        }
+        memcpy(buf, msg + offset, rlength);
+        return rlength;
+    }
+
+    // 名称不能超出资源数据的范围，但压缩指针可以指向报文中更早的位置
+    for (int i = 0; i < names; i++) {
+        if (dns_answer_unpack_rdata_name(msg, end, &pos, buf, buf_size, &buf_len) == false) {
+            return -1;
+        }
+    }
+
+    if (pos + fixed != end) {
+        dns_error_raise(DNS_ERROR_RDATA);
+        return -1;
+    }
+    if (buf_len + fixed > buf_size) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return -1;
+    }
+    memcpy(buf + buf_len, msg + pos, fixed);
+    buf_len += fixed;
+
+    return buf_len;
+}
+
+int dns_answer_unpack(dns_answer_t *answer, const uint8_t *msg, size_t msg_len, size_t offset)
+{
+    if (NULL == answer || NULL == msg) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return 0;
     }
 
     dns_answer_clear(answer);
-    int answer_len = dns_answer_length(answer);
-    if (data_len < answer_len) {
+
+    char         name[DNS_NAME_MAX_LENGTH];
+    uint8_t      rdata[DNS_ANSWER_RDATA_NAME_MAX];
+    dns_answer_t parsed;
+    int          answer_len = dns_answer_unpack_to(&parsed, msg, msg_len, offset, name, sizeof(name), rdata, sizeof(rdata));
+    if (answer_len < 1) {
         return 0;
     }
 
-    int name_len = strlen((const char *)data);
-    if (name_len > 0) {
-        answer->rname = strdup((char*)data);
-        if (NULL == answer->rname) {
-            printf("%s, %d\n", __func__, __LINE__);
+    answer->rname = strdup(name);
+    if (NULL == answer->rname) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return 0;
+    }
+
+    answer->rtype  = parsed.rtype;
+    answer->rclass = parsed.rclass;
+    answer->rttl   = parsed.rttl;
+    if (parsed.rlength > 0) {
+        if (dns_answer_set_data(answer, parsed.rdata, parsed.rlength) == false) {
+            dns_answer_clear(answer);
             return 0;
         }
     }
 
-    const uint8_t *ptr = data + name_len + 1;
+    return answer_len;
+}
+
+int dns_answer_unpack_to(dns_answer_t *answer, const uint8_t *msg, size_t msg_len, size_t offset, char *name_buf, size_t name_buf_size, uint8_t *rdata_buf, size_t rdata_buf_size)
+{
+    if (NULL == answer || NULL == msg || NULL == name_buf) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    int name_len = dns_name_unpack(msg, msg_len, offset, name_buf, name_buf_size, NULL);
+    if (name_len < 1) {
+        return 0;
+    }
+    if (offset + name_len + 10 > msg_len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return 0;
+    }
+
+    const uint8_t *ptr = msg + offset + name_len;
+    uint16_t rlength;
+    answer->rname   =  name_buf;
     answer->rtype   =  *(ptr++) << 8 ;
     answer->rtype   |= *(ptr++)      ;
     answer->rclass  =  *(ptr++) << 8 ;
@@ -333,22 +601,40 @@ int dns_answer_deserialize(dns_answer_t *answer, const uint8_t *data, size_t dat
     answer->rttl    |= *(ptr++) << 16;
     answer->rttl    |= *(ptr++) << 8 ;
     answer->rttl    |= *(ptr++)      ;
-    answer->rlength =  *(ptr++) << 8 ;
-    answer->rlength |= *(ptr++)      ;
-    if (answer->rlength > 0) {
-        if (dns_answer_set_data(answer, ptr, answer->rlength) == false) {
+    rlength         =  *(ptr++) << 8 ;
+    rlength         |= *(ptr++)      ;
+
+    size_t rdata_offset = ptr - msg;
+    if (rdata_offset + rlength > msg_len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return 0;
+    }
+
+    // 不含名称的资源数据直接指向报文，含名称的展开到rdata_buf中
+    answer->rdata   = (uint8_t *)ptr;
+    answer->rlength = rlength;
+    if (dns_type_rdata_has_name(answer->rtype)) {
+        if (NULL == rdata_buf) {
+            dns_error_raise(DNS_ERROR_INVALID_PARAM);
+            return 0;
+        }
+
+        int rdata_len = dns_answer_unpack_rdata(answer->rtype, msg, msg_len, rdata_offset, rlength, rdata_buf, rdata_buf_size);
+        if (rdata_len < 0) {
             return 0;
         }
+        answer->rdata   = rdata_buf;
+        answer->rlength = rdata_len;
     }
-    ptr += answer->rlength;
+    ptr += rlength;
 
-    return ptr - data;
+    return ptr - (msg + offset);
 }
 
 const char *dns_answer_to_string(dns_answer_t *answer, char *buf, uint32_t buf_size)
 {
     if (NULL == answer) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return NULL;
     }
 
@@ -356,7 +642,7 @@ const char *dns_answer_to_string(dns_answer_t *answer, char *buf, uint32_t buf_s
     int hexstr_len = (answer_len * 2 + 1);
     char *hexstr_buf = (char*)malloc(hexstr_len);
     if (NULL == hexstr_buf) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
         return NULL;
     }
 
@@ -370,14 +656,12 @@ const char *dns_answer_to_string(dns_answer_t *answer, char *buf, uint32_t buf_s
     if (serialize_len != answer_len) {
         free(hexstr_buf);
         free(serialize_buf);
-        printf("%s, %d\n", __func__, __LINE__);
         return NULL;
     }
     const char *hexstr = dns_hexstring(serialize_buf, answer_len, hexstr_buf, hexstr_len);
     if (NULL == hexstr) {
         free(hexstr_buf);
         free(serialize_buf);
-        printf("%s, %d\n", __func__, __LINE__);
         return NULL;
     }
 
@@ -386,7 +670,7 @@ const char *dns_answer_to_string(dns_answer_t *answer, char *buf, uint32_t buf_s
     if (NULL == data_hex) {
         free(hexstr_buf);
         free(serialize_buf);
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
         return NULL;
     }
 
@@ -396,7 +680,7 @@ const char *dns_answer_to_string(dns_answer_t *answer, char *buf, uint32_t buf_s
         free(hexstr_buf);
         free(serialize_buf);
         free(data_hex);
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
         return NULL;
     }
 
@@ -406,7 +690,7 @@ const char *dns_answer_to_string(dns_answer_t *answer, char *buf, uint32_t buf_s
         free(serialize_buf);
         free(data_hex);
         free(name);
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
         return NULL;
     }
 
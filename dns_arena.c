@@ -0,0 +1,128 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "dns_arena.h"
+
+bool dns_arena_init(dns_arena_t *arena, void *buf, size_t size)
+{
+    if (NULL == arena || NULL == buf || size < 1) {
+        return false;
+    }
+
+    arena->buf  = (uint8_t *)buf;
+    arena->size = size;
+    arena->used = 0;
+    arena->last = 0;
+    return true;
+}
+
+void dns_arena_reset(dns_arena_t *arena)
+{
+    if (NULL == arena) {
+        return;
+    }
+
+    arena->used = 0;
+    arena->last = 0;
+}
+
+void *dns_arena_alloc(dns_arena_t *arena, size_t size)
+{
+    if (NULL == arena || NULL == arena->buf) {
+        return NULL;
+    }
+
+    size_t offset = (arena->used + DNS_ARENA_ALIGN - 1) & ~(size_t)(DNS_ARENA_ALIGN - 1);
+    if (offset > arena->size || size > arena->size - offset) {
+        return NULL;
+    }
+
+    arena->last = offset;
+    arena->used = offset + size;
+    return arena->buf + offset;
+}
+
+void *dns_arena_realloc(dns_arena_t *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    if (NULL == arena || NULL == arena->buf) {
+        return NULL;
+    }
+
+    if (NULL == ptr) {
+        return dns_arena_alloc(arena, new_size);
+    }
+
+    // 最近一次分配的内存后面没有其它数据，可以原地扩展
+    if ((uint8_t *)ptr == arena->buf + arena->last && arena->last + old_size == arena->used) {
+        if (new_size > arena->size - arena->last) {
+            return NULL;
+        }
+        arena->used = arena->last + new_size;
+        return ptr;
+    }
+
+    void *new_ptr = dns_arena_alloc(arena, new_size);
+    if (NULL == new_ptr) {
+        return NULL;
+    }
+
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    return new_ptr;
+}
+
+char *dns_arena_strdup(dns_arena_t *arena, const char *str)
+{
+    if (NULL == str) {
+        return NULL;
+    }
+
+    return (char *)dns_arena_memdup(arena, str, strlen(str) + 1);
+}
+
+void *dns_arena_memdup(dns_arena_t *arena, const void *data, size_t size)
+{
+    if (NULL == data) {
+        return NULL;
+    }
+
+    void *ptr = dns_arena_alloc(arena, size);
+    if (NULL == ptr) {
+        return NULL;
+    }
+
+    memcpy(ptr, data, size);
+    return ptr;
+}
+
+#ifdef DNS_ARENA_TEST
+#include <stdio.h>
+
+int main(void)
+{
+    uint8_t     buf[64];
+    dns_arena_t arena;
+    int         failed = 0;
+
+    dns_arena_init(&arena, buf, sizeof(buf));
+
+    char *name = dns_arena_strdup(&arena, "www.baidu.com");
+    printf("strdup: %s used=%zu\n", name ? name : "NULL", arena.used);
+
+    // 最近一次分配可以原地扩展
+    uint16_t *array = (uint16_t *)dns_arena_alloc(&arena, 2 * sizeof(uint16_t));
+    uint16_t *grown = (uint16_t *)dns_arena_realloc(&arena, array, 2 * sizeof(uint16_t), 8 * sizeof(uint16_t));
+    printf("realloc in place: %s used=%zu\n", array == grown ? "yes" : "no", arena.used);
+    failed |= array != grown;
+
+    // 空间不足时返回NULL
+    void *too_big = dns_arena_alloc(&arena, sizeof(buf));
+    printf("alloc too big: %s\n", too_big ? "ok" : "NULL");
+    failed |= too_big != NULL;
+
+    dns_arena_reset(&arena);
+    printf("reset: used=%zu\n", arena.used);
+    failed |= arena.used != 0;
+
+    return failed;
+}
+#endif  // DNS_ARENA_TEST
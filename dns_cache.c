@@ -0,0 +1,562 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_cache.h"
+#include "dns_error.h"
+#include "dns_name.h"
+
+#define DNS_CACHE_HEADER_SIZE 12
+#define DNS_CACHE_RECORD_SIZE 12 // 名称指针2 + 类型2 + 类2 + TTL4 + 数据长度2
+
+/**
+ * @brief 计算键的哈希值，名称必须已经是小写
+ */
+static uint32_t dns_cache_hash(const uint8_t *name, size_t name_len, uint16_t qtype, uint16_t qclass)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < name_len; i++) {
+        hash = (hash ^ name[i]) * 16777619u;
+    }
+    hash = (hash ^ (qtype >> 8)) * 16777619u;
+    hash = (hash ^ (qtype & 0xFF)) * 16777619u;
+    hash = (hash ^ (qclass >> 8)) * 16777619u;
+    hash = (hash ^ (qclass & 0xFF)) * 16777619u;
+    return hash;
+}
+
+/**
+ * @brief 把线路格式名称复制为小写，并校验标签，不接受压缩指针
+ * @return size_t 名称长度，不合法返回0
+ */
+static size_t dns_cache_lower(const uint8_t *name, size_t max_len, uint8_t *out)
+{
+    size_t offset = 0;
+    while (offset < max_len && offset < DNS_NAME_MAX_LENGTH) {
+        uint8_t label = name[offset];
+        if (label > DNS_NAME_MAX_LABEL || offset + 1 + label > max_len) {
+            return 0;
+        }
+
+        out[offset] = label;
+        if (0 == label) {
+            return offset + 1;
+        }
+
+        for (size_t i = offset + 1; i <= offset + label; i++) {
+            uint8_t c = name[i];
+            out[i]    = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        }
+        offset += 1 + label;
+    }
+    return 0;
+}
+
+/**
+ * @brief 把点分域名编码为小写的线路格式
+ * @return size_t 名称长度，不合法返回0
+ */
+static size_t dns_cache_key(const char *name, uint8_t *key)
+{
+    char encoded[DNS_NAME_MAX_LENGTH + 2];
+    if (strlen(name) > DNS_NAME_MAX_LENGTH - 2 || NULL == dns_name_encode(name, encoded, sizeof(encoded))) {
+        return 0;
+    }
+
+    // 空标签（连续的点）会在编码中提前出现0字节，得到的名称比原名称短
+    size_t name_len = strlen(name);
+    size_t expect   = (name_len > 0 && '.' == name[name_len - 1]) ? name_len + 1 : name_len + 2;
+    size_t key_len  = dns_cache_lower((const uint8_t *)encoded, sizeof(encoded), key);
+    return key_len == expect ? key_len : 0;
+}
+
+static dns_shard_node_t **dns_cache_find(dns_shard_t *shard, uint32_t hash, const uint8_t *name, size_t name_len, uint16_t qtype,
+                                         uint16_t qclass)
+{
+    dns_shard_node_t **link = dns_shard_bucket(shard, hash);
+    for (; NULL != *link; link = &(*link)->next) {
+        dns_cache_entry_t *entry = (dns_cache_entry_t *)*link;
+        if (entry->node.hash == hash && entry->qtype == qtype && entry->qclass == qclass && entry->name_len == name_len &&
+            memcmp(entry->data, name, name_len) == 0) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+static dns_timer_wheel_t *dns_cache_wheel(dns_cache_t *cache, dns_shard_t *shard)
+{
+    return &cache->wheels[shard - cache->table.shards];
+}
+
+/**
+ * @brief 从分片中删除并释放条目，link是指向该条目的桶内链接
+ */
+static void dns_cache_unlink(dns_cache_t *cache, dns_shard_t *shard, dns_shard_node_t **link)
+{
+    dns_cache_entry_t *entry = (dns_cache_entry_t *)dns_shard_remove(shard, link);
+    dns_timer_wheel_remove(dns_cache_wheel(cache, shard), &entry->timer);
+    free(entry);
+}
+
+bool dns_cache_init(dns_cache_t *cache, uint32_t shards, uint32_t capacity)
+{
+    if (NULL == cache) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(cache, 0, sizeof(dns_cache_t));
+    if (!dns_shards_init(&cache->table, shards, capacity)) {
+        return false;
+    }
+
+    cache->wheels = (dns_timer_wheel_t *)calloc(cache->table.shard_mask + 1, sizeof(dns_timer_wheel_t));
+    if (NULL == cache->wheels) {
+        dns_shards_clear(&cache->table);
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+    return true;
+}
+
+void dns_cache_clear(dns_cache_t *cache)
+{
+    if (NULL == cache) {
+        return;
+    }
+
+    // 定时器嵌在条目中，随条目一起释放
+    dns_shards_clear(&cache->table);
+    free(cache->wheels);
+    memset(cache, 0, sizeof(dns_cache_t));
+}
+
+bool dns_cache_insert(dns_cache_t *cache, const char *name, uint16_t qtype, uint16_t qclass, uint32_t ttl,
+                      const dns_cache_rdata_t rdatas[], int count, uint32_t now)
+{
+    if (NULL == cache || NULL == cache->table.shards || NULL == name || NULL == rdatas || count < 1 || count > DNS_CACHE_RECORDS_MAX) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    uint8_t key[DNS_NAME_MAX_LENGTH];
+    size_t  name_len = dns_cache_key(name, key);
+    if (0 == name_len) {
+        dns_error_raise(DNS_ERROR_NAME_LABEL);
+        return false;
+    }
+
+    size_t rdata_len = 0;
+    for (int i = 0; i < count; i++) {
+        if (rdatas[i].length > 0 && NULL == rdatas[i].data) {
+            dns_error_raise(DNS_ERROR_INVALID_PARAM);
+            return false;
+        }
+        rdata_len += 2 + rdatas[i].length;
+    }
+
+    // 整个RRset必须能放进一个报文
+    if (DNS_CACHE_HEADER_SIZE + name_len + 4 + rdata_len + count * (DNS_CACHE_RECORD_SIZE - 2) > 0xFFFF) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return false;
+    }
+
+    if (0 == ttl) {
+        dns_cache_remove(cache, name, qtype, qclass);
+        return true;
+    }
+
+    dns_cache_entry_t *entry = (dns_cache_entry_t *)malloc(sizeof(dns_cache_entry_t) + name_len + rdata_len);
+    if (NULL == entry) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+
+    entry->timer.next  = NULL;
+    entry->timer.pprev = NULL;
+    entry->node.hash = dns_cache_hash(key, name_len, qtype, qclass);
+    entry->expire    = now + (ttl < INT32_MAX ? ttl : INT32_MAX);
+    entry->qtype     = qtype;
+    entry->qclass    = qclass;
+    entry->count     = count;
+    entry->rdata_len = rdata_len;
+    entry->name_len  = name_len;
+    memcpy(entry->data, key, name_len);
+
+    uint8_t *p = entry->data + name_len;
+    for (int i = 0; i < count; i++) {
+        p[0] = rdatas[i].length >> 8;
+        p[1] = rdatas[i].length & 0xFF;
+        if (rdatas[i].length > 0) {
+            memcpy(p + 2, rdatas[i].data, rdatas[i].length);
+        }
+        p += 2 + rdatas[i].length;
+    }
+
+    dns_shard_t       *shard = dns_shards_get(&cache->table, entry->node.hash);
+    dns_timer_wheel_t *wheel = dns_cache_wheel(cache, shard);
+    pthread_mutex_lock(&shard->lock);
+    dns_shard_node_t **link = dns_cache_find(shard, entry->node.hash, key, name_len, qtype, qclass);
+    if (NULL != link) {
+        dns_cache_unlink(cache, shard, link);
+    } else if (shard->count >= cache->table.capacity) {
+        dns_cache_unlink(cache, shard, dns_shard_link(shard, shard->lru_tail));
+        shard->evictions += 1;
+    }
+    dns_shard_insert(shard, &entry->node);
+
+    // 时间轮为空时对齐到当前时间，之后由dns_cache_expire推进
+    if (dns_timer_wheel_empty(wheel)) {
+        dns_timer_wheel_init(wheel, now);
+    }
+    dns_timer_wheel_add(wheel, &entry->timer, entry->expire);
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+int dns_cache_answer(dns_cache_t *cache, dns_reply_t *reply, uint32_t now)
+{
+    if (NULL == cache || NULL == cache->table.shards || NULL == reply || NULL == reply->packet || reply->section > DNS_SECTION_ANSWER) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    // 问题段紧跟头部，名称之后是4字节的类型和类
+    uint8_t key[DNS_NAME_MAX_LENGTH];
+    size_t  name_len = dns_cache_lower(reply->packet + DNS_CACHE_HEADER_SIZE, reply->question_end - 4 - DNS_CACHE_HEADER_SIZE, key);
+    if (0 == name_len) {
+        return 0;
+    }
+
+    uint32_t     hash  = dns_cache_hash(key, name_len, reply->qtype, reply->qclass);
+    dns_shard_t *shard = dns_shards_get(&cache->table, hash);
+    int          added = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    dns_shard_node_t **link = dns_cache_find(shard, hash, key, name_len, reply->qtype, reply->qclass);
+    if (NULL == link) {
+        shard->misses += 1;
+    } else if ((int32_t)(((dns_cache_entry_t *)*link)->expire - now) <= 0) {
+        dns_cache_unlink(cache, shard, link);
+        shard->misses  += 1;
+        shard->expired += 1;
+    } else {
+        dns_cache_entry_t *entry = (dns_cache_entry_t *)*link;
+        if (reply->len + entry->rdata_len + entry->count * (DNS_CACHE_RECORD_SIZE - 2) > reply->size ||
+            reply->counts[DNS_SECTION_ANSWER] + entry->count > 0xFFFF) {
+            added = -1;
+        } else {
+            uint32_t       ttl = entry->expire - now;
+            const uint8_t *p   = entry->data + entry->name_len;
+            for (int i = 0; i < entry->count; i++) {
+                uint16_t length = (p[0] << 8) | p[1];
+                dns_reply_add_record(reply, DNS_SECTION_ANSWER, entry->qtype, entry->qclass, ttl, p + 2, length);
+                p += 2 + length;
+            }
+            added = entry->count;
+        }
+
+        dns_shard_touch(shard, &entry->node);
+        shard->hits += 1;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (added < 0) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+    }
+    return added;
+}
+
+int dns_cache_expire(dns_cache_t *cache, uint32_t now, int budget)
+{
+    if (NULL == cache || NULL == cache->table.shards || budget < 1) {
+        return 0;
+    }
+
+    // 从上一次停下的分片之后开始，否则预算小于分片数时靠后的分片永远轮不到
+    uint32_t shards    = cache->table.shard_mask + 1;
+    uint32_t start     = atomic_load(&cache->expire_next);
+    uint32_t visited   = 0;
+    int      per_shard = (budget + shards - 1) / shards;
+    int      freed     = 0;
+    for (; visited < shards && freed < budget; visited++) {
+        uint32_t     i     = (start + visited) & cache->table.shard_mask;
+        dns_shard_t *shard = &cache->table.shards[i];
+        pthread_mutex_lock(&shard->lock);
+        for (int n = 0; n < per_shard && freed < budget; n++) {
+            dns_timer_t *timer = dns_timer_wheel_expire(&cache->wheels[i], now);
+            if (NULL == timer) {
+                break;
+            }
+
+            dns_cache_entry_t *entry = (dns_cache_entry_t *)((uint8_t *)timer - offsetof(dns_cache_entry_t, timer));
+            dns_cache_unlink(cache, shard, dns_shard_link(shard, &entry->node));
+            shard->expired += 1;
+            freed          += 1;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    atomic_store(&cache->expire_next, (start + visited) & cache->table.shard_mask);
+    return freed;
+}
+
+bool dns_cache_remove(dns_cache_t *cache, const char *name, uint16_t qtype, uint16_t qclass)
+{
+    if (NULL == cache || NULL == cache->table.shards || NULL == name) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    uint8_t key[DNS_NAME_MAX_LENGTH];
+    size_t  name_len = dns_cache_key(name, key);
+    if (0 == name_len) {
+        return false;
+    }
+
+    uint32_t     hash  = dns_cache_hash(key, name_len, qtype, qclass);
+    dns_shard_t *shard = dns_shards_get(&cache->table, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    dns_shard_node_t **link = dns_cache_find(shard, hash, key, name_len, qtype, qclass);
+    if (NULL != link) {
+        dns_cache_unlink(cache, shard, link);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return NULL != link;
+}
+
+void dns_cache_stats(dns_cache_t *cache, dns_cache_stats_t *stats)
+{
+    dns_shards_stats(NULL != cache ? &cache->table : NULL, stats);
+}
+
+#ifdef DNS_CACHE_TEST
+#include <time.h>
+#include "dns_class.h"
+#include "dns_message.h"
+#include "dns_type.h"
+
+#define TEST_THREADS 4
+#define TEST_NAMES   1024
+
+static size_t test_query(uint8_t *buf, size_t size, const char *qname, dns_type_t qtype)
+{
+    uint8_t        arena[1024];
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    dns_header_set_id(&msg.header, 0x2323);
+    dns_flags_set_rd(&msg.header.flags, DNS_RD_YES);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, qname);
+    dns_question_set_qtype(&question, qtype);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+
+    int len = dns_message_serialize(&msg, buf, size);
+    dns_message_clear(&msg);
+    return len > 0 ? len : 0;
+}
+
+/**
+ * @brief 查询缓存并检查回答的记录数和TTL
+ */
+static bool test_lookup(dns_cache_t *cache, const char *qname, dns_type_t qtype, uint32_t now, int expect, uint32_t expect_ttl)
+{
+    uint8_t     packet[512];
+    dns_reply_t reply;
+    size_t      len = test_query(packet, sizeof(packet), qname, qtype);
+    if (!dns_reply_init(&reply, packet, len, sizeof(packet))) {
+        return false;
+    }
+
+    int added = dns_cache_answer(cache, &reply, now);
+    len       = dns_reply_finish(&reply);
+
+    dns_message_t msg;
+    dns_message_init(&msg);
+    bool ok = dns_message_deserialize(&msg, packet, len) > 0 && added == expect;
+    ok      = ok && dns_message_count(&msg, DNS_SECTION_ANSWER) == expect && dns_header_get_id(&msg.header) == 0x2323;
+    for (int i = 0; ok && i < expect; i++) {
+        ok = dns_answer_get_ttl(&msg.answers[i]) == expect_ttl && dns_answer_get_type(&msg.answers[i]) == qtype;
+    }
+    dns_message_clear(&msg);
+    printf("  %-20s %-5s now=%u: %d records %s\n", qname, dns_type_name(qtype), now, added, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+typedef struct {
+    dns_cache_t *cache;
+    int          index;
+    bool         ok;
+} test_thread_t;
+
+static void *test_thread(void *arg)
+{
+    test_thread_t *t = (test_thread_t *)arg;
+    uint8_t        ip[4] = {10, 0, 0, 0};
+    uint8_t        packet[512];
+    char           name[64];
+
+    // 各线程写入互不相同的名称，同时查询其它线程的名称
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < TEST_NAMES; i++) {
+            snprintf(name, sizeof(name), "host%d-%d.example.com", t->index, i);
+            ip[3] = i & 0xFF;
+            dns_cache_rdata_t rdata = {ip, sizeof(ip)};
+            t->ok = t->ok && dns_cache_insert(t->cache, name, DNS_TYPE_A, DNS_CLASS_IN, 300, &rdata, 1, 1000);
+
+            snprintf(name, sizeof(name), "host%d-%d.example.com", (t->index + 1) % TEST_THREADS, i);
+            dns_reply_t reply;
+            size_t      len = test_query(packet, sizeof(packet), name, DNS_TYPE_A);
+            t->ok = t->ok && dns_reply_init(&reply, packet, len, sizeof(packet)) && dns_cache_answer(t->cache, &reply, 1001) >= 0;
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    bool        ok = true;
+    dns_cache_t cache;
+    ok = ok && dns_cache_init(&cache, 4, 64);
+
+    uint8_t           ip1[] = {192, 0, 2, 1}, ip2[] = {192, 0, 2, 2};
+    dns_cache_rdata_t a[]   = {{ip1, sizeof(ip1)}, {ip2, sizeof(ip2)}};
+    dns_cache_rdata_t txt[] = {{(const uint8_t *)"\x05hello", 6}};
+    ok = ok && dns_cache_insert(&cache, "www.Example.com", DNS_TYPE_A, DNS_CLASS_IN, 300, a, 2, 1000);
+    ok = ok && dns_cache_insert(&cache, "www.example.com", DNS_TYPE_TXT, DNS_CLASS_IN, 60, txt, 1, 1000);
+    ok = ok && !dns_cache_insert(&cache, "bad..name", DNS_TYPE_A, DNS_CLASS_IN, 60, a, 1, 1000);
+
+    // 键不区分大小写，TTL在输出时递减，到期后删除
+    printf("lookup:\n");
+    ok = test_lookup(&cache, "WWW.example.COM", DNS_TYPE_A, 1000, 2, 300) && ok;
+    ok = test_lookup(&cache, "www.example.com", DNS_TYPE_A, 1100, 2, 200) && ok;
+    ok = test_lookup(&cache, "www.example.com", DNS_TYPE_TXT, 1059, 1, 1) && ok;
+    ok = test_lookup(&cache, "www.example.com", DNS_TYPE_TXT, 1060, 0, 0) && ok;
+    ok = test_lookup(&cache, "www.example.com", DNS_TYPE_AAAA, 1000, 0, 0) && ok;
+    ok = test_lookup(&cache, "example.com", DNS_TYPE_A, 1000, 0, 0) && ok;
+
+    // 替换后使用新的数据和TTL
+    ok = ok && dns_cache_insert(&cache, "www.example.com", DNS_TYPE_A, DNS_CLASS_IN, 30, a, 1, 1200);
+    ok = test_lookup(&cache, "www.example.com", DNS_TYPE_A, 1210, 1, 20) && ok;
+
+    // 缓冲区不足时响应不变
+    uint8_t     packet[64];
+    dns_reply_t reply;
+    size_t      len = test_query(packet, sizeof(packet), "www.example.com", DNS_TYPE_A);
+    ok = ok && dns_cache_insert(&cache, "www.example.com", DNS_TYPE_A, DNS_CLASS_IN, 30, a, 2, 1200);
+    ok = ok && dns_reply_init(&reply, packet, len, len + 20);
+    ok = ok && dns_cache_answer(&cache, &reply, 1200) == -1 && reply.len == len && reply.counts[DNS_SECTION_ANSWER] == 0;
+
+    ok = ok && dns_cache_remove(&cache, "WWW.EXAMPLE.COM", DNS_TYPE_A, DNS_CLASS_IN);
+    ok = ok && !dns_cache_remove(&cache, "www.example.com", DNS_TYPE_A, DNS_CLASS_IN);
+
+    // 分片满时淘汰最久未使用的条目
+    char name[64];
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "n%d.example.com", i);
+        ok = ok && dns_cache_insert(&cache, name, DNS_TYPE_A, DNS_CLASS_IN, 300, a, 1, 1000);
+    }
+    dns_cache_stats_t stats;
+    dns_cache_stats(&cache, &stats);
+    printf("stats: entries=%llu hits=%llu misses=%llu expired=%llu evictions=%llu\n", (unsigned long long)stats.entries,
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.expired,
+           (unsigned long long)stats.evictions);
+    ok = ok && stats.entries <= 64 && stats.evictions >= 200 - 64 && stats.hits == 5 && stats.expired == 1;
+    ok = ok && test_lookup(&cache, "n199.example.com", DNS_TYPE_A, 1000, 1, 300);
+    ok = ok && test_lookup(&cache, "n0.example.com", DNS_TYPE_A, 1000, 0, 0);
+    dns_cache_clear(&cache);
+
+    // 时间轮按到期时间释放条目，不需要查找；每次调用按预算分批
+    ok = ok && dns_cache_init(&cache, 4, 4096);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "ttl%d.example.com", i);
+        ok = ok && dns_cache_insert(&cache, name, DNS_TYPE_A, DNS_CLASS_IN, i < 600 ? 60 : 3600, a, 1, 1000);
+    }
+    ok = ok && 0 == dns_cache_expire(&cache, 1059, 1000);
+    int freed = 0, calls = 0;
+    for (int n = 1; n > 0; calls++) {
+        n      = dns_cache_expire(&cache, 1060, 100);
+        freed += n;
+    }
+    dns_cache_stats(&cache, &stats);
+    printf("expire: %d freed in %d calls, %llu left\n", freed, calls - 1, (unsigned long long)stats.entries);
+    ok = ok && 600 == freed && calls - 1 >= 6 && 400 == stats.entries && 600 == stats.expired;
+    ok = ok && test_lookup(&cache, "ttl700.example.com", DNS_TYPE_A, 1060, 1, 3540);
+
+    // 预算小于分片数时各分片轮流释放，不会只释放前几个分片
+    dns_cache_t small;
+    ok = ok && dns_cache_init(&small, 8, 1024);
+    for (int i = 0; i < 400; i++) {
+        snprintf(name, sizeof(name), "rot%d.example.com", i);
+        ok = ok && dns_cache_insert(&small, name, DNS_TYPE_A, DNS_CLASS_IN, 10, a, 1, 1000);
+    }
+    uint32_t before[8];
+    for (int i = 0; i < 8; i++) {
+        before[i] = small.table.shards[i].count;
+    }
+    for (int i = 0; i < 4; i++) {
+        ok = ok && 2 == dns_cache_expire(&small, 1010, 2);
+    }
+    int drained = 0;
+    for (int i = 0; i < 8; i++) {
+        drained += small.table.shards[i].count == before[i] - 1;
+    }
+    printf("expire: budget 2 x 4 calls touched %d/8 shards\n", drained);
+    ok = ok && 8 == drained;
+    dns_cache_clear(&small);
+
+    // 替换和删除的条目不会再被时间轮释放
+    ok = ok && dns_cache_insert(&cache, "ttl700.example.com", DNS_TYPE_A, DNS_CLASS_IN, 10, a, 1, 1060);
+    ok = ok && dns_cache_remove(&cache, "ttl701.example.com", DNS_TYPE_A, DNS_CLASS_IN);
+    ok = ok && 1 == dns_cache_expire(&cache, 1070, 1000) && 398 == dns_cache_expire(&cache, 4600, 1000);
+    dns_cache_stats(&cache, &stats);
+    ok = ok && 0 == stats.entries;
+    dns_cache_clear(&cache);
+
+    // 多线程同时插入和查找
+    ok = ok && dns_cache_init(&cache, 16, TEST_THREADS * TEST_NAMES * 2);
+    pthread_t     threads[TEST_THREADS];
+    test_thread_t args[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++) {
+        args[i] = (test_thread_t){&cache, i, true};
+        pthread_create(&threads[i], NULL, test_thread, &args[i]);
+    }
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        ok = ok && args[i].ok;
+    }
+    dns_cache_stats(&cache, &stats);
+    printf("threads: entries=%llu hits=%llu misses=%llu\n", (unsigned long long)stats.entries, (unsigned long long)stats.hits,
+           (unsigned long long)stats.misses);
+    ok = ok && stats.entries == TEST_THREADS * TEST_NAMES && stats.evictions == 0;
+
+    // 命中路径的耗时：问题名称小写、哈希、查找、追加记录
+    uint8_t query[64];
+    len = test_query(query, sizeof(query), "host0-7.example.com", DNS_TYPE_A);
+    struct timespec start, end;
+    int             loops = 1000000;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < loops; i++) {
+        memcpy(packet, query, len);
+        dns_reply_init(&reply, packet, len, sizeof(packet));
+        ok = ok && dns_cache_answer(&cache, &reply, 1001) == 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / loops;
+    printf("hit: %.1f ns/lookup\n", ns);
+    dns_cache_clear(&cache);
+
+    printf("%s\n", ok ? "all ok" : "failed");
+    return ok ? 0 : 1;
+}
+#endif  // DNS_CACHE_TEST
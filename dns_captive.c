@@ -0,0 +1,146 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_captive.h"
+#include "dns_class.h"
+#include "dns_reply.h"
+#include "dns_type.h"
+
+void dns_captive_init(dns_captive_t *captive, const uint8_t ip[4], uint32_t ttl)
+{
+    if (NULL == captive || NULL == ip) {
+        return;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        captive->ip[i] = ip[i];
+    }
+    captive->ttl = ttl;
+}
+
+size_t dns_captive_respond(const dns_captive_t *captive, uint8_t *packet, size_t len, size_t size)
+{
+    // 不回复响应报文，避免两个应答器互相回复
+    if (NULL == captive || size < len || !dns_reply_is_query(packet, len)) {
+        return 0;
+    }
+
+    dns_reply_t reply;
+    if (!dns_reply_init(&reply, packet, len, size)) {
+        return dns_reply_error(packet, len, DNS_RCODE_FORMERR);
+    }
+
+    if (((reply.flags >> DNS_FLAGS_INDEX_OPCODE) & 0xF) != DNS_OPCODE_QUERY) {
+        return dns_reply_error(packet, len, DNS_RCODE_NOTIMP);
+    }
+
+    dns_reply_set_aa(&reply, DNS_AA_YES);
+    dns_reply_set_ra(&reply, DNS_RA_YES);
+
+    if (DNS_CLASS_IN != reply.qclass) {
+        dns_reply_set_rcode(&reply, DNS_RCODE_REFUSED);
+        return dns_reply_finish(&reply);
+    }
+
+    // AAAA等其它类型返回NODATA，客户端会退回到A查询
+    if (DNS_TYPE_A == reply.qtype && !dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, captive->ttl, captive->ip, 4)) {
+        return 0;
+    }
+
+    return dns_reply_finish(&reply);
+}
+
+#ifdef DNS_CAPTIVE_TEST
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "dns_message.h"
+
+#define TEST_LOOPS 1000000
+
+static int test_build_query(uint16_t id, const char *qname, dns_type_t qtype, uint8_t *buf, size_t buf_size)
+{
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, id);
+    dns_flags_set_rd(&msg.header.flags, DNS_RD_YES);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, qname);
+    dns_question_set_qtype(&question, qtype);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+    int len = dns_message_serialize(&msg, buf, buf_size);
+    dns_message_clear(&msg);
+    return len;
+}
+
+static bool test_check(const char *title, const uint8_t *packet, size_t len, uint16_t id, dns_rcode_t rcode, uint16_t answers)
+{
+    char          text[2048];
+    dns_message_t msg;
+    dns_message_init(&msg);
+    bool ok = len > 0 && dns_message_deserialize(&msg, packet, len) == (int)len;
+    ok = ok && dns_header_get_id(&msg.header) == id;
+    ok = ok && dns_flags_get_qr(msg.header.flags) == DNS_QR_RESPONSE;
+    ok = ok && (DNS_RCODE_FORMERR == rcode || dns_flags_get_aa(msg.header.flags) == DNS_AA_YES);
+    ok = ok && dns_flags_get_rcode(msg.header.flags) == rcode;
+    ok = ok && dns_message_count(&msg, DNS_SECTION_ANSWER) == answers;
+    if (ok) {
+        dns_message_to_string(&msg, text, sizeof(text));
+        printf("%s\n", text);
+    }
+    dns_message_clear(&msg);
+    printf("%s: %s len=%zu\n", title, ok ? "ok" : "failed", len);
+    return ok;
+}
+
+int main(void)
+{
+    dns_captive_t captive;
+    uint8_t       gateway[] = {192, 168, 4, 1};
+    dns_captive_init(&captive, gateway, DNS_CAPTIVE_TTL);
+
+    uint8_t packet[512];
+    bool    ok = true;
+
+    int    len   = test_build_query(0x1234, "apmode.enplus.com", DNS_TYPE_A, packet, sizeof(packet));
+    size_t reply = dns_captive_respond(&captive, packet, len, sizeof(packet));
+    ok = test_check("A", packet, reply, 0x1234, DNS_RCODE_NOERROR, 1) && ok;
+    ok = ok && 0 == memcmp(packet + reply - 4, gateway, 4) && packet[len] == 0xC0 && packet[len + 1] == 0x0C;
+
+    // 查询的CD位复制到响应中
+    len        = test_build_query(0x2345, "apmode.enplus.com", DNS_TYPE_AAAA, packet, sizeof(packet));
+    packet[3] |= 1 << DNS_FLAGS_INDEX_CD;
+    reply      = dns_captive_respond(&captive, packet, len, sizeof(packet));
+    ok         = test_check("AAAA", packet, reply, 0x2345, DNS_RCODE_NOERROR, 0) && ok;
+    ok         = ok && (packet[3] & (1 << DNS_FLAGS_INDEX_CD));
+
+    // 再次送入响应不会被回复
+    ok = ok && 0 == dns_captive_respond(&captive, packet, reply, sizeof(packet));
+
+    // 截断的问题返回FORMERR
+    len   = test_build_query(0x3456, "apmode.enplus.com", DNS_TYPE_A, packet, sizeof(packet));
+    reply = dns_captive_respond(&captive, packet, len - 3, sizeof(packet));
+    ok    = test_check("truncated", packet, reply, 0x3456, DNS_RCODE_FORMERR, 0) && ok;
+
+    // 缓冲区放不下回答时不回复
+    len = test_build_query(0x4567, "apmode.enplus.com", DNS_TYPE_A, packet, sizeof(packet));
+    ok  = ok && 0 == dns_captive_respond(&captive, packet, len, len + 8);
+
+    uint8_t query[512];
+    len = test_build_query(0x5678, "connectivitycheck.gstatic.com", DNS_TYPE_A, query, sizeof(query));
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < TEST_LOOPS; i++) {
+        memcpy(packet, query, len);
+        reply = dns_captive_respond(&captive, packet, len, sizeof(packet));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / TEST_LOOPS;
+    printf("respond %.1f ns/op\n", ns);
+
+    return ok ? 0 : 1;
+}
+#endif  // DNS_CAPTIVE_TEST
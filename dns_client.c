@@ -0,0 +1,543 @@
+#define _GNU_SOURCE  // struct mmsghdr（测试中使用dns_udp_server）
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dns_client.h"
+#include "dns_error.h"
+#include "dns_flags.h"
+#include "dns_name.h"
+#include "dns_type.h"
+
+#define DNS_CLIENT_HEADER_SIZE 12
+#define DNS_CLIENT_OPT_SIZE    11 // 根名称1 + 类型2 + 类2 + TTL4 + 长度2
+
+static uint64_t dns_client_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint16_t dns_client_random(dns_client_t *client)
+{
+    // xorshift64，事务ID不可预测即可，不需要密码学强度
+    uint64_t x = client->rand_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    client->rand_state = x;
+    return (x >> 16) & 0xFFFF;
+}
+
+bool dns_client_init(dns_client_t *client, const char *ip, uint16_t port, int max_pending, uint32_t rto_ms, uint32_t timeout_ms)
+{
+    if (NULL == client || NULL == ip || max_pending < 1 || max_pending > UINT16_MAX || rto_ms < 1 || timeout_ms < rto_ms) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t               addr_len = 0;
+    memset(&addr, 0, sizeof(addr));
+
+    struct sockaddr_in  *addr4 = (struct sockaddr_in *)&addr;
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+    if (inet_pton(AF_INET, ip, &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port   = htons(port);
+        addr_len          = sizeof(struct sockaddr_in);
+    } else if (inet_pton(AF_INET6, ip, &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port   = htons(port);
+        addr_len           = sizeof(struct sockaddr_in6);
+    } else {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(client, 0, sizeof(dns_client_t));
+    client->max_pending = max_pending;
+    client->rto_ms      = rto_ms;
+    client->timeout_ms  = timeout_ms;
+    client->next_timer  = UINT64_MAX;
+    client->queries     = (dns_client_query_t *)calloc(max_pending, sizeof(dns_client_query_t));
+    client->free_slots  = (uint16_t *)malloc(max_pending * sizeof(uint16_t));
+    client->by_id       = (uint16_t *)calloc(UINT16_MAX + 1, sizeof(uint16_t));
+    if (NULL == client->queries || NULL == client->free_slots || NULL == client->by_id) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        client->fd = -1;
+        dns_client_clear(client);
+        return false;
+    }
+
+    // 栈顶是槽位0
+    for (int i = 0; i < max_pending; i++) {
+        client->free_slots[i] = max_pending - 1 - i;
+    }
+    client->free_count = max_pending;
+
+    if (getrandom(&client->rand_state, sizeof(client->rand_state), 0) != sizeof(client->rand_state)) {
+        client->rand_state = dns_client_now_ms() ^ ((uint64_t)getpid() << 32);
+    }
+    client->rand_state |= 1;
+
+    // 连接后内核丢弃来自其它地址的报文
+    client->fd = socket(addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        dns_client_clear(client);
+        return false;
+    }
+
+    return true;
+}
+
+void dns_client_clear(dns_client_t *client)
+{
+    if (NULL == client) {
+        return;
+    }
+
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    free(client->queries);
+    free(client->free_slots);
+    free(client->by_id);
+    memset(client, 0, sizeof(dns_client_t));
+    client->fd = -1;
+}
+
+static void dns_client_release(dns_client_t *client, int slot)
+{
+    dns_client_query_t *query = &client->queries[slot];
+    uint16_t            id    = (query->query[0] << 8) | query->query[1];
+
+    client->by_id[id] = 0;
+    query->callback    = NULL;
+    client->free_slots[client->free_count++] = slot;
+}
+
+/**
+ * @brief 结束一个查询：先释放槽位再回调，回调中可以立即发出新的查询
+ */
+static void dns_client_finish(dns_client_t *client, int slot, dns_client_status_t status, const uint8_t *response, size_t len)
+{
+    dns_client_query_t   *query    = &client->queries[slot];
+    dns_client_callback_t callback = query->callback;
+    void                 *arg      = query->arg;
+
+    dns_client_release(client, slot);
+    callback(arg, status, response, len);
+}
+
+static bool dns_client_send(dns_client_t *client, dns_client_query_t *query)
+{
+    ssize_t n = send(client->fd, query->query, query->len, 0);
+    query->attempts += 1;
+    if (n == query->len) {
+        client->sent += 1;
+        return true;
+    }
+
+    // 发送缓冲区满时视为丢包，等待重传
+    return n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || ENOBUFS == errno);
+}
+
+bool dns_client_query(dns_client_t *client, const uint8_t *question, size_t question_len, dns_client_callback_t callback, void *arg)
+{
+    if (NULL == client || NULL == client->queries || NULL == question || NULL == callback) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    if (question_len < 5 || DNS_CLIENT_HEADER_SIZE + question_len + DNS_CLIENT_OPT_SIZE > DNS_CLIENT_QUERY_SIZE) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    if (0 == client->free_count) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+
+    uint16_t id = dns_client_random(client);
+    while (0 != client->by_id[id]) {
+        id = dns_client_random(client);
+    }
+
+    int                 slot  = client->free_slots[--client->free_count];
+    dns_client_query_t *query = &client->queries[slot];
+    client->by_id[id]         = slot + 1;
+
+    uint16_t flags = 0;
+    dns_flags_set_rd(&flags, DNS_RD_YES);
+
+    uint8_t *p = query->query;
+    memset(p, 0, DNS_CLIENT_HEADER_SIZE);
+    p[0]  = id >> 8;
+    p[1]  = id & 0xFF;
+    p[2]  = flags >> 8;
+    p[3]  = flags & 0xFF;
+    p[5]  = 1;
+    p[11] = 1;
+    memcpy(p + DNS_CLIENT_HEADER_SIZE, question, question_len);
+
+    // EDNS OPT，通告可以接收更大的UDP响应
+    uint8_t *opt = p + DNS_CLIENT_HEADER_SIZE + question_len;
+    memset(opt, 0, DNS_CLIENT_OPT_SIZE);
+    opt[2] = DNS_TYPE_OPT;
+    opt[3] = DNS_CLIENT_EDNS_SIZE >> 8;
+    opt[4] = DNS_CLIENT_EDNS_SIZE & 0xFF;
+
+    uint64_t now        = dns_client_now_ms();
+    query->callback     = callback;
+    query->arg          = arg;
+    query->len          = DNS_CLIENT_HEADER_SIZE + question_len + DNS_CLIENT_OPT_SIZE;
+    query->question_len = question_len;
+    query->deadline     = now + client->timeout_ms;
+    query->rto          = client->rto_ms;
+    query->retransmit   = now + query->rto;
+    query->attempts     = 0;
+    if (query->retransmit < client->next_timer) {
+        client->next_timer = query->retransmit;
+    }
+
+    if (!dns_client_send(client, query)) {
+        dns_error_raise(DNS_ERROR_IO);
+        dns_client_release(client, slot);
+        return false;
+    }
+
+    return true;
+}
+
+bool dns_client_resolve(dns_client_t *client, const char *name, uint16_t qtype, uint16_t qclass, dns_client_callback_t callback, void *arg)
+{
+    char question[DNS_NAME_MAX_LENGTH + 4 + 1];
+    if (NULL == name || NULL == dns_name_encode(name, question, DNS_NAME_MAX_LENGTH + 1)) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    // 编码不检查标签长度，这里补上
+    size_t name_len = strlen(question) + 1;
+    for (size_t i = 0; i + 1 < name_len; i += (uint8_t)question[i] + 1) {
+        if ((uint8_t)question[i] > DNS_NAME_MAX_LABEL) {
+            dns_error_raise(DNS_ERROR_NAME_LABEL);
+            return false;
+        }
+    }
+
+    uint8_t *p = (uint8_t *)question + name_len;
+    p[0] = qtype >> 8;
+    p[1] = qtype & 0xFF;
+    p[2] = qclass >> 8;
+    p[3] = qclass & 0xFF;
+    return dns_client_query(client, (const uint8_t *)question, name_len + 4, callback, arg);
+}
+
+/**
+ * @brief 比较问题，名称不区分大小写（服务器可能保留0x20随机大小写），类型和类逐字节比较
+ * @param len 问题长度，包括名称之后的4字节类型和类
+ */
+static bool dns_client_question_equal(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    // 标签长度都小于64，不受大小写转换影响
+    size_t name_len = len - 4;
+    for (size_t i = 0; i < name_len; i++) {
+        uint8_t ca = a[i], cb = b[i];
+        if (ca != cb) {
+            if (ca >= 'A' && ca <= 'Z') {
+                ca += 'a' - 'A';
+            }
+            if (cb >= 'A' && cb <= 'Z') {
+                cb += 'a' - 'A';
+            }
+            if (ca != cb) {
+                return false;
+            }
+        }
+    }
+    return memcmp(a + name_len, b + name_len, 4) == 0;
+}
+
+/**
+ * @brief 处理一个收到的响应
+ * @return bool 匹配到查询返回true
+ */
+static bool dns_client_on_response(dns_client_t *client, const uint8_t *response, size_t len)
+{
+    client->received += 1;
+
+    // 事务ID和问题都相同才接受，防止迟到的响应或伪造的响应匹配到新查询
+    uint16_t id   = (response[0] << 8) | response[1];
+    int      slot = len >= DNS_CLIENT_HEADER_SIZE ? client->by_id[id] - 1 : -1;
+    if (slot < 0 || 0 == (response[2] & 0x80) || response[4] != 0 || response[5] != 1) {
+        client->mismatched += 1;
+        return false;
+    }
+
+    dns_client_query_t *query = &client->queries[slot];
+    if (len < DNS_CLIENT_HEADER_SIZE + (size_t)query->question_len ||
+        !dns_client_question_equal(response + DNS_CLIENT_HEADER_SIZE, query->query + DNS_CLIENT_HEADER_SIZE, query->question_len)) {
+        client->mismatched += 1;
+        return false;
+    }
+
+    dns_client_finish(client, slot, DNS_CLIENT_OK, response, len);
+    return true;
+}
+
+/**
+ * @brief 处理到期的重传和超时，并重新计算最早的定时时刻
+ */
+static int dns_client_on_timer(dns_client_t *client, uint64_t now)
+{
+    int      finished = 0;
+    uint64_t next     = UINT64_MAX;
+
+    for (int i = 0; i < client->max_pending; i++) {
+        dns_client_query_t *query = &client->queries[i];
+        if (NULL == query->callback) {
+            continue;
+        }
+
+        if (now >= query->deadline) {
+            client->timeouts += 1;
+            finished         += 1;
+            dns_client_finish(client, i, DNS_CLIENT_TIMEOUT, NULL, 0);
+            continue;
+        }
+
+        if (now >= query->retransmit) {
+            // 指数退避，最后一次重传不晚于总超时
+            query->rto          *= 2;
+            query->retransmit    = now + query->rto;
+            client->retransmits += 1;
+            if (!dns_client_send(client, query)) {
+                finished += 1;
+                dns_client_finish(client, i, DNS_CLIENT_ERROR, NULL, 0);
+                continue;
+            }
+        }
+
+        uint64_t due = query->retransmit < query->deadline ? query->retransmit : query->deadline;
+        if (due < next) {
+            next = due;
+        }
+    }
+
+    // 回调中新发出的查询已经更新了next_timer
+    if (next < client->next_timer || client->next_timer <= now) {
+        client->next_timer = next;
+    }
+    return finished;
+}
+
+int dns_client_poll(dns_client_t *client, int timeout_ms)
+{
+    if (NULL == client || client->fd < 0) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    uint64_t now = dns_client_now_ms();
+    if (client->next_timer != UINT64_MAX) {
+        uint64_t wait = client->next_timer > now ? client->next_timer - now : 0;
+        if (wait < (uint64_t)timeout_ms) {
+            timeout_ms = wait;
+        }
+    }
+
+    struct pollfd pfd = {client->fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) < 0 && EINTR != errno) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int finished = 0;
+    for (int i = 0; i < DNS_CLIENT_RECV_BATCH; i++) {
+        ssize_t n = recv(client->fd, client->response, sizeof(client->response), 0);
+        if (n < 0) {
+            // ECONNREFUSED等ICMP错误只影响本次接收，查询仍按超时处理
+            if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                break;
+            }
+            continue;
+        }
+        finished += dns_client_on_response(client, client->response, n);
+    }
+
+    now = dns_client_now_ms();
+    if (now >= client->next_timer) {
+        finished += dns_client_on_timer(client, now);
+    }
+
+    return finished;
+}
+
+int dns_client_pending(const dns_client_t *client)
+{
+    if (NULL == client) {
+        return 0;
+    }
+
+    return client->max_pending - client->free_count;
+}
+
+#ifdef DNS_CLIENT_TEST
+#include <pthread.h>
+#include <stdio.h>
+#include "dns_class.h"
+#include "dns_reply.h"
+#include "dns_udp_server.h"
+
+#define TEST_QUERIES 2000
+#define TEST_WINDOW  256
+
+/**
+ * @brief 本地应答器：事务ID是5的倍数的查询第一次到达时被丢弃，以触发重传，
+ *       "timeout"开头的名称从不回复，"spoof"开头的名称回复一个问题被改动的响应
+ */
+typedef struct {
+    uint8_t dropped[UINT16_MAX + 1];
+} test_responder_t;
+
+static size_t test_responder(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    test_responder_t *responder = (test_responder_t *)arg;
+    (void)peer;
+    (void)peer_len;
+    uint16_t id = (packet[0] << 8) | packet[1];
+    if (id % 5 == 0 && !responder->dropped[id]) {
+        responder->dropped[id] = 1;
+        return 0;
+    }
+
+    dns_reply_t reply;
+    if (!dns_reply_init(&reply, packet, len, size)) {
+        return 0;
+    }
+
+    const char *qname = (const char *)packet + 13;
+    if (strncmp(qname, "timeout", 7) == 0) {
+        return 0;
+    }
+    if (strncmp(qname, "spoof", 5) == 0) {
+        packet[13] ^= 0x01;
+    }
+
+    // 0x20：把名称第一个字母改成大写回显，客户端仍应接受
+    if (packet[13] >= 'a' && packet[13] <= 'z') {
+        packet[13] -= 'a' - 'A';
+    }
+
+    uint8_t ip[] = {10, 0, 0, 1};
+    dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 60, ip, sizeof(ip));
+    return dns_reply_finish(&reply);
+}
+
+static void *test_server_thread(void *arg)
+{
+    dns_udp_server_run((dns_udp_server_t *)arg);
+    return NULL;
+}
+
+typedef struct {
+    int ok;
+    int timeout;
+    int error;
+} test_result_t;
+
+static void test_callback(void *arg, dns_client_status_t status, const uint8_t *response, size_t len)
+{
+    test_result_t *result = (test_result_t *)arg;
+    switch (status) {
+    case DNS_CLIENT_OK:
+        result->ok += len > 12 && response[7] == 1;
+        break;
+    case DNS_CLIENT_TIMEOUT:
+        result->timeout += 1;
+        break;
+    default:
+        result->error += 1;
+        break;
+    }
+}
+
+int main(void)
+{
+    // 名称不区分大小写，类型0x0041与0x0061不能因为大小写转换而相等
+    const uint8_t q41[] = {3, 'W', 'w', 'W', 0, 0x00, 0x41, 0x00, 0x01};
+    const uint8_t q61[] = {3, 'w', 'w', 'w', 0, 0x00, 0x61, 0x00, 0x01};
+    const uint8_t q41_lower[] = {3, 'w', 'w', 'w', 0, 0x00, 0x41, 0x00, 0x01};
+    bool question_ok = !dns_client_question_equal(q41, q61, sizeof(q41)) && dns_client_question_equal(q41, q41_lower, sizeof(q41));
+    printf("question compare: %s\n", question_ok ? "ok" : "failed");
+
+    int fd = dns_udp_socket_open("127.0.0.1", 0, false);
+    test_responder_t *responder = (test_responder_t *)calloc(1, sizeof(test_responder_t));
+    dns_udp_server_t *server    = (dns_udp_server_t *)malloc(sizeof(dns_udp_server_t));
+    dns_udp_server_init(server, fd, test_responder, responder);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_thread, server);
+
+    dns_client_t client;
+    if (!dns_client_init(&client, "127.0.0.1", dns_udp_socket_port(fd), 1024, 50, 1000)) {
+        printf("init failed: %s\n", dns_error_name(dns_error_last()));
+        return 1;
+    }
+
+    test_result_t result  = {0};
+    test_result_t special = {0};
+    dns_client_resolve(&client, "timeout.example.com", DNS_TYPE_A, DNS_CLASS_IN, test_callback, &special);
+    dns_client_resolve(&client, "spoof.example.com", DNS_TYPE_A, DNS_CLASS_IN, test_callback, &special);
+    bool rejected = !dns_client_resolve(&client, "bad.this-label-is-longer-than-the-sixty-three-bytes-allowed-by-rfc-1035.com", DNS_TYPE_A, DNS_CLASS_IN, test_callback, &special);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // 保持TEST_WINDOW个查询在途，避免一次性灌满本地套接字缓冲区
+    char name[64];
+    int  issued = 0;
+    while (issued < TEST_QUERIES || dns_client_pending(&client) > 0) {
+        while (issued < TEST_QUERIES && dns_client_pending(&client) < TEST_WINDOW) {
+            snprintf(name, sizeof(name), "host%d.example.com", issued++);
+            dns_client_resolve(&client, name, DNS_TYPE_A, DNS_CLASS_IN, test_callback, &result);
+        }
+        dns_client_poll(&client, 100);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+    printf("ok=%d timeout=%d error=%d special timeout=%d rejected=%d in %.1f ms\n",
+           result.ok, result.timeout, result.error, special.timeout, rejected, ms);
+    printf("sent=%llu retransmits=%llu received=%llu mismatched=%llu timeouts=%llu\n",
+           (unsigned long long)client.sent,
+           (unsigned long long)client.retransmits,
+           (unsigned long long)client.received,
+           (unsigned long long)client.mismatched,
+           (unsigned long long)client.timeouts);
+
+    bool ok = TEST_QUERIES == result.ok && 2 == special.timeout && 0 == special.ok && rejected;
+    ok = ok && client.retransmits > 0;
+
+    dns_udp_server_stop(server);
+    pthread_join(thread, NULL);
+    dns_client_clear(&client);
+    free(responder);
+    free(server);
+    close(fd);
+    return ok && question_ok ? 0 : 1;
+}
+#endif  // DNS_CLIENT_TEST
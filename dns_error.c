@@ -0,0 +1,110 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dns_error.h"
+
+#ifdef DNS_ERROR_TRACE
+void DNS_ERROR_TRACE(dns_error_t error, const char *func, int line);
+#endif
+
+static _Thread_local dns_error_t dns_error_last_error = DNS_OK;
+
+// 只统计次数，不需要与其它内存操作排序，relaxed即可
+static _Atomic uint64_t dns_error_counters[DNS_ERROR_MAX];
+
+static const char *dns_error_names[DNS_ERROR_MAX] = {
+    [DNS_OK]                     = "ok",
+    [DNS_ERROR_INVALID_PARAM]    = "invalid_param",
+    [DNS_ERROR_TRUNCATED]        = "truncated",
+    [DNS_ERROR_BUFFER_TOO_SMALL] = "buffer_too_small",
+    [DNS_ERROR_NAME_LABEL]       = "name_label",
+    [DNS_ERROR_NAME_TOO_LONG]    = "name_too_long",
+    [DNS_ERROR_NAME_POINTER]     = "name_pointer",
+    [DNS_ERROR_RDATA]            = "rdata",
+    [DNS_ERROR_NO_MEMORY]        = "no_memory",
+    [DNS_ERROR_IO]               = "io",
+};
+
+void dns_error_raise_at(dns_error_t error, const char *func, int line)
+{
+    if (error <= DNS_OK || error >= DNS_ERROR_MAX) {
+        return;
+    }
+
+    dns_error_last_error = error;
+    atomic_fetch_add_explicit(&dns_error_counters[error], 1, memory_order_relaxed);
+
+#ifdef DNS_ERROR_TRACE
+    DNS_ERROR_TRACE(error, func, line);
+#else
+    (void)func;
+    (void)line;
+#endif
+}
+
+dns_error_t dns_error_last(void)
+{
+    return dns_error_last_error;
+}
+
+void dns_error_clear(void)
+{
+    dns_error_last_error = DNS_OK;
+}
+
+const char *dns_error_name(dns_error_t error)
+{
+    if (error < DNS_OK || error >= DNS_ERROR_MAX) {
+        return "unknown";
+    }
+
+    return dns_error_names[error];
+}
+
+uint64_t dns_error_count(dns_error_t error)
+{
+    if (error < DNS_OK || error >= DNS_ERROR_MAX) {
+        return 0;
+    }
+
+    return atomic_load_explicit(&dns_error_counters[error], memory_order_relaxed);
+}
+
+void dns_error_count_reset(void)
+{
+    for (int i = 0; i < DNS_ERROR_MAX; i++) {
+        atomic_store_explicit(&dns_error_counters[i], 0, memory_order_relaxed);
+    }
+}
+
+void dns_error_trace_print(dns_error_t error, const char *func, int line)
+{
+    fprintf(stderr, "%s, %d: %s\n", func ? func : "?", line, dns_error_name(error));
+}
+
+#ifdef DNS_ERROR_TEST
+int main(void)
+{
+    dns_error_raise(DNS_ERROR_TRUNCATED);
+    dns_error_raise(DNS_ERROR_TRUNCATED);
+    dns_error_raise(DNS_ERROR_NAME_POINTER);
+    dns_error_raise(DNS_ERROR_MAX);
+
+    printf("last=%s\n", dns_error_name(dns_error_last()));
+    for (int i = DNS_OK; i < DNS_ERROR_MAX; i++) {
+        printf("%-16s %llu\n", dns_error_name(i), (unsigned long long)dns_error_count(i));
+    }
+
+    int ok = dns_error_last() == DNS_ERROR_NAME_POINTER
+          && dns_error_count(DNS_ERROR_TRUNCATED) == 2
+          && dns_error_count(DNS_ERROR_MAX) == 0;
+
+    dns_error_clear();
+    dns_error_count_reset();
+    ok = ok && dns_error_last() == DNS_OK && dns_error_count(DNS_ERROR_TRUNCATED) == 0;
+    printf("%s\n", ok ? "ok" : "failed");
+
+    return ok ? 0 : 1;
+}
+#endif  // DNS_ERROR_TEST
@@ -0,0 +1,628 @@
+#define _GNU_SOURCE  // struct mmsghdr（dns_udp_server.h）
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "dns_error.h"
+#include "dns_forwarder.h"
+#include "dns_reply.h"
+#include "dns_type.h"
+
+#define DNS_FORWARDER_HEADER_SIZE 12
+#define DNS_FORWARDER_POLL_MS     100
+
+static uint32_t dns_forwarder_hash(const uint8_t *key, size_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void dns_forwarder_send(dns_forwarder_t *forwarder, const dns_forwarder_waiter_t *waiter, const uint8_t *packet, size_t len)
+{
+    ssize_t n = sendto(forwarder->server->fd, packet, len, 0, (const struct sockaddr *)&waiter->peer, waiter->peer_len);
+    if (n != (ssize_t)len) {
+        forwarder->dropped += 1;
+    }
+}
+
+/**
+ * @brief 在报文的附加段中查找EDNS OPT记录
+ * @param opt : 找到的OPT记录
+ * @return bool 找到返回true，报文无法解析或没有OPT返回false
+ */
+static bool dns_forwarder_find_opt(const uint8_t *packet, size_t len, dns_answer_view_t *opt)
+{
+    dns_message_view_t view;
+    dns_view_iter_t    iter;
+    if (!dns_message_view_parse(&view, packet, len) || !dns_message_view_iter_init(&view, DNS_SECTION_ADDITIONAL, &iter)) {
+        return false;
+    }
+
+    while (dns_message_view_next_answer(&iter, opt)) {
+        if (DNS_TYPE_OPT == opt->rtype) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 把上游响应改写为某个客户端的回复：事务ID、RD位和问题的大小写换成该客户端的，
+ *        并按客户端的EDNS能力去掉OPT或截断
+ * @param opt_offset : 响应中OPT记录的偏移
+ * @param opt_len    : 响应中OPT记录的长度，0表示没有OPT
+ * @return size_t 回复长度
+ */
+static size_t dns_forwarder_restamp(dns_forwarder_t *forwarder, const dns_forwarder_entry_t *entry, const dns_forwarder_waiter_t *waiter,
+                                    const uint8_t *response, size_t len, size_t opt_offset, size_t opt_len)
+{
+    uint8_t *reply = forwarder->reply;
+    memcpy(reply, response, len);
+    reply[0] = waiter->id >> 8;
+    reply[1] = waiter->id & 0xFF;
+    reply[2] = (reply[2] & ~(1 << (DNS_FLAGS_INDEX_RD - 8))) | (waiter->rd << (DNS_FLAGS_INDEX_RD - 8));
+    reply[3] = (reply[3] & ~(1 << DNS_FLAGS_INDEX_CD)) | (waiter->cd << DNS_FLAGS_INDEX_CD);
+    // 存根解析器已确认响应中的问题与键等长
+    memcpy(reply + DNS_FORWARDER_HEADER_SIZE, waiter->question, entry->key_len);
+
+    // 上游查询总是带EDNS，查询中没有OPT的客户端不能收到OPT（RFC 6891 §7）
+    if (0 == waiter->udp_size && opt_len > 0) {
+        uint16_t additional = ((reply[10] << 8) | reply[11]) - 1;
+        memmove(reply + opt_offset, reply + opt_offset + opt_len, len - opt_offset - opt_len);
+        len      -= opt_len;
+        reply[10] = additional >> 8;
+        reply[11] = additional & 0xFF;
+    }
+
+    // 超过客户端能接收的大小时回复截断的响应，由它改用TCP；EDNS客户端的截断响应保留OPT
+    size_t limit = waiter->udp_size > 0 ? waiter->udp_size : DNS_FORWARDER_UDP_SIZE;
+    if (len > limit) {
+        uint16_t flags = (reply[2] << 8) | reply[3];
+        dns_flags_set_tc(&flags, DNS_TC_YES);
+        reply[2] = flags >> 8;
+        reply[3] = flags & 0xFF;
+        memset(reply + 6, 0, 6);
+        len = DNS_FORWARDER_HEADER_SIZE + entry->key_len;
+        if (waiter->udp_size > 0 && opt_len > 0 && len + opt_len <= limit) {
+            memcpy(reply + len, response + opt_offset, opt_len);
+            len      += opt_len;
+            reply[11] = 1;
+        }
+    }
+
+    return len;
+}
+
+/**
+ * @brief 构造SERVFAIL回复
+ * @return size_t 回复长度
+ */
+static size_t dns_forwarder_servfail(dns_forwarder_t *forwarder, const dns_forwarder_entry_t *entry, const dns_forwarder_waiter_t *waiter)
+{
+    uint8_t *reply = forwarder->reply;
+    memset(reply, 0, DNS_FORWARDER_HEADER_SIZE);
+    reply[0] = waiter->id >> 8;
+    reply[1] = waiter->id & 0xFF;
+    reply[2] = waiter->rd << (DNS_FLAGS_INDEX_RD - 8);
+    reply[3] = waiter->cd << DNS_FLAGS_INDEX_CD;
+    reply[5] = 1;
+    memcpy(reply + DNS_FORWARDER_HEADER_SIZE, waiter->question, entry->key_len);
+
+    dns_reply_t r;
+    dns_reply_init(&r, reply, DNS_FORWARDER_HEADER_SIZE + entry->key_len, sizeof(forwarder->reply));
+    dns_reply_set_ra(&r, DNS_RA_YES);
+    dns_reply_set_rcode(&r, DNS_RCODE_SERVFAIL);
+    return dns_reply_finish(&r);
+}
+
+static void dns_forwarder_unlink(dns_forwarder_t *forwarder, dns_forwarder_entry_t *entry)
+{
+    dns_forwarder_entry_t **link = &forwarder->buckets[entry->hash & (DNS_FORWARDER_BUCKETS - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    forwarder->inflight -= 1;
+}
+
+static void dns_forwarder_entry_free(dns_forwarder_entry_t *entry)
+{
+    free(entry->waiters);
+    free(entry);
+}
+
+/**
+ * @brief 上游查询结束：把同一个响应分别改写后回复给所有等待的客户端
+ */
+static void dns_forwarder_on_upstream(void *arg, dns_client_status_t status, const uint8_t *response, size_t len)
+{
+    dns_forwarder_entry_t *entry     = (dns_forwarder_entry_t *)arg;
+    dns_forwarder_t       *forwarder = entry->forwarder;
+
+    dns_answer_view_t opt;
+    size_t            opt_offset = 0;
+    size_t            opt_len    = 0;
+    if (DNS_CLIENT_OK == status && dns_forwarder_find_opt(response, len, &opt)) {
+        opt_offset = opt.name_offset;
+        opt_len    = opt.rdata_offset + opt.rlength - opt.name_offset;
+    }
+
+    dns_forwarder_unlink(forwarder, entry);
+    for (int i = 0; i < entry->count; i++) {
+        const dns_forwarder_waiter_t *waiter = &entry->waiters[i];
+        if (DNS_CLIENT_OK == status && len <= sizeof(forwarder->reply)) {
+            forwarder->answered += 1;
+            size_t n = dns_forwarder_restamp(forwarder, entry, waiter, response, len, opt_offset, opt_len);
+            dns_forwarder_send(forwarder, waiter, forwarder->reply, n);
+        } else {
+            forwarder->servfail += 1;
+            dns_forwarder_send(forwarder, waiter, forwarder->reply, dns_forwarder_servfail(forwarder, entry, waiter));
+        }
+    }
+    dns_forwarder_entry_free(entry);
+}
+
+static bool dns_forwarder_add_waiter(dns_forwarder_entry_t *entry, const uint8_t *packet, size_t len, size_t question_len,
+                                     const struct sockaddr *peer, socklen_t peer_len)
+{
+    if (entry->count >= DNS_FORWARDER_WAITERS_MAX || peer_len > sizeof(struct sockaddr_storage)) {
+        return false;
+    }
+
+    if (entry->count == entry->capacity) {
+        int capacity = entry->capacity ? entry->capacity * 2 : 1;
+        dns_forwarder_waiter_t *waiters = (dns_forwarder_waiter_t *)realloc(entry->waiters, capacity * sizeof(dns_forwarder_waiter_t));
+        if (NULL == waiters) {
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
+            return false;
+        }
+        entry->waiters  = waiters;
+        entry->capacity = capacity;
+    }
+
+    dns_forwarder_waiter_t *waiter = &entry->waiters[entry->count++];
+    memcpy(&waiter->peer, peer, peer_len);
+    waiter->peer_len = peer_len;
+    waiter->id       = (packet[0] << 8) | packet[1];
+    waiter->rd       = (packet[2] >> (DNS_FLAGS_INDEX_RD - 8)) & 0x01;
+    waiter->cd       = (packet[3] >> DNS_FLAGS_INDEX_CD) & 0x01;
+    waiter->udp_size = 0;
+    memcpy(waiter->question, packet + DNS_FORWARDER_HEADER_SIZE, question_len);
+
+    // OPT的类字段是客户端能接收的UDP负载大小，小于512时按512处理（RFC 6891 §6.2.5）
+    dns_answer_view_t opt;
+    if (dns_forwarder_find_opt(packet, len, &opt)) {
+        waiter->udp_size = opt.rclass > DNS_FORWARDER_UDP_SIZE ? opt.rclass : DNS_FORWARDER_UDP_SIZE;
+    }
+    return true;
+}
+
+/**
+ * @brief 处理一个客户端查询：相同问题已在途时只登记等待，否则发出上游查询
+ * @return size_t 立即回复的长度，0表示稍后回复或丢弃
+ */
+static size_t dns_forwarder_on_query(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    dns_forwarder_t *forwarder = (dns_forwarder_t *)arg;
+    if (!dns_reply_is_query(packet, len)) {
+        return 0;
+    }
+
+    forwarder->queries += 1;
+    uint16_t flags = (packet[2] << 8) | packet[3];
+    if (((flags >> DNS_FLAGS_INDEX_OPCODE) & 0xF) != DNS_OPCODE_QUERY) {
+        return dns_reply_error(packet, len, DNS_RCODE_NOTIMP);
+    }
+
+    // 问题中的名称不应被压缩
+    int name_len = packet[4] == 0 && packet[5] == 1 ? dns_name_skip(packet, len, DNS_FORWARDER_HEADER_SIZE) : 0;
+    if (name_len < 1 || packet[DNS_FORWARDER_HEADER_SIZE + name_len - 1] != 0 || DNS_FORWARDER_HEADER_SIZE + (size_t)name_len + 4 > len) {
+        return dns_reply_error(packet, len, DNS_RCODE_FORMERR);
+    }
+
+    // 键是小写的问题，标签长度都小于64，不受转换影响
+    uint8_t key[DNS_NAME_MAX_LENGTH + 4];
+    size_t  key_len = name_len + 4;
+    for (size_t i = 0; i < key_len; i++) {
+        uint8_t c = packet[DNS_FORWARDER_HEADER_SIZE + i];
+        key[i] = (i < (size_t)name_len && c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    uint32_t               hash  = dns_forwarder_hash(key, key_len);
+    dns_forwarder_entry_t *entry = forwarder->buckets[hash & (DNS_FORWARDER_BUCKETS - 1)];
+    while (NULL != entry && (entry->hash != hash || entry->key_len != key_len || memcmp(entry->key, key, key_len) != 0)) {
+        entry = entry->next;
+    }
+
+    if (NULL != entry) {
+        if (dns_forwarder_add_waiter(entry, packet, len, key_len, peer, peer_len)) {
+            forwarder->coalesced += 1;
+        } else {
+            forwarder->dropped += 1;
+        }
+        return 0;
+    }
+
+    entry = (dns_forwarder_entry_t *)calloc(1, sizeof(dns_forwarder_entry_t));
+    if (NULL == entry || !dns_forwarder_add_waiter(entry, packet, len, key_len, peer, peer_len)) {
+        if (NULL != entry) {
+            dns_forwarder_entry_free(entry);
+        } else {
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
+        }
+        forwarder->dropped += 1;
+        return 0;
+    }
+    entry->forwarder = forwarder;
+    entry->hash      = hash;
+    entry->key_len   = key_len;
+    memcpy(entry->key, key, key_len);
+
+    if (!dns_client_query(&forwarder->client, key, key_len, dns_forwarder_on_upstream, entry)) {
+        dns_forwarder_entry_free(entry);
+        forwarder->servfail += 1;
+        dns_reply_t reply;
+        dns_reply_init(&reply, packet, len, size);
+        dns_reply_set_ra(&reply, DNS_RA_YES);
+        dns_reply_set_rcode(&reply, DNS_RCODE_SERVFAIL);
+        return dns_reply_finish(&reply);
+    }
+
+    entry->next = forwarder->buckets[hash & (DNS_FORWARDER_BUCKETS - 1)];
+    forwarder->buckets[hash & (DNS_FORWARDER_BUCKETS - 1)] = entry;
+    forwarder->inflight += 1;
+    forwarder->upstream += 1;
+    return 0;
+}
+
+bool dns_forwarder_init(dns_forwarder_t *forwarder, const char *ip, uint16_t port, const char *upstream_ip, uint16_t upstream_port,
+                        int max_pending, uint32_t rto_ms, uint32_t timeout_ms)
+{
+    if (NULL == forwarder || NULL == ip || NULL == upstream_ip) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(forwarder, 0, sizeof(dns_forwarder_t));
+    if (!dns_client_init(&forwarder->client, upstream_ip, upstream_port, max_pending, rto_ms, timeout_ms)) {
+        return false;
+    }
+
+    int fd = dns_udp_socket_open(ip, port, false);
+    forwarder->server = (dns_udp_server_t *)malloc(sizeof(dns_udp_server_t));
+    if (fd < 0 || NULL == forwarder->server || !dns_udp_server_init(forwarder->server, fd, dns_forwarder_on_query, forwarder)) {
+        if (NULL == forwarder->server) {
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(forwarder->server);
+        dns_client_clear(&forwarder->client);
+        memset(forwarder, 0, sizeof(dns_forwarder_t));
+        return false;
+    }
+
+    return true;
+}
+
+void dns_forwarder_clear(dns_forwarder_t *forwarder)
+{
+    if (NULL == forwarder) {
+        return;
+    }
+
+    for (int i = 0; i < DNS_FORWARDER_BUCKETS; i++) {
+        dns_forwarder_entry_t *entry = forwarder->buckets[i];
+        while (NULL != entry) {
+            dns_forwarder_entry_t *next = entry->next;
+            dns_forwarder_entry_free(entry);
+            entry = next;
+        }
+    }
+
+    dns_client_clear(&forwarder->client);
+    if (NULL != forwarder->server) {
+        close(forwarder->server->fd);
+        free(forwarder->server);
+    }
+    memset(forwarder, 0, sizeof(dns_forwarder_t));
+}
+
+uint16_t dns_forwarder_port(const dns_forwarder_t *forwarder)
+{
+    if (NULL == forwarder || NULL == forwarder->server) {
+        return 0;
+    }
+
+    return dns_udp_socket_port(forwarder->server->fd);
+}
+
+int dns_forwarder_poll(dns_forwarder_t *forwarder, int timeout_ms)
+{
+    if (NULL == forwarder || NULL == forwarder->server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    // 同时等待客户端和上游两个套接字，上游的重传和超时由dns_client_poll处理
+    struct pollfd pfds[2] = {
+        {forwarder->server->fd, POLLIN, 0},
+        {forwarder->client.fd, POLLIN, 0},
+    };
+    if (forwarder->inflight > 0 && timeout_ms > (int)forwarder->client.rto_ms) {
+        timeout_ms = forwarder->client.rto_ms;
+    }
+    if (poll(pfds, 2, timeout_ms) < 0 && EINTR != errno) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int events = 0;
+    if (pfds[0].revents & POLLIN) {
+        int n = dns_udp_server_poll(forwarder->server, 0);
+        if (n < 0) {
+            return -1;
+        }
+        events += n;
+    }
+
+    int n = dns_client_poll(&forwarder->client, 0);
+    if (n < 0) {
+        return -1;
+    }
+    return events + n;
+}
+
+bool dns_forwarder_run(dns_forwarder_t *forwarder)
+{
+    if (NULL == forwarder || NULL == forwarder->server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    while (atomic_load_explicit(&forwarder->server->running, memory_order_relaxed)) {
+        if (dns_forwarder_poll(forwarder, DNS_FORWARDER_POLL_MS) < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void dns_forwarder_stop(dns_forwarder_t *forwarder)
+{
+    if (NULL == forwarder || NULL == forwarder->server) {
+        return;
+    }
+
+    dns_udp_server_stop(forwarder->server);
+}
+
+#ifdef DNS_FORWARDER_TEST
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "dns_class.h"
+#include "dns_type.h"
+
+#define TEST_CLIENTS     20
+#define TEST_BIG_ANSWERS 40 // 40条A记录超过512字节
+
+/**
+ * @brief 上游替身：每个查询先等待一段时间，让相同的客户端查询有机会合并；
+ *       "fail"开头的名称从不回复，"big"开头的名称回复超过512字节的响应，所有响应都带OPT
+ */
+typedef struct {
+    atomic_int queries;
+} test_upstream_t;
+
+static size_t test_upstream(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    test_upstream_t *upstream = (test_upstream_t *)arg;
+    (void)peer;
+    (void)peer_len;
+    atomic_fetch_add(&upstream->queries, 1);
+    usleep(50000);
+
+    dns_reply_t reply;
+    if (!dns_reply_init(&reply, packet, len, size) || strncmp((const char *)packet + 13, "fail", 4) == 0) {
+        return 0;
+    }
+
+    uint8_t ip[] = {10, 1, 2, 3};
+    int     count = strncmp((const char *)packet + 13, "big", 3) == 0 ? TEST_BIG_ANSWERS : 1;
+    for (int i = 0; i < count; i++) {
+        ip[3] = i;
+        dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 60, ip, sizeof(ip));
+    }
+    len = dns_reply_finish(&reply);
+
+    // OPT的名称是根，不能用指向问题的压缩指针，直接追加
+    uint8_t opt[] = {0, 0, DNS_TYPE_OPT, 0x10, 0x00, 0, 0, 0, 0, 0, 0};
+    memcpy(packet + len, opt, sizeof(opt));
+    packet[11] += 1;
+    return len + sizeof(opt);
+}
+
+static void *test_upstream_thread(void *arg)
+{
+    dns_udp_server_run((dns_udp_server_t *)arg);
+    return NULL;
+}
+
+static void *test_forwarder_thread(void *arg)
+{
+    dns_forwarder_run((dns_forwarder_t *)arg);
+    return NULL;
+}
+
+static int test_client(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/**
+ * @brief 构造查询，名称按序号改变大小写，奇数序号置CD位，检查回复是否回显了各自的大小写和CD位
+ * @param udp_size : 大于0时附加通告该UDP负载大小的OPT
+ */
+static size_t test_query(uint16_t id, const char *name, int variant, uint16_t udp_size, uint8_t *buf)
+{
+    char encoded[DNS_NAME_MAX_LENGTH + 1];
+    dns_name_encode(name, encoded, sizeof(encoded));
+    size_t name_len = strlen(encoded) + 1;
+    for (size_t i = 0; i < name_len; i++) {
+        if ((variant >> (i % 8)) & 0x01 && encoded[i] >= 'a' && encoded[i] <= 'z') {
+            encoded[i] -= 'a' - 'A';
+        }
+    }
+
+    memset(buf, 0, DNS_FORWARDER_HEADER_SIZE);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xFF;
+    buf[2] = 0x01;
+    buf[3] = (variant & 0x01) << DNS_FLAGS_INDEX_CD;
+    buf[5] = 1;
+    memcpy(buf + DNS_FORWARDER_HEADER_SIZE, encoded, name_len);
+    uint8_t *p = buf + DNS_FORWARDER_HEADER_SIZE + name_len;
+    p[0] = 0;
+    p[1] = DNS_TYPE_A;
+    p[2] = 0;
+    p[3] = DNS_CLASS_IN;
+    if (0 == udp_size) {
+        return DNS_FORWARDER_HEADER_SIZE + name_len + 4;
+    }
+
+    uint8_t opt[] = {0, 0, DNS_TYPE_OPT, udp_size >> 8, udp_size & 0xFF, 0, 0, 0, 0, 0, 0};
+    memcpy(p + 4, opt, sizeof(opt));
+    buf[11] = 1;
+    return DNS_FORWARDER_HEADER_SIZE + name_len + 4 + sizeof(opt);
+}
+
+/**
+ * @brief 一批客户端同时查询同一个名称，检查每个回复的ID、问题和响应码
+ */
+static bool test_burst(uint16_t port, const char *name, uint8_t rcode)
+{
+    int     fds[TEST_CLIENTS];
+    uint8_t queries[TEST_CLIENTS][300];
+    size_t  lens[TEST_CLIENTS];
+    for (int i = 0; i < TEST_CLIENTS; i++) {
+        fds[i]  = test_client(port);
+        lens[i] = test_query(0x1000 + i, name, i, 0, queries[i]);
+        send(fds[i], queries[i], lens[i], 0);
+    }
+
+    int good = 0;
+    for (int i = 0; i < TEST_CLIENTS; i++) {
+        uint8_t reply[4096];
+        ssize_t n = recv(fds[i], reply, sizeof(reply), 0);
+        if (n >= (ssize_t)lens[i] && 0 == memcmp(reply, queries[i], 2) && (reply[2] & 0x80) && (reply[3] & 0x0F) == rcode &&
+            (reply[3] & (1 << DNS_FLAGS_INDEX_CD)) == (queries[i][3] & (1 << DNS_FLAGS_INDEX_CD)) &&
+            0 == memcmp(reply + DNS_FORWARDER_HEADER_SIZE, queries[i] + DNS_FORWARDER_HEADER_SIZE, lens[i] - DNS_FORWARDER_HEADER_SIZE)) {
+            good += 1;
+        }
+        close(fds[i]);
+    }
+
+    printf("%s: %d/%d replies ok\n", name, good, TEST_CLIENTS);
+    return TEST_CLIENTS == good;
+}
+
+/**
+ * @brief 单个客户端查询，检查回复的TC位、回答数和附加记录数
+ * @param udp_size : 客户端OPT通告的大小，0表示不带EDNS
+ */
+static bool test_edns(uint16_t port, const char *name, uint16_t udp_size, bool tc, uint16_t answers, uint16_t additional)
+{
+    uint8_t query[300];
+    uint8_t reply[4096];
+    int     fd  = test_client(port);
+    size_t  len = test_query(0x2000, name, 0, udp_size, query);
+    send(fd, query, len, 0);
+    ssize_t n = recv(fd, reply, sizeof(reply), 0);
+    close(fd);
+
+    uint16_t limit = udp_size > DNS_FORWARDER_UDP_SIZE ? udp_size : DNS_FORWARDER_UDP_SIZE;
+    bool     ok    = n >= DNS_FORWARDER_HEADER_SIZE && n <= limit && tc == ((reply[2] >> (DNS_FLAGS_INDEX_TC - 8)) & 0x01) &&
+              answers == ((reply[6] << 8) | reply[7]) && additional == ((reply[10] << 8) | reply[11]);
+    printf("%s udp_size=%u: len=%zd tc=%d answers=%d additional=%d %s\n", name, udp_size, n, (reply[2] >> (DNS_FLAGS_INDEX_TC - 8)) & 0x01,
+           (reply[6] << 8) | reply[7], (reply[10] << 8) | reply[11], ok ? "ok" : "failed");
+    return ok;
+}
+
+int main(void)
+{
+    int              upstream_fd = dns_udp_socket_open("127.0.0.1", 0, false);
+    test_upstream_t  upstream    = {0};
+    dns_udp_server_t *server     = (dns_udp_server_t *)malloc(sizeof(dns_udp_server_t));
+    dns_udp_server_init(server, upstream_fd, test_upstream, &upstream);
+
+    dns_forwarder_t *forwarder = (dns_forwarder_t *)malloc(sizeof(dns_forwarder_t));
+    if (!dns_forwarder_init(forwarder, "127.0.0.1", 0, "127.0.0.1", dns_udp_socket_port(upstream_fd), 256, 200, 400)) {
+        printf("init failed: %s\n", dns_error_name(dns_error_last()));
+        return 1;
+    }
+
+    pthread_t upstream_thread, forwarder_thread;
+    pthread_create(&upstream_thread, NULL, test_upstream_thread, server);
+    pthread_create(&forwarder_thread, NULL, test_forwarder_thread, forwarder);
+
+    uint16_t port = dns_forwarder_port(forwarder);
+    bool     ok   = test_burst(port, "burst.example.com", DNS_RCODE_NOERROR);
+    int      first = atomic_load(&upstream.queries);
+    ok = test_burst(port, "other.example.com", DNS_RCODE_NOERROR) && ok;
+    int      second = atomic_load(&upstream.queries) - first;
+    ok = test_burst(port, "fail.example.com", DNS_RCODE_SERVFAIL) && ok;
+
+    // 不带EDNS的客户端收不到OPT，超过512字节时截断；EDNS客户端按通告的大小截断并保留OPT
+    ok = test_edns(port, "small.example.com", 0, false, 1, 0) && ok;
+    ok = test_edns(port, "big.example.com", 0, true, 0, 0) && ok;
+    ok = test_edns(port, "small.example.com", 1232, false, 1, 1) && ok;
+    ok = test_edns(port, "big.example.com", 1232, false, TEST_BIG_ANSWERS, 1) && ok;
+    ok = test_edns(port, "big.example.com", 600, true, 0, 1) && ok;
+    ok = test_edns(port, "big.example.com", 100, true, 0, 1) && ok;
+
+    dns_forwarder_stop(forwarder);
+    dns_udp_server_stop(server);
+    pthread_join(forwarder_thread, NULL);
+    pthread_join(upstream_thread, NULL);
+
+    printf("upstream queries: first burst=%d second burst=%d\n", first, second);
+    printf("queries=%llu coalesced=%llu upstream=%llu answered=%llu servfail=%llu dropped=%llu\n",
+           (unsigned long long)forwarder->queries,
+           (unsigned long long)forwarder->coalesced,
+           (unsigned long long)forwarder->upstream,
+           (unsigned long long)forwarder->answered,
+           (unsigned long long)forwarder->servfail,
+           (unsigned long long)forwarder->dropped);
+    ok = ok && 1 == first && 1 == second && forwarder->coalesced == 3 * (TEST_CLIENTS - 1);
+
+    dns_forwarder_clear(forwarder);
+    free(forwarder);
+    free(server);
+    close(upstream_fd);
+    return ok ? 0 : 1;
+}
+#endif  // DNS_FORWARDER_TEST
@@ -1,10 +1,11 @@
 #include <stdio.h>
+#include "dns_error.h"
 #include "dns_hexstring.h"
 
 const char* dns_hexstring(const uint8_t *data, size_t len, char *buf, size_t buf_size)
 {
     if (NULL == data || len < 1 || NULL == buf || buf_size < (2 * len + 1)) {
-        printf("%s Invalid parameters\n", __func__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return NULL;
     }
 
@@ -0,0 +1,582 @@
+#define _GNU_SOURCE  // struct mmsghdr（测试中使用dns_udp_server）
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dns_class.h"
+#include "dns_error.h"
+#include "dns_flags.h"
+#include "dns_load.h"
+#include "dns_message.h"
+
+#define DNS_LOAD_RECV_BATCH 64 // 每轮最多收取的响应数
+#define DNS_LOAD_SEND_BATCH 64 // 每轮最多发送的查询数，避免开环模式追赶时长时间不收包
+
+static uint64_t dns_load_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief 延迟所在的直方图桶：小于16纳秒直接作为下标，否则按最高位分区间，每个区间再分16个子桶
+ */
+static int dns_load_hist_index(uint64_t ns)
+{
+    if (ns < DNS_LOAD_HIST_SUB) {
+        return ns;
+    }
+
+    int msb = 63 - __builtin_clzll(ns);
+    return (msb - 3) * DNS_LOAD_HIST_SUB + ((ns >> (msb - 4)) & (DNS_LOAD_HIST_SUB - 1));
+}
+
+/**
+ * @brief 直方图桶的上界
+ */
+static uint64_t dns_load_hist_value(int index)
+{
+    if (index < DNS_LOAD_HIST_SUB) {
+        return index;
+    }
+
+    int msb = index / DNS_LOAD_HIST_SUB + 3;
+    int sub = index % DNS_LOAD_HIST_SUB;
+    return ((uint64_t)(DNS_LOAD_HIST_SUB + sub + 1) << (msb - 4)) - 1;
+}
+
+static uint64_t dns_load_percentile(const dns_load_t *load, uint64_t total, double percentile)
+{
+    uint64_t rank = (uint64_t)(total * percentile);
+    uint64_t seen = 0;
+    for (int i = 0; i < DNS_LOAD_HIST_SIZE; i++) {
+        seen += load->histogram[i];
+        if (seen > rank) {
+            return dns_load_hist_value(i);
+        }
+    }
+    return 0;
+}
+
+bool dns_load_init(dns_load_t *load, const char *ip, uint16_t port)
+{
+    if (NULL == load || NULL == ip) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t               addr_len = 0;
+    memset(&addr, 0, sizeof(addr));
+
+    struct sockaddr_in  *addr4 = (struct sockaddr_in *)&addr;
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+    if (inet_pton(AF_INET, ip, &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port   = htons(port);
+        addr_len          = sizeof(struct sockaddr_in);
+    } else if (inet_pton(AF_INET6, ip, &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port   = htons(port);
+        addr_len           = sizeof(struct sockaddr_in6);
+    } else {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(load, 0, sizeof(dns_load_t));
+    load->fd = socket(addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (load->fd < 0 || connect(load->fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        if (load->fd >= 0) {
+            close(load->fd);
+        }
+        load->fd = -1;
+        return false;
+    }
+
+    // 开环模式下响应可能成批到达，加大接收缓冲区减少本地丢包
+    int rcvbuf = 8 << 20;
+    setsockopt(load->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return true;
+}
+
+void dns_load_clear(dns_load_t *load)
+{
+    if (NULL == load) {
+        return;
+    }
+
+    if (load->fd >= 0) {
+        close(load->fd);
+    }
+    free(load->queries);
+    free(load->lens);
+    load->queries  = NULL;
+    load->lens     = NULL;
+    load->count    = 0;
+    load->capacity = 0;
+    load->fd       = -1;
+}
+
+bool dns_load_add(dns_load_t *load, const char *name, dns_type_t qtype)
+{
+    if (NULL == load || NULL == name) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    if (load->count == load->capacity) {
+        int   capacity = load->capacity ? load->capacity * 2 : 64;
+        void *queries  = realloc(load->queries, capacity * sizeof(*load->queries));
+        void *lens     = NULL != queries ? realloc(load->lens, capacity * sizeof(*load->lens)) : NULL;
+        if (NULL != queries) {
+            load->queries = queries;
+        }
+        if (NULL == lens) {
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
+            return false;
+        }
+        load->lens     = lens;
+        load->capacity = capacity;
+    }
+
+    uint8_t        arena[1024];
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    dns_flags_set_rd(&msg.header.flags, DNS_RD_YES);
+    dns_question_init(&question);
+    bool ok = dns_question_set_qname(&question, name);
+    dns_question_set_qtype(&question, qtype);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    ok = ok && dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+
+    int len = ok ? dns_message_serialize(&msg, load->queries[load->count], DNS_LOAD_QUERY_SIZE) : 0;
+    dns_message_clear(&msg);
+    if (len < 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    load->lens[load->count++] = len;
+    return true;
+}
+
+/**
+ * @brief 解析类型助记符或数字
+ * @return int 类型，无法识别返回-1
+ */
+static int dns_load_parse_type(const char *text)
+{
+    static const struct {
+        const char *name;
+        dns_type_t  type;
+    } types[] = {
+        {"A", DNS_TYPE_A},         {"NS", DNS_TYPE_NS},     {"CNAME", DNS_TYPE_CNAME}, {"SOA", DNS_TYPE_SOA},
+        {"PTR", DNS_TYPE_PTR},     {"MX", DNS_TYPE_MX},     {"TXT", DNS_TYPE_TXT},     {"AAAA", DNS_TYPE_AAAA},
+        {"SRV", DNS_TYPE_SRV},     {"DS", DNS_TYPE_DS},     {"DNSKEY", DNS_TYPE_DNSKEY}, {"SVCB", DNS_TYPE_SVCB},
+        {"HTTPS", DNS_TYPE_HTTPS}, {"ANY", (dns_type_t)255},
+    };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcasecmp(text, types[i].name) == 0) {
+            return types[i].type;
+        }
+    }
+
+    char *end   = NULL;
+    long  value = strtol(strncasecmp(text, "TYPE", 4) == 0 ? text + 4 : text, &end, 10);
+    return *text && *end == 0 && value > 0 && value <= 0xFFFF ? value : -1;
+}
+
+int dns_load_add_file(dns_load_t *load, const char *path)
+{
+    if (NULL == load || NULL == path) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int  added = 0;
+    char line[512];
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        char name[300];
+        char type[32] = "A";
+        if (line[0] == '#' || sscanf(line, "%299s %31s", name, type) < 1) {
+            continue;
+        }
+
+        int qtype = dns_load_parse_type(type);
+        if (qtype < 0 || !dns_load_add(load, name, qtype)) {
+            fprintf(stderr, "skip invalid query: %s", line);
+            continue;
+        }
+        added += 1;
+    }
+
+    fclose(fp);
+    return added;
+}
+
+typedef struct {
+    uint64_t next_seq;   // 下一个发送序号，事务ID取其低16位
+    uint64_t oldest_seq; // 最早可能仍在途的序号
+    uint64_t inflight;
+    uint8_t  buf[DNS_LOAD_QUERY_SIZE];
+} dns_load_state_t;
+
+static bool dns_load_send(dns_load_t *load, dns_load_state_t *state, dns_load_result_t *result, uint64_t now)
+{
+    // 窗口已满时最早的查询只能计为丢失，它的ID要被复用
+    uint16_t id = state->next_seq & (DNS_LOAD_WINDOW - 1);
+    if (load->sent_at[id] != 0) {
+        load->sent_at[id] = 0;
+        state->inflight  -= 1;
+        result->lost     += 1;
+    }
+
+    int      index = state->next_seq % load->count;
+    uint16_t len   = load->lens[index];
+    memcpy(state->buf, load->queries[index], len);
+    state->buf[0] = id >> 8;
+    state->buf[1] = id & 0xFF;
+
+    ssize_t n = send(load->fd, state->buf, len, 0);
+    if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || ENOBUFS == errno)) {
+        return false;
+    }
+
+    // 其它错误（如ICMP端口不可达）按已发送处理，最终计为丢失
+    load->sent_at[id] = now;
+    state->next_seq  += 1;
+    state->inflight  += 1;
+    result->sent     += 1;
+    return true;
+}
+
+static void dns_load_receive(dns_load_t *load, dns_load_state_t *state, dns_load_result_t *result)
+{
+    uint8_t buf[4096];
+    for (int i = 0; i < DNS_LOAD_RECV_BATCH; i++) {
+        ssize_t n = recv(load->fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                return;
+            }
+            continue;
+        }
+
+        uint16_t id = n >= 12 ? (buf[0] << 8) | buf[1] : 0;
+        if (n < 12 || 0 == (buf[2] & 0x80) || 0 == load->sent_at[id]) {
+            result->late += 1;
+            continue;
+        }
+
+        uint64_t latency = dns_load_now_ns() - load->sent_at[id];
+        load->sent_at[id] = 0;
+        state->inflight  -= 1;
+        result->received += 1;
+        load->histogram[dns_load_hist_index(latency)] += 1;
+        if (latency > result->max) {
+            result->max = latency;
+        }
+    }
+}
+
+/**
+ * @brief 从最早的序号开始，把已应答的跳过、超时的计为丢失
+ */
+static void dns_load_expire(dns_load_t *load, dns_load_state_t *state, dns_load_result_t *result, uint64_t now, uint64_t timeout_ns)
+{
+    while (state->oldest_seq < state->next_seq) {
+        uint16_t id = state->oldest_seq & (DNS_LOAD_WINDOW - 1);
+        if (load->sent_at[id] != 0) {
+            if (now - load->sent_at[id] < timeout_ns) {
+                return;
+            }
+            load->sent_at[id] = 0;
+            state->inflight  -= 1;
+            result->lost     += 1;
+        }
+        state->oldest_seq += 1;
+    }
+}
+
+bool dns_load_run(dns_load_t *load, const dns_load_config_t *config, dns_load_result_t *result)
+{
+    if (NULL == load || NULL == config || NULL == result || load->count < 1 || load->fd < 0) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    if ((0 == config->qps && (0 == config->concurrency || config->concurrency > DNS_LOAD_WINDOW)) || 0 == config->timeout_ms) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(result, 0, sizeof(dns_load_result_t));
+    memset(load->sent_at, 0, sizeof(load->sent_at));
+    memset(load->histogram, 0, sizeof(load->histogram));
+
+    dns_load_state_t state;
+    memset(&state, 0, sizeof(state));
+
+    uint64_t timeout_ns = (uint64_t)config->timeout_ms * 1000000;
+    uint64_t start      = dns_load_now_ns();
+    uint64_t end        = start + (uint64_t)config->duration_ms * 1000000;
+    uint64_t now        = start;
+
+    while (now < end) {
+        if (config->qps > 0) {
+            // 开环：按到目前为止应发送的数量补发，发送不受响应影响
+            uint64_t due = (now - start) * config->qps / 1000000000ull + 1;
+            for (int i = 0; i < DNS_LOAD_SEND_BATCH && result->sent < due; i++) {
+                if (!dns_load_send(load, &state, result, now)) {
+                    break;
+                }
+            }
+        } else {
+            for (int i = 0; i < DNS_LOAD_SEND_BATCH && state.inflight < config->concurrency; i++) {
+                if (!dns_load_send(load, &state, result, now)) {
+                    break;
+                }
+            }
+        }
+
+        dns_load_receive(load, &state, result);
+        now = dns_load_now_ns();
+        dns_load_expire(load, &state, result, now, timeout_ns);
+
+        // 闭环模式下窗口满了就等响应；开环模式等到下一个发送时刻
+        int wait_ms = 0;
+        if (0 == config->qps && state.inflight >= config->concurrency) {
+            wait_ms = 1;
+        } else if (config->qps > 0 && config->qps < 1000 && result->sent > (now - start) * config->qps / 1000000000ull) {
+            wait_ms = 1;
+        }
+        if (wait_ms > 0) {
+            struct pollfd pfd = {load->fd, POLLIN, 0};
+            poll(&pfd, 1, wait_ms);
+            now = dns_load_now_ns();
+        }
+    }
+
+    // 等待最后一批响应，超时的计为丢失
+    while (state.inflight > 0) {
+        struct pollfd pfd = {load->fd, POLLIN, 0};
+        poll(&pfd, 1, 1);
+        dns_load_receive(load, &state, result);
+        now = dns_load_now_ns();
+        dns_load_expire(load, &state, result, now, timeout_ns);
+    }
+
+    result->duration_ns = now - start;
+    result->qps         = result->duration_ns > 0 ? result->received * 1e9 / result->duration_ns : 0;
+    result->p50         = dns_load_percentile(load, result->received, 0.50);
+    result->p99         = dns_load_percentile(load, result->received, 0.99);
+    result->p999        = dns_load_percentile(load, result->received, 0.999);
+
+    // 桶的上界可能超过实际的最大值
+    result->p50  = result->p50 < result->max ? result->p50 : result->max;
+    result->p99  = result->p99 < result->max ? result->p99 : result->max;
+    result->p999 = result->p999 < result->max ? result->p999 : result->max;
+    return true;
+}
+
+const char *dns_load_result_to_string(const dns_load_result_t *result, char *buf, size_t buf_size)
+{
+    if (NULL == result || NULL == buf) {
+        return NULL;
+    }
+
+    double loss = result->sent > 0 ? 100.0 * result->lost / result->sent : 0;
+    snprintf(buf, buf_size,
+             "DNS Load:\n"
+             "  |-sent     : %llu\n"
+             "  |-received : %llu\n"
+             "  |-lost     : %llu (%.3f%%)\n"
+             "  |-late     : %llu\n"
+             "  |-duration : %.3f s\n"
+             "  |-qps      : %.0f\n"
+             "  |-latency  : p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us",
+             (unsigned long long)result->sent,
+             (unsigned long long)result->received,
+             (unsigned long long)result->lost, loss,
+             (unsigned long long)result->late,
+             result->duration_ns / 1e9,
+             result->qps,
+             result->p50 / 1e3, result->p99 / 1e3, result->p999 / 1e3, result->max / 1e3);
+    return buf;
+}
+
+#ifdef DNS_LOAD_MAIN
+#include <getopt.h>
+
+static void dns_load_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s server] [-p port] [-f file | -n name [-t type]] [-q qps | -c concurrency] [-d seconds] [-T timeout_ms]\n"
+            "  -s  target address, default 127.0.0.1\n"
+            "  -p  target port, default 53\n"
+            "  -f  query list, one \"name [type]\" per line\n"
+            "  -n  single query name, -t sets its type (default A)\n"
+            "  -q  open loop: send at this rate regardless of responses\n"
+            "  -c  closed loop: keep this many queries in flight (default 64)\n"
+            "  -d  duration in seconds, default 5\n"
+            "  -T  per-query timeout in milliseconds, default 1000\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char       *server = "127.0.0.1";
+    const char       *file   = NULL;
+    const char       *name   = NULL;
+    const char       *type   = "A";
+    uint16_t          port   = 53;
+    dns_load_config_t config = {0, 64, 5000, 1000};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:f:n:t:q:c:d:T:h")) != -1) {
+        switch (opt) {
+        case 's': server             = optarg; break;
+        case 'p': port               = atoi(optarg); break;
+        case 'f': file               = optarg; break;
+        case 'n': name               = optarg; break;
+        case 't': type               = optarg; break;
+        case 'q': config.qps         = atoi(optarg); break;
+        case 'c': config.concurrency = atoi(optarg); break;
+        case 'd': config.duration_ms = atof(optarg) * 1000; break;
+        case 'T': config.timeout_ms  = atoi(optarg); break;
+        default:
+            dns_load_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((NULL == file) == (NULL == name)) {
+        dns_load_usage(argv[0]);
+        return 1;
+    }
+
+    dns_load_t *load = (dns_load_t *)malloc(sizeof(dns_load_t));
+    if (NULL == load || !dns_load_init(load, server, port)) {
+        fprintf(stderr, "cannot reach %s:%u\n", server, port);
+        return 1;
+    }
+
+    int qtype = dns_load_parse_type(type);
+    if (NULL != file ? dns_load_add_file(load, file) < 1 : qtype < 0 || !dns_load_add(load, name, qtype)) {
+        fprintf(stderr, "no valid queries\n");
+        return 1;
+    }
+
+    printf("%s %s:%u, %d queries, %s %u, %u ms\n", config.qps ? "open loop" : "closed loop", server, port, load->count,
+           config.qps ? "qps" : "concurrency", config.qps ? config.qps : config.concurrency, config.duration_ms);
+
+    char              buf[1024];
+    dns_load_result_t result;
+    if (!dns_load_run(load, &config, &result)) {
+        fprintf(stderr, "run failed: %s\n", dns_error_name(dns_error_last()));
+        return 1;
+    }
+    printf("%s\n", dns_load_result_to_string(&result, buf, sizeof(buf)));
+
+    dns_load_clear(load);
+    free(load);
+    return 0;
+}
+#endif  // DNS_LOAD_MAIN
+
+#ifdef DNS_LOAD_TEST
+#include <pthread.h>
+#include "dns_captive.h"
+#include "dns_udp_server.h"
+
+static size_t test_responder(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    (void)peer;
+    (void)peer_len;
+    return dns_captive_respond((const dns_captive_t *)arg, packet, len, size);
+}
+
+static void *test_server_thread(void *arg)
+{
+    dns_udp_server_run((dns_udp_server_t *)arg);
+    return NULL;
+}
+
+int main(void)
+{
+    // 直方图桶的上界不小于落入该桶的值，相对误差不超过1/16
+    bool ok = true;
+    for (uint64_t v = 1; v < 10000000000ull; v = v * 3 + 1) {
+        uint64_t upper = dns_load_hist_value(dns_load_hist_index(v));
+        ok = ok && upper >= v && upper - v <= v / DNS_LOAD_HIST_SUB + 1;
+    }
+    printf("histogram: %s\n", ok ? "ok" : "failed");
+
+    dns_captive_t captive;
+    uint8_t       gateway[] = {192, 168, 4, 1};
+    dns_captive_init(&captive, gateway, DNS_CAPTIVE_TTL);
+
+    int               fd     = dns_udp_socket_open("127.0.0.1", 0, false);
+    dns_udp_server_t *server = (dns_udp_server_t *)malloc(sizeof(dns_udp_server_t));
+    dns_udp_server_init(server, fd, test_responder, &captive);
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_thread, server);
+
+    dns_load_t *load = (dns_load_t *)malloc(sizeof(dns_load_t));
+    dns_load_init(load, "127.0.0.1", dns_udp_socket_port(fd));
+    dns_load_add(load, "www.example.com", DNS_TYPE_A);
+    dns_load_add(load, "www.example.com", DNS_TYPE_AAAA);
+    dns_load_add(load, "mail.example.org", DNS_TYPE_MX);
+    ok = ok && 3 == load->count;
+
+    char              buf[1024];
+    dns_load_result_t result;
+    dns_load_config_t closed = {0, 16, 300, 500};
+    ok = dns_load_run(load, &closed, &result) && ok;
+    printf("closed loop\n%s\n", dns_load_result_to_string(&result, buf, sizeof(buf)));
+    ok = ok && result.received > 0 && 0 == result.lost && result.p50 <= result.p99 && result.p99 <= result.p999;
+
+    dns_load_config_t open = {2000, 0, 500, 500};
+    ok = dns_load_run(load, &open, &result) && ok;
+    printf("open loop\n%s\n", dns_load_result_to_string(&result, buf, sizeof(buf)));
+    ok = ok && result.sent >= 900 && result.sent <= 1100 && result.received + result.lost == result.sent;
+
+    dns_udp_server_stop(server);
+    pthread_join(thread, NULL);
+
+    // 目标不再应答，所有查询计为丢失
+    dns_load_config_t dead = {0, 8, 100, 50};
+    ok = dns_load_run(load, &dead, &result) && ok;
+    printf("no responder: sent=%llu lost=%llu\n", (unsigned long long)result.sent, (unsigned long long)result.lost);
+    ok = ok && result.sent > 0 && result.lost == result.sent;
+
+    dns_load_clear(load);
+    free(load);
+    free(server);
+    close(fd);
+    return ok ? 0 : 1;
+}
+#endif  // DNS_LOAD_TEST
@@ -1,7 +1,11 @@
 #include <stdlib.h>
+#include "dns_error.h"
 #include "dns_message.h"
 #include "dns_hexstring.h"
 
+#define DNS_MESSAGE_QUESTION_MIN 5  // 最短的问题：根名称1 + 类型2 + 类2
+#define DNS_MESSAGE_RECORD_MIN   11 // 最短的资源记录：根名称1 + 类型2 + 类2 + TTL4 + 数据长度2
+
 bool dns_message_init(dns_message_t *message)
 {
     if (NULL == message) {
@@ -12,13 +16,63 @@ bool dns_message_init(dns_message_t *message)
     return true;
 }
 
+bool dns_message_init_arena(dns_message_t *message, void *buf, size_t size)
+{
+    if (NULL == message || NULL == buf || size < 1) {
+        return false;
+    }
+
+    memset(message, 0, sizeof(dns_message_t));
+    return dns_arena_init(&message->arena, buf, size);
+}
+
+static inline bool dns_message_use_arena(const dns_message_t *message)
+{
+    return NULL != message->arena.buf;
+}
+
+/**
+ * @brief 获取资源记录段对应的数组、计数和容量
+ * @return dns_answer_t** 指向该段数组指针的指针，段无效返回NULL
+ */
+static dns_answer_t **dns_message_records(dns_message_t *message, dns_section_t section, uint16_t **count, uint16_t **capacity)
+{
+    switch (section) {
+    case DNS_SECTION_ANSWER:
+        *count    = &message->header.answers_count;
+        *capacity = &message->answers_capacity;
+        return &message->answers;
+    case DNS_SECTION_AUTHORITY:
+        *count    = &message->header.authorities_count;
+        *capacity = &message->authorities_capacity;
+        return &message->authorities;
+    case DNS_SECTION_ADDITIONAL:
+        *count    = &message->header.additional_count;
+        *capacity = &message->additionals_capacity;
+        return &message->additionals;
+    default:
+        return NULL;
+    }
+}
+
+static bool dns_message_materialize_section(dns_message_t *message, dns_section_t section);
+
 bool dns_message_clear(dns_message_t *message)
 {
     if (NULL == message) {
         return false;
     }
 
-    for (int i = 0; i < message->header.questions_count; i++) {
+    // 所有内存都来自分配器，整体回收即可
+    if (dns_message_use_arena(message)) {
+        dns_arena_t arena = message->arena;
+        dns_arena_reset(&arena);
+        memset(message, 0, sizeof(dns_message_t));
+        message->arena = arena;
+        return true;
+    }
+
+    for (int i = 0; i < message->header.questions_count && NULL != message->questions; i++) {
         dns_question_clear(&message->questions[i]);
     }
 
@@ -27,216 +81,701 @@ bool dns_message_clear(dns_message_t *message)
         message->questions = NULL;
     }
 
-    for (int i = 0; i < message->header.answers_count; i++) {
-        dns_answer_clear(&message->answers[i]);
-    }
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        uint16_t     *count    = NULL;
+        uint16_t     *capacity = NULL;
+        dns_answer_t **records = dns_message_records(message, section, &count, &capacity);
 
-    if (NULL != message->answers) {
-        free(message->answers);
-        message->answers = NULL;
+        for (int i = 0; i < *count && NULL != *records; i++) {
+            dns_answer_clear(&(*records)[i]);
+        }
+
+        if (NULL != *records) {
+            free(*records);
+            *records = NULL;
+        }
     }
 
     memset(message, 0, sizeof(dns_message_t));
     return true;
 }
 
+/**
+ * @brief 保证数组至少能容纳needed个元素，容量按倍数增长
+ * @return void* 新的数组，失败返回NULL，此时原数组保持不变
+ */
+static void *dns_message_grow(dns_message_t *message, void *array, uint16_t *capacity, size_t needed, size_t elem_size)
+{
+    if (needed <= *capacity) {
+        return array;
+    }
+
+    if (needed > UINT16_MAX) {
+        return NULL;
+    }
+
+    size_t new_capacity = *capacity * 2;
+    if (new_capacity < needed) {
+        new_capacity = needed;
+    }
+    if (new_capacity > UINT16_MAX) {
+        new_capacity = UINT16_MAX;
+    }
+
+    void *new_array = NULL;
+    if (dns_message_use_arena(message)) {
+        new_array = dns_arena_realloc(&message->arena, array, *capacity * elem_size, new_capacity * elem_size);
+    } else {
+        new_array = realloc(array, new_capacity * elem_size);
+    }
+
+    if (NULL == new_array) {
+        return NULL;
+    }
+
+    *capacity = new_capacity;
+    return new_array;
+}
+
 bool dns_message_add_question(dns_message_t *message, const dns_question_t *question)
 {
-    if (NULL == message || NULL == question) {
+    if (NULL == message || NULL == question || NULL == question->qname) {
         return false;
     }
 
-    // if (message->answers) {
-    //     free(message->answers);
-    //     message->answers = NULL;
-    //     message->header.answers_count = 0;
-    // }
+    uint16_t count = NULL == message->questions ? 0 : message->header.questions_count;
+    dns_question_t *questions = dns_message_grow(message, message->questions, &message->questions_capacity, count + 1, sizeof(dns_question_t));
+    if (NULL == questions) {
+        return false;
+    }
+    message->questions = questions;
 
-    if (NULL == message->questions) {
-        dns_question_t *questions = (dns_question_t *)malloc(sizeof(dns_question_t));
-        if (NULL == questions) {
+    dns_question_t *dst = &questions[count];
+    dns_question_init(dst);
+    if (dns_message_use_arena(message)) {
+        dst->qname  = dns_arena_strdup(&message->arena, question->qname);
+        dst->qtype  = question->qtype;
+        dst->qclass = question->qclass;
+        if (NULL == dst->qname) {
             return false;
         }
-        dns_question_init(&questions[0]);
-        dns_question_copy(&questions[0], question);
-        message->header.questions_count = 1;
-        message->questions = questions;
-        return true;
-    }
-
-    size_t new_size = (message->header.questions_count + 1) * sizeof(dns_question_t);
-    dns_question_t *questions = (dns_question_t *)realloc(message->questions, new_size);
-    if (NULL == questions) {
+    } else if (dns_question_copy(dst, question) == false) {
         return false;
     }
 
-    dns_question_init(&questions[message->header.questions_count]);
-    dns_question_copy(&questions[message->header.questions_count], question);
-    message->header.questions_count += 1;
-    message->questions = questions;
+    message->header.questions_count = count + 1;
     return true;
 }
 
 /**
- * @brief 添加DNS响应
+ * @brief 向回答/权威/附加段添加一条资源记录
  * @param message DNS消息
- * @param answer DNS响应
+ * @param section 资源记录段
+ * @param answer 资源记录
  * @return true 成功
  * @return false 失败
  */
-bool dns_message_add_answer(dns_message_t *message, const dns_answer_t *answer)
+static bool dns_message_add_record(dns_message_t *message, dns_section_t section, const dns_answer_t *answer)
 {
-    if (NULL == message || NULL == answer) {
+    if (NULL == message || NULL == answer || NULL == answer->rname) {
         return false;
     }
 
-    // if (message->questions) {
-    //     free(message->questions);
-    //     message->questions = NULL;
-    //     message->header.questions_count = 0;
-    // }
+    uint16_t     *count_ptr = NULL;
+    uint16_t     *capacity  = NULL;
+    dns_answer_t **records  = dns_message_records(message, section, &count_ptr, &capacity);
+    if (NULL == records) {
+        return false;
+    }
+
+    // 追加之前先解码报文中已有的记录，保持顺序
+    if (dns_message_materialize_section(message, section) == false) {
+        return false;
+    }
 
-    if (NULL == message->answers) {
-        dns_answer_t *answers = (dns_answer_t *)malloc(sizeof(dns_answer_t));
-        if (NULL == answers) {
+    uint16_t count = NULL == *records ? 0 : *count_ptr;
+    dns_answer_t *array = dns_message_grow(message, *records, capacity, count + 1, sizeof(dns_answer_t));
+    if (NULL == array) {
+        return false;
+    }
+    *records = array;
+
+    dns_answer_t *dst = &array[count];
+    dns_answer_init(dst);
+    if (dns_message_use_arena(message)) {
+        dst->rname   = dns_arena_strdup(&message->arena, answer->rname);
+        dst->rtype   = answer->rtype;
+        dst->rclass  = answer->rclass;
+        dst->rttl    = answer->rttl;
+        dst->rlength = answer->rlength;
+        if (answer->rlength > 0) {
+            dst->rdata = dns_arena_memdup(&message->arena, answer->rdata, answer->rlength);
+        }
+        if (NULL == dst->rname || (answer->rlength > 0 && NULL == dst->rdata)) {
             return false;
         }
-        dns_answer_init(&answers[0]);
-        dns_answer_copy(&answers[0], answer);
-        message->header.answers_count = 1;
-        message->answers = answers;
-        return true;
+    } else if (dns_answer_copy(dst, answer) == false) {
+        return false;
     }
 
-    size_t new_size = (message->header.answers_count + 1) * sizeof(dns_answer_t);
-    dns_answer_t *answers = (dns_answer_t *)realloc(message->answers, new_size);
-    if (NULL == answers) {
-        return false;
+    *count_ptr = count + 1;
+    return true;
+}
+
+bool dns_message_add_answer(dns_message_t *message, const dns_answer_t *answer)
+{
+    return dns_message_add_record(message, DNS_SECTION_ANSWER, answer);
+}
+
+bool dns_message_add_authority(dns_message_t *message, const dns_answer_t *authority)
+{
+    return dns_message_add_record(message, DNS_SECTION_AUTHORITY, authority);
+}
+
+bool dns_message_add_additional(dns_message_t *message, const dns_answer_t *additional)
+{
+    return dns_message_add_record(message, DNS_SECTION_ADDITIONAL, additional);
+}
+
+uint16_t dns_message_count(const dns_message_t *message, dns_section_t section)
+{
+    if (NULL == message || section >= DNS_SECTION_MAX) {
+        return 0;
+    }
+
+    // 延迟解码对调用者不可见，消息在逻辑上仍然是const的
+    if (message->lazy_pending & (1 << section)) {
+        dns_message_materialize_section((dns_message_t *)message, section);
+    }
+
+    // 解码失败的段不返回部分记录，每次访问都重新记录失败的原因
+    if (message->lazy_failed & (1 << section)) {
+        dns_error_raise(message->lazy_error);
+        return 0;
+    }
+
+    switch (section) {
+    case DNS_SECTION_QUESTION:
+        return NULL == message->questions ? 0 : message->header.questions_count;
+    case DNS_SECTION_ANSWER:
+        return NULL == message->answers ? 0 : message->header.answers_count;
+    case DNS_SECTION_AUTHORITY:
+        return NULL == message->authorities ? 0 : message->header.authorities_count;
+    case DNS_SECTION_ADDITIONAL:
+        return NULL == message->additionals ? 0 : message->header.additional_count;
+    default:
+        return 0;
+    }
+}
+
+const dns_question_t *dns_message_get_question(const dns_message_t *message, uint16_t index)
+{
+    if (index >= dns_message_count(message, DNS_SECTION_QUESTION)) {
+        return NULL;
     }
 
-    dns_answer_init(&answers[message->header.answers_count]);
-    dns_answer_copy(&answers[message->header.answers_count], answer);
-    message->header.answers_count += 1;
-    message->answers = answers;
+    return &message->questions[index];
+}
+
+const dns_answer_t *dns_message_get_record(const dns_message_t *message, dns_section_t section, uint16_t index)
+{
+    if (index >= dns_message_count(message, section)) {
+        return NULL;
+    }
+
+    switch (section) {
+    case DNS_SECTION_ANSWER:
+        return &message->answers[index];
+    case DNS_SECTION_AUTHORITY:
+        return &message->authorities[index];
+    case DNS_SECTION_ADDITIONAL:
+        return &message->additionals[index];
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief 序列化之前解码所有延迟的段，有段解码失败时不能写出缺少记录的报文
+ * @return bool 所有段都已解码返回true，否则记录失败原因并返回false
+ */
+static bool dns_message_lazy_ready(const dns_message_t *message)
+{
+    if (0 != message->lazy_pending) {
+        dns_message_materialize((dns_message_t *)message);
+    }
+
+    if (0 != message->lazy_failed) {
+        dns_error_raise(message->lazy_error);
+        return false;
+    }
     return true;
 }
 
 /**
- * @brief 序列化DNS消息
+ * @brief 把DNS消息写入缓冲区
  * @param message DNS消息
+ * @param table 名称压缩表，为NULL时不压缩
  * @param buffer 序列化后的缓冲区
  * @param buffer_size 缓冲区大小
  * @return int 序列化后的字节数，如果返0，则表示失败
  */
-int  dns_message_serialize(const dns_message_t *message, uint8_t *buffer, size_t buffer_size)
+static int dns_message_pack(const dns_message_t *message, dns_name_table_t *table, uint8_t *buffer, size_t buffer_size)
 {
     if (NULL == message || NULL == buffer || buffer_size < 1) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    if (dns_message_lazy_ready(message) == false) {
         return 0;
     }
 
     int buffer_offset = 0;
     int header_offset = dns_header_serialize(&message->header, buffer, buffer_size);
     if (header_offset < 1) {
-        printf("%s, %d\n", __func__, __LINE__);
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
         return 0;
     }
 
     buffer_offset += header_offset;
     for (int i = 0; i < message->header.questions_count; i++) {
-        int question_offset = dns_question_serialize(&message->questions[i], buffer + buffer_offset, buffer_size - buffer_offset);
+        int question_offset = dns_question_pack(&message->questions[i], table, buffer, buffer_size, buffer_offset);
         if (question_offset < 1) {
-            printf("%s, %d\n", __func__, __LINE__);
             return 0;
         }
         buffer_offset += question_offset;
     }
 
-    for (int i = 0; i < message->header.answers_count; i++) {
-        int answer_offset = dns_answer_serialize(&message->answers[i], buffer + buffer_offset, buffer_size - buffer_offset);
-        if (answer_offset < 1) {
-            printf("%s, %d\n", __func__, __LINE__);
-            return 0;
+    // 头部中的计数必须与记录数一致，否则写出的报文无法被解析
+    uint16_t header_counts[DNS_SECTION_MAX] = {
+        message->header.questions_count,
+        message->header.answers_count,
+        message->header.authorities_count,
+        message->header.additional_count,
+    };
+
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        for (int i = 0; i < header_counts[section]; i++) {
+            const dns_answer_t *answer = dns_message_get_record(message, section, i);
+            int answer_offset = dns_answer_pack(answer, table, buffer, buffer_size, buffer_offset);
+            if (answer_offset < 1) {
+                return 0;
+            }
+            buffer_offset += answer_offset;
         }
-        buffer_offset += answer_offset;
     }
 
     return buffer_offset;
 }
 
 /**
- * @brief 反序列化DNS消息
+ * @brief 序列化DNS消息
  * @param message DNS消息
- * @param data 反序列化后的缓冲区
- * @param data_len 缓冲区大小
- * @return int 反序列化消耗的字节数，如果返0，则表示失败
+ * @param buffer 序列化后的缓冲区
+ * @param buffer_size 缓冲区大小
+ * @return int 序列化后的字节数，如果返0，则表示失败
  */
-int  dns_message_deserialize(dns_message_t *message, const uint8_t *data, size_t data_len)
+int  dns_message_serialize(const dns_message_t *message, uint8_t *buffer, size_t buffer_size)
 {
-    if (NULL == message || NULL == data || data_len < 1) {
-        printf("%s, %d\n", __func__, __LINE__);
+    return dns_message_pack(message, NULL, buffer, buffer_size);
+}
+
+int  dns_message_serialize_compressed(const dns_message_t *message, uint8_t *buffer, size_t buffer_size)
+{
+    dns_name_table_t table;
+    dns_name_table_init(&table);
+
+    return dns_message_pack(message, &table, buffer, buffer_size);
+}
+
+uint32_t dns_message_wire_length(const dns_message_t *message)
+{
+    if (NULL == message) {
         return 0;
     }
 
-    int data_offset = 0;
-    int header_offset = dns_header_deserialize(&message->header, data, data_len);
-    if (header_offset < 1) {
-        printf("%s, %d\n", __func__, __LINE__);
+    uint32_t length = DNS_HEADER_SIZE;
+    for (int i = 0; i < message->header.questions_count; i++) {
+        uint32_t question_length = dns_question_length(dns_message_get_question(message, i));
+        if (question_length < 1) {
+            return 0;
+        }
+        length += question_length;
+    }
+
+    uint16_t header_counts[DNS_SECTION_MAX] = {
+        message->header.questions_count,
+        message->header.answers_count,
+        message->header.authorities_count,
+        message->header.additional_count,
+    };
+
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        for (int i = 0; i < header_counts[section]; i++) {
+            const dns_answer_t *answer = dns_message_get_record(message, section, i);
+            if (NULL == answer || NULL == answer->rname) {
+                return 0;
+            }
+            length += dns_answer_length(answer);
+        }
+    }
+
+    return length;
+}
+
+static bool dns_message_iov_push(struct iovec *iov, int iov_max, int *iov_count, const void *base, size_t len)
+{
+    if (len < 1) {
+        return true;
+    }
+
+    if (*iov_count >= iov_max) {
+        return false;
+    }
+
+    iov[*iov_count].iov_base = (void *)base;
+    iov[*iov_count].iov_len  = len;
+    *iov_count += 1;
+    return true;
+}
+
+int dns_message_serialize_iov(const dns_message_t *message, uint8_t *scratch, size_t scratch_size, struct iovec *iov, int iov_max)
+{
+    if (NULL == message || NULL == scratch || NULL == iov || iov_max < 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    if (dns_message_lazy_ready(message) == false) {
+        return 0;
+    }
+
+    int    iov_count = 0;
+    size_t used      = dns_header_serialize(&message->header, scratch, scratch_size);
+    size_t segment   = 0;  // 当前还未加入iov的scratch数据的起点
+    if (used < 1) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
         return 0;
     }
 
-    data_offset += header_offset;
     for (int i = 0; i < message->header.questions_count; i++) {
+        int question_len = dns_question_pack(dns_message_get_question(message, i), NULL, scratch, scratch_size, used);
+        if (question_len < 1) {
+            return 0;
+        }
+        used += question_len;
+    }
+
+    uint16_t header_counts[DNS_SECTION_MAX] = {
+        message->header.questions_count,
+        message->header.answers_count,
+        message->header.authorities_count,
+        message->header.additional_count,
+    };
+
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        for (int i = 0; i < header_counts[section]; i++) {
+            const dns_answer_t *answer = dns_message_get_record(message, section, i);
+            if (NULL == answer || (answer->rlength > 0 && NULL == answer->rdata)) {
+                dns_error_raise(DNS_ERROR_INVALID_PARAM);
+                return 0;
+            }
+
+            int name_len = dns_name_pack(NULL, answer->rname, scratch, scratch_size, used);
+            if (name_len < 1) {
+                return 0;
+            }
+            if (used + name_len + 10 > scratch_size) {
+                dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+                return 0;
+            }
+
+            uint8_t *ptr = scratch + used + name_len;
+            *(ptr++) = (answer->rtype   >> 8 ) & 0xFF;
+            *(ptr++) = (answer->rtype   >> 0 ) & 0xFF;
+            *(ptr++) = (answer->rclass  >> 8 ) & 0xFF;
+            *(ptr++) = (answer->rclass  >> 0 ) & 0xFF;
+            *(ptr++) = (answer->rttl    >> 24) & 0xFF;
+            *(ptr++) = (answer->rttl    >> 16) & 0xFF;
+            *(ptr++) = (answer->rttl    >> 8 ) & 0xFF;
+            *(ptr++) = (answer->rttl    >> 0 ) & 0xFF;
+            *(ptr++) = (answer->rlength >> 8 ) & 0xFF;
+            *(ptr++) = (answer->rlength >> 0 ) & 0xFF;
+            used = ptr - scratch;
+
+            // 短数据复制比多一个iov更便宜，长数据直接引用记录自己的缓冲区
+            if (answer->rlength <= DNS_MESSAGE_IOV_INLINE_MAX) {
+                if (used + answer->rlength > scratch_size) {
+                    dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+                    return 0;
+                }
+                memcpy(scratch + used, answer->rdata, answer->rlength);
+                used += answer->rlength;
+                continue;
+            }
+
+            if (dns_message_iov_push(iov, iov_max, &iov_count, scratch + segment, used - segment) == false
+            ||  dns_message_iov_push(iov, iov_max, &iov_count, answer->rdata, answer->rlength) == false) {
+                dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+                return 0;
+            }
+            segment = used;
+        }
+    }
+
+    if (dns_message_iov_push(iov, iov_max, &iov_count, scratch + segment, used - segment) == false) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    return iov_count;
+}
+
+/**
+ * @brief 计算解码前预分配的元素数：报文计数与剩余字节最多能容纳的条数中较小的一个
+ * @return size_t 预分配的元素数
+ */
+static size_t dns_message_reserve(size_t data_len, size_t offset, uint16_t count, size_t min_size)
+{
+    size_t fit = offset < data_len ? (data_len - offset) / min_size : 0;
+    return count < fit ? count : fit;
+}
+
+/**
+ * @brief 从报文的offset处解码count个问题加入消息
+ * @return size_t 解码结束的偏移，失败返回0
+ */
+static size_t dns_message_unpack_questions(dns_message_t *message, const uint8_t *data, size_t data_len, size_t offset, uint16_t count)
+{
+    message->header.questions_count = 0;
+
+    // 按报文中的计数一次分配好数组，避免逐条realloc；计数来自不可信的头部，
+    // 预分配不超过剩余字节能容纳的问题数，其余由dns_message_add_question按需增长
+    size_t          reserve   = dns_message_reserve(data_len, offset, count, DNS_MESSAGE_QUESTION_MIN);
+    dns_question_t *questions = dns_message_grow(message, message->questions, &message->questions_capacity, reserve, sizeof(dns_question_t));
+    if (reserve > 0 && NULL == questions) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return 0;
+    }
+    message->questions = questions;
+
+    // 名称先展开到栈上，加入消息时只复制一次
+    char name[DNS_NAME_MAX_LENGTH];
+    for (int i = 0; i < count; i++) {
         dns_question_t question;
-        dns_question_init(&question);
 
-        int question_offset = dns_question_deserialize(&question, data + data_offset, data_len - data_offset);
+        int question_offset = dns_question_unpack_to(&question, data, data_len, offset, name, sizeof(name));
         if (question_offset < 1) {
-            dns_message_clear(message);
-            printf("%s, %d\n", __func__, __LINE__);
             return 0;
         }
 
         if (dns_message_add_question(message, &question) == false) {
-            dns_message_clear(message);
-            printf("%s, %d\n", __func__, __LINE__);
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
             return 0;
         }
 
-        data_offset += question_offset;
+        offset += question_offset;
     }
 
-    for (int i = 0; i < message->header.answers_count; i++) {
+    return offset;
+}
+
+/**
+ * @brief 从报文的offset处解码count条资源记录加入某个段
+ * @return size_t 解码结束的偏移，失败返回0，此时段中只有已解码的记录
+ */
+static size_t dns_message_unpack_records(dns_message_t *message, dns_section_t section, const uint8_t *data, size_t data_len, size_t offset, uint16_t count)
+{
+    uint16_t     *count_ptr = NULL;
+    uint16_t     *capacity  = NULL;
+    dns_answer_t **records  = dns_message_records(message, section, &count_ptr, &capacity);
+    *count_ptr = 0;
+
+    size_t        reserve = dns_message_reserve(data_len, offset, count, DNS_MESSAGE_RECORD_MIN);
+    dns_answer_t *array   = dns_message_grow(message, *records, capacity, reserve, sizeof(dns_answer_t));
+    if (reserve > 0 && NULL == array) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return 0;
+    }
+    *records = array;
+
+    char    name[DNS_NAME_MAX_LENGTH];
+    uint8_t rdata[DNS_ANSWER_RDATA_NAME_MAX];
+    for (int i = 0; i < count; i++) {
         dns_answer_t answer;
-        dns_answer_init(&answer);
 
-        int answer_offset = dns_answer_deserialize(&answer, data + data_offset, data_len - data_offset);
+        int answer_offset = dns_answer_unpack_to(&answer, data, data_len, offset, name, sizeof(name), rdata, sizeof(rdata));
         if (answer_offset < 1) {
-            dns_message_clear(message);
-            printf("%s, %d\n", __func__, __LINE__);
             return 0;
         }
 
-        if (dns_message_add_answer(message, &answer) == false) {
-            dns_message_clear(message);
-            printf("%s, %d\n", __func__, __LINE__);
+        if (dns_message_add_record(message, section, &answer) == false) {
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
             return 0;
         }
 
-        data_offset += answer_offset;
-        dns_answer_clear(&answer);
+        offset += answer_offset;
+    }
+
+    return offset;
+}
+
+/**
+ * @brief 延迟解码的段在第一次访问时才解码
+ * @return bool 段已经解码返回true，解码失败返回false
+ */
+static bool dns_message_materialize_section(dns_message_t *message, dns_section_t section)
+{
+    uint8_t bit = 1 << section;
+    if (0 == (message->lazy_pending & bit)) {
+        return true;
+    }
+
+    // 先清掉标记，解码过程中dns_message_add_record不会再次进入这里
+    message->lazy_pending &= ~bit;
+
+    uint16_t counts[DNS_SECTION_MAX] = {
+        message->lazy.header.questions_count,
+        message->lazy.header.answers_count,
+        message->lazy.header.authorities_count,
+        message->lazy.header.additional_count,
+    };
+
+    size_t offset = message->lazy.section_offset[section];
+    if (dns_message_unpack_records(message, section, message->lazy.data, message->lazy.len, offset, counts[section]) > 0
+    ||  0 == counts[section]) {
+        return true;
+    }
+
+    // 视图只跳过名称，不校验压缩指针的目标和资源数据中的名称，这些错误到这里才发现；
+    // 丢弃已解码的部分记录并记住失败原因，不让调用者看到一个记录变少的段
+    uint16_t     *count_ptr = NULL;
+    uint16_t     *capacity  = NULL;
+    dns_answer_t **records  = dns_message_records(message, section, &count_ptr, &capacity);
+    for (int i = 0; i < *count_ptr && NULL != *records && !dns_message_use_arena(message); i++) {
+        dns_answer_clear(&(*records)[i]);
+    }
+    *count_ptr = 0;
+
+    if (0 == message->lazy_failed) {
+        dns_error_t error = dns_error_last();
+        message->lazy_error = DNS_OK == error ? DNS_ERROR_RDATA : error;
+    }
+    message->lazy_failed |= bit;
+    return false;
+}
+
+dns_error_t dns_message_lazy_error(const dns_message_t *message)
+{
+    if (NULL == message) {
+        return DNS_ERROR_INVALID_PARAM;
+    }
+
+    // 还未访问的段也一起解码，结果不依赖调用者访问过哪些段
+    if (0 != message->lazy_pending) {
+        dns_message_materialize((dns_message_t *)message);
+    }
+    return 0 == message->lazy_failed ? DNS_OK : message->lazy_error;
+}
+
+bool dns_message_materialize(dns_message_t *message)
+{
+    if (NULL == message) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    bool ok = true;
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        ok = dns_message_materialize_section(message, section) && ok;
+    }
+
+    return ok && 0 == message->lazy_failed;
+}
+
+/**
+ * @brief 反序列化DNS消息
+ * @param message DNS消息
+ * @param data 反序列化后的缓冲区
+ * @param data_len 缓冲区大小
+ * @return int 反序列化消耗的字节数，如果返0，则表示失败
+ */
+int  dns_message_deserialize(dns_message_t *message, const uint8_t *data, size_t data_len)
+{
+    if (NULL == message || NULL == data || data_len < 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    int header_offset = dns_header_deserialize(&message->header, data, data_len);
+    if (header_offset < 1) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return 0;
+    }
+
+    // dns_message_add_*会累加头部中的计数，先取出报文中的计数
+    uint16_t counts[DNS_SECTION_MAX] = {
+        message->header.questions_count,
+        message->header.answers_count,
+        message->header.authorities_count,
+        message->header.additional_count,
+    };
+
+    size_t data_offset = dns_message_unpack_questions(message, data, data_len, header_offset, counts[DNS_SECTION_QUESTION]);
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX && data_offset > 0; section++) {
+        data_offset = dns_message_unpack_records(message, section, data, data_len, data_offset, counts[section]);
+    }
+
+    if (data_offset < 1) {
+        dns_message_clear(message);
+        return 0;
     }
 
     return data_offset;
 }
 
+int dns_message_deserialize_lazy(dns_message_t *message, const uint8_t *data, size_t data_len)
+{
+    if (NULL == message || NULL == data) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    // 只跳过名称来校验并记录各段边界，不展开也不复制
+    if (dns_message_view_parse(&message->lazy, data, data_len) == false) {
+        return 0;
+    }
+
+    message->header = message->lazy.header;
+    size_t offset = dns_message_unpack_questions(message, data, data_len, DNS_HEADER_SIZE, message->lazy.header.questions_count);
+    if (offset < 1) {
+        dns_message_clear(message);
+        return 0;
+    }
+
+    // 记录段的计数保持报文中的值，数组在第一次访问时才创建
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        if (dns_message_view_count(&message->lazy, section) > 0) {
+            message->lazy_pending |= 1 << section;
+        }
+    }
+
+    return message->lazy.end_offset;
+}
+
 const char* dns_message_to_string(const dns_message_t *message, char *buffer, size_t buffer_size)
 {
     if (NULL == message || NULL == buffer || buffer_size < 1) {
         return NULL;
     }
 
-    size_t serialize_size = 1024;
+    size_t serialize_size = dns_message_wire_length(message);
+    if (serialize_size < 1) {
+        printf("dns_message_to_string dns_message_wire_length failed\n");
+        return NULL;
+    }
+
     uint8_t *serialize_buf = (uint8_t *)malloc(serialize_size);
     if (NULL == serialize_buf) {
         printf("dns_message_to_string malloc serialize_buf failed\n");
@@ -250,7 +789,7 @@ const char* dns_message_to_string(const dns_message_t *message, char *buffer, si
         return NULL;
     }
 
-    size_t sirerialize_hex_size = 1024;
+    size_t sirerialize_hex_size = serialize_len * 2 + 1;
     char *sirerialize_hex = (char *)malloc(sirerialize_hex_size);
     if (NULL == sirerialize_hex) {
         printf("dns_message_to_string malloc sirerialize_hex failed\n");
@@ -293,14 +832,16 @@ const char* dns_message_to_string(const dns_message_t *message, char *buffer, si
         }
     }
 
-    for (int i = 0; i < message->header.answers_count; i++) {
-        buffer_offset = strlen(buffer);
-        str = dns_answer_to_string(&message->answers[i], buffer + buffer_offset, buffer_size - buffer_offset);
-        if (NULL == str) {
-            printf("dns_message_to_string dns_answer_to_string failed\n");
-            free(serialize_buf);
-            free(sirerialize_hex);
-            return NULL;
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        for (int i = 0; i < dns_message_count(message, section); i++) {
+            buffer_offset = strlen(buffer);
+            str = dns_answer_to_string((dns_answer_t *)dns_message_get_record(message, section, i), buffer + buffer_offset, buffer_size - buffer_offset);
+            if (NULL == str) {
+                printf("dns_message_to_string dns_answer_to_string failed\n");
+                free(serialize_buf);
+                free(sirerialize_hex);
+                return NULL;
+            }
         }
     }
     
@@ -340,6 +881,7 @@ void test_dns_message_request(void)
         dns_question_set_qtype(&question, DNS_TYPE_A);
         dns_question_set_qclass(&question, DNS_CLASS_IN);
         dns_message_add_question(&msg, &question);
+        dns_question_clear(&question);
     }
 
     char info_buf[SHOW_BUFFER_SIZE];
@@ -354,6 +896,7 @@ void test_dns_message_request(void)
         dns_message_deserialize(&msg2, sirerialize_buf, serialize_len);
         dns_message_to_string(&msg2, info_buf, sizeof(info_buf));
         printf("msg2 hex:\n%s\n", info_buf);
+        dns_message_clear(&msg2);
     }
 
     dns_message_clear(&msg);
@@ -410,15 +953,400 @@ void test_dns_message_anser(void)
         dns_message_deserialize(&msg2, sirerialize_buf, serialize_len);
         dns_message_to_string(&msg2, info_buf, sizeof(info_buf));
         printf("%s mst2:\n%s\n", __func__, info_buf);
+        dns_message_clear(&msg2);
+    }
+
+    // 压缩后回答中的名称只剩一个指向问题的指针
+    int compressed_len = dns_message_serialize_compressed(&msg, sirerialize_buf, sizeof(sirerialize_buf));
+    if (compressed_len > 0) {
+        char hex_buf[SHOW_BUFFER_SIZE];
+        dns_message_t msg3;
+        dns_message_init(&msg3);
+        int len = dns_message_deserialize(&msg3, sirerialize_buf, compressed_len);
+        printf("%s compressed(%d -> %d): [%s] deserialize=%d\n",
+               __func__,
+               serialize_len,
+               compressed_len,
+               dns_hexstring(sirerialize_buf, compressed_len, hex_buf, sizeof(hex_buf)),
+               len);
+        dns_message_clear(&msg3);
     }
 
     dns_message_clear(&msg);
 }
 
+void test_dns_message_compressed(void)
+{
+    // 上游真实响应：www.example.com CNAME example.com，名称全部使用压缩指针
+    const uint8_t data[] = {
+        0xab, 0xcd, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+        0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+        0x00, 0x01, 0x00, 0x01,
+        0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x02, 0xc0, 0x10,
+        0xc0, 0x10, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 93, 184, 216, 34,
+    };
+
+    dns_message_t msg;
+    dns_message_init(&msg);
+
+    int len = dns_message_deserialize(&msg, data, sizeof(data));
+    printf("%s deserialize: %d/%zu\n", __func__, len, sizeof(data));
+    if (len > 0) {
+        char info_buf[SHOW_BUFFER_SIZE];
+        dns_message_to_string(&msg, info_buf, sizeof(info_buf));
+        printf("%s\n", info_buf);
+
+        // 重新压缩后应当与上游报文一样长，CNAME数据中的名称也被压缩
+        uint8_t packed[SHOW_BUFFER_SIZE];
+        int packed_len = dns_message_serialize_compressed(&msg, packed, sizeof(packed));
+        printf("%s repack: %d bytes, %s\n",
+               __func__,
+               packed_len,
+               packed_len == sizeof(data) && memcmp(packed, data, sizeof(data)) == 0 ? "identical" : "different");
+    }
+
+    dns_message_clear(&msg);
+}
+
+void test_dns_message_arena(void)
+{
+    uint8_t arena_buf[1024];
+    dns_message_t msg;
+    dns_message_init_arena(&msg, arena_buf, sizeof(arena_buf));
+
+    const uint8_t data[] = {
+        0xab, 0xcd, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+        0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+        0x00, 0x01, 0x00, 0x01,
+        0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x02, 0xc0, 0x10,
+        0xc0, 0x10, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 93, 184, 216, 34,
+    };
+
+    // 反复解析同一个报文，每次clear之后分配器都从头开始
+    for (int i = 0; i < 3; i++) {
+        int len = dns_message_deserialize(&msg, data, sizeof(data));
+        printf("%s round %d: deserialize=%d answers=%u arena used=%zu\n",
+               __func__, i, len, msg.header.answers_count, msg.arena.used);
+        dns_message_clear(&msg);
+    }
+
+    // 使用分配器构建响应
+    dns_header_set_id(&msg.header, 0x1234);
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    char qname[DNS_NAME_MAX_LENGTH];
+    dns_question_t question = {0};
+    question.qname  = (char *)dns_name_encode("apmode.enplus.com", qname, sizeof(qname));
+    question.qtype  = DNS_TYPE_A;
+    question.qclass = DNS_CLASS_IN;
+    dns_message_add_question(&msg, &question);
+
+    uint8_t ip[] = {192, 168, 4, 1};
+    dns_answer_t answer = {0};
+    answer.rname   = qname;
+    answer.rtype   = DNS_TYPE_A;
+    answer.rclass  = DNS_CLASS_IN;
+    answer.rttl    = 3600;
+    answer.rdata   = ip;
+    answer.rlength = sizeof(ip);
+    dns_message_add_answer(&msg, &answer);
+
+    uint8_t buf[512];
+    char    hex[1024];
+    int     len = dns_message_serialize_compressed(&msg, buf, sizeof(buf));
+    printf("%s build: %d bytes [%s] arena used=%zu\n",
+           __func__, len, len > 0 ? dns_hexstring(buf, len, hex, sizeof(hex)) : "", msg.arena.used);
+
+    dns_message_clear(&msg);
+}
+
+void test_dns_message_referral(void)
+{
+    dns_message_t msg;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, 0x4321);
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    dns_question_t question;
+    dns_question_init(&question);
+    dns_question_set_qname(&question, "www.example.com");
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+
+    // 权威段：example.com NS ns1.example.com，附加段：ns1.example.com的glue地址
+    char ns_name[DNS_NAME_MAX_LENGTH];
+    dns_name_encode("ns1.example.com", ns_name, sizeof(ns_name));
+
+    dns_answer_t authority;
+    dns_answer_init(&authority);
+    dns_answer_set_name(&authority, "example.com");
+    dns_answer_set_type(&authority, DNS_TYPE_NS);
+    dns_answer_set_class(&authority, DNS_CLASS_IN);
+    dns_answer_set_ttl(&authority, 86400);
+    dns_answer_set_data(&authority, (uint8_t *)ns_name, strlen(ns_name) + 1);
+    dns_message_add_authority(&msg, &authority);
+    dns_answer_clear(&authority);
+
+    dns_answer_t additional;
+    dns_answer_init(&additional);
+    dns_answer_set_name(&additional, "ns1.example.com");
+    dns_answer_set_type(&additional, DNS_TYPE_A);
+    dns_answer_set_class(&additional, DNS_CLASS_IN);
+    dns_answer_set_ttl(&additional, 86400);
+    uint8_t ip[] = {192, 0, 2, 53};
+    dns_answer_set_data(&additional, ip, sizeof(ip));
+    dns_message_add_additional(&msg, &additional);
+    dns_answer_clear(&additional);
+
+    uint8_t buf[SHOW_BUFFER_SIZE];
+    int len = dns_message_serialize_compressed(&msg, buf, sizeof(buf));
+
+    dns_message_t msg2;
+    dns_message_init(&msg2);
+    int parsed = dns_message_deserialize(&msg2, buf, len);
+    printf("%s: serialize=%d deserialize=%d qd=%u an=%u ns=%u ar=%u\n",
+           __func__,
+           len,
+           parsed,
+           dns_message_count(&msg2, DNS_SECTION_QUESTION),
+           dns_message_count(&msg2, DNS_SECTION_ANSWER),
+           dns_message_count(&msg2, DNS_SECTION_AUTHORITY),
+           dns_message_count(&msg2, DNS_SECTION_ADDITIONAL));
+
+    for (int section = DNS_SECTION_AUTHORITY; section < DNS_SECTION_MAX; section++) {
+        const dns_answer_t *record = dns_message_get_record(&msg2, section, 0);
+        const dns_answer_t *orig   = dns_message_get_record(&msg, section, 0);
+        printf("%s: section %d %s\n", __func__, section, dns_answer_equal(record, orig) ? "round-trip ok" : "round-trip failed");
+    }
+
+    dns_message_clear(&msg2);
+    dns_message_clear(&msg);
+}
+
+void test_dns_message_iov(void)
+{
+    dns_message_t msg;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, 0x5678);
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    dns_question_t question;
+    dns_question_init(&question);
+    dns_question_set_qname(&question, "txt.example.com");
+    dns_question_set_qtype(&question, DNS_TYPE_TXT);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+
+    // 两条长TXT记录中间夹一条A记录：长数据通过iov引用，短数据复制到scratch
+    uint8_t txt[200];
+    uint8_t ip[] = {192, 0, 2, 1};
+    txt[0] = sizeof(txt) - 1;
+    memset(txt + 1, 'x', sizeof(txt) - 1);
+    for (int i = 0; i < 3; i++) {
+        dns_answer_t answer;
+        dns_answer_init(&answer);
+        dns_answer_dup_name(&answer, question.qname);
+        dns_answer_set_type(&answer, i == 1 ? DNS_TYPE_A : DNS_TYPE_TXT);
+        dns_answer_set_class(&answer, DNS_CLASS_IN);
+        dns_answer_set_ttl(&answer, 300);
+        dns_answer_set_data(&answer, i == 1 ? ip : txt, i == 1 ? sizeof(ip) : sizeof(txt));
+        dns_message_add_answer(&msg, &answer);
+        dns_answer_clear(&answer);
+    }
+    dns_question_clear(&question);
+
+    uint32_t wire_len = dns_message_wire_length(&msg);
+    uint8_t  expected[SHOW_BUFFER_SIZE];
+    int      serialize_len = dns_message_serialize(&msg, expected, sizeof(expected));
+
+    uint8_t      scratch[256];
+    struct iovec iov[8];
+    int          iov_count = dns_message_serialize_iov(&msg, scratch, sizeof(scratch), iov, 8);
+
+    // 把iov拼起来，应该与普通序列化的结果完全一致
+    uint8_t gathered[SHOW_BUFFER_SIZE];
+    size_t  gathered_len = 0;
+    for (int i = 0; i < iov_count; i++) {
+        memcpy(gathered + gathered_len, iov[i].iov_base, iov[i].iov_len);
+        gathered_len += iov[i].iov_len;
+    }
+
+    printf("%s: wire_length=%u serialize=%d iov=%d gathered=%zu %s\n",
+           __func__,
+           wire_len,
+           serialize_len,
+           iov_count,
+           gathered_len,
+           gathered_len == (size_t)serialize_len && memcmp(gathered, expected, gathered_len) == 0 ? "identical" : "different");
+
+    dns_message_clear(&msg);
+}
+
+void test_dns_message_malformed(void)
+{
+    const uint8_t header[] = {0xab, 0xcd, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+    // 问题名称的压缩指针指向自己
+    uint8_t loop[sizeof(header) + 6];
+    memcpy(loop, header, sizeof(header));
+    memcpy(loop + sizeof(header), (const uint8_t[]){0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01}, 6);
+
+    // 标签长度超出报文
+    uint8_t truncated[sizeof(header) + 4];
+    memcpy(truncated, header, sizeof(header));
+    memcpy(truncated + sizeof(header), (const uint8_t[]){0x07, 'e', 'x', 'a'}, 4);
+
+    // 0x40保留标签类型
+    uint8_t label[sizeof(header) + 6];
+    memcpy(label, header, sizeof(header));
+    memcpy(label + sizeof(header), (const uint8_t[]){0x41, 0x00, 0x00, 0x01, 0x00, 0x01}, 6);
+
+    struct {
+        const uint8_t *data;
+        size_t         len;
+        dns_error_t    expected;
+    } cases[] = {
+        {loop,      sizeof(loop),      DNS_ERROR_NAME_POINTER},
+        {truncated, sizeof(truncated), DNS_ERROR_TRUNCATED},
+        {label,     sizeof(label),     DNS_ERROR_NAME_LABEL},
+        {header,    6,                 DNS_ERROR_TRUNCATED},
+    };
+
+    dns_error_count_reset();
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        dns_message_t msg;
+        dns_message_init(&msg);
+        dns_error_clear();
+        int len = dns_message_deserialize(&msg, cases[i].data, cases[i].len);
+        printf("%s case %zu: deserialize=%d error=%s %s\n",
+               __func__,
+               i,
+               len,
+               dns_error_name(dns_error_last()),
+               0 == len && dns_error_last() == cases[i].expected ? "ok" : "unexpected");
+        dns_message_clear(&msg);
+    }
+    // 头部声称每段65535条记录，但报文只有12字节：不能按计数预分配，arena模式下也不能耗尽arena
+    const uint8_t flood[] = {0xab, 0xcd, 0x01, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    uint8_t       arena[1024];
+    dns_message_t msg;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    dns_error_clear();
+    int len = dns_message_deserialize(&msg, flood, sizeof(flood));
+    printf("%s flood: deserialize=%d error=%s arena_used=%zu %s\n",
+           __func__,
+           len,
+           dns_error_name(dns_error_last()),
+           msg.arena.used,
+           0 == len && dns_error_last() == DNS_ERROR_TRUNCATED && msg.arena.used < sizeof(arena) / 2 ? "ok" : "unexpected");
+    dns_message_clear(&msg);
+
+    printf("%s truncated=%llu name_pointer=%llu name_label=%llu\n",
+           __func__,
+           (unsigned long long)dns_error_count(DNS_ERROR_TRUNCATED),
+           (unsigned long long)dns_error_count(DNS_ERROR_NAME_POINTER),
+           (unsigned long long)dns_error_count(DNS_ERROR_NAME_LABEL));
+}
+
+void test_dns_message_lazy(void)
+{
+    // 与test_dns_message_compressed相同的CNAME响应
+    const uint8_t data[] = {
+        0xab, 0xcd, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+        0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+        0x00, 0x01, 0x00, 0x01,
+        0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x02, 0xc0, 0x10,
+        0xc0, 0x10, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 93, 184, 216, 34,
+    };
+
+    dns_message_t eager;
+    dns_message_t lazy;
+    dns_message_init(&eager);
+    dns_message_init(&lazy);
+    int eager_len = dns_message_deserialize(&eager, data, sizeof(data));
+    int lazy_len  = dns_message_deserialize_lazy(&lazy, data, sizeof(data));
+
+    // 只访问问题段时记录段还没有解码
+    const dns_question_t *question = dns_message_get_question(&lazy, 0);
+    bool pending = NULL == lazy.answers && 2 == lazy.header.answers_count && NULL != question;
+
+    // 第一次访问回答段时才解码，结果与立即解码相同
+    bool same = dns_message_count(&lazy, DNS_SECTION_ANSWER) == dns_message_count(&eager, DNS_SECTION_ANSWER);
+    for (int i = 0; same && i < dns_message_count(&eager, DNS_SECTION_ANSWER); i++) {
+        same = dns_answer_equal(dns_message_get_record(&lazy, DNS_SECTION_ANSWER, i), dns_message_get_record(&eager, DNS_SECTION_ANSWER, i));
+    }
+
+    uint8_t eager_buf[SHOW_BUFFER_SIZE];
+    uint8_t lazy_buf[SHOW_BUFFER_SIZE];
+    dns_message_t lazy2;
+    dns_message_init(&lazy2);
+    dns_message_deserialize_lazy(&lazy2, data, sizeof(data));
+    int eager_out = dns_message_serialize(&eager, eager_buf, sizeof(eager_buf));
+    int lazy_out  = dns_message_serialize(&lazy2, lazy_buf, sizeof(lazy_buf));
+
+    printf("%s: eager=%d lazy=%d pending=%s records=%s serialize=%s\n",
+           __func__,
+           eager_len,
+           lazy_len,
+           pending ? "yes" : "no",
+           same ? "identical" : "different",
+           eager_out == lazy_out && memcmp(eager_buf, lazy_buf, eager_out) == 0 ? "identical" : "different");
+
+    // 回答的名称是指向自身的压缩指针：视图只跳过名称所以接受，解码回答段时才发现；
+    // 段不能只剩部分记录，错误原因与立即解码相同，序列化也必须失败
+    uint8_t bad[sizeof(data)];
+    memcpy(bad, data, sizeof(data));
+    bad[47] = 0xc0;
+    bad[48] = 47;
+    dns_message_t eager_bad;
+    dns_message_t lazy_bad;
+    dns_message_init(&eager_bad);
+    dns_message_init(&lazy_bad);
+    dns_error_clear();
+    int eager_bad_len = dns_message_deserialize(&eager_bad, bad, sizeof(bad));
+    dns_error_t eager_error = dns_error_last();
+    int lazy_bad_len = dns_message_deserialize_lazy(&lazy_bad, bad, sizeof(bad));
+    dns_error_clear();
+    uint16_t bad_count = dns_message_count(&lazy_bad, DNS_SECTION_ANSWER);
+    dns_error_t count_error = dns_error_last();
+    int bad_out = dns_message_serialize(&lazy_bad, lazy_buf, sizeof(lazy_buf));
+    printf("%s bad pointer: eager=%d(%s) lazy=%d count=%u(%s) lazy_error=%s serialize=%d %s\n",
+           __func__,
+           eager_bad_len,
+           dns_error_name(eager_error),
+           lazy_bad_len,
+           bad_count,
+           dns_error_name(count_error),
+           dns_error_name(dns_message_lazy_error(&lazy_bad)),
+           bad_out,
+           0 == eager_bad_len && 0 == bad_count && count_error == eager_error && dns_message_lazy_error(&lazy_bad) == eager_error
+               && 0 == bad_out && dns_message_materialize(&lazy_bad) == false ? "ok" : "unexpected");
+    dns_message_clear(&eager_bad);
+    dns_message_clear(&lazy_bad);
+
+    // 未访问记录段就清空，不能泄漏
+    dns_message_t lazy3;
+    dns_message_init(&lazy3);
+    dns_message_deserialize_lazy(&lazy3, data, sizeof(data));
+    dns_message_clear(&lazy3);
+
+    dns_message_clear(&eager);
+    dns_message_clear(&lazy);
+    dns_message_clear(&lazy2);
+}
+
 int main()
 {
     test_dns_message_request();
     test_dns_message_anser();
+    test_dns_message_compressed();
+    test_dns_message_arena();
+    test_dns_message_referral();
+    test_dns_message_iov();
+    test_dns_message_malformed();
+    test_dns_message_lazy();
     return 0;
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,365 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dns_error.h"
+#include "dns_message_view.h"
+#include "dns_name.h"
+
+/**
+ * @brief 从报文中读取一个问题，不复制任何数据
+ * @return int 消耗的字节数，失败返回0
+ */
+static int dns_message_view_read_question(const uint8_t *data, size_t len, size_t offset, dns_question_view_t *question)
+{
+    int name_len = dns_name_skip(data, len, offset);
+    if (name_len < 1) {
+        return 0;
+    }
+    if (offset + name_len + 4 > len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return 0;
+    }
+
+    const uint8_t *ptr = data + offset + name_len;
+    question->name_offset = offset;
+    question->name_length = name_len;
+    question->qtype       = (ptr[0] << 8) | ptr[1];
+    question->qclass      = (ptr[2] << 8) | ptr[3];
+
+    return name_len + 4;
+}
+
+/**
+ * @brief 从报文中读取一个资源记录，不复制任何数据
+ * @return int 消耗的字节数，失败返回0
+ */
+static int dns_message_view_read_answer(const uint8_t *data, size_t len, size_t offset, dns_answer_view_t *answer)
+{
+    int name_len = dns_name_skip(data, len, offset);
+    if (name_len < 1) {
+        return 0;
+    }
+    if (offset + name_len + 10 > len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return 0;
+    }
+
+    const uint8_t *ptr = data + offset + name_len;
+    answer->name_offset  = offset;
+    answer->name_length  = name_len;
+    answer->rtype        = (ptr[0] << 8) | ptr[1];
+    answer->rclass       = (ptr[2] << 8) | ptr[3];
+    answer->rttl         = ((uint32_t)ptr[4] << 24) | (ptr[5] << 16) | (ptr[6] << 8) | ptr[7];
+    answer->rlength      = (ptr[8] << 8) | ptr[9];
+    answer->rdata_offset = offset + name_len + 10;
+    if (answer->rdata_offset + answer->rlength > len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return 0;
+    }
+
+    return name_len + 10 + answer->rlength;
+}
+
+bool dns_message_view_parse(dns_message_view_t *view, const uint8_t *data, size_t data_len)
+{
+    if (NULL == view || NULL == data || data_len > UINT16_MAX) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(view, 0, sizeof(dns_message_view_t));
+    if (data_len < DNS_HEADER_SIZE || dns_header_deserialize(&view->header, data, data_len) != DNS_HEADER_SIZE) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
+        return false;
+    }
+
+    view->data = data;
+    view->len  = data_len;
+
+    size_t offset = DNS_HEADER_SIZE;
+    view->section_offset[DNS_SECTION_QUESTION] = offset;
+    for (int i = 0; i < view->header.questions_count; i++) {
+        dns_question_view_t question;
+        int question_len = dns_message_view_read_question(data, data_len, offset, &question);
+        if (question_len < 1) {
+            return false;
+        }
+        offset += question_len;
+    }
+
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        view->section_offset[section] = offset;
+        for (int i = 0; i < dns_message_view_count(view, section); i++) {
+            dns_answer_view_t answer;
+            int answer_len = dns_message_view_read_answer(data, data_len, offset, &answer);
+            if (answer_len < 1) {
+                return false;
+            }
+            offset += answer_len;
+        }
+    }
+
+    view->end_offset = offset;
+    return true;
+}
+
+uint16_t dns_message_view_count(const dns_message_view_t *view, dns_section_t section)
+{
+    if (NULL == view) {
+        return 0;
+    }
+
+    switch (section) {
+    case DNS_SECTION_QUESTION:
+        return view->header.questions_count;
+    case DNS_SECTION_ANSWER:
+        return view->header.answers_count;
+    case DNS_SECTION_AUTHORITY:
+        return view->header.authorities_count;
+    case DNS_SECTION_ADDITIONAL:
+        return view->header.additional_count;
+    default:
+        return 0;
+    }
+}
+
+bool dns_message_view_iter_init(const dns_message_view_t *view, dns_section_t section, dns_view_iter_t *iter)
+{
+    if (NULL == view || NULL == iter || NULL == view->data || section >= DNS_SECTION_MAX) {
+        return false;
+    }
+
+    iter->view    = view;
+    iter->section = section;
+    iter->index   = 0;
+    iter->count   = dns_message_view_count(view, section);
+    iter->offset  = view->section_offset[section];
+    return true;
+}
+
+bool dns_message_view_next_question(dns_view_iter_t *iter, dns_question_view_t *question)
+{
+    if (NULL == iter || NULL == question || DNS_SECTION_QUESTION != iter->section) {
+        return false;
+    }
+
+    if (iter->index >= iter->count) {
+        return false;
+    }
+
+    const dns_message_view_t *view = iter->view;
+    int question_len = dns_message_view_read_question(view->data, view->len, iter->offset, question);
+    if (question_len < 1) {
+        return false;
+    }
+
+    iter->offset += question_len;
+    iter->index  += 1;
+    return true;
+}
+
+bool dns_message_view_next_answer(dns_view_iter_t *iter, dns_answer_view_t *answer)
+{
+    if (NULL == iter || NULL == answer || DNS_SECTION_QUESTION == iter->section) {
+        return false;
+    }
+
+    if (iter->index >= iter->count) {
+        return false;
+    }
+
+    const dns_message_view_t *view = iter->view;
+    int answer_len = dns_message_view_read_answer(view->data, view->len, iter->offset, answer);
+    if (answer_len < 1) {
+        return false;
+    }
+
+    iter->offset += answer_len;
+    iter->index  += 1;
+    return true;
+}
+
+const uint8_t *dns_message_view_rdata(const dns_message_view_t *view, const dns_answer_view_t *answer)
+{
+    if (NULL == view || NULL == answer || NULL == view->data) {
+        return NULL;
+    }
+
+    if (answer->rdata_offset + answer->rlength > view->len) {
+        return NULL;
+    }
+
+    return view->data + answer->rdata_offset;
+}
+
+int dns_message_deserialize_batch(dns_message_batch_t *batch, const uint8_t *const packets[], const size_t lens[], int n)
+{
+    if (NULL == batch || NULL == packets || NULL == lens || n < 0 || n > DNS_BATCH_MAX) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    for (int i = 0; i < n && i < DNS_BATCH_PREFETCH; i++) {
+        __builtin_prefetch(packets[i]);
+    }
+
+    int valid = 0;
+    batch->count = n;
+    for (int i = 0; i < n; i++) {
+        // 头部和问题名称通常在报文的第一个缓存行内
+        if (i + DNS_BATCH_PREFETCH < n) {
+            __builtin_prefetch(packets[i + DNS_BATCH_PREFETCH]);
+        }
+
+        const uint8_t *data = packets[i];
+        size_t         len  = lens[i];
+        batch->valid[i] = 0;
+        if (NULL == data || len < DNS_HEADER_SIZE || len > UINT16_MAX) {
+            dns_error_raise(DNS_ERROR_TRUNCATED);
+            continue;
+        }
+
+        batch->id[i]      = (data[0] << 8) | data[1];
+        batch->flags[i]   = (data[2] << 8) | data[3];
+        batch->qdcount[i] = (data[4] << 8) | data[5];
+        if (0 == batch->qdcount[i]) {
+            continue;
+        }
+
+        dns_question_view_t question;
+        if (dns_message_view_read_question(data, len, DNS_HEADER_SIZE, &question) < 1) {
+            continue;
+        }
+
+        batch->qtype[i]        = question.qtype;
+        batch->qclass[i]       = question.qclass;
+        batch->qname_offset[i] = question.name_offset;
+        batch->qname_length[i] = question.name_length;
+        batch->valid[i]        = 1;
+        valid += 1;
+    }
+
+    return valid;
+}
+
+#ifdef DNS_MESSAGE_VIEW_TEST
+#include <stdio.h>
+#include "dns_flags.h"
+#include "dns_hexstring.h"
+#include "dns_message.h"
+
+static void dump_view(const char *title, const uint8_t *data, size_t len)
+{
+    dns_message_view_t view;
+    if (dns_message_view_parse(&view, data, len) == false) {
+        printf("%s: dns_message_view_parse failed\n", title);
+        return;
+    }
+
+    printf("%s: id=0x%04x flags=0x%04x qd=%u an=%u ns=%u ar=%u end=%u/%zu\n",
+           title,
+           view.header.id,
+           view.header.flags,
+           view.header.questions_count,
+           view.header.answers_count,
+           view.header.authorities_count,
+           view.header.additional_count,
+           view.end_offset,
+           view.len);
+
+    dns_view_iter_t     iter;
+    dns_question_view_t question;
+    dns_message_view_iter_init(&view, DNS_SECTION_QUESTION, &iter);
+    while (dns_message_view_next_question(&iter, &question)) {
+        char name[256] = {0};
+        dns_name_decode((const char *)data + question.name_offset, name, sizeof(name));
+        printf("  question @%u(%u): %s qtype=%u qclass=%u\n",
+               question.name_offset, question.name_length, name, question.qtype, question.qclass);
+    }
+
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        dns_answer_view_t answer;
+        dns_message_view_iter_init(&view, section, &iter);
+        while (dns_message_view_next_answer(&iter, &answer)) {
+            char hex[256];
+            printf("  section %d record @%u(%u): rtype=%u rclass=%u ttl=%u rdata=[%s]\n",
+                   section,
+                   answer.name_offset,
+                   answer.name_length,
+                   answer.rtype,
+                   answer.rclass,
+                   answer.rttl,
+                   dns_hexstring(dns_message_view_rdata(&view, &answer), answer.rlength, hex, sizeof(hex)));
+        }
+    }
+}
+
+int main(void)
+{
+    dns_message_t msg;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, 0x1234);
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    dns_question_t question;
+    dns_question_init(&question);
+    dns_question_set_qname(&question, "apmode.enplus.com");
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+
+    dns_answer_t answer;
+    dns_answer_init(&answer);
+    dns_answer_dup_name(&answer, question.qname);
+    dns_answer_set_type(&answer, DNS_TYPE_A);
+    dns_answer_set_class(&answer, DNS_CLASS_IN);
+    dns_answer_set_ttl(&answer, 3600);
+    uint8_t ip[] = {192, 168, 4, 1};
+    dns_answer_set_data(&answer, ip, sizeof(ip));
+    dns_message_add_answer(&msg, &answer);
+    dns_answer_clear(&answer);
+    dns_question_clear(&question);
+
+    uint8_t buf[512];
+    int len = dns_message_serialize(&msg, buf, sizeof(buf));
+    dns_message_clear(&msg);
+    dump_view("serialized", buf, len);
+
+    // 上游真实响应：www.example.com A，回答名称使用压缩指针0xC00C，附带一条权威记录
+    const uint8_t compressed[] = {
+        0xab, 0xcd, 0x81, 0x80, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+        0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+        0x00, 0x01, 0x00, 0x01,
+        0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 93, 184, 216, 34,
+        0xc0, 0x10, 0x00, 0x02, 0x00, 0x01, 0x00, 0x01, 0x51, 0x80, 0x00, 0x06,
+        0x03, 'n', 's', '1', 0xc0, 0x10,
+    };
+    dump_view("compressed", compressed, sizeof(compressed));
+
+    // 截断的报文必须被拒绝
+    dns_message_view_t view;
+    int truncated = dns_message_view_parse(&view, compressed, sizeof(compressed) - 3);
+    printf("truncated: %s (%s)\n", truncated ? "accepted" : "rejected", dns_error_name(dns_error_last()));
+
+    // 一批报文中混有截断和没有问题的报文
+    const uint8_t no_question[] = {0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t *packets[] = {buf, compressed, no_question, compressed};
+    const size_t   lens[]    = {len, sizeof(compressed), sizeof(no_question), 20};
+
+    dns_message_batch_t batch;
+    int valid = dns_message_deserialize_batch(&batch, packets, lens, 4);
+    printf("batch: valid=%d/%u\n", valid, batch.count);
+    for (int i = 0; i < batch.count; i++) {
+        if (batch.valid[i]) {
+            printf("  [%d] id=0x%04x flags=0x%04x qd=%u qtype=%u qclass=%u qname @%u(%u)\n",
+                   i, batch.id[i], batch.flags[i], batch.qdcount[i], batch.qtype[i], batch.qclass[i],
+                   batch.qname_offset[i], batch.qname_length[i]);
+        } else {
+            printf("  [%d] invalid\n", i);
+        }
+    }
+
+    return truncated || valid != 2 ? 1 : 0;
+}
+#endif  // DNS_MESSAGE_VIEW_TEST
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "dns_error.h"
 #include "dns_name.h"
 
 const char *dns_name_encode(const char *name, char *buf, size_t buf_len)
@@ -11,8 +12,9 @@ const char *dns_name_encode(const char *name, char *buf, size_t buf_len)
         return NULL;
     }
 
+    // 编码后比原名称多一个长度字节
     const int name_len = strlen(name) + 1;
-    if (buf_len < name_len) {
+    if (buf_len < name_len + 1) {
         return NULL;
     }
 
@@ -104,6 +106,295 @@ const char *dns_name_encoded_string(const char *name, char *buf, size_t buf_len)
     return buf;
 }
 
+int dns_name_skip(const uint8_t *msg, size_t msg_len, size_t offset)
+{
+    if (NULL == msg) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    size_t pos = offset;
+    while (pos < msg_len) {
+        uint8_t label = msg[pos];
+        if (0 == label) {
+            return pos + 1 - offset;
+        }
+
+        switch (label & 0xC0) {
+        case 0xC0:
+            // 压缩指针占2字节，名称到此结束
+            if (pos + 2 > msg_len) {
+                break;
+            }
+            return pos + 2 - offset;
+        case 0x00:
+            pos += label + 1;
+            if (pos - offset >= DNS_NAME_MAX_LENGTH) {
+                dns_error_raise(DNS_ERROR_NAME_TOO_LONG);
+                return 0;
+            }
+            continue;
+        default:
+            // 0x40、0x80为保留的标签类型
+            dns_error_raise(DNS_ERROR_NAME_LABEL);
+            return 0;
+        }
+        break;
+    }
+
+    dns_error_raise(DNS_ERROR_TRUNCATED);
+    return 0;
+}
+
+int dns_name_unpack(const uint8_t *msg, size_t msg_len, size_t offset, char *buf, size_t buf_size, size_t *name_len)
+{
+    if (NULL == msg || NULL == buf || buf_size < 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    size_t max_len  = buf_size < DNS_NAME_MAX_LENGTH ? buf_size : DNS_NAME_MAX_LENGTH;
+    size_t pos      = offset;  // 当前读取位置
+    size_t limit    = offset;  // 下一个压缩指针必须指向此偏移之前
+    size_t wire_len = 0;       // 名称在原位置占用的字节数，遇到第一个指针时确定
+    size_t out_len  = 0;
+    int    hops     = 0;
+
+    while (pos < msg_len) {
+        uint8_t label = msg[pos];
+
+        if (0 == label) {
+            if (0 == wire_len) {
+                wire_len = pos + 1 - offset;
+            }
+            buf[out_len] = 0;
+            if (name_len) {
+                *name_len = out_len;
+            }
+            return wire_len;
+        }
+
+        switch (label & 0xC0) {
+        case 0xC0: {
+            if (pos + 2 > msg_len) {
+                dns_error_raise(DNS_ERROR_TRUNCATED);
+                return 0;
+            }
+
+            size_t target = ((label & 0x3F) << 8) | msg[pos + 1];
+            if (target >= limit || ++hops > DNS_NAME_MAX_HOPS) {
+                // 指针只能指向之前出现过的名称，目标严格递减保证不会循环
+                dns_error_raise(DNS_ERROR_NAME_POINTER);
+                return 0;
+            }
+
+            if (0 == wire_len) {
+                wire_len = pos + 2 - offset;
+            }
+            limit = target;
+            pos   = target;
+            break;
+        }
+        case 0x00:
+            // 存储格式为C字符串，标签内不能出现0字节；预留结尾的0
+            if (pos + 1 + label > msg_len) {
+                dns_error_raise(DNS_ERROR_TRUNCATED);
+                return 0;
+            }
+            if (out_len + label + 2 > max_len) {
+                dns_error_raise(max_len < buf_size ? DNS_ERROR_NAME_TOO_LONG : DNS_ERROR_BUFFER_TOO_SMALL);
+                return 0;
+            }
+            if (memchr(msg + pos + 1, 0, label) != NULL) {
+                dns_error_raise(DNS_ERROR_NAME_LABEL);
+                return 0;
+            }
+            memcpy(buf + out_len, msg + pos, label + 1);
+            out_len += label + 1;
+            pos     += label + 1;
+            break;
+        default:
+            // 0x40、0x80为保留的标签类型
+            dns_error_raise(DNS_ERROR_NAME_LABEL);
+            return 0;
+        }
+    }
+
+    dns_error_raise(DNS_ERROR_TRUNCATED);
+    return 0;
+}
+
+static inline uint8_t dns_name_lower(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/**
+ * @brief 比较报文中offset处的名称与一个未压缩的名称后缀是否相同（大小写不敏感）
+ * @param msg 报文，只包含已经写出的部分
+ * @param msg_len 已经写出的长度
+ * @param offset 报文中名称的偏移
+ * @param suffix 编码格式的名称后缀
+ */
+static bool dns_name_suffix_equal(const uint8_t *msg, size_t msg_len, size_t offset, const uint8_t *suffix)
+{
+    size_t pos  = offset;
+    int    hops = 0;
+
+    while (pos < msg_len) {
+        uint8_t label = msg[pos];
+        if ((label & 0xC0) == 0xC0) {
+            if (pos + 2 > msg_len || ++hops > DNS_NAME_MAX_HOPS) {
+                return false;
+            }
+            pos = ((label & 0x3F) << 8) | msg[pos + 1];
+            continue;
+        }
+
+        if (label != *suffix || pos + label + 1 > msg_len) {
+            return false;
+        }
+        if (0 == label) {
+            return true;
+        }
+
+        for (int i = 1; i <= label; i++) {
+            if (dns_name_lower(msg[pos + i]) != dns_name_lower(suffix[i])) {
+                return false;
+            }
+        }
+        pos    += label + 1;
+        suffix += label + 1;
+    }
+
+    return false;
+}
+
+void dns_name_table_init(dns_name_table_t *table)
+{
+    if (NULL == table) {
+        return;
+    }
+
+    memset(table, 0, sizeof(dns_name_table_t));
+}
+
+static uint16_t dns_name_table_find(const dns_name_table_t *table, const uint8_t *msg, size_t msg_len, uint32_t hash, const uint8_t *suffix)
+{
+    for (uint32_t i = 0; i < DNS_NAME_TABLE_SIZE; i++) {
+        uint32_t slot = (hash + i) & (DNS_NAME_TABLE_SIZE - 1);
+        if (0 == table->offset[slot]) {
+            return 0;
+        }
+        if (table->hash[slot] == hash && dns_name_suffix_equal(msg, msg_len, table->offset[slot], suffix)) {
+            return table->offset[slot];
+        }
+    }
+
+    return 0;
+}
+
+static void dns_name_table_insert(dns_name_table_t *table, uint32_t hash, uint16_t offset)
+{
+    // 保留四分之一空槽，保证查找能在空槽处结束
+    if (table->count >= DNS_NAME_TABLE_SIZE / 4 * 3) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < DNS_NAME_TABLE_SIZE; i++) {
+        uint32_t slot = (hash + i) & (DNS_NAME_TABLE_SIZE - 1);
+        if (0 == table->offset[slot]) {
+            table->hash[slot]   = hash;
+            table->offset[slot] = offset;
+            table->count       += 1;
+            return;
+        }
+    }
+}
+
+int dns_name_pack(dns_name_table_t *table, const char *name, uint8_t *msg, size_t msg_size, size_t offset)
+{
+    if (NULL == name || NULL == msg || offset > msg_size) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    const uint8_t *src      = (const uint8_t *)name;
+    size_t         name_len = strlen(name);
+    if (name_len + 1 > DNS_NAME_MAX_LENGTH) {
+        dns_error_raise(DNS_ERROR_NAME_TOO_LONG);
+        return 0;
+    }
+
+    if (NULL == table) {
+        if (offset + name_len + 1 > msg_size) {
+            dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+            return 0;
+        }
+        memcpy(msg + offset, name, name_len + 1);
+        return name_len + 1;
+    }
+
+    // 记录每个标签的起点，再从右往左计算每个后缀的哈希
+    uint8_t  label_pos[DNS_NAME_MAX_LENGTH / 2];
+    uint32_t label_hash[DNS_NAME_MAX_LENGTH / 2];
+    int      labels = 0;
+    for (size_t pos = 0; pos < name_len; pos += src[pos] + 1) {
+        if (src[pos] > DNS_NAME_MAX_LABEL || pos + src[pos] + 1 > name_len) {
+            dns_error_raise(DNS_ERROR_NAME_LABEL);
+            return 0;
+        }
+        label_pos[labels++] = pos;
+    }
+
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (int i = labels - 1; i >= 0; i--) {
+        const uint8_t *label = src + label_pos[i];
+        for (int j = 0; j <= label[0]; j++) {
+            hash ^= dns_name_lower(label[j]);
+            hash *= 16777619u;
+        }
+        label_hash[i] = hash;
+    }
+
+    // 从最长的后缀开始找，第一个命中的就是能复用的最长后缀
+    int      match   = labels;
+    uint16_t pointer = 0;
+    for (int i = 0; i < labels; i++) {
+        pointer = dns_name_table_find(table, msg, offset, label_hash[i], src + label_pos[i]);
+        if (pointer) {
+            match = i;
+            break;
+        }
+    }
+
+    size_t prefix_len = match < labels ? label_pos[match] : name_len;
+    size_t total_len  = prefix_len + (match < labels ? 2 : 1);
+    if (offset + total_len > msg_size) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    memcpy(msg + offset, src, prefix_len);
+    if (match < labels) {
+        msg[offset + prefix_len]     = 0xC0 | (pointer >> 8);
+        msg[offset + prefix_len + 1] = pointer & 0xFF;
+    } else {
+        msg[offset + prefix_len] = 0;
+    }
+
+    // 登记新写出的后缀，压缩指针只有14位，更远的偏移无法被引用
+    for (int i = 0; i < match; i++) {
+        size_t suffix_offset = offset + label_pos[i];
+        if (suffix_offset > 0x3FFF) {
+            break;
+        }
+        dns_name_table_insert(table, label_hash[i], suffix_offset);
+    }
+
+    return total_len;
+}
+
 #ifdef DNS_NAME_TEST
 int main(void)
 {
@@ -124,6 +415,49 @@ int main(void)
     printf("orig:%s\n", orig);
     printf("encoded string:%s\n", encoded_buf);
 
-    return 0;
+    // www.example.com 之后跟着 mail + 指向 example.com 的压缩指针
+    const uint8_t msg[] = {
+        0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+        0x04, 'm', 'a', 'i', 'l', 0xc0, 0x04,
+        0xc0, 0x11,
+        0xc0, 0x1a,
+    };
+    char   unpacked[DNS_NAME_MAX_LENGTH];
+    size_t unpacked_len = 0;
+    int    failed       = 0;
+
+    int wire_len = dns_name_unpack(msg, sizeof(msg), 17, unpacked, sizeof(unpacked), &unpacked_len);
+    dns_name_decode(unpacked, orig, sizeof(orig));
+    printf("unpack @17: wire=%d len=%zu name=%s\n", wire_len, unpacked_len, orig);
+    failed |= wire_len != 7 || strcmp(orig, "mail.example.com") != 0;
+
+    wire_len = dns_name_unpack(msg, sizeof(msg), 24, unpacked, sizeof(unpacked), &unpacked_len);
+    dns_name_decode(unpacked, orig, sizeof(orig));
+    printf("unpack @24: wire=%d len=%zu name=%s\n", wire_len, unpacked_len, orig);
+    failed |= wire_len != 2 || strcmp(orig, "mail.example.com") != 0;
+
+    // 指向自身的指针构成循环，必须被拒绝
+    wire_len = dns_name_unpack(msg, sizeof(msg), 26, unpacked, sizeof(unpacked), NULL);
+    printf("unpack loop: wire=%d\n", wire_len);
+    failed |= wire_len != 0;
+
+    printf("skip @17: %d\n", dns_name_skip(msg, sizeof(msg), 17));
+    failed |= dns_name_skip(msg, sizeof(msg), 17) != 7;
+
+    // 压缩写出：第二个名称只需要写出mail和一个指针
+    dns_name_table_t table;
+    uint8_t          packed[64] = {0};
+    char             encoded2[256];
+    dns_name_table_init(&table);
+    dns_name_encode("www.Example.com", encoded, sizeof(encoded));
+    dns_name_encode("mail.example.COM", encoded2, sizeof(encoded2));
+    int packed_len1 = dns_name_pack(&table, encoded, packed, sizeof(packed), 12);
+    int packed_len2 = dns_name_pack(&table, encoded2, packed, sizeof(packed), 12 + packed_len1);
+    dns_name_unpack(packed, 12 + packed_len1 + packed_len2, 12 + packed_len1, unpacked, sizeof(unpacked), NULL);
+    dns_name_decode(unpacked, orig, sizeof(orig));
+    printf("pack: %d + %d bytes, second=%s\n", packed_len1, packed_len2, orig);
+    failed |= packed_len1 != 17 || packed_len2 != 7 || strcmp(orig, "mail.Example.com") != 0;
+
+    return failed;
 }
 #endif  // DNS_NAME_TEST
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_error.h"
+#include "dns_flags.h"
+#include "dns_message_view.h"
+#include "dns_packet_cache.h"
+#include "dns_type.h"
+
+#define DNS_PACKET_CACHE_HEADER_SIZE 12
+#define DNS_PACKET_CACHE_EDNS_DO     0x80   // OPT记录TTL字段中扩展标志的高字节里的DO位
+#define DNS_PACKET_CACHE_UDP_SIZE    512    // 没有EDNS的客户端可以接收的最大响应
+
+static uint16_t dns_packet_cache_get16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint8_t dns_packet_cache_lower(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static uint32_t dns_packet_cache_hash(const uint8_t *key, size_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint8_t *dns_packet_cache_entry_key(dns_packet_cache_entry_t *entry)
+{
+    return (uint8_t *)(entry->offsets + entry->ttl_count);
+}
+
+static uint8_t *dns_packet_cache_entry_response(dns_packet_cache_entry_t *entry)
+{
+    return dns_packet_cache_entry_key(entry) + entry->key_len;
+}
+
+/**
+ * @brief 取出缓存键和查询能接收的UDP负载大小
+ * @param udp_size : 输出OPT通告的大小（小于512时按512），没有EDNS时为512
+ * @return size_t 键长度，查询不可缓存返回0
+ */
+static size_t dns_packet_cache_parse(const uint8_t *query, size_t len, uint8_t *key, uint16_t *udp_size)
+{
+    if (NULL == query || NULL == key || len < DNS_PACKET_CACHE_HEADER_SIZE) {
+        return 0;
+    }
+
+    uint16_t flags   = dns_packet_cache_get16(query + 2);
+    uint16_t qdcount = dns_packet_cache_get16(query + 4);
+    uint16_t ancount = dns_packet_cache_get16(query + 6);
+    uint16_t nscount = dns_packet_cache_get16(query + 8);
+    uint16_t arcount = dns_packet_cache_get16(query + 10);
+    if (dns_flags_get_qr(flags) != DNS_QR_QUERY || dns_flags_get_opcode(flags) != DNS_OPCODE_QUERY || 1 != qdcount || 0 != ancount ||
+        0 != nscount || arcount > 1) {
+        return 0;
+    }
+
+    // 名称小写，不接受压缩指针
+    size_t offset = DNS_PACKET_CACHE_HEADER_SIZE;
+    for (;;) {
+        if (offset >= len || offset - DNS_PACKET_CACHE_HEADER_SIZE >= DNS_NAME_MAX_LENGTH) {
+            return 0;
+        }
+
+        uint8_t label = query[offset];
+        if (label > DNS_NAME_MAX_LABEL || offset + 1 + label > len) {
+            return 0;
+        }
+
+        key[offset - DNS_PACKET_CACHE_HEADER_SIZE] = label;
+        offset += 1;
+        if (0 == label) {
+            break;
+        }
+
+        for (size_t end = offset + label; offset < end; offset++) {
+            key[offset - DNS_PACKET_CACHE_HEADER_SIZE] = dns_packet_cache_lower(query[offset]);
+        }
+    }
+
+    if (offset + 4 > len) {
+        return 0;
+    }
+    memcpy(key + offset - DNS_PACKET_CACHE_HEADER_SIZE, query + offset, 4);
+    offset += 4;
+
+    uint8_t bits = 0;
+    if (dns_flags_get_rd(flags) == DNS_RD_YES) {
+        bits |= DNS_PACKET_CACHE_RD;
+    }
+    if (flags & (1 << DNS_FLAGS_INDEX_CD)) {
+        bits |= DNS_PACKET_CACHE_CD;
+    }
+
+    // 附加段只能是根名称的OPT记录：名称1 + 类型2 + 类2 + TTL4 + 数据长度2；
+    // 带选项（ECS、COOKIE等）的查询不缓存，否则不同客户端共用条目，命中时回放别人的选项
+    if (1 == arcount) {
+        if (offset + 11 > len || 0 != query[offset] || DNS_TYPE_OPT != dns_packet_cache_get16(query + offset + 1) ||
+            0 != dns_packet_cache_get16(query + offset + 9)) {
+            return 0;
+        }
+        bits |= DNS_PACKET_CACHE_EDNS;
+        if (query[offset + 7] & DNS_PACKET_CACHE_EDNS_DO) {
+            bits |= DNS_PACKET_CACHE_DO;
+        }
+    }
+
+    // OPT的类字段是UDP负载大小，小于512时按512处理（RFC 6891 §6.2.5）
+    *udp_size = DNS_PACKET_CACHE_UDP_SIZE;
+    if (1 == arcount && dns_packet_cache_get16(query + offset + 3) > DNS_PACKET_CACHE_UDP_SIZE) {
+        *udp_size = dns_packet_cache_get16(query + offset + 3);
+    }
+
+    size_t key_len = offset - DNS_PACKET_CACHE_HEADER_SIZE;
+    key[key_len]   = bits;
+    return key_len + 1;
+}
+
+size_t dns_packet_cache_key(const uint8_t *query, size_t len, uint8_t *key)
+{
+    uint16_t udp_size;
+    return dns_packet_cache_parse(query, len, key, &udp_size);
+}
+
+static dns_shard_node_t **dns_packet_cache_find(dns_shard_t *shard, uint32_t hash, const uint8_t *key, size_t key_len)
+{
+    dns_shard_node_t **link = dns_shard_bucket(shard, hash);
+    for (; NULL != *link; link = &(*link)->next) {
+        dns_packet_cache_entry_t *entry = (dns_packet_cache_entry_t *)*link;
+        if (entry->node.hash == hash && entry->key_len == key_len && memcmp(dns_packet_cache_entry_key(entry), key, key_len) == 0) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+bool dns_packet_cache_init(dns_packet_cache_t *cache, uint32_t shards, uint32_t capacity)
+{
+    if (NULL == cache) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+    return dns_shards_init(&cache->table, shards, capacity);
+}
+
+void dns_packet_cache_clear(dns_packet_cache_t *cache)
+{
+    if (NULL != cache) {
+        dns_shards_clear(&cache->table);
+    }
+}
+
+/**
+ * @brief 校验响应并收集所有记录的TTL偏移和最小TTL
+ * @return int TTL偏移的个数，不可缓存返回-1
+ */
+static int dns_packet_cache_scan(const uint8_t *response, size_t len, uint16_t *offsets, uint32_t *min_ttl)
+{
+    dns_message_view_t view;
+    if (!dns_message_view_parse(&view, response, len)) {
+        return -1;
+    }
+
+    uint16_t flags = view.header.flags;
+    uint8_t  rcode = dns_flags_get_rcode(flags);
+    if (dns_flags_get_qr(flags) != DNS_QR_RESPONSE || dns_flags_get_tc(flags) == DNS_TC_YES ||
+        (DNS_RCODE_NOERROR != rcode && DNS_RCODE_NXDOMAIN != rcode)) {
+        return -1;
+    }
+
+    int count = 0;
+    *min_ttl  = UINT32_MAX;
+    for (int section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX; section++) {
+        dns_view_iter_t   iter;
+        dns_answer_view_t answer;
+        dns_message_view_iter_init(&view, (dns_section_t)section, &iter);
+        while (dns_message_view_next_answer(&iter, &answer)) {
+            // OPT记录的TTL字段是扩展标志，不能递减；带选项的OPT（COOKIE、ECS作用域）只属于当次查询
+            if (DNS_TYPE_OPT == answer.rtype) {
+                if (answer.rlength > 0) {
+                    return -1;
+                }
+                continue;
+            }
+            if (count >= DNS_PACKET_CACHE_TTLS_MAX) {
+                return -1;
+            }
+            offsets[count++] = answer.rdata_offset - 6;
+            *min_ttl         = answer.rttl < *min_ttl ? answer.rttl : *min_ttl;
+        }
+    }
+
+    // 没有记录（例如没有SOA的否定响应）时不知道可以缓存多久
+    return count > 0 && *min_ttl > 0 ? count : -1;
+}
+
+bool dns_packet_cache_store(dns_packet_cache_t *cache, const uint8_t *query, size_t query_len, const uint8_t *response, size_t response_len,
+                            uint32_t now)
+{
+    if (NULL == cache || NULL == cache->table.shards || NULL == query || NULL == response || response_len > 0xFFFF) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    uint8_t key[DNS_PACKET_CACHE_KEY_MAX];
+    size_t  key_len = dns_packet_cache_key(query, query_len, key);
+    if (0 == key_len) {
+        return false;
+    }
+
+    // 响应的问题必须与键中的问题一致（名称不区分大小写，类型和类原样比较），命中时才能用查询的问题原样覆盖
+    size_t         question_len = key_len - 1;
+    size_t         name_len     = question_len - 4;
+    const uint8_t *question     = response + DNS_PACKET_CACHE_HEADER_SIZE;
+    if (response_len < DNS_PACKET_CACHE_HEADER_SIZE + question_len || 1 != dns_packet_cache_get16(response + 4)) {
+        return false;
+    }
+    for (size_t i = 0; i < name_len; i++) {
+        if (dns_packet_cache_lower(question[i]) != key[i]) {
+            return false;
+        }
+    }
+    if (memcmp(question + name_len, key + name_len, 4) != 0) {
+        return false;
+    }
+
+    uint16_t offsets[DNS_PACKET_CACHE_TTLS_MAX];
+    uint32_t min_ttl   = 0;
+    int      ttl_count = dns_packet_cache_scan(response, response_len, offsets, &min_ttl);
+    if (ttl_count < 0) {
+        return false;
+    }
+
+    size_t                    offsets_size = ttl_count * sizeof(uint16_t);
+    dns_packet_cache_entry_t *entry        = (dns_packet_cache_entry_t *)malloc(sizeof(dns_packet_cache_entry_t) + offsets_size + key_len + response_len);
+    if (NULL == entry) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+
+    entry->node.hash = dns_packet_cache_hash(key, key_len);
+    entry->stored    = now;
+    entry->expire    = now + (min_ttl < INT32_MAX ? min_ttl : INT32_MAX);
+    entry->key_len   = key_len;
+    entry->ttl_count = ttl_count;
+    entry->len       = response_len;
+    memcpy(entry->offsets, offsets, offsets_size);
+    memcpy(dns_packet_cache_entry_key(entry), key, key_len);
+    memcpy(dns_packet_cache_entry_response(entry), response, response_len);
+
+    dns_shard_t *shard = dns_shards_get(&cache->table, entry->node.hash);
+    pthread_mutex_lock(&shard->lock);
+    dns_shard_node_t **link = dns_packet_cache_find(shard, entry->node.hash, key, key_len);
+    if (NULL != link) {
+        free(dns_shard_remove(shard, link));
+    } else if (shard->count >= cache->table.capacity) {
+        free(dns_shard_remove(shard, dns_shard_link(shard, shard->lru_tail)));
+        shard->evictions += 1;
+    }
+    dns_shard_insert(shard, &entry->node);
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+size_t dns_packet_cache_respond(dns_packet_cache_t *cache, uint8_t *packet, size_t len, size_t size, uint32_t now)
+{
+    if (NULL == cache || NULL == cache->table.shards || NULL == packet) {
+        return 0;
+    }
+
+    uint8_t  key[DNS_PACKET_CACHE_KEY_MAX];
+    uint16_t udp_size = 0;
+    size_t   key_len  = dns_packet_cache_parse(packet, len, key, &udp_size);
+    if (0 == key_len) {
+        return 0;
+    }
+
+    // 覆盖报文前保存查询的ID和问题（保留原始大小写，兼容0x20随机化）
+    uint8_t id[2]  = {packet[0], packet[1]};
+    size_t  qlen   = key_len - 1;
+    uint8_t question[DNS_PACKET_CACHE_KEY_MAX];
+    memcpy(question, packet + DNS_PACKET_CACHE_HEADER_SIZE, qlen);
+
+    uint32_t     hash  = dns_packet_cache_hash(key, key_len);
+    dns_shard_t *shard = dns_shards_get(&cache->table, hash);
+    size_t       reply = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    dns_shard_node_t         **link  = dns_packet_cache_find(shard, hash, key, key_len);
+    dns_packet_cache_entry_t  *entry = NULL != link ? (dns_packet_cache_entry_t *)*link : NULL;
+    if (NULL == entry) {
+        shard->misses += 1;
+    } else if ((int32_t)(entry->expire - now) <= 0) {
+        free(dns_shard_remove(shard, link));
+        shard->misses  += 1;
+        shard->expired += 1;
+    } else if (entry->len > size || entry->len > udp_size) {
+        // 键相同的EDNS查询可能通告不同的大小，放不下时交给上游回复截断的响应
+        shard->misses += 1;
+    } else {
+        memcpy(packet, dns_packet_cache_entry_response(entry), entry->len);
+
+        uint32_t elapsed = now - entry->stored;
+        for (int i = 0; elapsed > 0 && i < entry->ttl_count; i++) {
+            uint8_t *p   = packet + entry->offsets[i];
+            uint32_t ttl = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+            ttl          = ttl > elapsed ? ttl - elapsed : 0;
+            p[0]         = ttl >> 24;
+            p[1]         = ttl >> 16;
+            p[2]         = ttl >> 8;
+            p[3]         = ttl;
+        }
+
+        dns_shard_touch(shard, &entry->node);
+        shard->hits += 1;
+        reply        = entry->len;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (reply > 0) {
+        packet[0] = id[0];
+        packet[1] = id[1];
+        memcpy(packet + DNS_PACKET_CACHE_HEADER_SIZE, question, qlen);
+    }
+    return reply;
+}
+
+void dns_packet_cache_stats(dns_packet_cache_t *cache, dns_packet_cache_stats_t *stats)
+{
+    dns_shards_stats(NULL != cache ? &cache->table : NULL, stats);
+}
+
+#ifdef DNS_PACKET_CACHE_TEST
+#include <time.h>
+#include "dns_class.h"
+#include "dns_message.h"
+#include "dns_reply.h"
+
+/**
+ * @brief 按线路格式直接构造查询，udp_size大于0时附加通告该大小的OPT记录，do_bit为true时置DO位
+ */
+static size_t test_query(uint8_t *buf, const char *qname, dns_type_t qtype, uint16_t id, bool rd, uint16_t udp_size, bool do_bit)
+{
+    char encoded[DNS_NAME_MAX_LENGTH + 2];
+    dns_name_encode(qname, encoded, sizeof(encoded));
+    size_t name_len = strlen(encoded) + 1;
+
+    memset(buf, 0, DNS_PACKET_CACHE_HEADER_SIZE);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xFF;
+    buf[2] = rd ? 0x01 : 0;
+    buf[5] = 1;
+    memcpy(buf + DNS_PACKET_CACHE_HEADER_SIZE, encoded, name_len);
+
+    uint8_t *p = buf + DNS_PACKET_CACHE_HEADER_SIZE + name_len;
+    p[0] = qtype >> 8;
+    p[1] = qtype & 0xFF;
+    p[2] = 0;
+    p[3] = DNS_CLASS_IN;
+    p   += 4;
+    if (udp_size > 0) {
+        uint8_t opt[] = {0, 0, DNS_TYPE_OPT, udp_size >> 8, udp_size & 0xFF, 0, 0, do_bit ? 0x80 : 0, 0, 0, 0};
+        memcpy(p, opt, sizeof(opt));
+        p      += sizeof(opt);
+        buf[11] = 1;
+    }
+    return p - buf;
+}
+
+/**
+ * @brief 由查询构造响应：两条A记录（TTL 300）和一条附加的TXT记录（TTL 120），records超过3时再追加A记录
+ */
+static size_t test_response(const uint8_t *query, size_t len, uint8_t *buf, size_t size, dns_rcode_t rcode, int records)
+{
+    uint8_t     ip1[] = {192, 0, 2, 1}, ip2[] = {192, 0, 2, 2};
+    dns_reply_t reply;
+    memcpy(buf, query, len);
+    dns_reply_init(&reply, buf, len, size);
+    dns_reply_set_ra(&reply, DNS_RA_YES);
+    dns_reply_set_rcode(&reply, rcode);
+    if (records > 0) {
+        dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip1, sizeof(ip1));
+        dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip2, sizeof(ip2));
+        for (int i = 3; i < records; i++) {
+            dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip1, sizeof(ip1));
+        }
+        dns_reply_add_record(&reply, DNS_SECTION_ADDITIONAL, DNS_TYPE_TXT, DNS_CLASS_IN, 120, (const uint8_t *)"\x02hi", 3);
+    }
+    return dns_reply_finish(&reply);
+}
+
+int main(void)
+{
+    bool               ok = true;
+    dns_packet_cache_t cache;
+    ok = ok && dns_packet_cache_init(&cache, 4, 64);
+
+    uint8_t query[512], response[512], packet[512];
+    size_t  query_len    = test_query(query, "www.example.com", DNS_TYPE_A, 0x1111, true, 0, false);
+    size_t  response_len = test_response(query, query_len, response, sizeof(response), DNS_RCODE_NOERROR, 3);
+    ok = ok && dns_packet_cache_store(&cache, query, query_len, response, response_len, 1000);
+
+    // 命中：事务ID和问题大小写换成本次查询的，所有TTL减去经过的50秒
+    size_t len = test_query(packet, "WWW.Example.com", DNS_TYPE_A, 0x7777, true, 0, false);
+    len        = dns_packet_cache_respond(&cache, packet, len, sizeof(packet), 1050);
+    ok         = ok && len == response_len && memcmp(packet + 13, "WWW", 3) == 0;
+
+    dns_message_t msg;
+    dns_message_init(&msg);
+    ok = ok && dns_message_deserialize(&msg, packet, len) > 0 && dns_header_get_id(&msg.header) == 0x7777;
+    ok = ok && dns_message_count(&msg, DNS_SECTION_ANSWER) == 2 && dns_message_count(&msg, DNS_SECTION_ADDITIONAL) == 1;
+    ok = ok && dns_answer_get_ttl(&msg.answers[0]) == 250 && dns_answer_get_ttl(&msg.answers[1]) == 250;
+    ok = ok && dns_answer_get_ttl(&msg.additionals[0]) == 70;
+    dns_message_clear(&msg);
+    printf("hit: len=%zu %s\n", len, ok ? "ok" : "FAILED");
+
+    // RD不同、带EDNS、DO不同的查询都不共用缓存
+    len = test_query(packet, "www.example.com", DNS_TYPE_A, 0x2222, false, 0, false);
+    ok  = ok && 0 == dns_packet_cache_respond(&cache, packet, len, sizeof(packet), 1050);
+    len = test_query(packet, "www.example.com", DNS_TYPE_A, 0x2222, true, 1232, false);
+    ok  = ok && 0 == dns_packet_cache_respond(&cache, packet, len, sizeof(packet), 1050);
+
+    uint8_t key1[DNS_PACKET_CACHE_KEY_MAX], key2[DNS_PACKET_CACHE_KEY_MAX];
+    size_t  key1_len = dns_packet_cache_key(packet, len, key1);
+    len              = test_query(packet, "www.example.com", DNS_TYPE_A, 0x2222, true, 1232, true);
+    size_t key2_len  = dns_packet_cache_key(packet, len, key2);
+    ok = ok && key1_len == key2_len && key1[key1_len - 1] == (DNS_PACKET_CACHE_RD | DNS_PACKET_CACHE_EDNS);
+    ok = ok && key2[key2_len - 1] == (DNS_PACKET_CACHE_RD | DNS_PACKET_CACHE_EDNS | DNS_PACKET_CACHE_DO);
+
+    // 类型码大于字母范围的HTTPS（65）查询：类型和类不参与大小写转换
+    uint8_t https[512];
+    size_t  https_len = test_query(https, "svc.example.com", DNS_TYPE_HTTPS, 0x4444, true, 0, false);
+    size_t  hresp_len = test_response(https, https_len, response, sizeof(response), DNS_RCODE_NOERROR, 3);
+    ok  = ok && dns_packet_cache_store(&cache, https, https_len, response, hresp_len, 1000);
+    len = test_query(packet, "SVC.example.com", DNS_TYPE_HTTPS, 0x5555, true, 0, false);
+    ok  = ok && dns_packet_cache_respond(&cache, packet, len, sizeof(packet), 1010) == hresp_len && packet[0] == 0x55;
+    response[https_len - 3] = 'a';
+    ok = ok && !dns_packet_cache_store(&cache, https, https_len, response, hresp_len, 1000);
+    printf("https: %s\n", ok ? "ok" : "FAILED");
+
+    // 带COOKIE选项的查询不可缓存；带选项的OPT响应也不保存
+    uint8_t cookie[512];
+    size_t  cookie_len = test_query(cookie, "www.example.com", DNS_TYPE_A, 0x1212, true, 1232, false);
+    uint8_t option[]   = {0, 10, 0, 8, 1, 2, 3, 4, 5, 6, 7, 8};
+    memcpy(cookie + cookie_len, option, sizeof(option));
+    cookie[cookie_len - 1] = sizeof(option);
+    cookie_len += sizeof(option);
+    ok = ok && 0 == dns_packet_cache_key(cookie, cookie_len, key1) && 0 == dns_packet_cache_respond(&cache, cookie, cookie_len, sizeof(cookie), 1050);
+    ok = ok && !dns_packet_cache_store(&cache, cookie, cookie_len, response, response_len, 1000);
+
+    uint8_t opt_response[600];
+    len          = test_query(packet, "www.example.com", DNS_TYPE_A, 0x1313, true, 1232, false);
+    response_len = test_response(query, query_len, response, sizeof(response), DNS_RCODE_NOERROR, 3);
+    memcpy(opt_response, response, response_len);
+    memcpy(opt_response + response_len, cookie + cookie_len - sizeof(option) - 11, 11 + sizeof(option));
+    opt_response[11] += 1;
+    ok = ok && !dns_packet_cache_store(&cache, packet, len, opt_response, response_len + 11 + sizeof(option), 1000);
+    opt_response[response_len + 10] = 0;
+    ok = ok && dns_packet_cache_store(&cache, packet, len, opt_response, response_len + 11, 1000);
+    printf("edns options: %s\n", ok ? "ok" : "FAILED");
+
+    // 超过512字节的响应只回复给通告了足够大小的EDNS查询
+    uint8_t large[2048], big[512];
+    size_t  big_len   = test_query(big, "big.example.com", DNS_TYPE_A, 0x6666, true, 4096, false);
+    size_t  large_len = test_response(big, big_len, large, sizeof(large), DNS_RCODE_NOERROR, 40);
+    ok  = ok && large_len > 600 && dns_packet_cache_store(&cache, big, big_len, large, large_len, 1000);
+    len = test_query(large, "big.example.com", DNS_TYPE_A, 0x6666, true, 512, false);
+    ok  = ok && 0 == dns_packet_cache_respond(&cache, large, len, sizeof(large), 1010);
+    len = test_query(large, "big.example.com", DNS_TYPE_A, 0x6666, true, 100, false);
+    ok  = ok && 0 == dns_packet_cache_respond(&cache, large, len, sizeof(large), 1010);
+    len = test_query(large, "big.example.com", DNS_TYPE_A, 0x6666, true, 1232, false);
+    ok  = ok && dns_packet_cache_respond(&cache, large, len, sizeof(large), 1010) == large_len;
+    printf("udp size: %s\n", ok ? "ok" : "FAILED");
+
+    // 缓冲区放不下响应时报文不变
+    len = test_query(packet, "www.example.com", DNS_TYPE_A, 0x3333, true, 0, false);
+    ok  = ok && 0 == dns_packet_cache_respond(&cache, packet, len, response_len - 1, 1050) && packet[0] == 0x33;
+
+    // 最小TTL（120秒）到期后删除
+    ok = ok && 0 == dns_packet_cache_respond(&cache, packet, len, sizeof(packet), 1120);
+
+    // 不可缓存的响应
+    uint8_t other[512];
+    size_t  other_len = test_query(other, "mail.example.com", DNS_TYPE_A, 0x1111, true, 0, false);
+    size_t  bad_len   = test_response(query, query_len, response, sizeof(response), DNS_RCODE_SERVFAIL, 3);
+    ok = ok && !dns_packet_cache_store(&cache, query, query_len, response, bad_len, 1000);
+    bad_len = test_response(query, query_len, response, sizeof(response), DNS_RCODE_NXDOMAIN, 0);
+    ok      = ok && !dns_packet_cache_store(&cache, query, query_len, response, bad_len, 1000);
+    bad_len = test_response(query, query_len, response, sizeof(response), DNS_RCODE_NOERROR, 3);
+    ok      = ok && !dns_packet_cache_store(&cache, other, other_len, response, bad_len, 1000);
+    response[2] |= 0x02;
+    ok = ok && !dns_packet_cache_store(&cache, query, query_len, response, bad_len, 1000);
+
+    dns_packet_cache_stats_t stats;
+    dns_packet_cache_stats(&cache, &stats);
+    printf("stats: entries=%llu hits=%llu misses=%llu expired=%llu evictions=%llu\n", (unsigned long long)stats.entries,
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.expired,
+           (unsigned long long)stats.evictions);
+    ok = ok && 3 == stats.entries && 3 == stats.hits && 6 == stats.misses && 1 == stats.expired;
+
+    // 命中路径的耗时：取键、哈希、复制、改写ID和TTL
+    response_len = test_response(query, query_len, response, sizeof(response), DNS_RCODE_NOERROR, 3);
+    ok = ok && dns_packet_cache_store(&cache, query, query_len, response, response_len, 1000);
+    struct timespec start, end;
+    int             loops = 1000000;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < loops; i++) {
+        memcpy(packet, query, query_len);
+        ok = ok && dns_packet_cache_respond(&cache, packet, query_len, sizeof(packet), 1001) == response_len;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / loops;
+    printf("hit: %.1f ns/query\n", ns);
+    dns_packet_cache_clear(&cache);
+
+    printf("%s\n", ok ? "all ok" : "failed");
+    return ok ? 0 : 1;
+}
+#endif  // DNS_PACKET_CACHE_TEST
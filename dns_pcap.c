@@ -0,0 +1,886 @@
+#define _GNU_SOURCE  // struct mmsghdr（dns_udp_server.h）
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dns_error.h"
+#include "dns_flags.h"
+#include "dns_message.h"
+#include "dns_message_view.h"
+#include "dns_pcap.h"
+
+#define DNS_PCAP_MAGIC_US      0xA1B2C3D4 // 经典pcap，微秒时间戳
+#define DNS_PCAP_MAGIC_NS      0xA1B23C4D // 经典pcap，纳秒时间戳
+#define DNS_PCAPNG_SHB         0x0A0D0D0A // pcapng节头块
+#define DNS_PCAPNG_BOM         0x1A2B3C4D // pcapng字节序标记
+#define DNS_PCAPNG_IDB         1          // 接口描述块
+#define DNS_PCAPNG_SPB         3          // 简单报文块
+#define DNS_PCAPNG_EPB         6          // 增强报文块
+#define DNS_PCAP_MAX_IFACES    256        // pcapng中最多记录的接口数
+#define DNS_PCAP_MAX_RECORD    (16 << 20) // 单个记录或块的最大长度，超过视为文件损坏
+#define DNS_PCAP_ARENA_SIZE    (256 << 10)
+
+// 链路层类型（LINKTYPE_*）
+#define DNS_PCAP_LINK_NULL     0
+#define DNS_PCAP_LINK_ETHERNET 1
+#define DNS_PCAP_LINK_RAW      101
+#define DNS_PCAP_LINK_LOOP     108
+#define DNS_PCAP_LINK_SLL      113
+#define DNS_PCAP_LINK_IPV4     228
+#define DNS_PCAP_LINK_IPV6     229
+#define DNS_PCAP_LINK_SLL2     276
+
+static uint16_t dns_pcap_be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t dns_pcap_u32(const uint8_t *p, bool swap)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return swap ? __builtin_bswap32(value) : value;
+}
+
+static uint16_t dns_pcap_u16(const uint8_t *p, bool swap)
+{
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return swap ? __builtin_bswap16(value) : value;
+}
+
+void dns_pcap_init(dns_pcap_t *pcap)
+{
+    if (NULL == pcap) {
+        return;
+    }
+
+    memset(pcap, 0, sizeof(dns_pcap_t));
+}
+
+void dns_pcap_clear(dns_pcap_t *pcap)
+{
+    if (NULL == pcap) {
+        return;
+    }
+
+    free(pcap->data);
+    free(pcap->offsets);
+    free(pcap->lens);
+    free(pcap->peers);
+    memset(pcap, 0, sizeof(dns_pcap_t));
+}
+
+static bool dns_pcap_add(dns_pcap_t *pcap, const uint8_t *payload, size_t len, int family, const uint8_t *src, uint16_t sport)
+{
+    if (pcap->size + len > pcap->capacity) {
+        size_t capacity = pcap->capacity ? pcap->capacity : 1 << 20;
+        while (capacity < pcap->size + len) {
+            capacity *= 2;
+        }
+        uint8_t *data = (uint8_t *)realloc(pcap->data, capacity);
+        if (NULL == data) {
+            return false;
+        }
+        pcap->data     = data;
+        pcap->capacity = capacity;
+    }
+
+    if (pcap->count == pcap->slots) {
+        size_t slots = pcap->slots ? pcap->slots * 2 : 4096;
+        void  *offsets = realloc(pcap->offsets, slots * sizeof(*pcap->offsets));
+        if (NULL != offsets) {
+            pcap->offsets = offsets;
+        }
+        void *lens = NULL != offsets ? realloc(pcap->lens, slots * sizeof(*pcap->lens)) : NULL;
+        if (NULL != lens) {
+            pcap->lens = lens;
+        }
+        void *peers = NULL != lens ? realloc(pcap->peers, slots * sizeof(*pcap->peers)) : NULL;
+        if (NULL == peers) {
+            return false;
+        }
+        pcap->peers = peers;
+        pcap->slots = slots;
+    }
+
+    struct sockaddr_in6 *peer = &pcap->peers[pcap->count];
+    memset(peer, 0, sizeof(*peer));
+    if (AF_INET == family) {
+        struct sockaddr_in *peer4 = (struct sockaddr_in *)peer;
+        peer4->sin_family = AF_INET;
+        peer4->sin_port   = htons(sport);
+        memcpy(&peer4->sin_addr, src, 4);
+    } else {
+        peer->sin6_family = AF_INET6;
+        peer->sin6_port   = htons(sport);
+        memcpy(&peer->sin6_addr, src, 16);
+    }
+
+    memcpy(pcap->data + pcap->size, payload, len);
+    pcap->offsets[pcap->count] = pcap->size;
+    pcap->lens[pcap->count]    = len;
+    pcap->size                += len;
+    pcap->count               += 1;
+    return true;
+}
+
+/**
+ * @brief 解析UDP头部，端口为53时保存载荷
+ * @return int 保存返回1，跳过返回0，内存不足返回-1
+ */
+static int dns_pcap_udp(dns_pcap_t *pcap, const uint8_t *p, size_t len, int family, const uint8_t *src)
+{
+    if (len < 8) {
+        return 0;
+    }
+
+    uint16_t sport = dns_pcap_be16(p);
+    uint16_t dport = dns_pcap_be16(p + 2);
+    uint16_t ulen  = dns_pcap_be16(p + 4);
+    // 抓包长度截断了载荷时跳过，否则会被误计为解码失败
+    if ((DNS_PCAP_PORT != sport && DNS_PCAP_PORT != dport) || ulen < 8 || ulen > len) {
+        return 0;
+    }
+
+    return dns_pcap_add(pcap, p + 8, ulen - 8, family, src, sport) ? 1 : -1;
+}
+
+static int dns_pcap_ipv4(dns_pcap_t *pcap, const uint8_t *p, size_t len)
+{
+    if (len < 20 || (p[0] >> 4) != 4) {
+        return 0;
+    }
+
+    size_t ihl   = (p[0] & 0x0F) * 4;
+    size_t total = dns_pcap_be16(p + 2);
+    // 分片（MF置位或偏移不为0）不重组
+    if (ihl < 20 || total < ihl || total > len || (dns_pcap_be16(p + 6) & 0x3FFF) || IPPROTO_UDP != p[9]) {
+        return 0;
+    }
+
+    return dns_pcap_udp(pcap, p + ihl, total - ihl, AF_INET, p + 12);
+}
+
+static int dns_pcap_ipv6(dns_pcap_t *pcap, const uint8_t *p, size_t len)
+{
+    if (len < 40 || (p[0] >> 4) != 6) {
+        return 0;
+    }
+
+    size_t total = 40 + dns_pcap_be16(p + 4);
+    if (total > len) {
+        return 0;
+    }
+
+    uint8_t next   = p[6];
+    size_t  offset = 40;
+    // 跳过逐跳、路由和目的选项扩展头，分片头不处理
+    while (IPPROTO_HOPOPTS == next || IPPROTO_ROUTING == next || IPPROTO_DSTOPTS == next) {
+        if (offset + 8 > total) {
+            return 0;
+        }
+        next    = p[offset];
+        offset += (p[offset + 1] + 1) * 8;
+    }
+
+    if (IPPROTO_UDP != next || offset > total) {
+        return 0;
+    }
+
+    return dns_pcap_udp(pcap, p + offset, total - offset, AF_INET6, p + 8);
+}
+
+static int dns_pcap_ip(dns_pcap_t *pcap, const uint8_t *p, size_t len)
+{
+    if (len < 1) {
+        return 0;
+    }
+
+    return (p[0] >> 4) == 4 ? dns_pcap_ipv4(pcap, p, len) : dns_pcap_ipv6(pcap, p, len);
+}
+
+static int dns_pcap_ethertype(dns_pcap_t *pcap, uint16_t ethertype, const uint8_t *p, size_t len)
+{
+    switch (ethertype) {
+    case 0x0800:
+        return dns_pcap_ipv4(pcap, p, len);
+    case 0x86DD:
+        return dns_pcap_ipv6(pcap, p, len);
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief 按链路层类型剥去链路层头部
+ * @return int 保存返回1，跳过返回0，内存不足返回-1
+ */
+static int dns_pcap_frame(dns_pcap_t *pcap, uint32_t linktype, const uint8_t *p, size_t len)
+{
+    pcap->frames += 1;
+
+    int ret = 0;
+    switch (linktype) {
+    case DNS_PCAP_LINK_ETHERNET: {
+        if (len < 14) {
+            break;
+        }
+        uint16_t ethertype = dns_pcap_be16(p + 12);
+        size_t   offset    = 14;
+        // 802.1Q/802.1ad VLAN标签
+        while ((0x8100 == ethertype || 0x88A8 == ethertype) && offset + 4 <= len) {
+            ethertype = dns_pcap_be16(p + offset + 2);
+            offset   += 4;
+        }
+        ret = dns_pcap_ethertype(pcap, ethertype, p + offset, len - offset);
+        break;
+    }
+    case DNS_PCAP_LINK_SLL:
+        if (len >= 16) {
+            ret = dns_pcap_ethertype(pcap, dns_pcap_be16(p + 14), p + 16, len - 16);
+        }
+        break;
+    case DNS_PCAP_LINK_SLL2:
+        if (len >= 20) {
+            ret = dns_pcap_ethertype(pcap, dns_pcap_be16(p), p + 20, len - 20);
+        }
+        break;
+    case DNS_PCAP_LINK_NULL:
+    case DNS_PCAP_LINK_LOOP:
+        // 4字节地址族，字节序随抓包主机而定，直接看IP版本号
+        if (len >= 4) {
+            ret = dns_pcap_ip(pcap, p + 4, len - 4);
+        }
+        break;
+    case DNS_PCAP_LINK_RAW:
+    case DNS_PCAP_LINK_IPV4:
+    case DNS_PCAP_LINK_IPV6:
+        ret = dns_pcap_ip(pcap, p, len);
+        break;
+    default:
+        break;
+    }
+
+    if (0 == ret) {
+        pcap->skipped += 1;
+    }
+    return ret;
+}
+
+/**
+ * @brief 从文件读取指定长度到可增长的缓冲区
+ */
+static bool dns_pcap_read(FILE *fp, uint8_t **buf, size_t *buf_size, size_t len)
+{
+    if (len > DNS_PCAP_MAX_RECORD) {
+        return false;
+    }
+
+    if (len > *buf_size) {
+        uint8_t *grown = (uint8_t *)realloc(*buf, len);
+        if (NULL == grown) {
+            return false;
+        }
+        *buf      = grown;
+        *buf_size = len;
+    }
+
+    return fread(*buf, 1, len, fp) == len;
+}
+
+static int dns_pcap_load_classic(dns_pcap_t *pcap, FILE *fp, const uint8_t *header)
+{
+    uint32_t magic    = dns_pcap_u32(header, false);
+    bool     swap     = DNS_PCAP_MAGIC_US != magic && DNS_PCAP_MAGIC_NS != magic;
+
+    // 全局头部24字节，已读入前8字节
+    uint8_t rest[16];
+    if (fread(rest, 1, sizeof(rest), fp) != sizeof(rest)) {
+        return -1;
+    }
+    uint32_t linktype = dns_pcap_u32(rest + 12, swap) & 0xFFFF;
+
+    int      added    = 0;
+    uint8_t *buf      = NULL;
+    size_t   buf_size = 0;
+    uint8_t  record[16];
+    while (fread(record, 1, sizeof(record), fp) == sizeof(record)) {
+        uint32_t caplen = dns_pcap_u32(record + 8, swap);
+        if (!dns_pcap_read(fp, &buf, &buf_size, caplen)) {
+            break;
+        }
+
+        int ret = dns_pcap_frame(pcap, linktype, buf, caplen);
+        if (ret < 0) {
+            added = -1;
+            break;
+        }
+        added += ret;
+    }
+
+    free(buf);
+    return added;
+}
+
+static int dns_pcap_load_ng(dns_pcap_t *pcap, FILE *fp, const uint8_t *header)
+{
+    uint32_t linktypes[DNS_PCAP_MAX_IFACES];
+    uint32_t ifaces   = 0;
+    bool     swap     = false;
+    int      added    = 0;
+    uint8_t *buf      = NULL;
+    size_t   buf_size = 0;
+
+    uint8_t block[8];
+    memcpy(block, header, sizeof(block));
+    for (;;) {
+        uint32_t type = dns_pcap_u32(block, swap);
+        uint32_t len  = dns_pcap_u32(block + 4, swap);
+        if (DNS_PCAPNG_SHB == type) {
+            // 每个节可以有不同的字节序，接口编号也重新开始
+            uint8_t bom[4];
+            if (fread(bom, 1, sizeof(bom), fp) != sizeof(bom)) {
+                break;
+            }
+            swap   = DNS_PCAPNG_BOM != dns_pcap_u32(bom, false);
+            len    = dns_pcap_u32(block + 4, swap);
+            ifaces = 0;
+            if (len < 16 || (len & 3) || !dns_pcap_read(fp, &buf, &buf_size, len - 12)) {
+                break;
+            }
+        } else {
+            // 块长度包含块头和结尾重复的长度字段
+            if (len < 12 || (len & 3) || !dns_pcap_read(fp, &buf, &buf_size, len - 8)) {
+                break;
+            }
+            size_t body = len - 12;
+
+            int ret = 0;
+            if (DNS_PCAPNG_IDB == type && body >= 8) {
+                if (ifaces < DNS_PCAP_MAX_IFACES) {
+                    linktypes[ifaces++] = dns_pcap_u16(buf, swap);
+                }
+            } else if (DNS_PCAPNG_EPB == type && body >= 20) {
+                uint32_t iface  = dns_pcap_u32(buf, swap);
+                uint32_t caplen = dns_pcap_u32(buf + 12, swap);
+                if (iface < ifaces && caplen <= body - 20) {
+                    ret = dns_pcap_frame(pcap, linktypes[iface], buf + 20, caplen);
+                }
+            } else if (DNS_PCAPNG_SPB == type && body >= 4 && ifaces > 0) {
+                uint32_t caplen = dns_pcap_u32(buf, swap);
+                ret = dns_pcap_frame(pcap, linktypes[0], buf + 4, caplen < body - 4 ? caplen : body - 4);
+            }
+
+            if (ret < 0) {
+                added = -1;
+                break;
+            }
+            added += ret;
+        }
+
+        if (fread(block, 1, sizeof(block), fp) != sizeof(block)) {
+            break;
+        }
+    }
+
+    free(buf);
+    return added;
+}
+
+int dns_pcap_load(dns_pcap_t *pcap, const char *path)
+{
+    if (NULL == pcap || NULL == path) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int     added = -1;
+    uint8_t header[8];
+    if (fread(header, 1, sizeof(header), fp) == sizeof(header)) {
+        uint32_t magic = dns_pcap_u32(header, false);
+        if (DNS_PCAPNG_SHB == magic) {
+            added = dns_pcap_load_ng(pcap, fp, header);
+        } else if (DNS_PCAP_MAGIC_US == magic || DNS_PCAP_MAGIC_NS == magic ||
+                   DNS_PCAP_MAGIC_US == __builtin_bswap32(magic) || DNS_PCAP_MAGIC_NS == __builtin_bswap32(magic)) {
+            added = dns_pcap_load_classic(pcap, fp, header);
+        }
+    }
+
+    fclose(fp);
+    if (added < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+    }
+    return added;
+}
+
+static uint64_t dns_pcap_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void dns_pcap_reject(dns_pcap_result_t *result)
+{
+    dns_error_t cause = dns_error_last();
+    result->rejected       += 1;
+    result->causes[cause < DNS_ERROR_MAX ? cause : DNS_OK] += 1;
+}
+
+bool dns_pcap_replay(const dns_pcap_t *pcap, dns_pcap_mode_t mode, int loops, dns_pcap_result_t *result)
+{
+    if (NULL == pcap || NULL == result || loops < 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    // 消息从arena分配，每个报文之后O(1)清空，测到的是解码本身而不是malloc
+    void *arena = malloc(DNS_PCAP_ARENA_SIZE);
+    if (NULL == arena) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+
+    memset(result, 0, sizeof(dns_pcap_result_t));
+    dns_message_t      msg;
+    dns_message_view_t view;
+    dns_message_init_arena(&msg, arena, DNS_PCAP_ARENA_SIZE);
+
+    uint64_t start = dns_pcap_now_ns();
+    for (int loop = 0; loop < loops; loop++) {
+        for (size_t i = 0; i < pcap->count; i++) {
+            const uint8_t *data = pcap->data + pcap->offsets[i];
+            size_t         len  = pcap->lens[i];
+            bool           ok   = false;
+
+            dns_error_clear();
+            switch (mode) {
+            case DNS_PCAP_MESSAGE:
+                ok = dns_message_deserialize(&msg, data, len) > 0;
+                dns_message_clear(&msg);
+                break;
+            case DNS_PCAP_LAZY:
+                ok = dns_message_deserialize_lazy(&msg, data, len) > 0;
+                dns_message_clear(&msg);
+                break;
+            case DNS_PCAP_VIEW:
+                ok = dns_message_view_parse(&view, data, len);
+                break;
+            }
+
+            if (!ok) {
+                dns_pcap_reject(result);
+            }
+        }
+        result->messages += pcap->count;
+    }
+    result->elapsed_ns = dns_pcap_now_ns() - start;
+
+    free(arena);
+    return true;
+}
+
+bool dns_pcap_replay_handler(const dns_pcap_t *pcap, dns_udp_handler_t handler, void *arg, int loops, dns_pcap_result_t *result)
+{
+    if (NULL == pcap || NULL == handler || NULL == result || loops < 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(result, 0, sizeof(dns_pcap_result_t));
+    uint8_t packet[DNS_UDP_PACKET_SIZE];
+
+    uint64_t start = dns_pcap_now_ns();
+    for (int loop = 0; loop < loops; loop++) {
+        for (size_t i = 0; i < pcap->count; i++) {
+            // 响应约占正常抓包的一半，交给处理回调只会被当作拒绝，拒绝率失去意义
+            const uint8_t *data = pcap->data + pcap->offsets[i];
+            if (pcap->lens[i] > 2 && (data[2] & 0x80)) {
+                result->responses += 1;
+                continue;
+            }
+
+            const struct sockaddr *peer = (const struct sockaddr *)&pcap->peers[i];
+            socklen_t peer_len = AF_INET == peer->sa_family ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+            size_t    len      = pcap->lens[i] < sizeof(packet) ? pcap->lens[i] : sizeof(packet);
+            memcpy(packet, data, len);
+
+            dns_error_clear();
+            if (handler(arg, packet, len, sizeof(packet), peer, peer_len) > 0) {
+                result->replies += 1;
+            } else {
+                dns_pcap_reject(result);
+            }
+            result->messages += 1;
+        }
+    }
+    result->elapsed_ns = dns_pcap_now_ns() - start;
+    return true;
+}
+
+const char *dns_pcap_result_to_string(const dns_pcap_result_t *result, char *buf, size_t buf_size)
+{
+    if (NULL == result || NULL == buf || buf_size < 1) {
+        return NULL;
+    }
+
+    double seconds = result->elapsed_ns / 1e9;
+    double rate    = seconds > 0 ? result->messages / seconds : 0;
+    double reject  = result->messages > 0 ? 100.0 * result->rejected / result->messages : 0;
+    int    len     = snprintf(buf, buf_size,
+                              "DNS Replay:\n"
+                              "  |-messages : %llu\n"
+                              "  |-replies  : %llu\n"
+                              "  |-rejected : %llu (%.3f%%)\n"
+                              "  |-elapsed  : %.3f s\n"
+                              "  |-rate     : %.0f msgs/s (%.1f ns/msg)",
+                              (unsigned long long)result->messages,
+                              (unsigned long long)result->replies,
+                              (unsigned long long)result->rejected, reject,
+                              seconds,
+                              rate, result->messages > 0 ? (double)result->elapsed_ns / result->messages : 0);
+
+    if (result->responses > 0 && len > 0 && (size_t)len < buf_size) {
+        len += snprintf(buf + len, buf_size - len, "\n  |-responses: %llu (skipped)", (unsigned long long)result->responses);
+    }
+    for (int i = 0; i < DNS_ERROR_MAX && len > 0 && (size_t)len < buf_size; i++) {
+        if (result->causes[i] > 0) {
+            len += snprintf(buf + len, buf_size - len, "\n  |-%-24s: %llu", DNS_OK == i ? "unknown" : dns_error_name(i),
+                            (unsigned long long)result->causes[i]);
+        }
+    }
+    return buf;
+}
+
+#ifdef DNS_PCAP_MAIN
+#include <getopt.h>
+#include "dns_captive.h"
+
+static size_t dns_pcap_captive(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    (void)peer;
+    (void)peer_len;
+    return dns_captive_respond((const dns_captive_t *)arg, packet, len, size);
+}
+
+static void dns_pcap_report(const char *title, const dns_pcap_result_t *result)
+{
+    char buf[2048];
+    printf("[%s]\n%s\n", title, dns_pcap_result_to_string(result, buf, sizeof(buf)));
+}
+
+int main(int argc, char *argv[])
+{
+    const char *mode  = "all";
+    int         loops = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:l:h")) != -1) {
+        switch (opt) {
+        case 'm': mode  = optarg; break;
+        case 'l': loops = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-m message|lazy|view|captive|all] [-l loops] file.pcap[ng]...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-m message|lazy|view|captive|all] [-l loops] file.pcap[ng]...\n", argv[0]);
+        return 1;
+    }
+
+    dns_pcap_t pcap;
+    dns_pcap_init(&pcap);
+    for (int i = optind; i < argc; i++) {
+        if (dns_pcap_load(&pcap, argv[i]) < 0) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    printf("%zu DNS messages (%zu bytes) from %llu frames, %llu skipped, %d loops\n", pcap.count, pcap.size,
+           (unsigned long long)pcap.frames, (unsigned long long)pcap.skipped, loops);
+
+    static const struct {
+        const char     *name;
+        dns_pcap_mode_t mode;
+    } modes[] = {
+        {"message", DNS_PCAP_MESSAGE},
+        {"lazy", DNS_PCAP_LAZY},
+        {"view", DNS_PCAP_VIEW},
+    };
+
+    dns_pcap_result_t result;
+    bool              all = strcmp(mode, "all") == 0;
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (all || strcmp(mode, modes[i].name) == 0) {
+            dns_pcap_replay(&pcap, modes[i].mode, loops, &result);
+            dns_pcap_report(modes[i].name, &result);
+        }
+    }
+
+    if (all || strcmp(mode, "captive") == 0) {
+        dns_captive_t captive;
+        uint8_t       gateway[] = {192, 168, 4, 1};
+        dns_captive_init(&captive, gateway, DNS_CAPTIVE_TTL);
+        dns_pcap_replay_handler(&pcap, dns_pcap_captive, &captive, loops, &result);
+        dns_pcap_report("captive", &result);
+    }
+
+    dns_pcap_clear(&pcap);
+    return 0;
+}
+#endif  // DNS_PCAP_MAIN
+
+#ifdef DNS_PCAP_TEST
+#include <unistd.h>
+#include "dns_class.h"
+
+typedef struct {
+    uint8_t data[512];
+    size_t  len;
+} test_frame_t;
+
+/**
+ * @brief 回复所有报文的处理回调，原样回显
+ */
+static size_t test_echo(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    (void)arg;
+    (void)packet;
+    (void)size;
+    (void)peer;
+    (void)peer_len;
+    return len;
+}
+
+static size_t test_query(uint8_t *buf, size_t size, const char *qname, bool response)
+{
+    uint8_t        arena[2048];
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    dns_header_set_id(&msg.header, 0x5151);
+    dns_flags_set_qr(&msg.header.flags, response ? DNS_QR_RESPONSE : DNS_QR_QUERY);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, qname);
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    if (response) {
+        dns_answer_t answer;
+        dns_answer_init(&answer);
+        dns_answer_set_name(&answer, qname);
+        dns_answer_set_type(&answer, DNS_TYPE_A);
+        dns_answer_set_class(&answer, DNS_CLASS_IN);
+        dns_answer_set_ttl(&answer, 60);
+        uint8_t ip[] = {10, 0, 0, 1};
+        dns_answer_set_data(&answer, ip, sizeof(ip));
+        dns_message_add_answer(&msg, &answer);
+        dns_answer_clear(&answer);
+    }
+    dns_question_clear(&question);
+
+    int len = dns_message_serialize_compressed(&msg, buf, size);
+    dns_message_clear(&msg);
+    return len > 0 ? len : 0;
+}
+
+/**
+ * @brief 构造以太网/IPv4/UDP帧
+ */
+static void test_frame4(test_frame_t *frame, uint8_t proto, uint16_t sport, uint16_t dport, uint16_t frag, const uint8_t *payload, size_t len)
+{
+    uint8_t *p = frame->data;
+    memset(p, 0, 14 + 20 + 8);
+    p[12] = 0x08;
+    uint8_t *ip = p + 14;
+    ip[0] = 0x45;
+    ip[2] = (20 + 8 + len) >> 8;
+    ip[3] = (20 + 8 + len) & 0xFF;
+    ip[6] = frag >> 8;
+    ip[7] = frag & 0xFF;
+    ip[8] = 64;
+    ip[9] = proto;
+    uint8_t src[] = {192, 0, 2, 10};
+    memcpy(ip + 12, src, 4);
+    uint8_t *udp = ip + 20;
+    udp[0] = sport >> 8;
+    udp[1] = sport & 0xFF;
+    udp[2] = dport >> 8;
+    udp[3] = dport & 0xFF;
+    udp[4] = (8 + len) >> 8;
+    udp[5] = (8 + len) & 0xFF;
+    memcpy(udp + 8, payload, len);
+    frame->len = 14 + 20 + 8 + len;
+}
+
+/**
+ * @brief 构造带VLAN标签的以太网/IPv6/UDP帧
+ */
+static void test_frame6(test_frame_t *frame, const uint8_t *payload, size_t len)
+{
+    uint8_t *p = frame->data;
+    memset(p, 0, 18 + 40 + 8);
+    p[12] = 0x81;
+    p[16] = 0x86;
+    p[17] = 0xDD;
+    uint8_t *ip = p + 18;
+    ip[0] = 0x60;
+    ip[4] = (8 + len) >> 8;
+    ip[5] = (8 + len) & 0xFF;
+    ip[6] = IPPROTO_UDP;
+    ip[8] = 0x20;
+    ip[9] = 0x01;
+    uint8_t *udp = ip + 40;
+    udp[0] = 0xC0;
+    udp[3] = 53;
+    udp[4] = (8 + len) >> 8;
+    udp[5] = (8 + len) & 0xFF;
+    memcpy(udp + 8, payload, len);
+    frame->len = 18 + 40 + 8 + len;
+}
+
+static void test_write_pcap(const char *path, const test_frame_t *frames, int count)
+{
+    FILE    *fp       = fopen(path, "wb");
+    uint32_t header[] = {DNS_PCAP_MAGIC_US, 0x00040002, 0, 0, 65535, DNS_PCAP_LINK_ETHERNET};
+    fwrite(header, sizeof(header), 1, fp);
+    for (int i = 0; i < count; i++) {
+        uint32_t record[] = {1700000000, i, frames[i].len, frames[i].len};
+        fwrite(record, sizeof(record), 1, fp);
+        fwrite(frames[i].data, frames[i].len, 1, fp);
+    }
+    fclose(fp);
+}
+
+static void test_write_block(FILE *fp, uint32_t type, const void *body, size_t len)
+{
+    uint32_t total  = 12 + ((len + 3) & ~3u);
+    uint32_t head[] = {type, total};
+    uint8_t  pad[4] = {0};
+    fwrite(head, sizeof(head), 1, fp);
+    fwrite(body, len, 1, fp);
+    fwrite(pad, ((len + 3) & ~3u) - len, 1, fp);
+    fwrite(&total, sizeof(total), 1, fp);
+}
+
+/**
+ * @brief 写pcapng：以太网接口上的增强报文块，原始IP接口上的一个报文，以及一个简单报文块
+ */
+static void test_write_pcapng(const char *path, const test_frame_t *frames, int count)
+{
+    FILE    *fp    = fopen(path, "wb");
+    uint32_t shb[] = {DNS_PCAPNG_BOM, 0x00000001, 0xFFFFFFFF, 0xFFFFFFFF};
+    test_write_block(fp, DNS_PCAPNG_SHB, shb, sizeof(shb));
+    uint32_t idb_eth[] = {DNS_PCAP_LINK_ETHERNET, 65535};
+    uint32_t idb_raw[] = {DNS_PCAP_LINK_RAW, 65535};
+    test_write_block(fp, DNS_PCAPNG_IDB, idb_eth, sizeof(idb_eth));
+    test_write_block(fp, DNS_PCAPNG_IDB, idb_raw, sizeof(idb_raw));
+
+    uint8_t body[600];
+    for (int i = 0; i < count; i++) {
+        uint32_t epb[] = {0, 0, i, frames[i].len, frames[i].len};
+        memcpy(body, epb, sizeof(epb));
+        memcpy(body + sizeof(epb), frames[i].data, frames[i].len);
+        test_write_block(fp, DNS_PCAPNG_EPB, body, sizeof(epb) + frames[i].len);
+    }
+
+    // 原始IP：去掉以太网头部
+    uint32_t epb[] = {1, 0, 0, frames[0].len - 14, frames[0].len - 14};
+    memcpy(body, epb, sizeof(epb));
+    memcpy(body + sizeof(epb), frames[0].data + 14, frames[0].len - 14);
+    test_write_block(fp, DNS_PCAPNG_EPB, body, sizeof(epb) + frames[0].len - 14);
+
+    uint32_t spb = frames[0].len;
+    memcpy(body, &spb, sizeof(spb));
+    memcpy(body + sizeof(spb), frames[0].data, frames[0].len);
+    test_write_block(fp, DNS_PCAPNG_SPB, body, sizeof(spb) + frames[0].len);
+    fclose(fp);
+}
+
+int main(void)
+{
+    uint8_t query[512], response[512];
+    size_t  query_len    = test_query(query, sizeof(query), "www.example.com", false);
+    size_t  response_len = test_query(response, sizeof(response), "www.example.com", true);
+
+    // 名称中的标签类型0x40是保留的
+    uint8_t bad_label[512];
+    memcpy(bad_label, query, query_len);
+    bad_label[12] = 0x43;
+
+    // 回答中的压缩指针指向自己
+    uint8_t bad_pointer[512];
+    memcpy(bad_pointer, response, response_len);
+    size_t answer = 12 + dns_name_skip(response, response_len, 12) + 4;
+    bad_pointer[answer]     = 0xC0 | (answer >> 8);
+    bad_pointer[answer + 1] = answer & 0xFF;
+
+    test_frame_t frames[8];
+    test_frame4(&frames[0], IPPROTO_UDP, 40000, 53, 0, query, query_len);
+    test_frame4(&frames[1], IPPROTO_UDP, 53, 40000, 0, response, response_len);
+    test_frame4(&frames[2], IPPROTO_UDP, 40001, 53, 0, query, query_len - 3);
+    test_frame4(&frames[3], IPPROTO_UDP, 40002, 53, 0, bad_label, query_len);
+    test_frame4(&frames[4], IPPROTO_UDP, 53, 40003, 0, bad_pointer, response_len);
+    test_frame6(&frames[5], query, query_len);
+    test_frame4(&frames[6], IPPROTO_UDP, 5353, 5353, 0, query, query_len);   // 不是53端口
+    test_frame4(&frames[7], IPPROTO_UDP, 40004, 53, 0x2000, query, query_len); // 分片
+
+    char pcap_path[]   = "/tmp/dns_pcap_XXXXXX";
+    char pcapng_path[] = "/tmp/dns_pcapng_XXXXXX";
+    close(mkstemp(pcap_path));
+    close(mkstemp(pcapng_path));
+    test_write_pcap(pcap_path, frames, 8);
+    test_write_pcapng(pcapng_path, frames, 8);
+
+    dns_pcap_t pcap;
+    dns_pcap_init(&pcap);
+    int classic = dns_pcap_load(&pcap, pcap_path);
+    int ng      = dns_pcap_load(&pcap, pcapng_path);
+    printf("loaded: pcap=%d pcapng=%d frames=%llu skipped=%llu\n", classic, ng, (unsigned long long)pcap.frames,
+           (unsigned long long)pcap.skipped);
+    bool ok = 6 == classic && 8 == ng && 18 == pcap.frames && 4 == pcap.skipped;
+
+    char              buf[2048];
+    dns_pcap_result_t result;
+    dns_pcap_replay(&pcap, DNS_PCAP_MESSAGE, 1000, &result);
+    printf("%s\n", dns_pcap_result_to_string(&result, buf, sizeof(buf)));
+    ok = ok && result.messages == 14000 && result.rejected == 6000;
+    ok = ok && result.causes[DNS_ERROR_TRUNCATED] == 2000 && result.causes[DNS_ERROR_NAME_LABEL] == 2000;
+    ok = ok && result.causes[DNS_ERROR_NAME_POINTER] == 2000;
+
+    // 视图只跳过名称不跟随压缩指针，指针环要到读取名称时才会发现
+    dns_pcap_replay(&pcap, DNS_PCAP_VIEW, 1000, &result);
+    printf("%s\n", dns_pcap_result_to_string(&result, buf, sizeof(buf)));
+    ok = ok && result.rejected == 4000 && result.causes[DNS_ERROR_NAME_POINTER] == 0;
+
+    // 处理回调只收到查询，响应跳过并单独计数
+    dns_pcap_replay_handler(&pcap, test_echo, NULL, 10, &result);
+    printf("%s\n", dns_pcap_result_to_string(&result, buf, sizeof(buf)));
+    ok = ok && result.messages == 100 && result.replies == 100 && result.rejected == 0 && result.responses == 40;
+
+    dns_pcap_t raw;
+    dns_pcap_init(&raw);
+    ok = ok && dns_pcap_load(&raw, "/nonexistent.pcap") < 0 && DNS_ERROR_IO == dns_error_last();
+    dns_pcap_clear(&raw);
+
+    unlink(pcap_path);
+    unlink(pcapng_path);
+    dns_pcap_clear(&pcap);
+    printf("%s\n", ok ? "all ok" : "failed");
+    return ok ? 0 : 1;
+}
+#endif  // DNS_PCAP_TEST
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "dns_class.h"
+#include "dns_error.h"
 #include "dns_question.h"
 #include "dns_type.h"
 #include "dns_name.h"
@@ -190,33 +191,87 @@ int dns_question_serialize(const dns_question_t *question, uint8_t *buf, uint16_
     return ptr - buf;
 }
 
+int dns_question_pack(const dns_question_t *question, dns_name_table_t *table, uint8_t *msg, size_t msg_size, size_t offset)
+{
+    if (NULL == question || NULL == question->qname || NULL == msg) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    int name_len = dns_name_pack(table, question->qname, msg, msg_size, offset);
+    if (name_len < 1) {
+        return 0;
+    }
+    if (offset + name_len + 4 > msg_size) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return 0;
+    }
+
+    uint8_t *ptr = msg + offset + name_len;
+    *(ptr++) = (question->qtype  >> 8) & 0xFF;
+    *(ptr++) =  question->qtype        & 0xFF;
+    *(ptr++) = (question->qclass >> 8) & 0xFF;
+    *(ptr++) =  question->qclass       & 0xFF;
+
+    return ptr - (msg + offset);
+}
 
 int dns_question_deserialize(dns_question_t *question, const uint8_t *data, uint16_t data_len)
 {
-    if (NULL == question || NULL == data) {
+    return dns_question_unpack(question, data, data_len, 0);
+}
+
+int dns_question_unpack(dns_question_t *question, const uint8_t *msg, size_t msg_len, size_t offset)
+{
+    if (NULL == question || NULL == msg) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
         return 0;
     }
 
     dns_question_clear(question);
 
-    int name_len = strlen((char*)data) + 1;
-    if (data_len < (name_len + dns_question_length(question))) {
+    char           name[DNS_NAME_MAX_LENGTH];
+    dns_question_t parsed;
+    int            question_len = dns_question_unpack_to(&parsed, msg, msg_len, offset, name, sizeof(name));
+    if (question_len < 1) {
         return 0;
     }
 
-    question->qname = strdup((char*)data);
+    question->qname = strdup(name);
     if (NULL == question->qname) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return 0;
+    }
+
+    question->qtype  = parsed.qtype;
+    question->qclass = parsed.qclass;
+    return question_len;
+}
+
+int dns_question_unpack_to(dns_question_t *question, const uint8_t *msg, size_t msg_len, size_t offset, char *name_buf, size_t name_buf_size)
+{
+    if (NULL == question || NULL == msg || NULL == name_buf) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return 0;
+    }
+
+    int name_len = dns_name_unpack(msg, msg_len, offset, name_buf, name_buf_size, NULL);
+    if (name_len < 1) {
+        return 0;
+    }
+    if (offset + name_len + 4 > msg_len) {
+        dns_error_raise(DNS_ERROR_TRUNCATED);
         return 0;
     }
 
-    uint8_t *ptr = (uint8_t*)data;
-    ptr += name_len;
+    const uint8_t *ptr = msg + offset + name_len;
+    question->qname  =  name_buf;
     question->qtype  =  *(ptr++) << 8;
     question->qtype  |= *(ptr++)     ;
     question->qclass =  *(ptr++) << 8;
     question->qclass |= *(ptr++)     ;
 
-    return ptr - data;
+    return ptr - (msg + offset);
 }
 
 const char *dns_question_to_string(const dns_question_t *question, char *buf, uint32_t buf_size)
@@ -0,0 +1,279 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dns_reply.h"
+
+#define DNS_REPLY_HEADER_SIZE 12
+#define DNS_REPLY_RECORD_SIZE 12 // 压缩名称2 + 类型2 + 类2 + TTL4 + 长度2
+
+static uint16_t dns_reply_get16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static void dns_reply_put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xFF;
+}
+
+/**
+ * @brief 由查询标志得到响应的初始标志：置QR，保留OPCODE、RD和CD（RFC 4035 §3.2.2），其余清零
+ */
+static uint16_t dns_reply_flags(uint16_t query_flags)
+{
+    uint16_t flags = query_flags & ((0xF << DNS_FLAGS_INDEX_OPCODE) | (1 << DNS_FLAGS_INDEX_RD) | (1 << DNS_FLAGS_INDEX_CD));
+    dns_flags_set_qr(&flags, DNS_QR_RESPONSE);
+    return flags;
+}
+
+/**
+ * @brief 跳过问题名称，问题中的名称不应被压缩
+ * @return size_t 名称之后的偏移，名称非法返回0
+ */
+static size_t dns_reply_skip_qname(const uint8_t *packet, size_t len)
+{
+    size_t offset = DNS_REPLY_HEADER_SIZE;
+    while (offset < len) {
+        uint8_t label = packet[offset];
+        if (0 == label) {
+            return offset + 1 - DNS_REPLY_HEADER_SIZE <= 255 ? offset + 1 : 0;
+        }
+        if (label > 63) {
+            return 0;
+        }
+        offset += label + 1;
+    }
+    return 0;
+}
+
+bool dns_reply_is_query(const uint8_t *packet, size_t len)
+{
+    return NULL != packet && len >= DNS_REPLY_HEADER_SIZE && 0 == (packet[2] & 0x80);
+}
+
+bool dns_reply_init(dns_reply_t *reply, uint8_t *packet, size_t len, size_t size)
+{
+    if (NULL == reply || size < len || !dns_reply_is_query(packet, len) || dns_reply_get16(packet + 4) != 1) {
+        return false;
+    }
+
+    size_t qend = dns_reply_skip_qname(packet, len);
+    if (0 == qend || qend + 4 > len) {
+        return false;
+    }
+
+    memset(reply, 0, sizeof(dns_reply_t));
+    reply->packet       = packet;
+    reply->size         = size;
+    reply->qtype        = dns_reply_get16(packet + qend);
+    reply->qclass       = dns_reply_get16(packet + qend + 2);
+    reply->question_end = qend + 4;
+    reply->len          = reply->question_end;
+    reply->flags        = dns_reply_flags(dns_reply_get16(packet + 2));
+    reply->section      = DNS_SECTION_ANSWER;
+
+    // 查询中问题之后的记录（如EDNS OPT）被截掉
+    dns_reply_put16(packet + 2, reply->flags);
+    memset(packet + 6, 0, 6);
+    return true;
+}
+
+bool dns_reply_set_aa(dns_reply_t *reply, dns_aa_t aa)
+{
+    if (NULL == reply || !dns_flags_set_aa(&reply->flags, aa)) {
+        return false;
+    }
+
+    dns_reply_put16(reply->packet + 2, reply->flags);
+    return true;
+}
+
+bool dns_reply_set_tc(dns_reply_t *reply, dns_tc_t tc)
+{
+    if (NULL == reply || !dns_flags_set_tc(&reply->flags, tc)) {
+        return false;
+    }
+
+    dns_reply_put16(reply->packet + 2, reply->flags);
+    return true;
+}
+
+bool dns_reply_set_ra(dns_reply_t *reply, dns_ra_t ra)
+{
+    if (NULL == reply || !dns_flags_set_ra(&reply->flags, ra)) {
+        return false;
+    }
+
+    dns_reply_put16(reply->packet + 2, reply->flags);
+    return true;
+}
+
+bool dns_reply_set_rcode(dns_reply_t *reply, dns_rcode_t rcode)
+{
+    if (NULL == reply || !dns_flags_set_rcode(&reply->flags, rcode)) {
+        return false;
+    }
+
+    dns_reply_put16(reply->packet + 2, reply->flags);
+    return true;
+}
+
+bool dns_reply_add_record(dns_reply_t *reply, dns_section_t section, uint16_t rtype, uint16_t rclass, uint32_t ttl, const uint8_t *rdata, uint16_t rlength)
+{
+    if (NULL == reply || section < reply->section || section >= DNS_SECTION_MAX || (rlength > 0 && NULL == rdata)) {
+        return false;
+    }
+
+    if (reply->len + DNS_REPLY_RECORD_SIZE + rlength > reply->size || 0xFFFF == reply->counts[section]) {
+        return false;
+    }
+
+    uint8_t *record = reply->packet + reply->len;
+    dns_reply_put16(record, DNS_REPLY_QNAME_PTR);
+    dns_reply_put16(record + 2, rtype);
+    dns_reply_put16(record + 4, rclass);
+    dns_reply_put16(record + 6, ttl >> 16);
+    dns_reply_put16(record + 8, ttl & 0xFFFF);
+    dns_reply_put16(record + 10, rlength);
+    if (rlength > 0) {
+        memcpy(record + DNS_REPLY_RECORD_SIZE, rdata, rlength);
+    }
+
+    reply->len            += DNS_REPLY_RECORD_SIZE + rlength;
+    reply->counts[section] += 1;
+    reply->section         = section;
+    return true;
+}
+
+size_t dns_reply_finish(dns_reply_t *reply)
+{
+    if (NULL == reply || NULL == reply->packet) {
+        return 0;
+    }
+
+    dns_reply_put16(reply->packet + 6, reply->counts[DNS_SECTION_ANSWER]);
+    dns_reply_put16(reply->packet + 8, reply->counts[DNS_SECTION_AUTHORITY]);
+    dns_reply_put16(reply->packet + 10, reply->counts[DNS_SECTION_ADDITIONAL]);
+    return reply->len;
+}
+
+size_t dns_reply_error(uint8_t *packet, size_t len, dns_rcode_t rcode)
+{
+    if (NULL == packet || len < DNS_REPLY_HEADER_SIZE) {
+        return 0;
+    }
+
+    uint16_t flags = dns_reply_flags(dns_reply_get16(packet + 2));
+    if (!dns_flags_set_rcode(&flags, rcode)) {
+        return 0;
+    }
+
+    dns_reply_put16(packet + 2, flags);
+    memset(packet + 4, 0, 8);
+    return DNS_REPLY_HEADER_SIZE;
+}
+
+#ifdef DNS_REPLY_TEST
+#include <stdio.h>
+#include "dns_message.h"
+
+static int test_build_query(uint16_t id, const char *qname, dns_type_t qtype, bool edns, uint8_t *buf, size_t buf_size)
+{
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, id);
+    dns_flags_set_rd(&msg.header.flags, DNS_RD_YES);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, qname);
+    dns_question_set_qtype(&question, qtype);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+
+    if (edns) {
+        dns_answer_t opt;
+        dns_answer_init(&opt);
+        dns_answer_set_name(&opt, "");
+        dns_answer_set_type(&opt, DNS_TYPE_OPT);
+        dns_answer_set_class(&opt, 1232);
+        dns_message_add_additional(&msg, &opt);
+        dns_answer_clear(&opt);
+    }
+
+    int len = dns_message_serialize(&msg, buf, buf_size);
+    dns_message_clear(&msg);
+    return len;
+}
+
+static bool test_show(const char *title, const uint8_t *packet, size_t len)
+{
+    char          text[2048];
+    dns_message_t msg;
+    dns_message_init(&msg);
+    bool ok = len > 0 && dns_message_deserialize(&msg, packet, len) == (int)len;
+    if (ok) {
+        dns_message_to_string(&msg, text, sizeof(text));
+        printf("%s\n", text);
+    }
+    dns_message_clear(&msg);
+    printf("%s: %s len=%zu\n", title, ok ? "ok" : "failed", len);
+    return ok;
+}
+
+int main(void)
+{
+    uint8_t     packet[512];
+    dns_reply_t reply;
+    bool        ok = true;
+
+    // A查询带EDNS：OPT被截掉，追加两条A记录和一条附加记录
+    int len = test_build_query(0x1234, "www.example.com", DNS_TYPE_A, true, packet, sizeof(packet));
+    ok = dns_reply_init(&reply, packet, len, sizeof(packet)) && ok;
+    ok = ok && reply.qtype == DNS_TYPE_A && reply.qclass == DNS_CLASS_IN;
+    dns_reply_set_aa(&reply, DNS_AA_YES);
+    dns_reply_set_ra(&reply, DNS_RA_YES);
+    uint8_t ip1[] = {10, 0, 0, 1};
+    uint8_t ip2[] = {10, 0, 0, 2};
+    ok = ok && dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip1, sizeof(ip1));
+    ok = ok && dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip2, sizeof(ip2));
+    ok = ok && dns_reply_add_record(&reply, DNS_SECTION_ADDITIONAL, DNS_TYPE_TXT, DNS_CLASS_IN, 60, (const uint8_t *)"\x02hi", 3);
+    // 段顺序不能倒退
+    ok = ok && !dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip1, sizeof(ip1));
+    size_t reply_len = dns_reply_finish(&reply);
+    ok = test_show("answer", packet, reply_len) && ok;
+
+    dns_message_t msg;
+    dns_message_init(&msg);
+    dns_message_deserialize(&msg, packet, reply_len);
+    ok = ok && dns_header_get_id(&msg.header) == 0x1234;
+    ok = ok && dns_flags_get_qr(msg.header.flags) == DNS_QR_RESPONSE && dns_flags_get_rd(msg.header.flags) == DNS_RD_YES;
+    ok = ok && dns_flags_get_aa(msg.header.flags) == DNS_AA_YES && dns_flags_get_ra(msg.header.flags) == DNS_RA_YES;
+    ok = ok && dns_message_count(&msg, DNS_SECTION_ANSWER) == 2 && dns_message_count(&msg, DNS_SECTION_ADDITIONAL) == 1;
+    dns_message_clear(&msg);
+
+    // 缓冲区不足时记录不被追加
+    // 查询的CD位复制到响应中（RFC 4035 §3.2.2），AD位清零
+    len = test_build_query(0x2345, "www.example.com", DNS_TYPE_A, false, packet, sizeof(packet));
+    packet[3] |= (1 << DNS_FLAGS_INDEX_CD) | 0x20;
+    ok  = ok && dns_reply_init(&reply, packet, len, len + 15);
+    ok  = ok && !dns_reply_add_record(&reply, DNS_SECTION_ANSWER, DNS_TYPE_A, DNS_CLASS_IN, 300, ip1, sizeof(ip1));
+    dns_reply_set_rcode(&reply, DNS_RCODE_NXDOMAIN);
+    ok = test_show("nxdomain", packet, dns_reply_finish(&reply)) && ok;
+    ok = ok && (packet[3] & 0xF0) == (1 << DNS_FLAGS_INDEX_CD);
+
+    // 问题不完整时初始化失败，改用只有头部的错误响应
+    len = test_build_query(0x3456, "www.example.com", DNS_TYPE_A, false, packet, sizeof(packet));
+    ok  = ok && !dns_reply_init(&reply, packet, len - 2, sizeof(packet));
+    ok  = test_show("formerr", packet, dns_reply_error(packet, len - 2, DNS_RCODE_FORMERR)) && ok;
+
+    // 响应报文不是查询
+    ok = ok && !dns_reply_is_query(packet, len) && !dns_reply_init(&reply, packet, 12, sizeof(packet));
+
+    printf("%s\n", ok ? "all ok" : "failed");
+    return ok ? 0 : 1;
+}
+#endif  // DNS_REPLY_TEST
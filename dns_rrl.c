@@ -0,0 +1,345 @@
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "dns_error.h"
+#include "dns_flags.h"
+#include "dns_name.h"
+#include "dns_rrl.h"
+
+#define DNS_RRL_HEADER_SIZE 12
+#define DNS_RRL_TAG_SHIFT   40
+#define DNS_RRL_TIME_SHIFT  24
+#define DNS_RRL_TIME_MASK   0xFFFF
+
+/**
+ * @brief 把网段、地址族和类别拼成一个64位键：IPv4 /24或IPv6 /56占低56位
+ * @return bool 地址族不支持返回false
+ */
+static bool dns_rrl_key(const struct sockaddr *peer, dns_rrl_class_t cls, uint64_t *key)
+{
+    uint64_t prefix = 0;
+    if (AF_INET == peer->sa_family) {
+        const uint8_t *addr = (const uint8_t *)&((const struct sockaddr_in *)peer)->sin_addr;
+        prefix = ((uint64_t)addr[0] << 16) | (addr[1] << 8) | addr[2];
+    } else if (AF_INET6 == peer->sa_family) {
+        const uint8_t *addr = ((const struct sockaddr_in6 *)peer)->sin6_addr.s6_addr;
+        for (int i = 0; i < 7; i++) {
+            prefix = (prefix << 8) | addr[i];
+        }
+        prefix |= 1ull << 63;
+    } else {
+        return false;
+    }
+
+    *key = prefix | ((uint64_t)cls << 56);
+    return true;
+}
+
+static uint64_t dns_rrl_hash(uint64_t key)
+{
+    // splitmix64的混合函数
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+bool dns_rrl_init(dns_rrl_t *rrl, uint32_t size, uint32_t rate, uint32_t slip)
+{
+    if (NULL == rrl || size < 1 || size > (1u << 31) || rate < 1 || rate > DNS_RRL_CREDIT_MAX) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    uint32_t count = 1;
+    while (count < size) {
+        count <<= 1;
+    }
+
+    memset(rrl, 0, sizeof(dns_rrl_t));
+    rrl->buckets = (_Atomic uint64_t *)calloc(count, sizeof(uint64_t));
+    if (NULL == rrl->buckets) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+
+    rrl->mask = count - 1;
+    rrl->rate = rate;
+    rrl->slip = slip;
+    return true;
+}
+
+void dns_rrl_clear(dns_rrl_t *rrl)
+{
+    if (NULL == rrl) {
+        return;
+    }
+
+    free((void *)rrl->buckets);
+    memset(rrl, 0, sizeof(dns_rrl_t));
+}
+
+dns_rrl_class_t dns_rrl_classify(const uint8_t *response, size_t len)
+{
+    if (NULL == response || len < DNS_RRL_HEADER_SIZE) {
+        return DNS_RRL_ERROR;
+    }
+
+    switch (response[3] & 0x0F) {
+    case DNS_RCODE_NOERROR:
+        return DNS_RRL_ANSWER;
+    case DNS_RCODE_NXDOMAIN:
+        return DNS_RRL_NXDOMAIN;
+    default:
+        return DNS_RRL_ERROR;
+    }
+}
+
+dns_rrl_action_t dns_rrl_check(dns_rrl_t *rrl, const struct sockaddr *peer, dns_rrl_class_t cls, uint32_t now)
+{
+    uint64_t key;
+    if (NULL == rrl || NULL == rrl->buckets || NULL == peer || !dns_rrl_key(peer, cls, &key)) {
+        return DNS_RRL_PASS;
+    }
+
+    uint64_t          hash   = dns_rrl_hash(key);
+    _Atomic uint64_t *bucket = &rrl->buckets[hash & rrl->mask];
+    uint64_t          tag    = hash >> DNS_RRL_TAG_SHIFT;
+    uint64_t          time   = now & DNS_RRL_TIME_MASK;
+
+    uint64_t old = atomic_load_explicit(bucket, memory_order_relaxed);
+    for (;;) {
+        uint64_t credit;
+        if ((old >> DNS_RRL_TAG_SHIFT) != tag) {
+            // 空桶或被其它键占用：按满桶开始
+            credit = rrl->rate;
+        } else {
+            // 时间只保留16位，回绕后的差值仍然正确，超过18小时未活动的桶会被当作刚用过
+            uint64_t elapsed = (time - ((old >> DNS_RRL_TIME_SHIFT) & DNS_RRL_TIME_MASK)) & DNS_RRL_TIME_MASK;
+            credit = (old & DNS_RRL_CREDIT_MAX) + elapsed * rrl->rate;
+            if (credit > rrl->rate) {
+                credit = rrl->rate;
+            }
+        }
+
+        bool pass = credit > 0;
+        uint64_t next = (tag << DNS_RRL_TAG_SHIFT) | (time << DNS_RRL_TIME_SHIFT) | (pass ? credit - 1 : 0);
+        if (next == old || atomic_compare_exchange_weak_explicit(bucket, &old, next, memory_order_relaxed, memory_order_relaxed)) {
+            if (pass) {
+                return DNS_RRL_PASS;
+            }
+            break;
+        }
+    }
+
+    if (0 == rrl->slip) {
+        return DNS_RRL_DROP;
+    }
+
+    // 每个线程各自计数，不在共享的计数器上竞争
+    static _Thread_local uint32_t limited = 0;
+    return ++limited % rrl->slip == 0 ? DNS_RRL_SLIP : DNS_RRL_DROP;
+}
+
+size_t dns_rrl_apply(dns_rrl_t *rrl, const struct sockaddr *peer, uint8_t *response, size_t len, uint32_t now)
+{
+    if (NULL == response || len < DNS_RRL_HEADER_SIZE) {
+        return len;
+    }
+
+    switch (dns_rrl_check(rrl, peer, dns_rrl_classify(response, len), now)) {
+    case DNS_RRL_PASS:
+        return len;
+    case DNS_RRL_DROP:
+        return 0;
+    default:
+        break;
+    }
+
+    // 截断为头部加问题，问题不完整时只保留头部
+    size_t end = DNS_RRL_HEADER_SIZE;
+    if (0 == response[4] && 1 == response[5]) {
+        int name_len = dns_name_skip(response, len, DNS_RRL_HEADER_SIZE);
+        if (name_len > 0 && DNS_RRL_HEADER_SIZE + (size_t)name_len + 4 <= len) {
+            end = DNS_RRL_HEADER_SIZE + name_len + 4;
+        }
+    }
+    if (DNS_RRL_HEADER_SIZE == end) {
+        response[4] = 0;
+        response[5] = 0;
+    }
+
+    uint16_t flags = (response[2] << 8) | response[3];
+    dns_flags_set_tc(&flags, DNS_TC_YES);
+    response[2] = flags >> 8;
+    response[3] = flags & 0xFF;
+    memset(response + 6, 0, 6);
+    return end;
+}
+
+#ifdef DNS_RRL_TEST
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "dns_class.h"
+#include "dns_message.h"
+
+#define TEST_THREADS 4
+#define TEST_LOOPS   10000000
+
+static struct sockaddr_in test_addr4(const char *ip)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+static struct sockaddr_in6 test_addr6(const char *ip)
+{
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, ip, &addr.sin6_addr);
+    return addr;
+}
+
+static int test_passes(dns_rrl_t *rrl, const void *peer, dns_rrl_class_t cls, uint32_t now, int count)
+{
+    int passed = 0;
+    for (int i = 0; i < count; i++) {
+        passed += DNS_RRL_PASS == dns_rrl_check(rrl, (const struct sockaddr *)peer, cls, now);
+    }
+    return passed;
+}
+
+typedef struct {
+    dns_rrl_t  *rrl;
+    atomic_int  passed;
+} test_shared_t;
+
+static void *test_thread(void *arg)
+{
+    test_shared_t      *shared = (test_shared_t *)arg;
+    struct sockaddr_in  peer   = test_addr4("198.51.100.7");
+    atomic_fetch_add(&shared->passed, test_passes(shared->rrl, &peer, DNS_RRL_ANSWER, 5000, 100000));
+    return NULL;
+}
+
+int main(void)
+{
+    dns_rrl_t rrl;
+    dns_rrl_init(&rrl, 4096, 10, 2);
+    bool ok = true;
+
+    // 同一/24内的地址共享令牌，不同/24和不同类别互不影响
+    struct sockaddr_in a = test_addr4("192.0.2.1");
+    struct sockaddr_in b = test_addr4("192.0.2.200");
+    struct sockaddr_in c = test_addr4("192.0.3.1");
+    int pa = test_passes(&rrl, &a, DNS_RRL_ANSWER, 100, 8);
+    int pb = test_passes(&rrl, &b, DNS_RRL_ANSWER, 100, 8);
+    int pc = test_passes(&rrl, &c, DNS_RRL_ANSWER, 100, 20);
+    int pn = test_passes(&rrl, &a, DNS_RRL_NXDOMAIN, 100, 20);
+    printf("ipv4 /24: same=%d+%d other=%d nxdomain=%d\n", pa, pb, pc, pn);
+    ok = ok && 8 == pa && 2 == pb && 10 == pc && 10 == pn;
+
+    // 一秒后补充rate个令牌，不超过容量
+    int refill = test_passes(&rrl, &a, DNS_RRL_ANSWER, 101, 20);
+    int full   = test_passes(&rrl, &a, DNS_RRL_ANSWER, 200, 20);
+    printf("refill: after 1s=%d after 99s=%d\n", refill, full);
+    ok = ok && 10 == refill && 10 == full;
+
+    // IPv6按/56分组
+    struct sockaddr_in6 x = test_addr6("2001:db8:0:1100::1");
+    struct sockaddr_in6 y = test_addr6("2001:db8:0:11ff::2");
+    struct sockaddr_in6 z = test_addr6("2001:db8:0:1200::1");
+    int px = test_passes(&rrl, &x, DNS_RRL_ANSWER, 100, 6);
+    int py = test_passes(&rrl, &y, DNS_RRL_ANSWER, 100, 6);
+    int pz = test_passes(&rrl, &z, DNS_RRL_ANSWER, 100, 10);
+    printf("ipv6 /56: same=%d+%d other=%d\n", px, py, pz);
+    ok = ok && 6 == px && 4 == py && 10 == pz;
+
+    // 超限的响应一半被截断：TC=1，只剩头部和问题
+    uint8_t        arena[1024];
+    uint8_t        packet[512];
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, "amplify.example.com");
+    dns_question_set_qtype(&question, DNS_TYPE_TXT);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+    dns_answer_t answer;
+    dns_answer_init(&answer);
+    dns_answer_set_name(&answer, "amplify.example.com");
+    dns_answer_set_type(&answer, DNS_TYPE_TXT);
+    dns_answer_set_class(&answer, DNS_CLASS_IN);
+    dns_answer_set_ttl(&answer, 60);
+    uint8_t txt[200];
+    memset(txt, 'x', sizeof(txt));
+    txt[0] = sizeof(txt) - 1;
+    dns_answer_set_data(&answer, txt, sizeof(txt));
+    dns_message_add_answer(&msg, &answer);
+    dns_answer_clear(&answer);
+    int len = dns_message_serialize(&msg, packet, sizeof(packet));
+
+    struct sockaddr_in victim = test_addr4("203.0.113.5");
+    int    sent = 0, slipped = 0, dropped = 0;
+    for (int i = 0; i < 30; i++) {
+        uint8_t copy[512];
+        memcpy(copy, packet, len);
+        size_t out = dns_rrl_apply(&rrl, (const struct sockaddr *)&victim, copy, len, 300);
+        if (out == (size_t)len) {
+            sent += 1;
+        } else if (out > 0) {
+            slipped += (copy[2] & 0x02) && 0 == copy[7] && out == 12 + 21 + 4;
+        } else {
+            dropped += 1;
+        }
+    }
+    printf("apply: sent=%d slipped=%d dropped=%d\n", sent, slipped, dropped);
+    ok = ok && 10 == sent && 10 == slipped && 10 == dropped;
+
+    // 多线程同时扣减同一个桶，通过的总数正好是rate
+    test_shared_t shared = {&rrl, 0};
+    pthread_t     threads[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, test_thread, &shared);
+    }
+    for (int i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    printf("concurrent: passed=%d\n", atomic_load(&shared.passed));
+    ok = ok && 10 == atomic_load(&shared.passed);
+    dns_rrl_clear(&rrl);
+
+    // 单次检查的开销：每次换一个/24，大部分通过
+    dns_rrl_init(&rrl, 1 << 20, 100, 2);
+    struct sockaddr_in peer = test_addr4("10.0.0.1");
+    struct timespec    start, end;
+    uint32_t           passed = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < TEST_LOOPS; i++) {
+        peer.sin_addr.s_addr = htonl(0x0A000000 | ((i & 0xFFFF) << 8));
+        passed += DNS_RRL_PASS == dns_rrl_check(&rrl, (const struct sockaddr *)&peer, DNS_RRL_ANSWER, 1000);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / TEST_LOOPS;
+    printf("check: %.1f ns/op, passed=%u\n", ns, passed);
+    dns_rrl_clear(&rrl);
+
+    return ok ? 0 : 1;
+}
+#endif  // DNS_RRL_TEST
@@ -0,0 +1,220 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_error.h"
+#include "dns_shard.h"
+
+/**
+ * @brief 释放前count个分片及其中的条目
+ */
+static void dns_shards_free(dns_shards_t *table, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        dns_shard_t *shard = &table->shards[i];
+        for (dns_shard_node_t *node = shard->lru_head; NULL != node;) {
+            dns_shard_node_t *next = node->lru_next;
+            free(node);
+            node = next;
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(table->shards);
+    memset(table, 0, sizeof(dns_shards_t));
+}
+
+bool dns_shards_init(dns_shards_t *table, uint32_t shards, uint32_t capacity)
+{
+    if (NULL == table || shards < 1 || shards > DNS_SHARD_MAX || capacity < shards) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    uint32_t count = 1;
+    while (count < shards) {
+        count <<= 1;
+    }
+
+    memset(table, 0, sizeof(dns_shards_t));
+    table->shards = (dns_shard_t *)calloc(count, sizeof(dns_shard_t));
+    if (NULL == table->shards) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+    table->shard_mask = count - 1;
+    table->capacity   = (capacity + count - 1) / count;
+
+    // 桶数不少于每个分片的容量，链表平均长度不超过1
+    uint32_t buckets = 1;
+    while (buckets < table->capacity) {
+        buckets <<= 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        dns_shard_t *shard = &table->shards[i];
+        shard->mask    = buckets - 1;
+        shard->buckets = (dns_shard_node_t **)calloc(buckets, sizeof(dns_shard_node_t *));
+        if (NULL == shard->buckets) {
+            dns_shards_free(table, i);
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
+            return false;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+    return true;
+}
+
+void dns_shards_clear(dns_shards_t *table)
+{
+    if (NULL == table || NULL == table->shards) {
+        return;
+    }
+    dns_shards_free(table, table->shard_mask + 1);
+}
+
+dns_shard_t *dns_shards_get(dns_shards_t *table, uint32_t hash)
+{
+    // 分片用哈希的高位，桶用低位，避免同一分片里只用到一部分桶
+    return &table->shards[(hash >> 24) & table->shard_mask];
+}
+
+void dns_shards_stats(dns_shards_t *table, dns_shard_stats_t *stats)
+{
+    if (NULL == stats) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(dns_shard_stats_t));
+    if (NULL == table || NULL == table->shards) {
+        return;
+    }
+
+    for (uint32_t i = 0; i <= table->shard_mask; i++) {
+        dns_shard_t *shard = &table->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        stats->entries   += shard->count;
+        stats->hits      += shard->hits;
+        stats->misses    += shard->misses;
+        stats->expired   += shard->expired;
+        stats->evictions += shard->evictions;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+dns_shard_node_t **dns_shard_bucket(dns_shard_t *shard, uint32_t hash)
+{
+    return &shard->buckets[hash & shard->mask];
+}
+
+dns_shard_node_t **dns_shard_link(dns_shard_t *shard, dns_shard_node_t *node)
+{
+    dns_shard_node_t **link = dns_shard_bucket(shard, node->hash);
+    while (NULL != *link && *link != node) {
+        link = &(*link)->next;
+    }
+    return NULL != *link ? link : NULL;
+}
+
+static void dns_shard_lru_unlink(dns_shard_t *shard, dns_shard_node_t *node)
+{
+    if (NULL != node->lru_prev) {
+        node->lru_prev->lru_next = node->lru_next;
+    } else {
+        shard->lru_head = node->lru_next;
+    }
+
+    if (NULL != node->lru_next) {
+        node->lru_next->lru_prev = node->lru_prev;
+    } else {
+        shard->lru_tail = node->lru_prev;
+    }
+}
+
+static void dns_shard_lru_push(dns_shard_t *shard, dns_shard_node_t *node)
+{
+    node->lru_prev = NULL;
+    node->lru_next = shard->lru_head;
+    if (NULL != shard->lru_head) {
+        shard->lru_head->lru_prev = node;
+    } else {
+        shard->lru_tail = node;
+    }
+    shard->lru_head = node;
+}
+
+void dns_shard_insert(dns_shard_t *shard, dns_shard_node_t *node)
+{
+    dns_shard_node_t **bucket = dns_shard_bucket(shard, node->hash);
+    node->next = *bucket;
+    *bucket    = node;
+    dns_shard_lru_push(shard, node);
+    shard->count += 1;
+}
+
+dns_shard_node_t *dns_shard_remove(dns_shard_t *shard, dns_shard_node_t **link)
+{
+    dns_shard_node_t *node = *link;
+    *link = node->next;
+    dns_shard_lru_unlink(shard, node);
+    shard->count -= 1;
+    return node;
+}
+
+void dns_shard_touch(dns_shard_t *shard, dns_shard_node_t *node)
+{
+    if (shard->lru_head != node) {
+        dns_shard_lru_unlink(shard, node);
+        dns_shard_lru_push(shard, node);
+    }
+}
+
+#ifdef DNS_SHARD_TEST
+int main(void)
+{
+    bool         ok = true;
+    dns_shards_t table;
+    ok = ok && !dns_shards_init(&table, 0, 8) && !dns_shards_init(&table, DNS_SHARD_MAX + 1, 1024) && !dns_shards_init(&table, 4, 2);
+    ok = ok && dns_shards_init(&table, 3, 10) && table.shard_mask == 3 && table.capacity == 3 && table.shards[0].mask == 3;
+
+    // 同一分片中的三个节点：哈希高位相同，低位相同的两个落在同一个桶
+    dns_shard_t      *shard = dns_shards_get(&table, 0x01000001);
+    dns_shard_node_t *nodes[3];
+    uint32_t          hashes[3] = {0x01000001, 0x01000005, 0x01000002};
+    for (int i = 0; i < 3; i++) {
+        nodes[i]       = (dns_shard_node_t *)calloc(1, sizeof(dns_shard_node_t));
+        nodes[i]->hash = hashes[i];
+        ok             = ok && dns_shards_get(&table, hashes[i]) == shard;
+        dns_shard_insert(shard, nodes[i]);
+    }
+    ok = ok && 3 == shard->count && *dns_shard_bucket(shard, hashes[1]) == nodes[1] && nodes[1]->next == nodes[0];
+    ok = ok && shard->lru_head == nodes[2] && shard->lru_tail == nodes[0];
+
+    // 命中移到头部，最久未使用的变为nodes[1]
+    dns_shard_touch(shard, nodes[0]);
+    ok = ok && shard->lru_head == nodes[0] && shard->lru_tail == nodes[1];
+
+    // 从桶链表中间摘下
+    dns_shard_node_t **link = dns_shard_link(shard, nodes[0]);
+    ok = ok && NULL != link && dns_shard_remove(shard, link) == nodes[0] && NULL == dns_shard_link(shard, nodes[0]);
+    ok = ok && 2 == shard->count && *dns_shard_bucket(shard, hashes[1]) == nodes[1] && NULL == nodes[1]->next;
+    ok = ok && shard->lru_head == nodes[2] && shard->lru_tail == nodes[1];
+    free(nodes[0]);
+
+    dns_shard_stats_t stats;
+    shard->hits = 5;
+    dns_shards_stats(&table, &stats);
+    ok = ok && 2 == stats.entries && 5 == stats.hits;
+
+    dns_shards_clear(&table);
+    ok = ok && NULL == table.shards;
+    dns_shards_clear(&table);
+
+    printf("%s\n", ok ? "all ok" : "failed");
+    return ok ? 0 : 1;
+}
+#endif  // DNS_SHARD_TEST
@@ -0,0 +1,196 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dns_error.h"
+#include "dns_header.h"
+#include "dns_stream.h"
+
+bool dns_stream_init(dns_stream_t *stream, uint8_t *buf, size_t buf_size)
+{
+    if (NULL == stream || NULL == buf || buf_size < DNS_HEADER_SIZE) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(stream, 0, sizeof(dns_stream_t));
+    stream->buf      = buf;
+    stream->buf_size = buf_size;
+    return true;
+}
+
+void dns_stream_reset(dns_stream_t *stream)
+{
+    if (NULL == stream) {
+        return;
+    }
+
+    stream->prefix_len = 0;
+    stream->expected   = 0;
+    stream->buffered   = 0;
+}
+
+bool dns_stream_idle(const dns_stream_t *stream)
+{
+    return NULL == stream || (0 == stream->prefix_len && 0 == stream->buffered);
+}
+
+int dns_stream_feed(dns_stream_t *stream, const uint8_t *data, size_t len, dns_stream_callback_t callback, void *arg)
+{
+    if (NULL == stream || (NULL == data && len > 0) || NULL == callback || len > INT32_MAX) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    size_t pos = 0;
+    while (pos < len) {
+        // 长度前缀本身也可能被拆开
+        if (stream->prefix_len < 2) {
+            stream->prefix[stream->prefix_len++] = data[pos++];
+            if (stream->prefix_len < 2) {
+                continue;
+            }
+
+            stream->expected = (stream->prefix[0] << 8) | stream->prefix[1];
+            if (stream->expected < DNS_HEADER_SIZE) {
+                dns_error_raise(DNS_ERROR_TRUNCATED);
+                return -1;
+            }
+            if (stream->expected > stream->buf_size) {
+                dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+                return -1;
+            }
+        }
+
+        const uint8_t *msg    = NULL;
+        size_t         remain = len - pos;
+        if (0 == stream->buffered && remain >= stream->expected) {
+            // 整个消息都在本次数据中，直接交给回调
+            msg  = data + pos;
+            pos += stream->expected;
+        } else {
+            size_t need = stream->expected - stream->buffered;
+            size_t take = remain < need ? remain : need;
+            memcpy(stream->buf + stream->buffered, data + pos, take);
+            stream->buffered += take;
+            pos              += take;
+            if (stream->buffered < stream->expected) {
+                break;
+            }
+            msg = stream->buf;
+            stream->copied += 1;
+        }
+
+        size_t msg_len = stream->expected;
+        stream->prefix_len = 0;
+        stream->expected   = 0;
+        stream->buffered   = 0;
+        stream->messages  += 1;
+        if (callback(arg, msg, msg_len) == false) {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+#ifdef DNS_STREAM_TEST
+#include <stdio.h>
+#include "dns_flags.h"
+#include "dns_message.h"
+
+typedef struct {
+    const uint8_t *input;
+    size_t         input_len;
+    int            parsed;
+    int            zero_copy;
+    uint16_t       ids[8];
+} test_context_t;
+
+static bool test_on_message(void *arg, const uint8_t *msg, size_t len)
+{
+    test_context_t *ctx = (test_context_t *)arg;
+
+    dns_message_t message;
+    dns_message_init(&message);
+    if (dns_message_deserialize(&message, msg, len) == (int)len && ctx->parsed < 8) {
+        ctx->ids[ctx->parsed++] = message.header.id;
+    }
+    dns_message_clear(&message);
+
+    if (msg >= ctx->input && msg < ctx->input + ctx->input_len) {
+        ctx->zero_copy += 1;
+    }
+    return true;
+}
+
+static size_t build_query(uint16_t id, const char *name, uint8_t *buf, size_t buf_size)
+{
+    dns_message_t msg;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, id);
+    dns_flags_set_rd(&msg.header.flags, 1);
+
+    dns_question_t question;
+    dns_question_init(&question);
+    dns_question_set_qname(&question, name);
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+
+    // 前2字节留给长度前缀
+    int len = dns_message_serialize(&msg, buf + 2, buf_size - 2);
+    dns_message_clear(&msg);
+    buf[0] = (len >> 8) & 0xFF;
+    buf[1] = len & 0xFF;
+    return len + 2;
+}
+
+int main(void)
+{
+    // 三个流水线查询首尾相连，模拟一个连接上的数据
+    uint8_t     input[512];
+    size_t      input_len = 0;
+    const char *names[]   = {"a.example.com", "bb.example.com", "ccc.example.com"};
+    for (int i = 0; i < 3; i++) {
+        input_len += build_query(0x1000 + i, names[i], input + input_len, sizeof(input) - input_len);
+    }
+
+    int failed = 0;
+    for (size_t chunk = 1; chunk <= input_len; chunk++) {
+        uint8_t        buf[512];
+        dns_stream_t   stream;
+        test_context_t ctx = {input, input_len, 0, 0, {0}};
+        dns_stream_init(&stream, buf, sizeof(buf));
+
+        for (size_t pos = 0; pos < input_len; pos += chunk) {
+            size_t n = input_len - pos < chunk ? input_len - pos : chunk;
+            if (dns_stream_feed(&stream, input + pos, n, test_on_message, &ctx) != (int)n) {
+                failed = 1;
+            }
+        }
+
+        if (ctx.parsed != 3 || ctx.ids[0] != 0x1000 || ctx.ids[2] != 0x1002 || !dns_stream_idle(&stream)) {
+            printf("chunk %zu: parsed=%d\n", chunk, ctx.parsed);
+            failed = 1;
+        }
+        if (1 == chunk || 16 == chunk || input_len == chunk) {
+            printf("chunk %3zu: messages=%llu copied=%llu zero_copy=%d\n",
+                   chunk, (unsigned long long)stream.messages, (unsigned long long)stream.copied, ctx.zero_copy);
+        }
+    }
+
+    // 长度前缀超过缓冲区的连接必须被拒绝
+    uint8_t      small[64];
+    dns_stream_t stream;
+    dns_stream_init(&stream, small, sizeof(small));
+    const uint8_t oversize[] = {0x01, 0x00};
+    int rejected = dns_stream_feed(&stream, oversize, sizeof(oversize), test_on_message, NULL) < 0;
+    printf("oversize: %s (%s)\n", rejected ? "rejected" : "accepted", dns_error_name(dns_error_last()));
+
+    failed |= !rejected;
+    printf("%s\n", failed ? "failed" : "ok");
+    return failed;
+}
+#endif  // DNS_STREAM_TEST
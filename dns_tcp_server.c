@@ -0,0 +1,655 @@
+#define _GNU_SOURCE  // accept4
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dns_error.h"
+#include "dns_tcp_server.h"
+
+#define DNS_TCP_LISTEN_TAG UINT64_MAX // 监听套接字在epoll中的标记
+#define DNS_TCP_SWEEP_MS   100        // 检查空闲连接的间隔
+
+static uint64_t dns_tcp_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int dns_tcp_listen_open(const char *ip, uint16_t port)
+{
+    if (NULL == ip) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t               addr_len = 0;
+    memset(&addr, 0, sizeof(addr));
+
+    struct sockaddr_in  *addr4 = (struct sockaddr_in *)&addr;
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+    if (inet_pton(AF_INET, ip, &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port   = htons(port);
+        addr_len          = sizeof(struct sockaddr_in);
+    } else if (inet_pton(AF_INET6, ip, &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port   = htons(port);
+        addr_len           = sizeof(struct sockaddr_in6);
+    } else {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, (struct sockaddr *)&addr, addr_len) < 0 || listen(fd, SOMAXCONN) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool dns_tcp_server_init(dns_tcp_server_t *server, int listen_fd, int max_conns, uint32_t idle_ms, dns_tcp_handler_t handler, void *arg)
+{
+    if (NULL == server || listen_fd < 0 || max_conns < 1 || idle_ms < 1 || NULL == handler) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(server, 0, sizeof(dns_tcp_server_t));
+    server->listen_fd  = listen_fd;
+    server->handler    = handler;
+    server->arg        = arg;
+    server->max_conns  = max_conns;
+    server->idle_ms    = idle_ms;
+    server->last_sweep = dns_tcp_now_ms();
+    atomic_init(&server->running, true);
+
+    server->conns    = (dns_tcp_conn_t *)calloc(max_conns, sizeof(dns_tcp_conn_t));
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (NULL == server->conns || server->epoll_fd < 0) {
+        dns_error_raise(NULL == server->conns ? DNS_ERROR_NO_MEMORY : DNS_ERROR_IO);
+        free(server->conns);
+        if (server->epoll_fd >= 0) {
+            close(server->epoll_fd);
+        }
+        memset(server, 0, sizeof(dns_tcp_server_t));
+        return false;
+    }
+
+    for (int i = 0; i < max_conns; i++) {
+        server->conns[i].fd        = -1;
+        server->conns[i].next_free = i + 1 < max_conns ? i + 1 : -1;
+    }
+    server->free_head = 0;
+
+    struct epoll_event event = {EPOLLIN, {.u64 = DNS_TCP_LISTEN_TAG}};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        dns_tcp_server_clear(server);
+        return false;
+    }
+
+    return true;
+}
+
+static void dns_tcp_conn_close(dns_tcp_server_t *server, int slot)
+{
+    dns_tcp_conn_t *conn = &server->conns[slot];
+
+    close(conn->fd);
+    free(conn->wbuf);
+
+    uint32_t generation = conn->generation;
+    memset(conn, 0, sizeof(dns_tcp_conn_t));
+    conn->fd         = -1;
+    conn->generation = generation + 1;
+    conn->next_free  = server->free_head;
+    server->free_head = slot;
+    server->active   -= 1;
+}
+
+void dns_tcp_server_clear(dns_tcp_server_t *server)
+{
+    if (NULL == server) {
+        return;
+    }
+
+    // 初始化失败或已经释放时整个结构体是0，epoll_fd为0并不代表打开了描述符0
+    if (NULL == server->conns) {
+        return;
+    }
+
+    for (int i = 0; i < server->max_conns; i++) {
+        if (server->conns[i].fd >= 0) {
+            dns_tcp_conn_close(server, i);
+        }
+    }
+
+    free(server->conns);
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    memset(server, 0, sizeof(dns_tcp_server_t));
+}
+
+/**
+ * @brief 尽量写出写缓冲区中的数据
+ */
+static void dns_tcp_conn_flush(dns_tcp_conn_t *conn)
+{
+    while (conn->wbuf_off < conn->wbuf_len) {
+        ssize_t n = write(conn->fd, conn->wbuf + conn->wbuf_off, conn->wbuf_len - conn->wbuf_off);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                dns_error_raise(DNS_ERROR_IO);
+                conn->closing = true;
+            }
+            return;
+        }
+        conn->wbuf_off += n;
+    }
+
+    conn->wbuf_off = 0;
+    conn->wbuf_len = 0;
+}
+
+/**
+ * @brief 根据连接状态调整关注的事件，该关闭时关闭连接
+ */
+static void dns_tcp_conn_update(dns_tcp_server_t *server, int slot)
+{
+    dns_tcp_conn_t *conn = &server->conns[slot];
+    if (conn->fd < 0 || conn->busy) {
+        return;
+    }
+
+    bool drained = 0 == conn->pending && conn->wbuf_off == conn->wbuf_len;
+    if (conn->closing || (conn->eof && drained)) {
+        dns_tcp_conn_close(server, slot);
+        return;
+    }
+
+    // 未回复的查询太多时停止读取，由TCP流控把压力传回客户端
+    bool reading = !conn->eof && conn->pending < DNS_TCP_PIPELINE_MAX;
+    bool writing = conn->wbuf_off < conn->wbuf_len;
+    if (reading == conn->reading && writing == conn->writing) {
+        return;
+    }
+
+    struct epoll_event event = {(reading ? EPOLLIN : 0) | (writing ? EPOLLOUT : 0), {.u64 = (uint64_t)slot}};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->reading = reading;
+    conn->writing = writing;
+}
+
+/**
+ * @brief 按token找到仍然打开的连接，并把它的未回复查询数减一
+ * @return dns_tcp_conn_t* 连接，token非法、连接已关闭或槽位已被新连接复用返回NULL
+ */
+static dns_tcp_conn_t *dns_tcp_conn_settle(dns_tcp_server_t *server, uint64_t token)
+{
+    // 令牌可能来自调用者的任意值，槽号按无符号比较，低32位超过2^31时不会变成负下标
+    uint32_t slot       = token & 0xFFFFFFFF;
+    uint32_t generation = token >> 32;
+    if (slot >= (uint32_t)server->max_conns) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return NULL;
+    }
+
+    dns_tcp_conn_t *conn = &server->conns[slot];
+    if (conn->fd < 0 || conn->generation != generation || conn->closing) {
+        return NULL;
+    }
+
+    if (conn->pending > 0) {
+        conn->pending -= 1;
+    }
+    return conn;
+}
+
+bool dns_tcp_server_drop(dns_tcp_server_t *server, uint64_t token)
+{
+    if (NULL == server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    dns_tcp_conn_t *conn = dns_tcp_conn_settle(server, token);
+    if (NULL == conn) {
+        return false;
+    }
+
+    // 空闲超时从放弃查询时开始计算
+    conn->last_active = dns_tcp_now_ms();
+    dns_tcp_conn_update(server, (int)(token & 0xFFFFFFFF));
+    return true;
+}
+
+bool dns_tcp_server_respond(dns_tcp_server_t *server, uint64_t token, const uint8_t *response, size_t len)
+{
+    if (NULL == server || NULL == response || len < 1 || len > UINT16_MAX) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    dns_tcp_conn_t *conn = dns_tcp_conn_settle(server, token);
+    if (NULL == conn) {
+        return false;
+    }
+    int slot = (int)(token & 0xFFFFFFFF);
+
+    size_t need = conn->wbuf_len + 2 + len;
+    if (need > conn->wbuf_size) {
+        size_t   size = conn->wbuf_size ? conn->wbuf_size * 2 : 1024;
+        while (size < need) {
+            size *= 2;
+        }
+        uint8_t *wbuf = (uint8_t *)realloc(conn->wbuf, size);
+        if (NULL == wbuf) {
+            dns_error_raise(DNS_ERROR_NO_MEMORY);
+            conn->closing = true;
+            dns_tcp_conn_update(server, slot);
+            return false;
+        }
+        conn->wbuf      = wbuf;
+        conn->wbuf_size = size;
+    }
+
+    bool idle = conn->wbuf_off == conn->wbuf_len;
+    conn->wbuf[conn->wbuf_len++] = (len >> 8) & 0xFF;
+    conn->wbuf[conn->wbuf_len++] = len & 0xFF;
+    memcpy(conn->wbuf + conn->wbuf_len, response, len);
+    conn->wbuf_len += len;
+    server->responses += 1;
+
+    // 之前有积压时等可写事件，保证按写入顺序发出
+    if (idle) {
+        dns_tcp_conn_flush(conn);
+    }
+    conn->last_active = dns_tcp_now_ms();
+    dns_tcp_conn_update(server, slot);
+    return true;
+}
+
+typedef struct {
+    dns_tcp_server_t *server;
+    int               slot;
+} dns_tcp_feed_t;
+
+static bool dns_tcp_on_query(void *arg, const uint8_t *msg, size_t len)
+{
+    dns_tcp_feed_t   *feed   = (dns_tcp_feed_t *)arg;
+    dns_tcp_server_t *server = feed->server;
+    dns_tcp_conn_t   *conn   = &server->conns[feed->slot];
+
+    conn->pending   += 1;
+    server->queries += 1;
+    server->handler(server->arg, server, ((uint64_t)conn->generation << 32) | feed->slot, msg, len);
+    return !conn->closing;
+}
+
+static void dns_tcp_on_readable(dns_tcp_server_t *server, int slot)
+{
+    dns_tcp_conn_t *conn = &server->conns[slot];
+
+    ssize_t n = read(conn->fd, server->read_buf, sizeof(server->read_buf));
+    if (n < 0) {
+        if (EINTR != errno && EAGAIN != errno && EWOULDBLOCK != errno) {
+            conn->closing = true;
+        }
+    } else if (0 == n) {
+        // 客户端可以先关闭写方向再等待所有回复（RFC 7766 6.2.4）
+        conn->eof = true;
+        if (!dns_stream_idle(&conn->stream)) {
+            conn->closing = true;
+        }
+    } else {
+        dns_tcp_feed_t feed = {server, slot};
+        conn->busy        = true;
+        conn->last_active = dns_tcp_now_ms();
+        if (dns_stream_feed(&conn->stream, server->read_buf, n, dns_tcp_on_query, &feed) < 0) {
+            conn->closing = true;
+        }
+        conn->busy = false;
+    }
+
+    dns_tcp_conn_update(server, slot);
+}
+
+static void dns_tcp_on_accept(dns_tcp_server_t *server)
+{
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return;
+        }
+
+        // 超过连接上限时立即关闭，保护已有连接
+        if (server->free_head < 0) {
+            server->rejected += 1;
+            close(fd);
+            continue;
+        }
+
+        int             slot = server->free_head;
+        dns_tcp_conn_t *conn = &server->conns[slot];
+        server->free_head = conn->next_free;
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        conn->fd          = fd;
+        conn->reading     = true;
+        conn->last_active = dns_tcp_now_ms();
+        dns_stream_init(&conn->stream, conn->query_buf, sizeof(conn->query_buf));
+        server->active   += 1;
+        server->accepted += 1;
+
+        struct epoll_event event = {EPOLLIN, {.u64 = (uint64_t)slot}};
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            dns_error_raise(DNS_ERROR_IO);
+            dns_tcp_conn_close(server, slot);
+        }
+    }
+}
+
+/**
+ * @brief 关闭没有未回复查询且空闲超时的连接
+ */
+static void dns_tcp_sweep(dns_tcp_server_t *server, uint64_t now)
+{
+    server->last_sweep = now;
+    for (int i = 0; i < server->max_conns && server->active > 0; i++) {
+        dns_tcp_conn_t *conn = &server->conns[i];
+        if (conn->fd < 0 || conn->pending > 0 || conn->wbuf_off < conn->wbuf_len) {
+            continue;
+        }
+        if (now - conn->last_active >= server->idle_ms) {
+            server->timeouts += 1;
+            dns_tcp_conn_close(server, i);
+        }
+    }
+}
+
+int dns_tcp_server_poll(dns_tcp_server_t *server, int timeout_ms)
+{
+    if (NULL == server || NULL == server->conns) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    if (timeout_ms > DNS_TCP_SWEEP_MS) {
+        timeout_ms = DNS_TCP_SWEEP_MS;
+    }
+
+    struct epoll_event events[DNS_TCP_EVENTS];
+    int count = epoll_wait(server->epoll_fd, events, DNS_TCP_EVENTS, timeout_ms);
+    if (count < 0) {
+        if (EINTR == errno) {
+            return 0;
+        }
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (DNS_TCP_LISTEN_TAG == events[i].data.u64) {
+            dns_tcp_on_accept(server);
+            continue;
+        }
+
+        int             slot = events[i].data.u64;
+        dns_tcp_conn_t *conn = &server->conns[slot];
+        if (conn->fd < 0) {
+            continue;
+        }
+
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            conn->closing = true;
+        } else {
+            if (events[i].events & EPOLLOUT) {
+                dns_tcp_conn_flush(conn);
+                conn->last_active = dns_tcp_now_ms();
+            }
+            if (events[i].events & EPOLLIN) {
+                dns_tcp_on_readable(server, slot);
+                continue;
+            }
+        }
+        dns_tcp_conn_update(server, slot);
+    }
+
+    uint64_t now = dns_tcp_now_ms();
+    if (now - server->last_sweep >= DNS_TCP_SWEEP_MS) {
+        dns_tcp_sweep(server, now);
+    }
+
+    return count;
+}
+
+bool dns_tcp_server_run(dns_tcp_server_t *server)
+{
+    if (NULL == server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    while (atomic_load_explicit(&server->running, memory_order_relaxed)) {
+        if (dns_tcp_server_poll(server, DNS_TCP_SWEEP_MS) < 0) {
+            atomic_store(&server->running, false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void dns_tcp_server_stop(dns_tcp_server_t *server)
+{
+    if (NULL == server) {
+        return;
+    }
+
+    atomic_store(&server->running, false);
+}
+
+#ifdef DNS_TCP_SERVER_TEST
+#include <pthread.h>
+#include <stdio.h>
+#include "dns_flags.h"
+#include "dns_message.h"
+
+#define TEST_BATCH 3
+
+/**
+ * @brief 模拟异步处理：每攒够TEST_BATCH个查询，按收到的相反顺序回复
+ */
+typedef struct {
+    int      count;
+    uint64_t tokens[TEST_BATCH];
+    uint8_t  responses[TEST_BATCH][512];
+    size_t   lens[TEST_BATCH];
+} test_context_t;
+
+static void test_handler(void *arg, dns_tcp_server_t *server, uint64_t token, const uint8_t *query, size_t len)
+{
+    test_context_t *ctx = (test_context_t *)arg;
+
+    uint8_t       arena[2048];
+    dns_message_t msg;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    if (dns_message_deserialize(&msg, query, len) < 1) {
+        dns_tcp_server_drop(server, token);
+        return;
+    }
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    int i = ctx->count++;
+    ctx->tokens[i] = token;
+    ctx->lens[i]   = dns_message_serialize(&msg, ctx->responses[i], sizeof(ctx->responses[i]));
+    if (ctx->count < TEST_BATCH) {
+        return;
+    }
+
+    for (i = TEST_BATCH - 1; i >= 0; i--) {
+        dns_tcp_server_respond(server, ctx->tokens[i], ctx->responses[i], ctx->lens[i]);
+    }
+    ctx->count = 0;
+}
+
+static void *test_server_thread(void *arg)
+{
+    dns_tcp_server_run((dns_tcp_server_t *)arg);
+    return NULL;
+}
+
+static int test_connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+static size_t test_query(uint16_t id, uint8_t *buf, size_t buf_size)
+{
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, id);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, "tcp.example.com");
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+    int len = dns_message_serialize(&msg, buf + 2, buf_size - 2);
+    dns_message_clear(&msg);
+    buf[0] = (len >> 8) & 0xFF;
+    buf[1] = len & 0xFF;
+    return len + 2;
+}
+
+static bool test_read_full(int fd, uint8_t *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read(fd, buf + done, len - done);
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+int main(void)
+{
+    int listen_fd = dns_tcp_listen_open("127.0.0.1", 0);
+    struct sockaddr_in addr;
+    socklen_t          addr_len = sizeof(addr);
+    getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+    uint16_t port = ntohs(addr.sin_port);
+
+    test_context_t    ctx    = {0};
+    dns_tcp_server_t *server = (dns_tcp_server_t *)malloc(sizeof(dns_tcp_server_t));
+    dns_tcp_server_init(server, listen_fd, 2, 300, test_handler, &ctx);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_thread, server);
+
+    // 三个查询在一次写入中流水线发出，第三个再拆成两次写入
+    int     client = test_connect(port);
+    uint8_t out[512];
+    size_t  out_len = 0;
+    for (int i = 0; i < TEST_BATCH; i++) {
+        out_len += test_query(0x100 + i, out + out_len, sizeof(out) - out_len);
+    }
+    write(client, out, out_len - 5);
+    usleep(20000);
+    write(client, out + out_len - 5, 5);
+
+    uint16_t order[TEST_BATCH];
+    bool     ok = true;
+    for (int i = 0; i < TEST_BATCH && ok; i++) {
+        uint8_t buf[512];
+        ok = test_read_full(client, buf, 2) && test_read_full(client, buf + 2, (buf[0] << 8) | buf[1]);
+        order[i] = ok ? (buf[2] << 8) | buf[3] : 0;
+    }
+    printf("pipelined responses: %s order=0x%x,0x%x,0x%x\n", ok ? "ok" : "failed", order[0], order[1], order[2]);
+    ok = ok && 0x102 == order[0] && 0x100 == order[2];
+
+    // 连接数上限为2：第二个连接被接受，第三个被立即关闭
+    int     idle    = test_connect(port);
+    int     extra   = test_connect(port);
+    uint8_t byte;
+    bool    refused = read(extra, &byte, 1) == 0;
+    printf("connection cap: %s\n", refused ? "third connection closed" : "third connection accepted");
+
+    // 回调放弃的查询不会让连接一直算作有未回复的查询，空闲连接仍在超时后被关闭
+    uint8_t garbage[] = {0, 14, 0xde, 0xad, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0x3f, 'x'};
+    write(idle, garbage, sizeof(garbage));
+    bool timed_out = read(idle, &byte, 1) == 0;
+    printf("idle timeout: %s\n", timed_out ? "closed" : "still open");
+
+    dns_tcp_server_stop(server);
+    pthread_join(thread, NULL);
+
+    // 非法令牌（低32位为负数的槽号、超出范围的槽号）被拒绝
+    bool bad_token = !dns_tcp_server_respond(server, 0xFFFFFFFFull, out, 12) && !dns_tcp_server_respond(server, 0x80000000ull, out, 12)
+                  && !dns_tcp_server_respond(server, 2, out, 12) && DNS_ERROR_INVALID_PARAM == dns_error_last();
+    printf("bad tokens: %s\n", bad_token ? "rejected" : "accepted");
+    ok = ok && bad_token;
+
+    printf("accepted=%llu rejected=%llu timeouts=%llu queries=%llu responses=%llu\n",
+           (unsigned long long)server->accepted,
+           (unsigned long long)server->rejected,
+           (unsigned long long)server->timeouts,
+           (unsigned long long)server->queries,
+           (unsigned long long)server->responses);
+
+    close(client);
+    close(idle);
+    close(extra);
+    dns_tcp_server_clear(server);
+    free(server);
+    close(listen_fd);
+    return ok && refused && timed_out ? 0 : 1;
+}
+#endif  // DNS_TCP_SERVER_TEST
@@ -0,0 +1,256 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_error.h"
+#include "dns_flags.h"
+#include "dns_name.h"
+#include "dns_template.h"
+
+#define DNS_TEMPLATE_HEADER_SIZE 12
+#define DNS_TEMPLATE_RD_MASK     (1 << (DNS_FLAGS_INDEX_RD - 8)) // RD位在标志高字节中的位置
+
+bool dns_template_init(dns_template_t *tpl, const dns_message_t *message)
+{
+    if (NULL == tpl || NULL == message || dns_message_count(message, DNS_SECTION_QUESTION) != 1) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(tpl, 0, sizeof(dns_template_t));
+
+    // 压缩后的长度不会超过未压缩的长度
+    uint32_t size = dns_message_wire_length(message);
+    uint8_t *wire = (uint8_t *)malloc(size);
+    if (NULL == wire) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+
+    int len = dns_message_serialize_compressed(message, wire, size);
+    int name_len = len > 0 ? dns_name_skip(wire, len, DNS_TEMPLATE_HEADER_SIZE) : 0;
+    // 问题是第一个写入的名称，不会被压缩
+    if (name_len < 1 || wire[DNS_TEMPLATE_HEADER_SIZE + name_len - 1] != 0 || DNS_TEMPLATE_HEADER_SIZE + name_len + 4 > len) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        free(wire);
+        return false;
+    }
+
+    tpl->wire            = wire;
+    tpl->len             = len;
+    tpl->question_length = name_len + 4;
+    return true;
+}
+
+void dns_template_clear(dns_template_t *tpl)
+{
+    if (NULL == tpl) {
+        return;
+    }
+
+    free(tpl->wire);
+    memset(tpl, 0, sizeof(dns_template_t));
+}
+
+bool dns_template_match(const dns_template_t *tpl, const uint8_t *query, size_t query_len)
+{
+    if (NULL == tpl || NULL == tpl->wire || NULL == query) {
+        return false;
+    }
+
+    size_t end = DNS_TEMPLATE_HEADER_SIZE + tpl->question_length;
+    if (query_len < end || query[4] != 0 || query[5] != 1) {
+        return false;
+    }
+
+    // 只应答标准查询：回复响应报文会在两个应答器之间形成循环，NOTIFY/UPDATE等不能用A记录回答
+    uint16_t flags = (query[2] << 8) | query[3];
+    if (dns_flags_get_qr(flags) != DNS_QR_QUERY || dns_flags_get_opcode(flags) != DNS_OPCODE_QUERY) {
+        return false;
+    }
+
+    // 标签长度都小于64，不受大小写转换影响，整个名称可以逐字节比较
+    const uint8_t *a = query + DNS_TEMPLATE_HEADER_SIZE;
+    const uint8_t *b = tpl->wire + DNS_TEMPLATE_HEADER_SIZE;
+    size_t         name_len = tpl->question_length - 4;
+    for (size_t i = 0; i < name_len; i++) {
+        uint8_t ca = a[i], cb = b[i];
+        if (ca != cb) {
+            if (ca >= 'A' && ca <= 'Z') {
+                ca += 'a' - 'A';
+            }
+            if (cb >= 'A' && cb <= 'Z') {
+                cb += 'a' - 'A';
+            }
+            if (ca != cb) {
+                return false;
+            }
+        }
+    }
+
+    return memcmp(a + name_len, b + name_len, 4) == 0;
+}
+
+int dns_template_render(const dns_template_t *tpl, const uint8_t *query, size_t query_len, uint8_t *buffer, size_t buffer_size)
+{
+    if (NULL == tpl || NULL == tpl->wire || NULL == query || NULL == buffer) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    if (!dns_template_match(tpl, query, query_len)) {
+        return 0;
+    }
+
+    if (buffer_size < tpl->len) {
+        dns_error_raise(DNS_ERROR_BUFFER_TOO_SMALL);
+        return -1;
+    }
+
+    // 先取出查询中要保留的部分，buffer可能与query重叠
+    uint8_t id0 = query[0];
+    uint8_t id1 = query[1];
+    uint8_t rd  = query[2] & DNS_TEMPLATE_RD_MASK;
+    uint8_t question[DNS_NAME_MAX_LENGTH + 4];
+    memcpy(question, query + DNS_TEMPLATE_HEADER_SIZE, tpl->question_length);
+
+    memcpy(buffer, tpl->wire, tpl->len);
+    buffer[0] = id0;
+    buffer[1] = id1;
+    buffer[2] = (buffer[2] & ~DNS_TEMPLATE_RD_MASK) | rd;
+    memcpy(buffer + DNS_TEMPLATE_HEADER_SIZE, question, tpl->question_length);
+    return tpl->len;
+}
+
+#ifdef DNS_TEMPLATE_TEST
+#include <stdio.h>
+#include <time.h>
+
+#define TEST_LOOPS 1000000
+
+static void test_build_response(dns_message_t *msg, const char *qname)
+{
+    dns_message_init(msg);
+    dns_header_set_id(&msg->header, 0x1234);
+    dns_flags_set_qr(&msg->header.flags, DNS_QR_RESPONSE);
+    dns_flags_set_aa(&msg->header.flags, DNS_AA_YES);
+
+    dns_question_t question;
+    dns_question_init(&question);
+    dns_question_set_qname(&question, qname);
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(msg, &question);
+
+    dns_answer_t answer;
+    dns_answer_init(&answer);
+    dns_answer_dup_name(&answer, question.qname);
+    dns_answer_set_type(&answer, DNS_TYPE_A);
+    dns_answer_set_class(&answer, DNS_CLASS_IN);
+    dns_answer_set_ttl(&answer, 3600);
+    uint8_t ip[] = {192, 168, 4, 1};
+    dns_answer_set_data(&answer, ip, sizeof(ip));
+    dns_message_add_answer(msg, &answer);
+    dns_answer_clear(&answer);
+    dns_question_clear(&question);
+}
+
+static int test_build_query(uint16_t id, const char *qname, uint8_t *buf, size_t buf_size)
+{
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init(&msg);
+    dns_header_set_id(&msg.header, id);
+    dns_flags_set_rd(&msg.header.flags, DNS_RD_YES);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, qname);
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+    int len = dns_message_serialize(&msg, buf, buf_size);
+    dns_message_clear(&msg);
+    return len;
+}
+
+static double test_elapsed_ns(struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+int main(void)
+{
+    dns_message_t msg;
+    test_build_response(&msg, "apmode.enplus.com");
+
+    dns_template_t tpl;
+    bool ok = dns_template_init(&tpl, &msg);
+    dns_message_clear(&msg);
+    printf("template: %s len=%zu question_length=%u\n", ok ? "ok" : "failed", tpl.len, tpl.question_length);
+
+    // 大小写混合的查询匹配模板，响应回显原始大小写
+    uint8_t query[512];
+    uint8_t response[512];
+    int     query_len = test_build_query(0xBEEF, "APMode.Enplus.COM", query, sizeof(query));
+    int     len       = dns_template_render(&tpl, query, query_len, response, sizeof(response));
+
+    char text[2048];
+    char name[DNS_NAME_MAX_LENGTH];
+    dns_message_t reply;
+    dns_message_init(&reply);
+    ok = ok && len > 0 && dns_message_deserialize(&reply, response, len) == len;
+    ok = ok && dns_header_get_id(&reply.header) == 0xBEEF && dns_flags_get_rd(reply.header.flags) == DNS_RD_YES;
+    ok = ok && strcmp(dns_name_decode(dns_question_get_qname(dns_message_get_question(&reply, 0)), name, sizeof(name)), "APMode.Enplus.COM") == 0;
+    ok = ok && dns_message_count(&reply, DNS_SECTION_ANSWER) == 1;
+    dns_message_to_string(&reply, text, sizeof(text));
+    printf("%s\n", text);
+    dns_message_clear(&reply);
+    printf("render: %s len=%d\n", ok ? "ok" : "failed", len);
+
+    // 不匹配的名称和类型返回0
+    int other_len = test_build_query(0x1111, "other.enplus.com", query, sizeof(query));
+    int other     = dns_template_render(&tpl, query, other_len, response, sizeof(response));
+    query_len     = test_build_query(0x2222, "apmode.enplus.com", query, sizeof(query));
+    query[query_len - 3] = DNS_TYPE_AAAA;
+    int aaaa      = dns_template_render(&tpl, query, query_len, response, sizeof(response));
+    // 响应报文和非QUERY操作码（NOTIFY）不应答
+    query_len = test_build_query(0x2222, "apmode.enplus.com", query, sizeof(query));
+    query[2] |= 0x80;
+    int qr    = dns_template_render(&tpl, query, query_len, response, sizeof(response));
+    query[2]  = (query[2] & 0x07) | (DNS_OPCODE_NOTIFY << 3);
+    int notify = dns_template_render(&tpl, query, query_len, response, sizeof(response));
+    printf("mismatch: name=%d type=%d qr=%d notify=%d\n", other, aaaa, qr, notify);
+    ok = ok && 0 == other && 0 == aaaa && 0 == qr && 0 == notify;
+
+    // 在查询所在的缓冲区中原地回复
+    query_len = test_build_query(0x3333, "apmode.enplus.com", query, sizeof(query));
+    len       = dns_template_render(&tpl, query, query_len, query, sizeof(query));
+    ok = ok && len == (int)tpl.len && query[0] == 0x33 && query[1] == 0x33 && (query[2] & 0x80);
+    printf("in place: %s\n", len > 0 ? "ok" : "failed");
+
+    // 与每次构建消息并序列化对比
+    struct timespec start;
+    query_len = test_build_query(0x4444, "apmode.enplus.com", query, sizeof(query));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < TEST_LOOPS; i++) {
+        query[1] = i;
+        len = dns_template_render(&tpl, query, query_len, response, sizeof(response));
+    }
+    double render_ns = test_elapsed_ns(&start) / TEST_LOOPS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < TEST_LOOPS / 10; i++) {
+        test_build_response(&msg, "apmode.enplus.com");
+        len = dns_message_serialize_compressed(&msg, response, sizeof(response));
+        dns_message_clear(&msg);
+    }
+    double build_ns = test_elapsed_ns(&start) / (TEST_LOOPS / 10);
+    printf("render %.1f ns/op, build+serialize %.1f ns/op\n", render_ns, build_ns);
+
+    dns_template_clear(&tpl);
+    return ok ? 0 : 1;
+}
+#endif  // DNS_TEMPLATE_TEST
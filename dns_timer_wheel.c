@@ -0,0 +1,261 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dns_timer_wheel.h"
+
+#define DNS_TIMER_WHEEL_MASK  (DNS_TIMER_WHEEL_SLOTS - 1)
+#define DNS_TIMER_WHEEL_RANGE (1u << (DNS_TIMER_WHEEL_BITS * DNS_TIMER_WHEEL_LEVELS)) // 时间轮能表示的最大间隔
+
+static void dns_timer_link(dns_timer_t **head, dns_timer_t *timer)
+{
+    timer->next  = *head;
+    timer->pprev = head;
+    if (NULL != *head) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+}
+
+/**
+ * @brief 按到期刻度与当前刻度的间隔选择层和槽
+ */
+static void dns_timer_wheel_place(dns_timer_wheel_t *wheel, dns_timer_t *timer)
+{
+    int32_t delta = (int32_t)(timer->expire - wheel->current);
+    if (delta <= 0) {
+        timer->level = DNS_TIMER_WHEEL_DUE;
+        dns_timer_link(&wheel->due, timer);
+        return;
+    }
+
+    // 超出范围的先放在最高层最晚的槽，下移时按真实的到期刻度重新放置
+    uint32_t expire = (uint32_t)delta < DNS_TIMER_WHEEL_RANGE ? timer->expire : wheel->current + DNS_TIMER_WHEEL_RANGE - 1;
+    int      level  = 0;
+    while (level < DNS_TIMER_WHEEL_LEVELS - 1 && (uint32_t)delta >= (1u << (DNS_TIMER_WHEEL_BITS * (level + 1)))) {
+        level += 1;
+    }
+
+    int slot     = (expire >> (DNS_TIMER_WHEEL_BITS * level)) & DNS_TIMER_WHEEL_MASK;
+    timer->level = level;
+    wheel->counts[level] += 1;
+    dns_timer_link(&wheel->slots[level][slot], timer);
+}
+
+void dns_timer_wheel_init(dns_timer_wheel_t *wheel, uint32_t now)
+{
+    if (NULL == wheel) {
+        return;
+    }
+
+    memset(wheel, 0, sizeof(dns_timer_wheel_t));
+    wheel->current = now;
+}
+
+bool dns_timer_wheel_empty(const dns_timer_wheel_t *wheel)
+{
+    if (NULL == wheel || NULL != wheel->due) {
+        return NULL == wheel;
+    }
+
+    for (int level = 0; level < DNS_TIMER_WHEEL_LEVELS; level++) {
+        if (wheel->counts[level] > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool dns_timer_pending(const dns_timer_t *timer)
+{
+    return NULL != timer && NULL != timer->pprev;
+}
+
+void dns_timer_wheel_add(dns_timer_wheel_t *wheel, dns_timer_t *timer, uint32_t expire)
+{
+    if (NULL == wheel || NULL == timer) {
+        return;
+    }
+
+    if (dns_timer_pending(timer)) {
+        dns_timer_wheel_remove(wheel, timer);
+    }
+
+    timer->expire = expire;
+    dns_timer_wheel_place(wheel, timer);
+}
+
+void dns_timer_wheel_remove(dns_timer_wheel_t *wheel, dns_timer_t *timer)
+{
+    if (NULL == wheel || !dns_timer_pending(timer)) {
+        return;
+    }
+
+    *timer->pprev = timer->next;
+    if (NULL != timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    if (timer->level < DNS_TIMER_WHEEL_LEVELS) {
+        wheel->counts[timer->level] -= 1;
+    }
+
+    timer->next  = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * @brief 把一个槽中的定时器全部取下，按新的当前刻度重新放置
+ */
+static void dns_timer_wheel_cascade(dns_timer_wheel_t *wheel, int level, int slot)
+{
+    dns_timer_t *timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    while (NULL != timer) {
+        dns_timer_t *next = timer->next;
+        wheel->counts[level] -= 1;
+        dns_timer_wheel_place(wheel, timer);
+        timer = next;
+    }
+}
+
+/**
+ * @brief 前进一个刻度：经过高层槽的边界时下移该槽，再把第0层当前槽移入到期链表
+ */
+static void dns_timer_wheel_tick(dns_timer_wheel_t *wheel)
+{
+    wheel->current += 1;
+    uint32_t now = wheel->current;
+    for (int level = DNS_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        if (0 == (now & ((1u << (DNS_TIMER_WHEEL_BITS * level)) - 1))) {
+            dns_timer_wheel_cascade(wheel, level, (now >> (DNS_TIMER_WHEEL_BITS * level)) & DNS_TIMER_WHEEL_MASK);
+        }
+    }
+
+    dns_timer_wheel_cascade(wheel, 0, now & DNS_TIMER_WHEEL_MASK);
+}
+
+dns_timer_t *dns_timer_wheel_expire(dns_timer_wheel_t *wheel, uint32_t now)
+{
+    if (NULL == wheel) {
+        return NULL;
+    }
+
+    while (NULL == wheel->due && (int32_t)(now - wheel->current) > 0) {
+        // 第0层为空时直接跳到下一个64刻度的边界之前，跨过的刻度都没有定时器要处理
+        if (0 == wheel->counts[0]) {
+            if (dns_timer_wheel_empty(wheel)) {
+                wheel->current = now;
+                break;
+            }
+            uint32_t boundary = wheel->current | DNS_TIMER_WHEEL_MASK;
+            wheel->current    = (int32_t)(now - boundary) <= 0 ? now - 1 : boundary;
+        }
+        dns_timer_wheel_tick(wheel);
+    }
+
+    dns_timer_t *timer = wheel->due;
+    if (NULL != timer) {
+        dns_timer_wheel_remove(wheel, timer);
+    }
+    return timer;
+}
+
+#ifdef DNS_TIMER_WHEEL_TEST
+#include <stdlib.h>
+#include <time.h>
+
+#define TEST_TIMERS 200000
+
+static uint32_t test_random(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static double test_elapsed_ns(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+int main(void)
+{
+    bool              ok = true;
+    uint32_t          seed = 12345;
+    dns_timer_wheel_t wheel;
+    dns_timer_t      *timers = (dns_timer_t *)calloc(TEST_TIMERS, sizeof(dns_timer_t));
+    uint8_t          *fired  = (uint8_t *)calloc(TEST_TIMERS, 1);
+
+    // 起点靠近32位回绕，到期时刻跨越各层以及超出2^24的范围；删除其中十分之一
+    uint32_t start = 0xFFFFF000u;
+    dns_timer_wheel_init(&wheel, start);
+    for (int i = 0; i < TEST_TIMERS; i++) {
+        uint32_t r     = test_random(&seed);
+        uint32_t delta = (i % 100 == 0) ? (1u << 24) + (r & 0xFFFF) : (r % 4 == 0 ? r & 0x3F : r & 0xFFFFF);
+        dns_timer_wheel_add(&wheel, &timers[i], start + delta);
+    }
+    for (int i = 0; i < TEST_TIMERS; i += 10) {
+        dns_timer_wheel_remove(&wheel, &timers[i]);
+        ok = ok && !dns_timer_pending(&timers[i]);
+    }
+
+    // 每次前进一个刻度时，取出的定时器必须恰好在这个刻度到期
+    int      count = 0, late = 0;
+    uint32_t now   = start;
+    for (uint32_t step = 0; step <= (1u << 24) + 0x10000; step++, now++) {
+        dns_timer_t *timer;
+        while (NULL != (timer = dns_timer_wheel_expire(&wheel, now))) {
+            size_t index = timer - timers;
+            late += timer->expire != now || fired[index];
+            fired[index] = 1;
+            count += 1;
+        }
+    }
+    for (int i = 0; i < TEST_TIMERS; i++) {
+        ok = ok && fired[i] == (i % 10 != 0);
+    }
+    printf("fired: %d timers, %d late or duplicated\n", count, late);
+    ok = ok && 0 == late && count == TEST_TIMERS - TEST_TIMERS / 10 && dns_timer_wheel_empty(&wheel);
+
+    // 同一刻度大量到期时按预算分批取出；时间跳跃也不会逐个刻度推进
+    dns_timer_wheel_init(&wheel, 1000);
+    for (int i = 0; i < 1000; i++) {
+        dns_timer_wheel_add(&wheel, &timers[i], 1100);
+    }
+    ok = ok && NULL == dns_timer_wheel_expire(&wheel, 1099);
+    int batches = 0;
+    for (count = 0; count < 1000; batches++) {
+        for (int budget = 0; budget < 64 && NULL != dns_timer_wheel_expire(&wheel, 5000000); budget++) {
+            count += 1;
+        }
+    }
+    printf("burst: %d timers in %d batches, wheel at %u\n", count, batches, wheel.current);
+    ok = ok && 16 == batches && dns_timer_wheel_empty(&wheel);
+
+    // 加入/删除/到期的平均耗时
+    dns_timer_wheel_init(&wheel, 0);
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int i = 0; i < TEST_TIMERS; i++) {
+        dns_timer_wheel_add(&wheel, &timers[i], 1 + (test_random(&seed) & 0xFFFF));
+    }
+    double add_ns = test_elapsed_ns(&begin) / TEST_TIMERS;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (count = 0; NULL != dns_timer_wheel_expire(&wheel, 0x10000); count++) {
+    }
+    double expire_ns = test_elapsed_ns(&begin) / TEST_TIMERS;
+    printf("add: %.1f ns/timer, expire: %.1f ns/timer\n", add_ns, expire_ns);
+    ok = ok && count == TEST_TIMERS;
+
+    free(timers);
+    free(fired);
+    printf("%s\n", ok ? "all ok" : "failed");
+    return ok ? 0 : 1;
+}
+#endif  // DNS_TIMER_WHEEL_TEST
@@ -66,4 +66,24 @@ const char* dns_type_name(dns_type_t qtype)
     default:
         return "UNKNOWN (Unknown answer type)";
     }
-}
\ No newline at end of file
+}
+
+bool dns_type_rdata_has_name(dns_type_t type)
+{
+    switch (type) {
+    case DNS_TYPE_NS:
+    case DNS_TYPE_MD:
+    case DNS_TYPE_MF:
+    case DNS_TYPE_CNAME:
+    case DNS_TYPE_SOA:
+    case DNS_TYPE_MB:
+    case DNS_TYPE_MG:
+    case DNS_TYPE_MR:
+    case DNS_TYPE_PTR:
+    case DNS_TYPE_MINFO:
+    case DNS_TYPE_MX:
+        return true;
+    default:
+        return false;
+    }
+}
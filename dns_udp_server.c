@@ -0,0 +1,376 @@
+#define _GNU_SOURCE  // recvmmsg/sendmmsg
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "dns_error.h"
+#include "dns_udp_server.h"
+
+int dns_udp_socket_open(const char *ip, uint16_t port, bool reuseport)
+{
+    if (NULL == ip) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t               addr_len = 0;
+    memset(&addr, 0, sizeof(addr));
+
+    struct sockaddr_in  *addr4 = (struct sockaddr_in *)&addr;
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+    if (inet_pton(AF_INET, ip, &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port   = htons(port);
+        addr_len          = sizeof(struct sockaddr_in);
+    } else if (inet_pton(AF_INET6, ip, &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port   = htons(port);
+        addr_len           = sizeof(struct sockaddr_in6);
+    } else {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    int fd = socket(addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int on = 1;
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+uint16_t dns_udp_socket_port(int fd)
+{
+    struct sockaddr_storage addr;
+    socklen_t               addr_len = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        return 0;
+    }
+
+    if (AF_INET6 == addr.ss_family) {
+        return ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+    }
+    return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+}
+
+bool dns_udp_server_init(dns_udp_server_t *server, int fd, dns_udp_handler_t handler, void *arg)
+{
+    if (NULL == server || fd < 0 || NULL == handler) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(server, 0, sizeof(dns_udp_server_t));
+    server->fd      = fd;
+    server->handler = handler;
+    server->arg     = arg;
+    atomic_init(&server->running, true);
+
+    // 收发共用报文缓冲区和对端地址，响应直接从查询所在的缓冲区发出
+    for (int i = 0; i < DNS_UDP_BATCH; i++) {
+        server->iov[i].iov_base = server->packets[i];
+        server->iov[i].iov_len  = DNS_UDP_PACKET_SIZE;
+    }
+
+    return true;
+}
+
+/**
+ * @brief 用sendmmsg发出count个响应，内核只接受一部分时继续发送剩余的
+ * @note sendmmsg只在第一个报文就失败时返回错误，错误属于第done个报文
+ */
+static void dns_udp_server_flush(dns_udp_server_t *server, int count)
+{
+    int done = 0;
+    while (done < count) {
+        int n = sendmmsg(server->fd, server->tx + done, count - done, MSG_DONTWAIT);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            dns_error_raise(DNS_ERROR_IO);
+            if (EAGAIN == errno || EWOULDBLOCK == errno || ENOBUFS == errno) {
+                // 发送缓冲区满时丢弃剩余的，UDP客户端会重传
+                server->dropped += count - done;
+                return;
+            }
+            // 其它错误（EMSGSIZE、EHOSTUNREACH等）只属于这一个对端，跳过它继续发送
+            server->dropped += 1;
+            done            += 1;
+            continue;
+        }
+        done         += n;
+        server->sent += n;
+    }
+}
+
+int dns_udp_server_poll(dns_udp_server_t *server, int timeout_ms)
+{
+    if (NULL == server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    for (int i = 0; i < DNS_UDP_BATCH; i++) {
+        struct msghdr *hdr = &server->rx[i].msg_hdr;
+        server->iov[i].iov_len = DNS_UDP_PACKET_SIZE;
+        memset(hdr, 0, sizeof(struct msghdr));
+        hdr->msg_name    = &server->peers[i];
+        hdr->msg_namelen = sizeof(struct sockaddr_storage);
+        hdr->msg_iov     = &server->iov[i];
+        hdr->msg_iovlen  = 1;
+    }
+
+    int count = recvmmsg(server->fd, server->rx, DNS_UDP_BATCH, MSG_DONTWAIT, NULL);
+    if (count < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)) {
+        struct pollfd pfd = {server->fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && EINTR != errno) {
+            dns_error_raise(DNS_ERROR_IO);
+            return -1;
+        }
+        if (ready <= 0) {
+            return 0;
+        }
+        count = recvmmsg(server->fd, server->rx, DNS_UDP_BATCH, MSG_DONTWAIT, NULL);
+    }
+
+    if (count < 0) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+            return 0;
+        }
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+
+    int replies = 0;
+    for (int i = 0; i < count; i++) {
+        struct msghdr *rx  = &server->rx[i].msg_hdr;
+        size_t         len = server->rx[i].msg_len;
+        if (rx->msg_flags & MSG_TRUNC) {
+            continue;
+        }
+
+        size_t response_len = server->handler(server->arg, server->packets[i], len, DNS_UDP_PACKET_SIZE, (struct sockaddr *)rx->msg_name, rx->msg_namelen);
+        if (response_len < 1 || response_len > DNS_UDP_PACKET_SIZE) {
+            continue;
+        }
+
+        struct msghdr *tx = &server->tx[replies].msg_hdr;
+        server->iov[i].iov_len = response_len;
+        memset(tx, 0, sizeof(struct msghdr));
+        tx->msg_name    = rx->msg_name;
+        tx->msg_namelen = rx->msg_namelen;
+        tx->msg_iov     = &server->iov[i];
+        tx->msg_iovlen  = 1;
+        replies += 1;
+    }
+
+    server->received += count;
+    if (replies > 0) {
+        dns_udp_server_flush(server, replies);
+    }
+
+    return count;
+}
+
+bool dns_udp_server_run(dns_udp_server_t *server)
+{
+    if (NULL == server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    while (atomic_load_explicit(&server->running, memory_order_relaxed)) {
+        if (dns_udp_server_poll(server, DNS_UDP_POLL_MS) < 0) {
+            atomic_store(&server->running, false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void dns_udp_server_stop(dns_udp_server_t *server)
+{
+    if (NULL == server) {
+        return;
+    }
+
+    atomic_store(&server->running, false);
+}
+
+#ifdef DNS_UDP_SERVER_TEST
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "dns_flags.h"
+#include "dns_message.h"
+
+/**
+ * @brief 对每个A查询回答192.0.2.1
+ */
+static size_t test_handler(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    (void)arg;
+    (void)peer;
+    (void)peer_len;
+
+    uint8_t       arena[2048];
+    dns_message_t msg;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    if (dns_message_deserialize(&msg, packet, len) < 1 || dns_message_count(&msg, DNS_SECTION_QUESTION) != 1) {
+        return 0;
+    }
+
+    const dns_question_t *question = dns_message_get_question(&msg, 0);
+    dns_answer_t answer;
+    uint8_t      ip[] = {192, 0, 2, 1};
+    dns_answer_init(&answer);
+    answer.rname   = question->qname;
+    answer.rtype   = DNS_TYPE_A;
+    answer.rclass  = DNS_CLASS_IN;
+    answer.rttl    = 60;
+    answer.rdata   = ip;
+    answer.rlength = sizeof(ip);
+    dns_message_add_answer(&msg, &answer);
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    int response_len = dns_message_serialize(&msg, packet, size);
+    dns_message_clear(&msg);
+    return response_len > 0 ? response_len : 0;
+}
+
+static void *test_server_thread(void *arg)
+{
+    dns_udp_server_run((dns_udp_server_t *)arg);
+    return NULL;
+}
+
+int main(void)
+{
+    int fd = dns_udp_socket_open("127.0.0.1", 0, false);
+    if (fd < 0) {
+        printf("dns_udp_socket_open failed\n");
+        return 1;
+    }
+
+    dns_udp_server_t *server = (dns_udp_server_t *)malloc(sizeof(dns_udp_server_t));
+    dns_udp_server_init(server, fd, test_handler, NULL);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_thread, server);
+
+    // 客户端一次发出一批查询，服务器应当在少数几次recvmmsg中收完
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(dns_udp_socket_port(fd));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const int queries = 100;
+    for (int i = 0; i < queries; i++) {
+        dns_message_t  msg;
+        dns_question_t question;
+        uint8_t        buf[512];
+        dns_message_init(&msg);
+        dns_header_set_id(&msg.header, i);
+        dns_question_init(&question);
+        dns_question_set_qname(&question, "udp.example.com");
+        dns_question_set_qtype(&question, DNS_TYPE_A);
+        dns_question_set_qclass(&question, DNS_CLASS_IN);
+        dns_message_add_question(&msg, &question);
+        dns_question_clear(&question);
+        int len = dns_message_serialize(&msg, buf, sizeof(buf));
+        dns_message_clear(&msg);
+        sendto(client, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
+
+    struct timeval tv = {2, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int     answered = 0;
+    uint8_t seen[100] = {0};
+    for (int i = 0; i < queries; i++) {
+        uint8_t buf[512];
+        ssize_t len = recv(client, buf, sizeof(buf), 0);
+        if (len < 0) {
+            break;
+        }
+
+        dns_message_t msg;
+        dns_message_init(&msg);
+        if (dns_message_deserialize(&msg, buf, len) > 0
+        &&  dns_message_count(&msg, DNS_SECTION_ANSWER) == 1
+        &&  msg.header.id < queries
+        &&  !seen[msg.header.id]) {
+            seen[msg.header.id] = 1;
+            answered += 1;
+        }
+        dns_message_clear(&msg);
+    }
+
+    dns_udp_server_stop(server);
+    pthread_join(thread, NULL);
+
+    // 回环上不应丢包
+    printf("queries=%d answered=%d received=%llu sent=%llu dropped=%llu\n",
+           queries,
+           answered,
+           (unsigned long long)server->received,
+           (unsigned long long)server->sent,
+           (unsigned long long)server->dropped);
+
+    // 一批响应中第一个发往非法地址（端口0，EINVAL）：只丢这一个，其余照常发出
+    struct sockaddr_in bad = addr, peer;
+    socklen_t          peer_len = sizeof(peer);
+    bad.sin_port = 0;
+    getsockname(client, (struct sockaddr *)&peer, &peer_len);
+    for (int i = 0; i < 3; i++) {
+        struct msghdr *tx = &server->tx[i].msg_hdr;
+        memset(tx, 0, sizeof(struct msghdr));
+        tx->msg_name    = 0 == i ? &bad : &peer;
+        tx->msg_namelen = sizeof(struct sockaddr_in);
+        tx->msg_iov     = &server->iov[i];
+        tx->msg_iovlen  = 1;
+        server->iov[i].iov_len = 12;
+    }
+    unsigned long long dropped = server->dropped;
+    dns_udp_server_flush(server, 3);
+
+    int delivered = 0;
+    for (uint8_t buf[512]; delivered < 3 && recv(client, buf, sizeof(buf), 0) == 12; delivered++) {
+    }
+    printf("flush with bad peer: delivered=%d dropped=%llu\n", delivered, (unsigned long long)(server->dropped - dropped));
+
+    close(client);
+    close(fd);
+    bool ok = answered == queries && 2 == delivered && 1 == server->dropped - dropped;
+    free(server);
+    return ok ? 0 : 1;
+}
+#endif  // DNS_UDP_SERVER_TEST
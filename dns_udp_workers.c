@@ -0,0 +1,325 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np, recvmmsg/sendmmsg
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dns_error.h"
+#include "dns_udp_workers.h"
+
+/**
+ * @brief 每个报文先清空本线程的消息（O(1)重置分配器），再交给调用者的回调
+ */
+static size_t dns_udp_worker_dispatch(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    dns_udp_worker_t *worker = (dns_udp_worker_t *)arg;
+
+    dns_message_clear(&worker->message);
+    return worker->handler(worker, packet, len, size, peer, peer_len);
+}
+
+static void *dns_udp_worker_main(void *arg)
+{
+    dns_udp_worker_t *worker = (dns_udp_worker_t *)arg;
+
+    if (worker->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    dns_udp_server_run(worker->server);
+    return NULL;
+}
+
+/**
+ * @brief 回收前count个工作线程，started个线程已经启动
+ */
+static void dns_udp_pool_release(dns_udp_pool_t *pool, int count, int started)
+{
+    for (int i = 0; i < started; i++) {
+        dns_udp_server_stop(pool->workers[i].server);
+    }
+
+    for (int i = 0; i < count; i++) {
+        dns_udp_worker_t *worker = &pool->workers[i];
+        if (i < started) {
+            pthread_join(worker->thread, NULL);
+        }
+        if (worker->fd >= 0) {
+            close(worker->fd);
+        }
+        free(worker->server);
+    }
+
+    free(pool->workers);
+    memset(pool, 0, sizeof(dns_udp_pool_t));
+}
+
+bool dns_udp_pool_start(dns_udp_pool_t *pool, const char *ip, uint16_t port, int count, bool pin, dns_udp_handler_t handler, void *arg)
+{
+    if (NULL == pool || NULL == ip || count < 1 || count > DNS_UDP_WORKERS_MAX || NULL == handler) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(pool, 0, sizeof(dns_udp_pool_t));
+    pool->workers = (dns_udp_worker_t *)calloc(count, sizeof(dns_udp_worker_t));
+    if (NULL == pool->workers) {
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        return false;
+    }
+    pool->count = count;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+
+    // 先全部创建套接字再启动线程，端口为0时后面的套接字绑定第一个分配到的端口
+    for (int i = 0; i < count; i++) {
+        dns_udp_worker_t *worker = &pool->workers[i];
+        worker->index   = i;
+        worker->cpu     = pin ? i % cpus : -1;
+        worker->handler = handler;
+        worker->arg     = arg;
+        worker->fd      = dns_udp_socket_open(ip, pool->port ? pool->port : port, true);
+        worker->server  = (dns_udp_server_t *)malloc(sizeof(dns_udp_server_t));
+        if (worker->fd < 0 || NULL == worker->server) {
+            if (NULL == worker->server) {
+                dns_error_raise(DNS_ERROR_NO_MEMORY);
+            }
+            dns_udp_pool_release(pool, i + 1, 0);
+            return false;
+        }
+
+        if (0 == pool->port) {
+            pool->port = dns_udp_socket_port(worker->fd);
+        }
+        dns_message_init_arena(&worker->message, worker->arena, sizeof(worker->arena));
+        dns_udp_server_init(worker->server, worker->fd, dns_udp_worker_dispatch, worker);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, dns_udp_worker_main, &pool->workers[i]) != 0) {
+            dns_error_raise(DNS_ERROR_IO);
+            dns_udp_pool_release(pool, count, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void dns_udp_pool_stop(dns_udp_pool_t *pool)
+{
+    if (NULL == pool || NULL == pool->workers) {
+        return;
+    }
+
+    dns_udp_pool_release(pool, pool->count, pool->count);
+}
+
+uint64_t dns_udp_pool_received(const dns_udp_pool_t *pool)
+{
+    if (NULL == pool || NULL == pool->workers) {
+        return 0;
+    }
+
+    uint64_t received = 0;
+    for (int i = 0; i < pool->count; i++) {
+        received += pool->workers[i].server->received;
+    }
+
+    return received;
+}
+
+#ifdef DNS_UDP_WORKERS_TEST
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include "dns_flags.h"
+
+#define BENCH_WINDOW 32 // 每个客户端在途的查询数
+
+typedef struct {
+    uint16_t    port;
+    double      seconds;
+    uint64_t    answered;
+    pthread_t   thread;
+} bench_client_t;
+
+/**
+ * @brief 用本线程的消息解析查询并回答一个A记录
+ */
+static size_t bench_handler(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    dns_udp_worker_t *worker = (dns_udp_worker_t *)arg;
+    dns_message_t    *msg    = &worker->message;
+    (void)peer;
+    (void)peer_len;
+
+    if (dns_message_deserialize(msg, packet, len) < 1 || dns_message_count(msg, DNS_SECTION_QUESTION) != 1) {
+        return 0;
+    }
+
+    uint8_t      ip[] = {192, 0, 2, 1};
+    dns_answer_t answer;
+    dns_answer_init(&answer);
+    answer.rname   = dns_message_get_question(msg, 0)->qname;
+    answer.rtype   = DNS_TYPE_A;
+    answer.rclass  = DNS_CLASS_IN;
+    answer.rttl    = 60;
+    answer.rdata   = ip;
+    answer.rlength = sizeof(ip);
+    dns_message_add_answer(msg, &answer);
+    dns_flags_set_qr(&msg->header.flags, DNS_QR_RESPONSE);
+
+    int response_len = dns_message_serialize(msg, packet, size);
+    return response_len > 0 ? response_len : 0;
+}
+
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 闭环客户端：保持BENCH_WINDOW个查询在途，收到多少补发多少
+ */
+static void *bench_client_main(void *arg)
+{
+    bench_client_t *client = (bench_client_t *)arg;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(client->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+    uint8_t        query[512];
+    dns_message_t  msg;
+    dns_question_t question;
+    dns_message_init(&msg);
+    dns_question_init(&question);
+    dns_question_set_qname(&question, "bench.example.com");
+    dns_question_set_qtype(&question, DNS_TYPE_A);
+    dns_question_set_qclass(&question, DNS_CLASS_IN);
+    dns_message_add_question(&msg, &question);
+    dns_question_clear(&question);
+    int query_len = dns_message_serialize(&msg, query, sizeof(query));
+    dns_message_clear(&msg);
+
+    struct mmsghdr msgs[BENCH_WINDOW];
+    struct iovec   iov[BENCH_WINDOW];
+    uint8_t        responses[BENCH_WINDOW][512];
+
+    double deadline = bench_now() + client->seconds;
+    int    inflight = 0;
+    while (bench_now() < deadline) {
+        int burst = BENCH_WINDOW - inflight;
+        for (int i = 0; i < burst; i++) {
+            iov[i].iov_base = query;
+            iov[i].iov_len  = query_len;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        if (burst > 0) {
+            int sent = sendmmsg(fd, msgs, burst, 0);
+            inflight += sent > 0 ? sent : 0;
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 10) <= 0) {
+            // 回环上也可能丢包，超时后认为在途的查询丢失
+            inflight = 0;
+            continue;
+        }
+
+        for (int i = 0; i < BENCH_WINDOW; i++) {
+            iov[i].iov_base = responses[i];
+            iov[i].iov_len  = sizeof(responses[i]);
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = recvmmsg(fd, msgs, BENCH_WINDOW, MSG_DONTWAIT, NULL);
+        if (received > 0) {
+            client->answered += received;
+            inflight         -= received;
+            if (inflight < 0) {
+                inflight = 0;
+            }
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+/**
+ * @brief 用法：dns_udp_workers.exe [最大线程数] [每个点的秒数]
+ *        依次测量1、2、4……个工作线程的pps，输出扩展曲线
+ */
+int main(int argc, char **argv)
+{
+    long   cpus        = sysconf(_SC_NPROCESSORS_ONLN);
+    int    max_workers = argc > 1 ? atoi(argv[1]) : (int)cpus;
+    double seconds     = argc > 2 ? atof(argv[2]) : 0.5;
+    if (max_workers < 1) {
+        max_workers = 1;
+    }
+
+    printf("cpus=%ld seconds=%.2f\n", cpus, seconds);
+    printf("%8s %8s %12s %8s\n", "workers", "clients", "pps", "scaling");
+
+    double base   = 0;
+    int    failed = 0;
+    for (int next = 1; next > 0; next = next < max_workers ? next * 2 : 0) {
+        int workers = next < max_workers ? next : max_workers;
+        dns_udp_pool_t pool;
+        if (dns_udp_pool_start(&pool, "127.0.0.1", 0, workers, true, bench_handler, NULL) == false) {
+            printf("dns_udp_pool_start failed: %s\n", dns_error_name(dns_error_last()));
+            return 1;
+        }
+
+        // 客户端数多于工作线程，内核按源端口哈希才能分到每个套接字
+        int             clients = workers * 2 < 4 ? 4 : workers * 2;
+        bench_client_t *client  = (bench_client_t *)calloc(clients, sizeof(bench_client_t));
+        for (int i = 0; i < clients; i++) {
+            client[i].port    = pool.port;
+            client[i].seconds = seconds;
+            pthread_create(&client[i].thread, NULL, bench_client_main, &client[i]);
+        }
+
+        uint64_t answered = 0;
+        for (int i = 0; i < clients; i++) {
+            pthread_join(client[i].thread, NULL);
+            answered += client[i].answered;
+        }
+        free(client);
+        dns_udp_pool_stop(&pool);
+
+        double pps = answered / seconds;
+        if (1 == workers) {
+            base = pps;
+        }
+        printf("%8d %8d %12.0f %7.2fx\n", workers, clients, pps, base > 0 ? pps / base : 0);
+        failed |= 0 == answered;
+    }
+
+    return failed;
+}
+#endif  // DNS_UDP_WORKERS_TEST
@@ -0,0 +1,535 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "dns_error.h"
+#include "dns_uring_server.h"
+
+#define DNS_URING_OP_RECV 0ULL
+#define DNS_URING_OP_SEND 1ULL
+
+static int dns_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int dns_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t arg_size)
+{
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int dns_uring_register(int ring_fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+/**
+ * @brief 把缓冲区放回缓冲区环，调用dns_uring_buffer_publish之后内核才可见
+ */
+static void dns_uring_buffer_recycle(dns_uring_server_t *server, uint16_t bid)
+{
+    struct io_uring_buf *buf = &server->buf_ring->bufs[server->buf_tail & (DNS_URING_BUFFERS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(server->buffers + (size_t)bid * DNS_URING_BUFFER_SIZE);
+    buf->len  = DNS_URING_BUFFER_SIZE;
+    buf->bid  = bid;
+    server->buf_tail += 1;
+}
+
+static void dns_uring_buffer_publish(dns_uring_server_t *server)
+{
+    __atomic_store_n(&server->buf_ring->tail, server->buf_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 提交已填写的SQE，不等待完成
+ */
+static bool dns_uring_submit(dns_uring_server_t *server)
+{
+    while (server->to_submit > 0) {
+        int n = dns_uring_enter(server->ring_fd, server->to_submit, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (EINTR == errno || EAGAIN == errno || EBUSY == errno) {
+                continue;
+            }
+            dns_error_raise(DNS_ERROR_IO);
+            return false;
+        }
+        server->to_submit -= n;
+    }
+
+    return true;
+}
+
+/**
+ * @brief 取一个空闲的SQE，提交队列满时先提交积压的SQE
+ */
+static struct io_uring_sqe *dns_uring_get_sqe(dns_uring_server_t *server)
+{
+    unsigned tail = *server->sq_tail;
+    if (tail - __atomic_load_n(server->sq_head, __ATOMIC_ACQUIRE) >= server->sq_entries) {
+        if (dns_uring_submit(server) == false) {
+            return NULL;
+        }
+        if (tail - __atomic_load_n(server->sq_head, __ATOMIC_ACQUIRE) >= server->sq_entries) {
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe *sqe = &server->sqes[tail & server->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    __atomic_store_n(server->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    server->to_submit += 1;
+    return sqe;
+}
+
+static bool dns_uring_arm_recv(dns_uring_server_t *server)
+{
+    struct io_uring_sqe *sqe = dns_uring_get_sqe(server);
+    if (NULL == sqe) {
+        return false;
+    }
+
+    sqe->opcode    = IORING_OP_RECVMSG;
+    sqe->fd        = server->fd;
+    sqe->addr      = (uint64_t)(uintptr_t)&server->recv_msg;
+    sqe->len       = 1;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = DNS_URING_GROUP;
+    sqe->user_data = DNS_URING_OP_RECV;
+    server->recv_armed = true;
+    return true;
+}
+
+bool dns_uring_server_init(dns_uring_server_t *server, int fd, dns_udp_handler_t handler, void *arg)
+{
+    if (NULL == server || fd < 0 || NULL == handler) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    memset(server, 0, sizeof(dns_uring_server_t));
+    server->ring_fd = -1;
+    server->fd      = fd;
+    server->handler = handler;
+    server->arg     = arg;
+    atomic_init(&server->running, true);
+
+    // 只有本线程提交，让内核把完成处理推迟到io_uring_enter中，老内核不支持时退回默认模式
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags      = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = DNS_URING_ENTRIES * 4;
+    server->ring_fd   = dns_uring_setup(DNS_URING_ENTRIES, &params);
+    if (server->ring_fd < 0 && EINVAL == errno) {
+        memset(&params, 0, sizeof(params));
+        params.flags      = IORING_SETUP_CQSIZE;
+        params.cq_entries = DNS_URING_ENTRIES * 4;
+        server->ring_fd   = dns_uring_setup(DNS_URING_ENTRIES, &params);
+    }
+    if (server->ring_fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        dns_error_raise(DNS_ERROR_IO);
+        dns_uring_server_clear(server);
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    server->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    server->ring_ptr  = mmap(NULL, server->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, server->ring_fd, IORING_OFF_SQ_RING);
+    server->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    server->sqes      = mmap(NULL, server->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, server->ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == server->ring_ptr || MAP_FAILED == server->sqes) {
+        server->ring_ptr = MAP_FAILED == server->ring_ptr ? NULL : server->ring_ptr;
+        server->sqes     = MAP_FAILED == server->sqes ? NULL : server->sqes;
+        dns_error_raise(DNS_ERROR_IO);
+        dns_uring_server_clear(server);
+        return false;
+    }
+
+    uint8_t  *ring     = (uint8_t *)server->ring_ptr;
+    unsigned *sq_array = (unsigned *)(ring + params.sq_off.array);
+    server->sq_head    = (unsigned *)(ring + params.sq_off.head);
+    server->sq_tail    = (unsigned *)(ring + params.sq_off.tail);
+    server->sq_mask    = *(unsigned *)(ring + params.sq_off.ring_mask);
+    server->sq_entries = params.sq_entries;
+    server->cq_head    = (unsigned *)(ring + params.cq_off.head);
+    server->cq_tail    = (unsigned *)(ring + params.cq_off.tail);
+    server->cq_mask    = *(unsigned *)(ring + params.cq_off.ring_mask);
+    server->cqes       = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    // SQE下标与提交队列位置一一对应
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    server->buf_ring_size = DNS_URING_BUFFERS * sizeof(struct io_uring_buf);
+    server->buf_ring      = mmap(NULL, server->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    server->buffers       = mmap(NULL, (size_t)DNS_URING_BUFFERS * DNS_URING_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == server->buf_ring || MAP_FAILED == server->buffers) {
+        server->buf_ring = MAP_FAILED == server->buf_ring ? NULL : server->buf_ring;
+        server->buffers  = MAP_FAILED == server->buffers ? NULL : server->buffers;
+        dns_error_raise(DNS_ERROR_NO_MEMORY);
+        dns_uring_server_clear(server);
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t)(uintptr_t)server->buf_ring;
+    reg.ring_entries = DNS_URING_BUFFERS;
+    reg.bgid         = DNS_URING_GROUP;
+    if (dns_uring_register(server->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        dns_error_raise(DNS_ERROR_IO);
+        dns_uring_server_clear(server);
+        return false;
+    }
+
+    for (uint16_t bid = 0; bid < DNS_URING_BUFFERS; bid++) {
+        dns_uring_buffer_recycle(server, bid);
+    }
+    dns_uring_buffer_publish(server);
+
+    // multishot recvmsg只用msghdr中的地址和控制信息长度来划分每个缓冲区
+    server->recv_msg.msg_namelen = sizeof(struct sockaddr_storage);
+    return true;
+}
+
+void dns_uring_server_clear(dns_uring_server_t *server)
+{
+    if (NULL == server) {
+        return;
+    }
+
+    if (server->buffers) {
+        munmap(server->buffers, (size_t)DNS_URING_BUFFERS * DNS_URING_BUFFER_SIZE);
+    }
+    if (server->buf_ring) {
+        munmap(server->buf_ring, server->buf_ring_size);
+    }
+    if (server->sqes) {
+        munmap(server->sqes, server->sqes_size);
+    }
+    if (server->ring_ptr) {
+        munmap(server->ring_ptr, server->ring_size);
+    }
+    if (server->ring_fd >= 0) {
+        close(server->ring_fd);
+    }
+
+    server->buffers  = NULL;
+    server->buf_ring = NULL;
+    server->sqes     = NULL;
+    server->ring_ptr = NULL;
+    server->ring_fd  = -1;
+}
+
+/**
+ * @brief 处理一个multishot recvmsg的完成事件
+ * @return bool 收到了报文返回true
+ */
+static bool dns_uring_on_recv(dns_uring_server_t *server, const struct io_uring_cqe *cqe)
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        server->recv_armed = false;
+    }
+
+    if (cqe->res < 0) {
+        // 缓冲区全部在途时内核会结束multishot，等发送完成归还缓冲区后重新提交
+        if (-ENOBUFS == cqe->res) {
+            server->no_buffers += 1;
+        } else {
+            dns_error_raise(DNS_ERROR_IO);
+        }
+        return false;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        return false;
+    }
+
+    uint16_t bid      = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    uint8_t *buf      = server->buffers + (size_t)bid * DNS_URING_BUFFER_SIZE;
+    size_t   headroom = sizeof(struct io_uring_recvmsg_out) + server->recv_msg.msg_namelen + server->recv_msg.msg_controllen;
+    size_t   size     = DNS_URING_BUFFER_SIZE - headroom;
+
+    struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)buf;
+    uint8_t *name    = buf + sizeof(struct io_uring_recvmsg_out);
+    uint8_t *payload = buf + headroom;
+    server->received += 1;
+
+    if ((out->flags & MSG_TRUNC) || out->payloadlen > size || out->namelen > server->recv_msg.msg_namelen) {
+        server->dropped += 1;
+        dns_uring_buffer_recycle(server, bid);
+        return true;
+    }
+
+    size_t response_len = server->handler(server->arg, payload, out->payloadlen, size, (struct sockaddr *)name, out->namelen);
+    if (response_len < 1 || response_len > size) {
+        dns_uring_buffer_recycle(server, bid);
+        return true;
+    }
+
+    // 响应直接从接收缓冲区发出，发送完成后再归还
+    struct io_uring_sqe *sqe = dns_uring_get_sqe(server);
+    if (NULL == sqe) {
+        server->dropped += 1;
+        dns_uring_buffer_recycle(server, bid);
+        return true;
+    }
+
+    struct msghdr *msg = &server->send_msg[bid];
+    struct iovec  *iov = &server->send_iov[bid];
+    iov->iov_base = payload;
+    iov->iov_len  = response_len;
+    memset(msg, 0, sizeof(struct msghdr));
+    msg->msg_name    = name;
+    msg->msg_namelen = out->namelen;
+    msg->msg_iov     = iov;
+    msg->msg_iovlen  = 1;
+
+    sqe->opcode    = IORING_OP_SENDMSG;
+    sqe->fd        = server->fd;
+    sqe->addr      = (uint64_t)(uintptr_t)msg;
+    sqe->len       = 1;
+    sqe->user_data = (DNS_URING_OP_SEND << 32) | bid;
+    return true;
+}
+
+int dns_uring_server_poll(dns_uring_server_t *server, int timeout_ms)
+{
+    if (NULL == server || server->ring_fd < 0) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return -1;
+    }
+
+    if (!server->recv_armed && dns_uring_arm_recv(server) == false) {
+        return -1;
+    }
+
+    // 一次系统调用同时提交积压的发送并等待完成事件
+    struct __kernel_timespec        ts  = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000LL};
+    struct io_uring_getevents_arg   arg = {0, 0, 0, (uint64_t)(uintptr_t)&ts};
+    int n = dns_uring_enter(server->ring_fd, server->to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (n < 0 && ETIME != errno && EINTR != errno) {
+        dns_error_raise(DNS_ERROR_IO);
+        return -1;
+    }
+    if (n > 0) {
+        server->to_submit -= (unsigned)n < server->to_submit ? (unsigned)n : server->to_submit;
+    }
+
+    int      received = 0;
+    unsigned head     = *server->cq_head;
+    unsigned tail     = __atomic_load_n(server->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &server->cqes[head & server->cq_mask];
+        if (DNS_URING_OP_RECV == cqe->user_data) {
+            received += dns_uring_on_recv(server, cqe) ? 1 : 0;
+            continue;
+        }
+
+        if (cqe->res < 0) {
+            server->dropped += 1;
+        } else {
+            server->sent += 1;
+        }
+        dns_uring_buffer_recycle(server, cqe->user_data & 0xFFFF);
+    }
+    __atomic_store_n(server->cq_head, head, __ATOMIC_RELEASE);
+    dns_uring_buffer_publish(server);
+
+    return received;
+}
+
+bool dns_uring_server_run(dns_uring_server_t *server)
+{
+    if (NULL == server) {
+        dns_error_raise(DNS_ERROR_INVALID_PARAM);
+        return false;
+    }
+
+    while (atomic_load_explicit(&server->running, memory_order_relaxed)) {
+        if (dns_uring_server_poll(server, DNS_UDP_POLL_MS) < 0) {
+            atomic_store(&server->running, false);
+            return false;
+        }
+    }
+
+    // 退出前把已经生成的响应发出去
+    return dns_uring_submit(server);
+}
+
+void dns_uring_server_stop(dns_uring_server_t *server)
+{
+    if (NULL == server) {
+        return;
+    }
+
+    atomic_store(&server->running, false);
+}
+
+#ifdef DNS_URING_SERVER_TEST
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "dns_flags.h"
+#include "dns_message.h"
+
+static size_t test_handler(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len)
+{
+    (void)arg;
+    (void)peer;
+    (void)peer_len;
+
+    uint8_t       arena[2048];
+    dns_message_t msg;
+    dns_message_init_arena(&msg, arena, sizeof(arena));
+    if (dns_message_deserialize(&msg, packet, len) < 1 || dns_message_count(&msg, DNS_SECTION_QUESTION) != 1) {
+        return 0;
+    }
+
+    uint8_t      ip[] = {192, 0, 2, 2};
+    dns_answer_t answer;
+    dns_answer_init(&answer);
+    answer.rname   = dns_message_get_question(&msg, 0)->qname;
+    answer.rtype   = DNS_TYPE_A;
+    answer.rclass  = DNS_CLASS_IN;
+    answer.rttl    = 60;
+    answer.rdata   = ip;
+    answer.rlength = sizeof(ip);
+    dns_message_add_answer(&msg, &answer);
+    dns_flags_set_qr(&msg.header.flags, DNS_QR_RESPONSE);
+
+    int response_len = dns_message_serialize(&msg, packet, size);
+    return response_len > 0 ? response_len : 0;
+}
+
+typedef struct {
+    int                 fd;
+    dns_uring_server_t *server;
+    atomic_int          ready;  // 1: 已初始化, -1: 不可用
+    dns_error_t         error;
+} test_context_t;
+
+static void *test_server_thread(void *arg)
+{
+    test_context_t *ctx = (test_context_t *)arg;
+
+    // SINGLE_ISSUER/DEFER_TASKRUN要求创建、提交和收割都在同一个线程
+    if (dns_uring_server_init(ctx->server, ctx->fd, test_handler, NULL) == false) {
+        ctx->error = dns_error_last();
+        atomic_store(&ctx->ready, -1);
+        return NULL;
+    }
+
+    atomic_store(&ctx->ready, 1);
+    dns_uring_server_run(ctx->server);
+    return NULL;
+}
+
+int main(void)
+{
+    int fd = dns_udp_socket_open("127.0.0.1", 0, false);
+    if (fd < 0) {
+        printf("dns_udp_socket_open failed\n");
+        return 1;
+    }
+
+    test_context_t ctx;
+    ctx.fd     = fd;
+    ctx.server = (dns_uring_server_t *)malloc(sizeof(dns_uring_server_t));
+    atomic_init(&ctx.ready, 0);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_thread, &ctx);
+    while (0 == atomic_load(&ctx.ready)) {
+        usleep(1000);
+    }
+
+    dns_uring_server_t *server = ctx.server;
+    if (atomic_load(&ctx.ready) < 0) {
+        // 容器或老内核可能禁止io_uring，此时服务应当退回dns_udp_server
+        printf("io_uring unavailable (%s), skipped\n", dns_error_name(ctx.error));
+        pthread_join(thread, NULL);
+        free(server);
+        close(fd);
+        return 0;
+    }
+
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(dns_udp_socket_port(fd));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const int queries = 100;
+    for (int i = 0; i < queries; i++) {
+        dns_message_t  msg;
+        dns_question_t question;
+        uint8_t        buf[512];
+        dns_message_init(&msg);
+        dns_header_set_id(&msg.header, i);
+        dns_question_init(&question);
+        dns_question_set_qname(&question, "uring.example.com");
+        dns_question_set_qtype(&question, DNS_TYPE_A);
+        dns_question_set_qclass(&question, DNS_CLASS_IN);
+        dns_message_add_question(&msg, &question);
+        dns_question_clear(&question);
+        int len = dns_message_serialize(&msg, buf, sizeof(buf));
+        dns_message_clear(&msg);
+        sendto(client, buf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
+
+    struct timeval tv = {2, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int     answered = 0;
+    uint8_t seen[100] = {0};
+    for (int i = 0; i < queries; i++) {
+        uint8_t buf[512];
+        ssize_t len = recv(client, buf, sizeof(buf), 0);
+        if (len < 0) {
+            break;
+        }
+
+        dns_message_t msg;
+        dns_message_init(&msg);
+        if (dns_message_deserialize(&msg, buf, len) > 0
+        &&  dns_message_count(&msg, DNS_SECTION_ANSWER) == 1
+        &&  msg.header.id < queries
+        &&  !seen[msg.header.id]) {
+            seen[msg.header.id] = 1;
+            answered += 1;
+        }
+        dns_message_clear(&msg);
+    }
+
+    dns_uring_server_stop(server);
+    pthread_join(thread, NULL);
+
+    printf("queries=%d answered=%d received=%llu sent=%llu dropped=%llu no_buffers=%llu\n",
+           queries,
+           answered,
+           (unsigned long long)server->received,
+           (unsigned long long)server->sent,
+           (unsigned long long)server->dropped,
+           (unsigned long long)server->no_buffers);
+
+    dns_uring_server_clear(server);
+    free(server);
+    close(client);
+    close(fd);
+    return answered == queries ? 0 : 1;
+}
+#endif  // DNS_URING_SERVER_TEST
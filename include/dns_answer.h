@@ -4,12 +4,16 @@
 #include <stdint.h>
 
 #include "dns_class.h"
+#include "dns_name.h"
 #include "dns_type.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// 包含域名的资源数据展开后的最大长度（SOA：两个名称加20字节定长字段）
+#define DNS_ANSWER_RDATA_NAME_MAX (2 * 255 + 20)
+
 // DNS资源记录结构体
 typedef struct {
     char    *rname;    // 域名，通常为压缩格式
@@ -163,6 +167,18 @@ bool dns_answer_copy(dns_answer_t *dst, const dns_answer_t *src);;
 int  dns_answer_serialize(const dns_answer_t *answer, uint8_t *buf, size_t buf_size);
 ;
 
+/**
+ * @brief 把资源记录写入报文，名称及NS/CNAME/PTR/MX/SOA等类型资源数据中的名称可以压缩
+ * @param[in] answer 资源记录结构体指针
+ * @param[in,out] table 名称压缩表，为NULL时不压缩
+ * @param[out] msg 报文缓冲区
+ * @param[in] msg_size 报文缓冲区大小
+ * @param[in] offset 资源记录写入的偏移
+ * @return int 写入的字节数，失败返回0
+ */
+int dns_answer_pack(const dns_answer_t *answer, dns_name_table_t *table, uint8_t *msg, size_t msg_size, size_t offset);
+;
+
 /**
  * @brief DNS资源记录反序列化
  * @param[out] answer 资源记录结构体指针
@@ -173,6 +189,48 @@ int  dns_answer_serialize(const dns_answer_t *answer, uint8_t *buf, size_t buf_s
 int dns_answer_deserialize(dns_answer_t *answer, const uint8_t *data, size_t data_len);
 ;
 
+/**
+ * @brief 从完整报文中反序列化资源记录，名称及资源数据中的压缩指针相对于整个报文解析
+ * @param[out] answer 资源记录结构体指针
+ * @param[in] msg 整个报文
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 资源记录在报文中的偏移
+ * @return int 反序列化消耗的数据长度，失败返回0
+ */
+int dns_answer_unpack(dns_answer_t *answer, const uint8_t *msg, size_t msg_len, size_t offset);
+;
+
+/**
+ * @brief 同dns_answer_unpack，但不分配内存：rname指向name_buf，
+ *        不含名称的资源数据直接指向报文，含名称的展开到rdata_buf中
+ * @note 得到的资源记录不拥有rname和rdata，不能对其调用dns_answer_clear
+ * @param[out] answer 资源记录结构体指针
+ * @param[in] msg 整个报文
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 资源记录在报文中的偏移
+ * @param[out] name_buf 存放展开后名称的缓冲区
+ * @param[in] name_buf_size 缓冲区大小，DNS_NAME_MAX_LENGTH即可
+ * @param[out] rdata_buf 存放展开后资源数据的缓冲区
+ * @param[in] rdata_buf_size 缓冲区大小，DNS_ANSWER_RDATA_NAME_MAX即可
+ * @return int 反序列化消耗的数据长度，失败返回0
+ */
+int dns_answer_unpack_to(dns_answer_t *answer, const uint8_t *msg, size_t msg_len, size_t offset, char *name_buf, size_t name_buf_size, uint8_t *rdata_buf, size_t rdata_buf_size);
+;
+
+/**
+ * @brief 展开资源数据，NS/CNAME/PTR/MX/SOA等类型中的压缩名称会被还原为完整名称
+ * @param[in] rtype 资源记录类型
+ * @param[in] msg 整个报文
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 资源数据在报文中的偏移
+ * @param[in] rlength 资源数据在报文中的长度
+ * @param[out] buf 展开后的资源数据
+ * @param[in] buf_size buf长度，包含名称的类型DNS_ANSWER_RDATA_NAME_MAX即可
+ * @return int 展开后的资源数据长度，失败返回-1
+ */
+int dns_answer_unpack_rdata(uint16_t rtype, const uint8_t *msg, size_t msg_len, size_t offset, uint16_t rlength, uint8_t *buf, size_t buf_size);
+;
+
 /**
  * @brief 将资源记录转换为字符串
  * @param answer 资源记录结构体指针
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_ARENA_ALIGN 8 // 每次分配的对齐字节数
+
+/**
+ * @brief 线性（bump）分配器，所有内存来自调用者提供的一块缓冲区
+ * @param buf  : 缓冲区
+ * @param size : 缓冲区大小
+ * @param used : 已分配的字节数
+ * @param last : 最近一次分配的起始偏移，用于原地扩展
+ * @note 不能单独释放，只能通过dns_arena_reset整体回收
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t   size;
+    size_t   used;
+    size_t   last;
+} dns_arena_t;
+
+/**
+ * @brief 初始化分配器
+ * @param[out] arena 分配器
+ * @param[in] buf 缓冲区，生命周期必须长于分配器
+ * @param[in] size 缓冲区大小
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_arena_init(dns_arena_t *arena, void *buf, size_t size);
+
+/**
+ * @brief 回收全部内存，O(1)
+ * @param[in,out] arena 分配器
+ */
+void dns_arena_reset(dns_arena_t *arena);
+
+/**
+ * @brief 分配内存，按DNS_ARENA_ALIGN对齐
+ * @param[in,out] arena 分配器
+ * @param[in] size 需要的字节数
+ * @return void* 内存指针，空间不足返回NULL
+ */
+void *dns_arena_alloc(dns_arena_t *arena, size_t size);
+
+/**
+ * @brief 调整内存大小，ptr是最近一次分配时原地扩展，否则分配新内存并复制
+ * @param[in,out] arena 分配器
+ * @param[in] ptr 原内存指针，可以为NULL
+ * @param[in] old_size 原内存大小
+ * @param[in] new_size 新内存大小
+ * @return void* 内存指针，空间不足返回NULL，此时原内存保持不变
+ */
+void *dns_arena_realloc(dns_arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief 复制字符串
+ * @param[in,out] arena 分配器
+ * @param[in] str 字符串
+ * @return char* 复制后的字符串，空间不足返回NULL
+ */
+char *dns_arena_strdup(dns_arena_t *arena, const char *str);
+
+/**
+ * @brief 复制一段内存
+ * @param[in,out] arena 分配器
+ * @param[in] data 数据
+ * @param[in] size 数据长度
+ * @return void* 复制后的数据，空间不足返回NULL
+ */
+void *dns_arena_memdup(dns_arena_t *arena, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,141 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_reply.h"
+#include "dns_shard.h"
+#include "dns_timer_wheel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CACHE_SHARDS_MAX  DNS_SHARD_MAX // 分片数上限
+#define DNS_CACHE_RECORDS_MAX 256 // 一个RRset最多的记录数
+
+/**
+ * @brief 插入缓存的一条记录数据
+ * @param data   : 记录数据（线路格式），其中的名称不能使用压缩指针
+ * @param length : 记录数据长度
+ */
+typedef struct {
+    const uint8_t *data;
+    uint16_t       length;
+} dns_cache_rdata_t;
+
+/**
+ * @brief 一个缓存的RRset，名称和记录数据放在同一块内存中
+ * @param node      : 分片哈希表和LRU链表的节点，hash是键的哈希值
+ * @param timer     : 过期定时器，挂在所属分片的时间轮上
+ * @param expire    : 过期时间（秒），输出时的TTL为expire减去当前时间
+ * @param qtype     : 类型
+ * @param qclass    : 类
+ * @param count     : 记录数
+ * @param rdata_len : data中记录数据部分的长度，每条记录是2字节长度加数据
+ * @param name_len  : 小写的线路格式名称的长度
+ * @param data      : 名称，紧接着是记录数据
+ */
+typedef struct {
+    dns_shard_node_t node;
+    dns_timer_t      timer;
+    uint32_t         expire;
+    uint16_t         qtype;
+    uint16_t         qclass;
+    uint16_t         count;
+    uint16_t         rdata_len;
+    uint8_t          name_len;
+    uint8_t          data[];
+} dns_cache_entry_t;
+
+/**
+ * @brief RRset缓存，按小写的线路格式名称、类型和类分片加锁
+ * @note 记录以线路格式保存，命中时直接追加到dns_reply_t，不经过dns_answer_t和dns_message_t；
+ *       TTL不在缓存中递减，而是输出时用过期时间减去当前时间；过期的条目由dns_cache_expire按时间轮
+ *       分批释放，不需要扫描整个缓存
+ * @param table       : 分片，统计中的expired包括查找时发现和由时间轮释放的条目
+ * @param wheels      : 各分片的时间轮，按过期时间排列该分片的所有条目，由同一个分片锁保护
+ * @param expire_next : 下一次dns_cache_expire开始的分片，轮流开始，预算小于分片数时靠后的分片也能释放
+ */
+typedef struct {
+    dns_shards_t       table;
+    dns_timer_wheel_t *wheels;
+    atomic_uint        expire_next;
+} dns_cache_t;
+
+/**
+ * @brief 缓存统计，各分片之和
+ */
+typedef dns_shard_stats_t dns_cache_stats_t;
+
+/**
+ * @brief 初始化缓存
+ * @param[out] cache 缓存
+ * @param[in] shards 分片数，向上取整到2的幂，不超过DNS_CACHE_SHARDS_MAX；一般取工作线程数的几倍
+ * @param[in] capacity 最多缓存的RRset数，平均分到各分片
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_cache_init(dns_cache_t *cache, uint32_t shards, uint32_t capacity);
+
+/**
+ * @brief 释放缓存的所有条目
+ * @param[in,out] cache 缓存
+ */
+void dns_cache_clear(dns_cache_t *cache);
+
+/**
+ * @brief 插入或替换一个RRset
+ * @param[in,out] cache 缓存
+ * @param[in] name 域名，点分格式，不区分大小写
+ * @param[in] qtype 类型
+ * @param[in] qclass 类
+ * @param[in] ttl 生存时间（秒），0表示不缓存
+ * @param[in] rdatas 记录数据
+ * @param[in] count 记录数，1到DNS_CACHE_RECORDS_MAX
+ * @param[in] now 当前时间（秒），查找时必须使用同一个时钟
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_cache_insert(dns_cache_t *cache, const char *name, uint16_t qtype, uint16_t qclass, uint32_t ttl,
+                      const dns_cache_rdata_t rdatas[], int count, uint32_t now);
+
+/**
+ * @brief 按响应中的问题查找缓存，命中时把RRset追加到回答段，TTL为剩余的生存时间
+ * @param[in,out] cache 缓存
+ * @param[in,out] reply 由dns_reply_init得到的响应，还没有追加过回答段之后的记录
+ * @param[in] now 当前时间（秒）
+ * @return int 追加的记录数，未命中或已过期返回0，缓冲区不足返回-1，响应不变
+ */
+int dns_cache_answer(dns_cache_t *cache, dns_reply_t *reply, uint32_t now);
+
+/**
+ * @brief 释放已过期的RRset，应该每个刻度（秒）调用一次，例如在维护线程或服务器的空闲回调中
+ * @note 每个分片只推进自己的时间轮，持锁时间与释放的条目数成正比；超出预算的过期条目留到下次调用，
+ *       在此之前查找也不会返回它们；每次从上一次停下的分片之后开始，预算小于分片数时各分片轮流释放
+ * @param[in,out] cache 缓存
+ * @param[in] now 当前时间（秒）
+ * @param[in] budget 本次最多释放的条目数，平均分到各分片
+ * @return int 释放的条目数
+ */
+int dns_cache_expire(dns_cache_t *cache, uint32_t now, int budget);
+
+/**
+ * @brief 删除一个RRset
+ * @param[in,out] cache 缓存
+ * @param[in] name 域名，点分格式
+ * @param[in] qtype 类型
+ * @param[in] qclass 类
+ * @return bool 删除返回true，不存在返回false
+ */
+bool dns_cache_remove(dns_cache_t *cache, const char *name, uint16_t qtype, uint16_t qclass);
+
+/**
+ * @brief 获取统计
+ * @param[in] cache 缓存
+ * @param[out] stats 统计
+ */
+void dns_cache_stats(dns_cache_t *cache, dns_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
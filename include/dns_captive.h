@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CAPTIVE_TTL 60 // 默认TTL，较短以便设备离开AP后尽快恢复正常解析
+
+/**
+ * @brief 强制门户（captive portal）应答器配置，所有A查询都应答为网关地址
+ * @param ip  : 网关IPv4地址，网络字节序
+ * @param ttl : 应答的TTL
+ */
+typedef struct {
+    uint8_t  ip[4];
+    uint32_t ttl;
+} dns_captive_t;
+
+/**
+ * @brief 初始化应答器配置
+ * @param[out] captive 配置
+ * @param[in] ip 网关IPv4地址，网络字节序，如{192, 168, 4, 1}
+ * @param[in] ttl 应答的TTL
+ */
+void dns_captive_init(dns_captive_t *captive, const uint8_t ip[4], uint32_t ttl);
+
+/**
+ * @brief 用dns_reply把查询原地改写为响应，不分配内存、不使用标准IO，适合在小设备上逐包调用
+ * @note 响应置QR/AA/RA，保留ID/OPCODE/RD，截断到问题段之后：
+ *       IN类的A查询追加一条用压缩指针指向问题名称的A记录，其它类型返回NODATA，
+ *       非IN类返回REFUSED，问题数不为1返回FORMERR，非标准查询返回NOTIMP
+ * @param[in] captive 配置
+ * @param[in,out] packet 报文缓冲区，进入时是查询，返回时是响应
+ * @param[in] len 查询长度
+ * @param[in] size 缓冲区大小
+ * @return size_t 响应长度，报文不是查询、头部不完整或缓冲区不足时返回0，表示不回复
+ */
+size_t dns_captive_respond(const dns_captive_t *captive, uint8_t *packet, size_t len, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
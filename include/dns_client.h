@@ -0,0 +1,152 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_CLIENT_QUERY_SIZE    288  // 头部12 + 最长问题259 + EDNS OPT 11，向上取整
+#define DNS_CLIENT_RESPONSE_SIZE 4096 // 接收缓冲区大小，大于通告的EDNS载荷大小，服务器超出通告时也能完整收下
+#define DNS_CLIENT_EDNS_SIZE     1232 // 通告给服务器的UDP载荷大小
+#define DNS_CLIENT_RECV_BATCH    64   // 每次poll最多收取的响应数
+
+/**
+ * @brief 查询结束的原因
+ * @param DNS_CLIENT_OK      : 收到匹配的响应（包括TC=1的截断响应，需要时由调用者改用TCP）
+ * @param DNS_CLIENT_TIMEOUT : 超过总超时仍没有响应
+ * @param DNS_CLIENT_ERROR   : 发送失败
+ */
+typedef enum {
+    DNS_CLIENT_OK      = 0,
+    DNS_CLIENT_TIMEOUT = 1,
+    DNS_CLIENT_ERROR   = 2
+} dns_client_status_t;
+
+/**
+ * @brief 查询结束时的回调，每个查询正好调用一次
+ * @param arg 调用者的参数
+ * @param status 结束原因
+ * @param response 响应报文，status不为DNS_CLIENT_OK时为NULL，只在回调期间有效
+ * @param len 响应长度
+ */
+typedef void (*dns_client_callback_t)(void *arg, dns_client_status_t status, const uint8_t *response, size_t len);
+
+/**
+ * @brief 一个未完成的查询
+ * @param callback     : 结束回调，NULL表示槽位空闲
+ * @param arg          : 回调参数
+ * @param query        : 已序列化的查询，重传时原样发送
+ * @param len          : 查询长度
+ * @param question_len : 问题段的长度，用于与响应中的问题比较
+ * @param deadline     : 总超时的时刻（毫秒）
+ * @param retransmit   : 下一次重传的时刻（毫秒）
+ * @param rto          : 当前重传间隔，每次重传加倍
+ * @param attempts     : 已发送次数
+ */
+typedef struct {
+    dns_client_callback_t callback;
+    void                 *arg;
+    uint8_t               query[DNS_CLIENT_QUERY_SIZE];
+    uint16_t              len;
+    uint16_t              question_len;
+    uint64_t              deadline;
+    uint64_t              retransmit;
+    uint32_t              rto;
+    uint32_t              attempts;
+} dns_client_query_t;
+
+/**
+ * @brief 异步存根解析器，在一个UDP套接字上复用大量并发查询，单线程使用
+ * @param fd          : 已连接到服务器的UDP套接字，只接收来自服务器的报文
+ * @param max_pending : 最多同时未完成的查询数，不超过65535
+ * @param rto_ms      : 首次重传间隔
+ * @param timeout_ms  : 每个查询的总超时
+ * @param queries     : 查询槽位
+ * @param free_slots  : 空闲槽位栈
+ * @param free_count  : 空闲槽位数
+ * @param by_id       : 按事务ID索引的槽位号加一，0表示该ID未使用
+ * @param next_timer  : 最早的重传或超时时刻，未到时不扫描槽位
+ * @param rand_state  : 生成事务ID的随机数状态
+ * @param response    : 接收缓冲区
+ * @param sent/retransmits/received/mismatched/timeouts : 统计
+ */
+typedef struct {
+    int                 fd;
+    int                 max_pending;
+    uint32_t            rto_ms;
+    uint32_t            timeout_ms;
+    dns_client_query_t *queries;
+    uint16_t           *free_slots;
+    int                 free_count;
+    uint16_t           *by_id;
+    uint64_t            next_timer;
+    uint64_t            rand_state;
+    uint8_t             response[DNS_CLIENT_RESPONSE_SIZE];
+    uint64_t            sent;
+    uint64_t            retransmits;
+    uint64_t            received;
+    uint64_t            mismatched;
+    uint64_t            timeouts;
+} dns_client_t;
+
+/**
+ * @brief 初始化客户端并连接服务器
+ * @param[out] client 客户端
+ * @param[in] ip 服务器地址，IPv4或IPv6的文本格式
+ * @param[in] port 服务器端口
+ * @param[in] max_pending 最多同时未完成的查询数
+ * @param[in] rto_ms 首次重传间隔（毫秒），之后每次加倍
+ * @param[in] timeout_ms 每个查询的总超时（毫秒）
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_client_init(dns_client_t *client, const char *ip, uint16_t port, int max_pending, uint32_t rto_ms, uint32_t timeout_ms);
+
+/**
+ * @brief 关闭套接字并释放资源，未完成的查询不再回调
+ * @param[in,out] client 客户端
+ */
+void dns_client_clear(dns_client_t *client);
+
+/**
+ * @brief 发出一个查询，问题已是报文格式（编码后的名称+类型+类）
+ * @param[in,out] client 客户端
+ * @param[in] question 问题
+ * @param[in] question_len 问题长度
+ * @param[in] callback 结束回调
+ * @param[in] arg 回调参数
+ * @return bool 已发出返回true，参数非法或没有空闲槽位返回false，此时不会回调
+ */
+bool dns_client_query(dns_client_t *client, const uint8_t *question, size_t question_len, dns_client_callback_t callback, void *arg);
+
+/**
+ * @brief 按名称发出一个查询
+ * @param[in,out] client 客户端
+ * @param[in] name 域名，如"www.example.com"
+ * @param[in] qtype 查询类型
+ * @param[in] qclass 查询类
+ * @param[in] callback 结束回调
+ * @param[in] arg 回调参数
+ * @return bool 已发出返回true，失败返回false，此时不会回调
+ */
+bool dns_client_resolve(dns_client_t *client, const char *name, uint16_t qtype, uint16_t qclass, dns_client_callback_t callback, void *arg);
+
+/**
+ * @brief 接收响应并处理到期的重传和超时，结束的查询在此调用回调
+ * @param[in,out] client 客户端
+ * @param[in] timeout_ms 没有事件时最多等待的毫秒数
+ * @return int 本次结束的查询数，出错返回-1
+ */
+int dns_client_poll(dns_client_t *client, int timeout_ms);
+
+/**
+ * @brief 获取未完成的查询数
+ * @param[in] client 客户端
+ * @return int 未完成的查询数
+ */
+int dns_client_pending(const dns_client_t *client);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 错误原因
+ * @param DNS_OK                     : 没有错误
+ * @param DNS_ERROR_INVALID_PARAM    : 参数非法
+ * @param DNS_ERROR_TRUNCATED        : 报文长度不足，记录超出报文范围
+ * @param DNS_ERROR_BUFFER_TOO_SMALL : 输出缓冲区不足
+ * @param DNS_ERROR_NAME_LABEL       : 名称中有保留的标签类型或标签内含0字节
+ * @param DNS_ERROR_NAME_TOO_LONG    : 名称超过255字节
+ * @param DNS_ERROR_NAME_POINTER     : 压缩指针越界、向后指向或跳转次数过多
+ * @param DNS_ERROR_RDATA            : 资源数据与其类型的格式不符
+ * @param DNS_ERROR_NO_MEMORY        : 内存分配失败
+ * @param DNS_ERROR_IO               : 套接字等系统调用失败，详细原因见errno
+ */
+typedef enum {
+    DNS_OK                     = 0,
+    DNS_ERROR_INVALID_PARAM    = 1,
+    DNS_ERROR_TRUNCATED        = 2,
+    DNS_ERROR_BUFFER_TOO_SMALL = 3,
+    DNS_ERROR_NAME_LABEL       = 4,
+    DNS_ERROR_NAME_TOO_LONG    = 5,
+    DNS_ERROR_NAME_POINTER     = 6,
+    DNS_ERROR_RDATA            = 7,
+    DNS_ERROR_NO_MEMORY        = 8,
+    DNS_ERROR_IO               = 9,
+    DNS_ERROR_MAX              = 10
+} dns_error_t;
+
+/**
+ * @brief 记录一次错误：写入本线程的最近错误并累加该原因的计数，不做任何IO
+ * @note 编译时定义DNS_ERROR_TRACE才会带上函数名和行号并调用跟踪钩子，
+ *       例如 -DDNS_ERROR_TRACE=dns_error_trace_print
+ */
+#ifdef DNS_ERROR_TRACE
+#define dns_error_raise(error) dns_error_raise_at((error), __func__, __LINE__)
+#else
+#define dns_error_raise(error) dns_error_raise_at((error), NULL, 0)
+#endif
+
+/**
+ * @brief 记录一次错误，一般通过dns_error_raise宏调用
+ * @param[in] error 错误原因
+ * @param[in] func 出错的函数，未开启跟踪时为NULL
+ * @param[in] line 出错的行号，未开启跟踪时为0
+ */
+void dns_error_raise_at(dns_error_t error, const char *func, int line);
+
+/**
+ * @brief 获取本线程最近一次的错误
+ * @return dns_error_t 错误原因，没有错误返回DNS_OK
+ */
+dns_error_t dns_error_last(void);
+
+/**
+ * @brief 清除本线程最近一次的错误
+ */
+void dns_error_clear(void);
+
+/**
+ * @brief 获取错误原因的名称
+ * @param[in] error 错误原因
+ * @return const char* 名称，未知的原因返回"unknown"
+ */
+const char *dns_error_name(dns_error_t error);
+
+/**
+ * @brief 获取某个原因累计发生的次数（所有线程）
+ * @param[in] error 错误原因
+ * @return uint64_t 次数
+ */
+uint64_t dns_error_count(dns_error_t error);
+
+/**
+ * @brief 清零所有原因的计数
+ */
+void dns_error_count_reset(void);
+
+/**
+ * @brief 跟踪钩子的参考实现，把错误打印到stderr
+ * @param[in] error 错误原因
+ * @param[in] func 出错的函数
+ * @param[in] line 出错的行号
+ */
+void dns_error_trace_print(dns_error_t error, const char *func, int line);
+
+#ifdef __cplusplus
+}
+#endif
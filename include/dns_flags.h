@@ -21,6 +21,7 @@ typedef enum {
     DNS_FLAGS_INDEX_RD     = 8 ,
     DNS_FLAGS_INDEX_RA     = 7 ,
     DNS_FLAGS_INDEX_ZERO   = 4 ,
+    DNS_FLAGS_INDEX_CD     = 4 , // zero字段的最低位，DNSSEC的CD位（RFC 4035）
     DNS_FLAGS_INDEX_RCODE  = 0
 } dns_flags_index_t;
 
@@ -0,0 +1,137 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "dns_client.h"
+#include "dns_name.h"
+#include "dns_udp_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_FORWARDER_BUCKETS     1024 // 在途查询表的桶数，必须是2的幂
+#define DNS_FORWARDER_WAITERS_MAX 256  // 同一问题最多合并的客户端数，超过的查询被丢弃
+#define DNS_FORWARDER_UDP_SIZE    512  // 没有EDNS的客户端可以接收的最大响应
+
+/**
+ * @brief 等待同一上游响应的一个客户端查询
+ * @param peer     : 客户端地址
+ * @param peer_len : 地址长度
+ * @param id       : 客户端查询的事务ID，回复时改写到响应中
+ * @param rd       : 客户端查询的RD位
+ * @param cd       : 客户端查询的CD位，回复时复制到响应中（RFC 4035 §3.2.2）
+ * @param udp_size : 客户端OPT通告的UDP负载大小（不小于512），0表示查询不带EDNS
+ * @param question : 客户端查询中的问题，保留原始大小写，回复时回显
+ */
+typedef struct {
+    struct sockaddr_storage peer;
+    socklen_t               peer_len;
+    uint16_t                id;
+    uint8_t                 rd;
+    uint8_t                 cd;
+    uint16_t                udp_size;
+    uint8_t                 question[DNS_NAME_MAX_LENGTH + 4];
+} dns_forwarder_waiter_t;
+
+typedef struct dns_forwarder dns_forwarder_t;
+
+/**
+ * @brief 一个在途的上游查询，按小写问题合并所有相同的客户端查询
+ * @param next      : 桶内链表的下一个
+ * @param forwarder : 所属的转发器
+ * @param hash      : 键的哈希值
+ * @param key_len   : 键长度
+ * @param key       : 小写的问题（名称+类型+类），也是发给上游的问题
+ * @param count     : 等待的客户端数
+ * @param capacity  : waiters的容量
+ * @param waiters   : 等待的客户端
+ */
+typedef struct dns_forwarder_entry {
+    struct dns_forwarder_entry *next;
+    dns_forwarder_t            *forwarder;
+    uint32_t                    hash;
+    uint16_t                    key_len;
+    uint8_t                     key[DNS_NAME_MAX_LENGTH + 4];
+    int                         count;
+    int                         capacity;
+    dns_forwarder_waiter_t     *waiters;
+} dns_forwarder_entry_t;
+
+/**
+ * @brief 转发器：在一个线程中接收客户端查询，合并相同的在途问题后转发给上游
+ * @param server    : 面向客户端的UDP服务器
+ * @param client    : 面向上游的存根解析器
+ * @param buckets   : 在途查询表
+ * @param inflight  : 在途的上游查询数
+ * @param reply     : 构造回复的缓冲区
+ * @param queries/coalesced/upstream/answered/servfail/dropped : 统计
+ */
+struct dns_forwarder {
+    dns_udp_server_t      *server;
+    dns_client_t           client;
+    dns_forwarder_entry_t *buckets[DNS_FORWARDER_BUCKETS];
+    int                    inflight;
+    uint8_t                reply[DNS_CLIENT_RESPONSE_SIZE];
+    uint64_t               queries;
+    uint64_t               coalesced;
+    uint64_t               upstream;
+    uint64_t               answered;
+    uint64_t               servfail;
+    uint64_t               dropped;
+};
+
+/**
+ * @brief 初始化转发器
+ * @param[out] forwarder 转发器
+ * @param[in] ip 本地监听地址
+ * @param[in] port 本地监听端口，0表示由系统分配
+ * @param[in] upstream_ip 上游服务器地址
+ * @param[in] upstream_port 上游服务器端口
+ * @param[in] max_pending 最多同时在途的上游查询数
+ * @param[in] rto_ms 上游查询的首次重传间隔
+ * @param[in] timeout_ms 上游查询的总超时，超时后回复SERVFAIL
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_forwarder_init(dns_forwarder_t *forwarder, const char *ip, uint16_t port, const char *upstream_ip, uint16_t upstream_port,
+                        int max_pending, uint32_t rto_ms, uint32_t timeout_ms);
+
+/**
+ * @brief 关闭套接字并释放资源，在途查询的客户端不再收到回复
+ * @param[in,out] forwarder 转发器
+ */
+void dns_forwarder_clear(dns_forwarder_t *forwarder);
+
+/**
+ * @brief 获取本地监听端口
+ * @param[in] forwarder 转发器
+ * @return uint16_t 端口，失败返回0
+ */
+uint16_t dns_forwarder_port(const dns_forwarder_t *forwarder);
+
+/**
+ * @brief 等待并处理客户端查询、上游响应和上游超时
+ * @param[in,out] forwarder 转发器
+ * @param[in] timeout_ms 没有事件时最多等待的毫秒数
+ * @return int 处理的事件数，出错返回-1
+ */
+int dns_forwarder_poll(dns_forwarder_t *forwarder, int timeout_ms);
+
+/**
+ * @brief 循环处理直到dns_forwarder_stop被调用
+ * @param[in,out] forwarder 转发器
+ * @return bool 正常停止返回true，出错返回false
+ */
+bool dns_forwarder_run(dns_forwarder_t *forwarder);
+
+/**
+ * @brief 通知dns_forwarder_run返回，可以在其它线程中调用
+ * @param[in,out] forwarder 转发器
+ */
+void dns_forwarder_stop(dns_forwarder_t *forwarder);
+
+#ifdef __cplusplus
+}
+#endif
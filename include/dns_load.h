@@ -0,0 +1,126 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_type.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_LOAD_QUERY_SIZE 288   // 单个预构建查询的最大长度
+#define DNS_LOAD_WINDOW     65536 // 在途查询窗口，等于事务ID空间
+#define DNS_LOAD_HIST_SUB   16    // 延迟直方图每个2的幂区间的子桶数，精度约6%
+#define DNS_LOAD_HIST_SIZE  (64 * DNS_LOAD_HIST_SUB)
+
+/**
+ * @brief 压测参数
+ * @param qps         : 目标发送速率，大于0时为开环模式，按固定速率发送而不等待响应
+ * @param concurrency : qps为0时为闭环模式，保持该数量的查询在途，收到一个响应再发下一个
+ * @param duration_ms : 发送持续时间
+ * @param timeout_ms  : 超过该时间没有响应的查询计为丢失
+ */
+typedef struct {
+    uint32_t qps;
+    uint32_t concurrency;
+    uint32_t duration_ms;
+    uint32_t timeout_ms;
+} dns_load_config_t;
+
+/**
+ * @brief 压测结果，延迟单位为纳秒
+ * @param sent        : 发出的查询数
+ * @param received    : 在超时前收到的响应数
+ * @param lost        : 超时未收到响应的查询数
+ * @param late        : 超时后才到达或ID不匹配的响应数
+ * @param duration_ns : 从第一个查询发出到最后一个响应或超时的时间
+ * @param qps         : 实际应答速率（received / duration）
+ * @param p50/p99/p999/max : 延迟分位数
+ */
+typedef struct {
+    uint64_t sent;
+    uint64_t received;
+    uint64_t lost;
+    uint64_t late;
+    uint64_t duration_ns;
+    double   qps;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} dns_load_result_t;
+
+/**
+ * @brief 负载生成器，查询预先用dns_message_serialize构建好，发送时只改写事务ID
+ * @param fd        : 已连接到目标的UDP套接字
+ * @param queries   : 预构建的查询，按顺序循环发送
+ * @param lens      : 每个查询的长度
+ * @param count     : 查询数
+ * @param capacity  : 查询数组的容量
+ * @param sent_at   : 按事务ID记录的发送时刻，0表示该ID不在途
+ * @param histogram : 延迟直方图
+ */
+typedef struct {
+    int       fd;
+    uint8_t (*queries)[DNS_LOAD_QUERY_SIZE];
+    uint16_t *lens;
+    int       count;
+    int       capacity;
+    uint64_t  sent_at[DNS_LOAD_WINDOW];
+    uint64_t  histogram[DNS_LOAD_HIST_SIZE];
+} dns_load_t;
+
+/**
+ * @brief 初始化负载生成器并连接目标
+ * @param[out] load 负载生成器，结构体较大，应当放在堆上
+ * @param[in] ip 目标地址，IPv4或IPv6的文本格式
+ * @param[in] port 目标端口
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_load_init(dns_load_t *load, const char *ip, uint16_t port);
+
+/**
+ * @brief 释放资源
+ * @param[in,out] load 负载生成器
+ */
+void dns_load_clear(dns_load_t *load);
+
+/**
+ * @brief 预构建一个查询，RD置位
+ * @param[in,out] load 负载生成器
+ * @param[in] name 域名
+ * @param[in] qtype 查询类型
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_load_add(dns_load_t *load, const char *name, dns_type_t qtype);
+
+/**
+ * @brief 从文件读取查询列表，每行一个"名称 [类型]"，类型可以是A/AAAA/MX等助记符或数字，缺省为A，#开头的行被忽略
+ * @param[in,out] load 负载生成器
+ * @param[in] path 文件路径
+ * @return int 读取的查询数，失败返回-1
+ */
+int dns_load_add_file(dns_load_t *load, const char *path);
+
+/**
+ * @brief 执行一次压测
+ * @param[in,out] load 负载生成器
+ * @param[in] config 压测参数
+ * @param[out] result 压测结果
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_load_run(dns_load_t *load, const dns_load_config_t *config, dns_load_result_t *result);
+
+/**
+ * @brief 将压测结果转换为字符串
+ * @param[in] result 压测结果
+ * @param[out] buf 缓冲区
+ * @param[in] buf_size 缓冲区大小
+ * @return const char* 返回buf
+ */
+const char *dns_load_result_to_string(const dns_load_result_t *result, char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,11 @@
 #pragma once
+#include <sys/uio.h>
+
 #include "dns_answer.h"
+#include "dns_arena.h"
+#include "dns_error.h"
 #include "dns_header.h"
+#include "dns_message_view.h"
 #include "dns_question.h"
 #include "dns_type.h"
 
@@ -8,16 +13,38 @@
 extern "C" {
 #endif
 
+// dns_message_serialize_iov中不超过该长度的资源数据直接复制，更长的通过iov引用
+#define DNS_MESSAGE_IOV_INLINE_MAX 16
+
 /**
  * @brief DNS消息定义
  * @param header DNS消息头
  * @param questions DNS查询列表，如果为空，则表示该消息为响应消息
  * @param ansers DNS响应列表，如果为空，则表示该消息为查询消息
+ * @param authorities 权威记录列表，如NS引用
+ * @param additionals 附加记录列表，如NS的glue地址、EDNS的OPT
+ * @param *_capacity 对应数组已分配的元素个数
+ * @param arena 分配器，buf为NULL时使用malloc/free，否则所有名称、资源数据和数组都从它分配
+ * @param lazy 延迟解码时原始报文的视图，记录各段的边界
+ * @param lazy_pending 还未解码的段，按(1 << dns_section_t)置位
+ * @param lazy_failed 延迟解码失败的段，按(1 << dns_section_t)置位，这些段不包含任何记录
+ * @param lazy_error 第一个失败的段的错误原因
  */
 typedef struct dns_message {
-    dns_header_t    header;
-    dns_question_t *questions;
-    dns_answer_t   *answers;
+    dns_header_t        header;
+    dns_question_t     *questions;
+    dns_answer_t       *answers;
+    dns_answer_t       *authorities;
+    dns_answer_t       *additionals;
+    uint16_t            questions_capacity;
+    uint16_t            answers_capacity;
+    uint16_t            authorities_capacity;
+    uint16_t            additionals_capacity;
+    dns_arena_t         arena;
+    dns_message_view_t  lazy;
+    uint8_t             lazy_pending;
+    uint8_t             lazy_failed;
+    dns_error_t         lazy_error;
 } dns_message_t;
 
 /**
@@ -29,6 +56,19 @@ typedef struct dns_message {
 bool dns_message_init(dns_message_t *message);
 ;
 
+/**
+ * @brief 使用调用者提供的缓冲区初始化DNS消息，之后消息的所有内存都从该缓冲区线性分配
+ * @note 加入消息的问题和资源记录属于缓冲区，不能对它们调用dns_question_clear/dns_answer_clear，
+ *       dns_message_clear只会重置分配器，是O(1)的
+ * @param message DNS消息
+ * @param buf 缓冲区，生命周期必须长于消息
+ * @param size 缓冲区大小
+ * @return true 成功
+ * @return false 失败
+ */
+bool dns_message_init_arena(dns_message_t *message, void *buf, size_t size);
+;
+
 /**
  * @brief 清空DNS消息
  * @param message DNS消息
@@ -58,6 +98,56 @@ bool dns_message_add_question(dns_message_t *message, const dns_question_t *ques
 bool dns_message_add_answer(dns_message_t *message, const dns_answer_t *answer);
 ;
 
+/**
+ * @brief 添加权威记录
+ * @param message DNS消息
+ * @param authority 权威记录
+ * @return true 成功
+ * @return false 失败
+ */
+bool dns_message_add_authority(dns_message_t *message, const dns_answer_t *authority);
+;
+
+/**
+ * @brief 添加附加记录
+ * @param message DNS消息
+ * @param additional 附加记录
+ * @return true 成功
+ * @return false 失败
+ */
+bool dns_message_add_additional(dns_message_t *message, const dns_answer_t *additional);
+;
+
+/**
+ * @brief 获取某个段中的记录数
+ * @note 延迟解码的段在这里解码；解码失败时返回0并通过dns_error_raise记录原因，
+ *       不会返回部分记录数，可以用dns_message_lazy_error区分空段和失败的段
+ * @param message DNS消息
+ * @param section 段
+ * @return uint16_t 记录数
+ */
+uint16_t dns_message_count(const dns_message_t *message, dns_section_t section);
+;
+
+/**
+ * @brief 获取问题段中的第index个问题
+ * @param message DNS消息
+ * @param index 序号
+ * @return const dns_question_t* 问题，越界返回NULL
+ */
+const dns_question_t *dns_message_get_question(const dns_message_t *message, uint16_t index);
+;
+
+/**
+ * @brief 获取回答/权威/附加段中的第index条资源记录
+ * @param message DNS消息
+ * @param section 段，不能是DNS_SECTION_QUESTION
+ * @param index 序号
+ * @return const dns_answer_t* 资源记录，越界返回NULL
+ */
+const dns_answer_t *dns_message_get_record(const dns_message_t *message, dns_section_t section, uint16_t index);
+;
+
 /**
  * @brief 序列化DNS消息
  * @param message DNS消息
@@ -68,6 +158,39 @@ bool dns_message_add_answer(dns_message_t *message, const dns_answer_t *answer);
 int dns_message_serialize(const dns_message_t *message, uint8_t *buffer, size_t buffer_size);
 ;
 
+/**
+ * @brief 压缩序列化DNS消息，重复出现的名称后缀用压缩指针代替（RFC 1035 4.1.4）
+ * @param message DNS消息
+ * @param buffer 序列化后的缓冲区
+ * @param buffer_size 缓冲区大小
+ * @return int 序列化后的字节数，如果返回0，则表示失败
+ */
+int dns_message_serialize_compressed(const dns_message_t *message, uint8_t *buffer, size_t buffer_size);
+;
+
+/**
+ * @brief 计算DNS消息不压缩序列化后的准确长度
+ * @param message DNS消息
+ * @return uint32_t dns_message_serialize写出的字节数，如果返回0，则表示消息不完整
+ */
+uint32_t dns_message_wire_length(const dns_message_t *message);
+;
+
+/**
+ * @brief 分散序列化DNS消息，供writev/sendmsg直接发送
+ * @note 头部、名称和定长字段写入scratch，超过DNS_MESSAGE_IOV_INLINE_MAX的资源数据
+ *       直接引用记录自己的缓冲区而不复制，发送完成前消息不能被修改或清空；
+ *       输出与dns_message_serialize完全一致
+ * @param message DNS消息
+ * @param scratch 存放头部、名称等数据的缓冲区
+ * @param scratch_size 缓冲区大小，dns_message_wire_length即可保证足够
+ * @param iov 输出的iovec数组
+ * @param iov_max iov数组的元素个数
+ * @return int 使用的iov个数，如果返回0，则表示失败
+ */
+int dns_message_serialize_iov(const dns_message_t *message, uint8_t *scratch, size_t scratch_size, struct iovec *iov, int iov_max);
+;
+
 /**
  * @brief 反序列化DNS消息
  * @param message DNS消息
@@ -78,6 +201,39 @@ int dns_message_serialize(const dns_message_t *message, uint8_t *buffer, size_t
 int dns_message_deserialize(dns_message_t *message, const uint8_t *data, size_t data_len);
 ;
 
+/**
+ * @brief 延迟反序列化DNS消息：校验并记录所有段的边界，只解码头部和问题段
+ * @note 回答/权威/附加段在第一次通过dns_message_count、dns_message_get_record访问时才解码，
+ *       头部中的计数在此之前保持报文中的值；在所有段解码或消息清空之前data必须保持有效，
+ *       需要提前释放data时先调用dns_message_materialize。首次访问会修改消息，
+ *       同一个消息不能在多个线程中同时首次访问
+ * @param message DNS消息，必须是刚初始化或已清空的
+ * @param data 报文
+ * @param data_len 报文长度
+ * @return int 报文的有效长度，如果返0，则表示失败
+ */
+int dns_message_deserialize_lazy(dns_message_t *message, const uint8_t *data, size_t data_len);
+;
+
+/**
+ * @brief 立即解码延迟反序列化中还未解码的段，之后消息不再引用原始报文
+ * @param message DNS消息
+ * @return true 成功
+ * @return false 失败，失败的段不包含任何记录，序列化该消息也会失败
+ */
+bool dns_message_materialize(dns_message_t *message);
+;
+
+/**
+ * @brief 获取延迟解码的错误，还未解码的段先解码
+ * @note 延迟反序列化只校验段边界，压缩指针和资源数据中的名称在解码时才校验，
+ *       返回DNS_OK时消息与dns_message_deserialize得到的相同
+ * @param message DNS消息
+ * @return dns_error_t 没有错误返回DNS_OK，否则返回第一个失败的段的错误
+ */
+dns_error_t dns_message_lazy_error(const dns_message_t *message);
+;
+
 /**
  * @brief 将DNS消息打印为字符串
  * @param message DNS消息
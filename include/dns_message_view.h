@@ -0,0 +1,184 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief DNS消息的四个段
+ * @param DNS_SECTION_QUESTION   : 问题段
+ * @param DNS_SECTION_ANSWER     : 回答段
+ * @param DNS_SECTION_AUTHORITY  : 权威段
+ * @param DNS_SECTION_ADDITIONAL : 附加段
+ */
+typedef enum {
+    DNS_SECTION_QUESTION   = 0,
+    DNS_SECTION_ANSWER     = 1,
+    DNS_SECTION_AUTHORITY  = 2,
+    DNS_SECTION_ADDITIONAL = 3,
+    DNS_SECTION_MAX        = 4
+} dns_section_t;
+
+/**
+ * @brief DNS消息视图，只记录偏移和长度，数据仍然指向调用者的缓冲区
+ * @param data           : 报文数据，视图有效期间调用者必须保证其不被释放或修改
+ * @param len            : 报文长度
+ * @param header         : 已解析的DNS头部
+ * @param section_offset : 各段第一个记录在报文中的偏移
+ * @param end_offset     : 最后一个记录结束的偏移
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t         len;
+    dns_header_t   header;
+    uint16_t       section_offset[DNS_SECTION_MAX];
+    uint16_t       end_offset;
+} dns_message_view_t;
+
+/**
+ * @brief DNS查询问题视图
+ * @param name_offset : 名称在报文中的偏移
+ * @param name_length : 名称在报文中占用的字节数（压缩指针只计2字节）
+ * @param qtype       : 查询类型
+ * @param qclass      : 查询类
+ */
+typedef struct {
+    uint16_t name_offset;
+    uint16_t name_length;
+    uint16_t qtype;
+    uint16_t qclass;
+} dns_question_view_t;
+
+/**
+ * @brief DNS资源记录视图
+ * @param name_offset  : 名称在报文中的偏移
+ * @param name_length  : 名称在报文中占用的字节数（压缩指针只计2字节）
+ * @param rtype        : 资源记录类型
+ * @param rclass       : 资源记录类
+ * @param rttl         : 生存时间
+ * @param rdata_offset : 资源数据在报文中的偏移
+ * @param rlength      : 资源数据长度
+ */
+typedef struct {
+    uint16_t name_offset;
+    uint16_t name_length;
+    uint16_t rtype;
+    uint16_t rclass;
+    uint32_t rttl;
+    uint16_t rdata_offset;
+    uint16_t rlength;
+} dns_answer_view_t;
+
+/**
+ * @brief 段迭代器
+ * @param view    : 所属的消息视图
+ * @param section : 正在迭代的段
+ * @param index   : 下一个记录的序号
+ * @param count   : 该段的记录数
+ * @param offset  : 下一个记录在报文中的偏移
+ */
+typedef struct {
+    const dns_message_view_t *view;
+    dns_section_t             section;
+    uint16_t                  index;
+    uint16_t                  count;
+    uint16_t                  offset;
+} dns_view_iter_t;
+
+#define DNS_BATCH_MAX      64 // 一次批量解码的最大报文数
+#define DNS_BATCH_PREFETCH 4  // 批量解码时提前预取的报文数
+
+/**
+ * @brief 批量解码结果，按字段分别存放（SoA），下标与输入报文一一对应
+ * @param count        : 本批的报文数
+ * @param valid        : 头部和第一个问题完整时为1，否则为0，其余字段无意义
+ * @param id           : 事务ID
+ * @param flags        : 头部标志
+ * @param qdcount      : 问题数
+ * @param qtype        : 第一个问题的类型
+ * @param qclass       : 第一个问题的类
+ * @param qname_offset : 第一个问题名称在报文中的偏移
+ * @param qname_length : 第一个问题名称在报文中占用的字节数
+ */
+typedef struct {
+    uint16_t count;
+    uint8_t  valid[DNS_BATCH_MAX];
+    uint16_t id[DNS_BATCH_MAX];
+    uint16_t flags[DNS_BATCH_MAX];
+    uint16_t qdcount[DNS_BATCH_MAX];
+    uint16_t qtype[DNS_BATCH_MAX];
+    uint16_t qclass[DNS_BATCH_MAX];
+    uint16_t qname_offset[DNS_BATCH_MAX];
+    uint16_t qname_length[DNS_BATCH_MAX];
+} dns_message_batch_t;
+
+/**
+ * @brief 解析报文为消息视图，校验所有段的边界，不分配内存也不复制数据
+ * @param[out] view 消息视图
+ * @param[in] data 报文数据
+ * @param[in] data_len 报文长度，不能超过65535
+ * @return bool 报文合法返回true，否则返回false
+ */
+bool dns_message_view_parse(dns_message_view_t *view, const uint8_t *data, size_t data_len);
+
+/**
+ * @brief 获取某个段的记录数
+ * @param[in] view 消息视图
+ * @param[in] section 段
+ * @return uint16_t 记录数
+ */
+uint16_t dns_message_view_count(const dns_message_view_t *view, dns_section_t section);
+
+/**
+ * @brief 初始化段迭代器
+ * @param[in] view 消息视图
+ * @param[in] section 要迭代的段
+ * @param[out] iter 迭代器
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_message_view_iter_init(const dns_message_view_t *view, dns_section_t section, dns_view_iter_t *iter);
+
+/**
+ * @brief 取出问题段的下一个问题
+ * @param[in,out] iter 迭代器，必须是问题段的迭代器
+ * @param[out] question 问题视图
+ * @return bool 取到返回true，迭代结束或出错返回false
+ */
+bool dns_message_view_next_question(dns_view_iter_t *iter, dns_question_view_t *question);
+
+/**
+ * @brief 取出回答/权威/附加段的下一个资源记录
+ * @param[in,out] iter 迭代器，不能是问题段的迭代器
+ * @param[out] answer 资源记录视图
+ * @return bool 取到返回true，迭代结束或出错返回false
+ */
+bool dns_message_view_next_answer(dns_view_iter_t *iter, dns_answer_view_t *answer);
+
+/**
+ * @brief 获取资源记录数据的指针，指向原始报文
+ * @param[in] view 消息视图
+ * @param[in] answer 资源记录视图
+ * @return const uint8_t* 资源数据指针，失败返回NULL
+ */
+const uint8_t *dns_message_view_rdata(const dns_message_view_t *view, const dns_answer_view_t *answer);
+
+/**
+ * @brief 批量解码一次收包得到的多个报文的头部和第一个问题，不复制数据
+ * @note 只校验头部和第一个问题，需要其余段时再对单个报文调用dns_message_view_parse；
+ *       循环中提前预取后面的报文，隐藏逐个解码时的缓存缺失
+ * @param[out] batch 解码结果
+ * @param[in] packets 报文指针数组
+ * @param[in] lens 报文长度数组
+ * @param[in] n 报文数，不能超过DNS_BATCH_MAX
+ * @return int 有效报文数，参数非法返回-1
+ */
+int dns_message_deserialize_batch(dns_message_batch_t *batch, const uint8_t *const packets[], const size_t lens[], int n);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,23 @@
 extern "C" {
 #endif
 
+#define DNS_NAME_MAX_LENGTH 255 // 编码后名称的最大长度（含结尾的0）
+#define DNS_NAME_MAX_LABEL  63  // 单个标签的最大长度
+#define DNS_NAME_MAX_HOPS   32  // 解压一个名称最多跟随的压缩指针数
+#define DNS_NAME_TABLE_SIZE 128 // 压缩表的槽位数，必须是2的幂
+
+/**
+ * @brief 名称压缩表，记录一个报文中已经写出的名称后缀及其偏移
+ * @param hash   : 后缀的哈希值（大小写不敏感）
+ * @param offset : 后缀在报文中的偏移，0表示空槽
+ * @param count  : 已使用的槽位数
+ */
+typedef struct {
+    uint32_t hash[DNS_NAME_TABLE_SIZE];
+    uint16_t offset[DNS_NAME_TABLE_SIZE];
+    uint16_t count;
+} dns_name_table_t;
+
 /**
  * @brief DNS 域名编码
  * @param[in] name 域名
@@ -34,6 +51,46 @@ const char *dns_name_decode(const char *data, char *buf, size_t buf_size);
  */
 const char *dns_name_encoded_string(const char *name, char *buf, size_t buf_len);
 
+/**
+ * @brief 跳过报文中的一个名称，不跟随压缩指针
+ * @param[in] msg 整个报文
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 名称在报文中的偏移
+ * @return int 名称在报文中占用的字节数（压缩指针计2字节），失败返回0
+ */
+int dns_name_skip(const uint8_t *msg, size_t msg_len, size_t offset);
+
+/**
+ * @brief 从报文中解出一个名称，跟随RFC 1035的压缩指针
+ * @note 单次遍历，压缩指针必须严格向前（指向更小的偏移），最多跟随DNS_NAME_MAX_HOPS次，
+ *       因此不会出现循环；名称以编码格式（不含压缩指针，以0结尾）写入buf
+ * @param[in] msg 整个报文，压缩指针相对于它解析
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 名称在报文中的偏移
+ * @param[out] buf 展开后的编码格式名称
+ * @param[in] buf_size buf长度，DNS_NAME_MAX_LENGTH即可容纳任何合法名称
+ * @param[out] name_len 展开后名称的长度（不含结尾的0），可以为NULL
+ * @return int 名称在报文中占用的字节数，失败返回0
+ */
+int dns_name_unpack(const uint8_t *msg, size_t msg_len, size_t offset, char *buf, size_t buf_size, size_t *name_len);
+
+/**
+ * @brief 初始化名称压缩表，每个报文序列化前都需要重新初始化
+ * @param[out] table 名称压缩表
+ */
+void dns_name_table_init(dns_name_table_t *table);
+
+/**
+ * @brief 把编码格式的名称写入报文，已经写过的后缀用压缩指针代替
+ * @param[in,out] table 名称压缩表，为NULL时不压缩
+ * @param[in] name 编码格式的名称（不含压缩指针，以0结尾）
+ * @param[out] msg 报文缓冲区，压缩指针相对于它计算
+ * @param[in] msg_size 报文缓冲区大小
+ * @param[in] offset 名称写入的偏移
+ * @return int 写入的字节数，失败返回0
+ */
+int dns_name_pack(dns_name_table_t *table, const char *name, uint8_t *msg, size_t msg_size, size_t offset);
+
 #ifdef __cplusplus
 }
 #endif
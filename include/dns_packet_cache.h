@@ -0,0 +1,127 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_name.h"
+#include "dns_shard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_PACKET_CACHE_SHARDS_MAX DNS_SHARD_MAX // 分片数上限
+#define DNS_PACKET_CACHE_TTLS_MAX   256  // 一个响应中最多记录的TTL位置，超过的响应不缓存
+#define DNS_PACKET_CACHE_KEY_MAX    (DNS_NAME_MAX_LENGTH + 5) // 问题（名称+类型+类）加1字节标志
+
+/**
+ * @brief 键中的查询标志，标志不同的查询得到不同的响应，不能共用缓存
+ * @param DNS_PACKET_CACHE_RD   : 期望递归
+ * @param DNS_PACKET_CACHE_CD   : 禁用DNSSEC检查
+ * @param DNS_PACKET_CACHE_DO   : EDNS中的DNSSEC OK
+ * @param DNS_PACKET_CACHE_EDNS : 查询带有EDNS，没有EDNS的客户端不能收到带OPT记录或超过512字节的响应
+ */
+typedef enum {
+    DNS_PACKET_CACHE_RD   = 0x01,
+    DNS_PACKET_CACHE_CD   = 0x02,
+    DNS_PACKET_CACHE_DO   = 0x04,
+    DNS_PACKET_CACHE_EDNS = 0x08
+} dns_packet_cache_bits_t;
+
+/**
+ * @brief 一个缓存的响应，TTL位置、键和响应放在同一块内存中
+ * @param node      : 分片哈希表和LRU链表的节点，hash是键的哈希值
+ * @param stored    : 存入的时间（秒），命中时所有TTL减去经过的时间
+ * @param expire    : 过期时间（秒），即存入时间加上响应中最小的TTL
+ * @param key_len   : 键长度
+ * @param ttl_count : TTL位置的个数
+ * @param len       : 响应长度
+ * @param offsets   : 响应中各TTL字段的偏移，共ttl_count个，之后依次存放键和响应
+ */
+typedef struct {
+    dns_shard_node_t node;
+    uint32_t         stored;
+    uint32_t         expire;
+    uint16_t         key_len;
+    uint16_t         ttl_count;
+    uint16_t         len;
+    uint16_t         offsets[];
+} dns_packet_cache_entry_t;
+
+/**
+ * @brief 整包响应缓存，放在dns_message_deserialize之前
+ * @note 键是小写的问题字节加RD/CD/DO/EDNS标志；命中时复制保存的响应，改写事务ID和问题的大小写，
+ *       在记录下的偏移处递减TTL，不构造dns_message_t
+ * @param table : 分片，统计中的misses包括已过期和不可缓存的查询
+ */
+typedef struct {
+    dns_shards_t table;
+} dns_packet_cache_t;
+
+/**
+ * @brief 缓存统计，各分片之和
+ */
+typedef dns_shard_stats_t dns_packet_cache_stats_t;
+
+/**
+ * @brief 初始化缓存
+ * @param[out] cache 缓存
+ * @param[in] shards 分片数，向上取整到2的幂，不超过DNS_PACKET_CACHE_SHARDS_MAX
+ * @param[in] capacity 最多缓存的响应数，平均分到各分片
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_packet_cache_init(dns_packet_cache_t *cache, uint32_t shards, uint32_t capacity);
+
+/**
+ * @brief 释放缓存的所有响应
+ * @param[in,out] cache 缓存
+ */
+void dns_packet_cache_clear(dns_packet_cache_t *cache);
+
+/**
+ * @brief 从查询中取出缓存键：小写的问题字节加一个标志字节
+ * @note 只接受一个问题、没有回答和权威记录、附加段至多一个不带选项的OPT记录的标准查询
+ * @param[in] query 查询报文
+ * @param[in] len 查询长度
+ * @param[out] key 键，至少DNS_PACKET_CACHE_KEY_MAX字节
+ * @return size_t 键长度，查询不可缓存返回0
+ */
+size_t dns_packet_cache_key(const uint8_t *query, size_t len, uint8_t *key);
+
+/**
+ * @brief 保存查询对应的上游响应
+ * @note 只缓存问题与查询一致、没有截断、OPT不带选项、RCODE为NOERROR或NXDOMAIN且至少有一条记录的响应，
+ *       过期时间取最小的记录TTL（OPT记录除外）
+ * @param[in,out] cache 缓存
+ * @param[in] query 查询报文
+ * @param[in] query_len 查询长度
+ * @param[in] response 响应报文
+ * @param[in] response_len 响应长度
+ * @param[in] now 当前时间（秒），查找时必须使用同一个时钟
+ * @return bool 已缓存返回true，不可缓存或失败返回false
+ */
+bool dns_packet_cache_store(dns_packet_cache_t *cache, const uint8_t *query, size_t query_len, const uint8_t *response, size_t response_len,
+                            uint32_t now);
+
+/**
+ * @brief 用缓存的响应原地回复查询，可以直接用在UDP服务器的处理回调中
+ * @param[in,out] cache 缓存
+ * @param[in,out] packet 报文缓冲区，命中时查询被改写为响应
+ * @param[in] len 查询长度
+ * @param[in] size 缓冲区大小
+ * @param[in] now 当前时间（秒）
+ * @return size_t 响应长度，未命中返回0，报文不变；缓存的响应超过查询OPT通告的UDP负载大小
+ *         （没有EDNS时为512字节）也按未命中处理
+ */
+size_t dns_packet_cache_respond(dns_packet_cache_t *cache, uint8_t *packet, size_t len, size_t size, uint32_t now);
+
+/**
+ * @brief 获取统计
+ * @param[in] cache 缓存
+ * @param[out] stats 统计
+ */
+void dns_packet_cache_stats(dns_packet_cache_t *cache, dns_packet_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
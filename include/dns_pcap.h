@@ -0,0 +1,126 @@
+#pragma once
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_error.h"
+#include "dns_udp_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_PCAP_PORT 53 // 提取源端口或目的端口为该值的UDP载荷
+
+/**
+ * @brief 回放方式
+ * @param DNS_PCAP_MESSAGE : dns_message_deserialize完整解码
+ * @param DNS_PCAP_LAZY    : dns_message_deserialize_lazy只解码头部和问题
+ * @param DNS_PCAP_VIEW    : dns_message_view_parse零拷贝校验
+ */
+typedef enum {
+    DNS_PCAP_MESSAGE = 0,
+    DNS_PCAP_LAZY    = 1,
+    DNS_PCAP_VIEW    = 2
+} dns_pcap_mode_t;
+
+/**
+ * @brief 从抓包文件中提取的DNS报文，全部载入内存，回放时不再读文件
+ * @param data     : 所有载荷首尾相接
+ * @param size     : data已用的字节数
+ * @param capacity : data的容量
+ * @param offsets  : 每个报文在data中的偏移
+ * @param lens     : 每个报文的长度
+ * @param peers    : 每个报文的源地址（IPv4或IPv6），处理回调模式中作为对端地址
+ * @param count    : 报文数
+ * @param slots    : offsets/lens/peers的容量
+ * @param frames   : 文件中的总帧数
+ * @param skipped  : 不是UDP/53、分片或无法解析的帧数
+ */
+typedef struct {
+    uint8_t             *data;
+    size_t               size;
+    size_t               capacity;
+    size_t              *offsets;
+    uint16_t            *lens;
+    struct sockaddr_in6 *peers;
+    size_t               count;
+    size_t               slots;
+    uint64_t             frames;
+    uint64_t             skipped;
+} dns_pcap_t;
+
+/**
+ * @brief 回放结果
+ * @param messages  : 处理的报文数（含循环次数）
+ * @param rejected  : 解码失败的报文数，处理回调模式中为不回复的查询数
+ * @param replies   : 处理回调模式中回复的报文数
+ * @param responses : 处理回调模式中跳过的响应报文（QR=1）数，不计入messages
+ * @param causes    : 按dns_error_t统计的失败原因，DNS_OK表示失败但没有记录原因
+ * @param elapsed_ns : 耗时
+ */
+typedef struct {
+    uint64_t messages;
+    uint64_t rejected;
+    uint64_t replies;
+    uint64_t responses;
+    uint64_t causes[DNS_ERROR_MAX];
+    uint64_t elapsed_ns;
+} dns_pcap_result_t;
+
+/**
+ * @brief 初始化
+ * @param[out] pcap 报文集合
+ */
+void dns_pcap_init(dns_pcap_t *pcap);
+
+/**
+ * @brief 释放所有报文
+ * @param[in,out] pcap 报文集合
+ */
+void dns_pcap_clear(dns_pcap_t *pcap);
+
+/**
+ * @brief 读取经典pcap或pcapng文件，提取UDP/53的载荷
+ * @note 支持以太网（含VLAN）、Linux cooked、BSD loopback和原始IP链路层；IPv4分片被跳过
+ * @param[in,out] pcap 报文集合，可以多次调用追加多个文件
+ * @param[in] path 文件路径
+ * @return int 本次提取的报文数，文件无法读取或格式不支持返回-1
+ */
+int dns_pcap_load(dns_pcap_t *pcap, const char *path);
+
+/**
+ * @brief 循环解码所有报文，统计速度和失败原因
+ * @param[in] pcap 报文集合
+ * @param[in] mode 解码方式
+ * @param[in] loops 循环次数
+ * @param[out] result 回放结果
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_pcap_replay(const dns_pcap_t *pcap, dns_pcap_mode_t mode, int loops, dns_pcap_result_t *result);
+
+/**
+ * @brief 循环把所有查询交给服务器的处理回调，每次先复制到报文缓冲区，与服务器收包时一致
+ * @note 抓包中的响应（源端口53）服务器本来就不会回复，跳过并单独计数，不算作拒绝
+ * @param[in] pcap 报文集合
+ * @param[in] handler 处理回调
+ * @param[in] arg 回调参数
+ * @param[in] loops 循环次数
+ * @param[out] result 回放结果
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_pcap_replay_handler(const dns_pcap_t *pcap, dns_udp_handler_t handler, void *arg, int loops, dns_pcap_result_t *result);
+
+/**
+ * @brief 将回放结果转换为字符串
+ * @param[in] result 回放结果
+ * @param[out] buf 缓冲区
+ * @param[in] buf_size 缓冲区大小
+ * @return const char* 返回buf
+ */
+const char *dns_pcap_result_to_string(const dns_pcap_result_t *result, char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
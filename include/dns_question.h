@@ -10,6 +10,7 @@ extern "C" {
 #include <string.h>
 #include "dns_type.h"
 #include "dns_class.h"
+#include "dns_name.h"
 
 // DNS查询问题结构
 typedef struct {
@@ -122,6 +123,18 @@ bool dns_question_copy(dns_question_t *dst, const dns_question_t *src);
 int dns_question_serialize(const dns_question_t *question, uint8_t *buf, uint16_t buf_size);
 ;
 
+/**
+ * @brief 把DNS查询问题写入报文，名称可以压缩
+ * @param[in] question DNS查询问题结构
+ * @param[in,out] table 名称压缩表，为NULL时不压缩
+ * @param[out] msg 报文缓冲区
+ * @param[in] msg_size 报文缓冲区大小
+ * @param[in] offset 问题写入的偏移
+ * @return int 写入的字节数，失败返回0
+ */
+int dns_question_pack(const dns_question_t *question, dns_name_table_t *table, uint8_t *msg, size_t msg_size, size_t offset);
+;
+
 /**
  * @brief 反序列化DNS查询问题
  * @param[out] question DNS查询问题结构
@@ -132,6 +145,31 @@ int dns_question_serialize(const dns_question_t *question, uint8_t *buf, uint16_
 int dns_question_deserialize(dns_question_t *question, const uint8_t *src, uint16_t src_len);
 ;
 
+/**
+ * @brief 从完整报文中反序列化DNS查询问题，名称中的压缩指针相对于整个报文解析
+ * @param[out] question DNS查询问题结构
+ * @param[in] msg 整个报文
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 问题在报文中的偏移
+ * @return int 反序列消耗的字节数，失败返回0
+ */
+int dns_question_unpack(dns_question_t *question, const uint8_t *msg, size_t msg_len, size_t offset);
+;
+
+/**
+ * @brief 同dns_question_unpack，但qname指向调用者提供的name_buf，不分配内存
+ * @note 得到的问题不拥有qname，不能对其调用dns_question_clear
+ * @param[out] question DNS查询问题结构
+ * @param[in] msg 整个报文
+ * @param[in] msg_len 报文长度
+ * @param[in] offset 问题在报文中的偏移
+ * @param[out] name_buf 存放展开后名称的缓冲区
+ * @param[in] name_buf_size 缓冲区大小，DNS_NAME_MAX_LENGTH即可
+ * @return int 反序列消耗的字节数，失败返回0
+ */
+int dns_question_unpack_to(dns_question_t *question, const uint8_t *msg, size_t msg_len, size_t offset, char *name_buf, size_t name_buf_size);
+;
+
 /**
  * @brief 打印DNS查询问题
  * @param[in] question DNS查询问题结构
@@ -0,0 +1,122 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_flags.h"
+#include "dns_message_view.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_REPLY_QNAME_PTR 0xC00C // 指向偏移12（问题名称）的压缩指针
+
+/**
+ * @brief 在收包缓冲区中原地构造响应，省去反序列化、重新构建消息和第二个缓冲区
+ * @param packet       : 报文缓冲区，初始化时是查询，之后逐步改写为响应
+ * @param size         : 缓冲区大小
+ * @param len          : 当前响应长度
+ * @param question_end : 问题段结束的偏移，响应中的记录从这里开始追加
+ * @param flags        : 响应标志，修改后立即写回报文
+ * @param qtype        : 问题的类型
+ * @param qclass       : 问题的类
+ * @param counts       : 回答/权威/附加段的记录数，按dns_section_t下标
+ * @param section      : 最近追加记录的段，记录必须按段的顺序追加
+ * @note 不分配内存，不使用标准IO，也不记录dns_error，可以用在小设备上
+ */
+typedef struct {
+    uint8_t      *packet;
+    size_t        size;
+    size_t        len;
+    size_t        question_end;
+    uint16_t      flags;
+    uint16_t      qtype;
+    uint16_t      qclass;
+    uint16_t      counts[DNS_SECTION_MAX];
+    dns_section_t section;
+} dns_reply_t;
+
+/**
+ * @brief 判断报文是否是需要回复的查询：头部完整且QR为0
+ * @param[in] packet 报文
+ * @param[in] len 报文长度
+ * @return bool 是查询返回true
+ */
+bool dns_reply_is_query(const uint8_t *packet, size_t len);
+
+/**
+ * @brief 把查询改写为空响应：置QR，保留ID/OPCODE/RD，清除其它标志，截断到问题段之后
+ * @param[out] reply 响应
+ * @param[in,out] packet 报文缓冲区
+ * @param[in] len 查询长度
+ * @param[in] size 缓冲区大小
+ * @return bool 成功返回true；不是查询、问题数不为1或问题不完整返回false，报文不被修改
+ */
+bool dns_reply_init(dns_reply_t *reply, uint8_t *packet, size_t len, size_t size);
+
+/**
+ * @brief 设置AA标志位
+ * @param[in,out] reply 响应
+ * @param[in] aa AA值
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_reply_set_aa(dns_reply_t *reply, dns_aa_t aa);
+
+/**
+ * @brief 设置TC标志位
+ * @param[in,out] reply 响应
+ * @param[in] tc TC值
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_reply_set_tc(dns_reply_t *reply, dns_tc_t tc);
+
+/**
+ * @brief 设置RA标志位
+ * @param[in,out] reply 响应
+ * @param[in] ra RA值
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_reply_set_ra(dns_reply_t *reply, dns_ra_t ra);
+
+/**
+ * @brief 设置RCODE
+ * @param[in,out] reply 响应
+ * @param[in] rcode 响应码
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_reply_set_rcode(dns_reply_t *reply, dns_rcode_t rcode);
+
+/**
+ * @brief 追加一条名称为问题名称（压缩指针C00C）的记录
+ * @param[in,out] reply 响应
+ * @param[in] section 回答、权威或附加段，不能早于已追加记录的段
+ * @param[in] rtype 记录类型
+ * @param[in] rclass 记录类
+ * @param[in] ttl 生存时间
+ * @param[in] rdata 记录数据，rlength为0时可以为NULL
+ * @param[in] rlength 记录数据长度
+ * @return bool 成功返回true，缓冲区不足或段顺序错误返回false，响应不变
+ */
+bool dns_reply_add_record(dns_reply_t *reply, dns_section_t section, uint16_t rtype, uint16_t rclass, uint32_t ttl, const uint8_t *rdata, uint16_t rlength);
+
+/**
+ * @brief 写回各段记录数，得到最终的响应长度
+ * @param[in,out] reply 响应
+ * @return size_t 响应长度
+ */
+size_t dns_reply_finish(dns_reply_t *reply);
+
+/**
+ * @brief 把查询改写为只有头部的错误响应，用于无法解析问题的报文
+ * @note 置QR，保留ID/OPCODE/RD，各段记录数清零
+ * @param[in,out] packet 报文缓冲区
+ * @param[in] len 查询长度
+ * @param[in] rcode 响应码
+ * @return size_t 响应长度，头部不完整返回0
+ */
+size_t dns_reply_error(uint8_t *packet, size_t len, dns_rcode_t rcode);
+
+#ifdef __cplusplus
+}
+#endif
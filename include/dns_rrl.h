@@ -0,0 +1,101 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_RRL_CREDIT_MAX 0xFFFFFF // 桶中令牌数的上限（24位）
+
+/**
+ * @brief 响应类别，不同类别分别限速
+ * @param DNS_RRL_ANSWER   : 正常回答（包括NODATA）
+ * @param DNS_RRL_NXDOMAIN : 域名不存在
+ * @param DNS_RRL_ERROR    : 其它错误（SERVFAIL/FORMERR/REFUSED等）
+ */
+typedef enum {
+    DNS_RRL_ANSWER   = 0,
+    DNS_RRL_NXDOMAIN = 1,
+    DNS_RRL_ERROR    = 2
+} dns_rrl_class_t;
+
+/**
+ * @brief 限速结果
+ * @param DNS_RRL_PASS : 正常发送
+ * @param DNS_RRL_DROP : 丢弃
+ * @param DNS_RRL_SLIP : 改为发送TC=1的截断响应，真实客户端会改用TCP重试，反射攻击得不到放大
+ */
+typedef enum {
+    DNS_RRL_PASS = 0,
+    DNS_RRL_DROP = 1,
+    DNS_RRL_SLIP = 2
+} dns_rrl_action_t;
+
+/**
+ * @brief 响应限速（Response Rate Limiting），按客户端网段（IPv4 /24、IPv6 /56）和响应类别计数
+ * @param buckets : 令牌桶，每个桶一个64位原子字：键标签24位 | 时间（秒）16位 | 令牌24位，
+ *                  用一次CAS完成补充和扣减，不加锁；哈希冲突时新键覆盖旧键
+ * @param mask    : 桶数减一，桶数是2的幂
+ * @param rate    : 每秒每个网段每个类别允许的响应数，也是桶的容量
+ * @param slip    : 每slip个被限速的响应中有一个改为截断响应，0表示全部丢弃，1表示全部截断
+ */
+typedef struct {
+    _Atomic uint64_t *buckets;
+    uint32_t          mask;
+    uint32_t          rate;
+    uint32_t          slip;
+} dns_rrl_t;
+
+/**
+ * @brief 初始化限速表
+ * @param[out] rrl 限速表
+ * @param[in] size 桶数，向上取整到2的幂，应明显大于同时活跃的网段数
+ * @param[in] rate 每秒允许的响应数，不超过DNS_RRL_CREDIT_MAX
+ * @param[in] slip 截断比例，见dns_rrl_t
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_rrl_init(dns_rrl_t *rrl, uint32_t size, uint32_t rate, uint32_t slip);
+
+/**
+ * @brief 释放限速表
+ * @param[in,out] rrl 限速表
+ */
+void dns_rrl_clear(dns_rrl_t *rrl);
+
+/**
+ * @brief 根据响应码和回答数判断响应类别
+ * @param[in] response 响应报文
+ * @param[in] len 响应长度
+ * @return dns_rrl_class_t 类别，头部不完整时为DNS_RRL_ERROR
+ */
+dns_rrl_class_t dns_rrl_classify(const uint8_t *response, size_t len);
+
+/**
+ * @brief 为发往peer的一个响应扣减令牌，可以在多个线程中同时调用
+ * @param[in,out] rrl 限速表
+ * @param[in] peer 客户端地址，IPv4或IPv6
+ * @param[in] cls 响应类别
+ * @param[in] now 当前时间（秒），只用于计算补充的令牌，可以用单调时钟
+ * @return dns_rrl_action_t 限速结果，不支持的地址族总是DNS_RRL_PASS
+ */
+dns_rrl_action_t dns_rrl_check(dns_rrl_t *rrl, const struct sockaddr *peer, dns_rrl_class_t cls, uint32_t now);
+
+/**
+ * @brief 对即将发送的响应应用限速：分类、扣减令牌，需要时原地改写为截断响应
+ * @note 截断响应只保留头部和问题，置TC=1，各段记录数清零；适合在UDP服务器的处理回调末尾调用
+ * @param[in,out] rrl 限速表
+ * @param[in] peer 客户端地址
+ * @param[in,out] response 响应报文
+ * @param[in] len 响应长度
+ * @param[in] now 当前时间（秒）
+ * @return size_t 应发送的长度，0表示丢弃
+ */
+size_t dns_rrl_apply(dns_rrl_t *rrl, const struct sockaddr *peer, uint8_t *response, size_t len, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,152 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_SHARD_MAX 256 // 分片数上限
+
+/**
+ * @brief 分片哈希表和LRU链表的节点，必须是条目的第一个成员，条目用一次malloc分配
+ * @param next     : 桶内链表的下一个
+ * @param lru_prev : LRU链表中较新的一个
+ * @param lru_next : LRU链表中较旧的一个
+ * @param hash     : 键的哈希值，高位选分片，低位选桶
+ */
+typedef struct dns_shard_node {
+    struct dns_shard_node *next;
+    struct dns_shard_node *lru_prev;
+    struct dns_shard_node *lru_next;
+    uint32_t               hash;
+} dns_shard_node_t;
+
+/**
+ * @brief 一个分片，有自己的锁、哈希表和LRU链表；除初始化和释放外，操作分片前调用者必须持有lock
+ * @param lock      : 分片锁，只保护本分片
+ * @param buckets   : 哈希桶
+ * @param mask      : 桶数减一，桶数是2的幂
+ * @param count     : 条目数
+ * @param lru_head  : 最近使用的条目
+ * @param lru_tail  : 最久未使用的条目，分片满时首先淘汰
+ * @param hits      : 命中次数
+ * @param misses    : 未命中次数
+ * @param expired   : 过期删除的条目数
+ * @param evictions : 分片满时淘汰的条目数
+ */
+typedef struct {
+    pthread_mutex_t    lock;
+    dns_shard_node_t **buckets;
+    uint32_t           mask;
+    uint32_t           count;
+    dns_shard_node_t  *lru_head;
+    dns_shard_node_t  *lru_tail;
+    uint64_t           hits;
+    uint64_t           misses;
+    uint64_t           expired;
+    uint64_t           evictions;
+} dns_shard_t;
+
+/**
+ * @brief 按哈希高位分片的一组分片，dns_cache和dns_packet_cache共用
+ * @note 只管理节点的链接和统计，键的比较和条目的内容由使用者负责
+ * @param shards     : 分片
+ * @param shard_mask : 分片数减一，分片数是2的幂
+ * @param capacity   : 每个分片最多的条目数
+ */
+typedef struct {
+    dns_shard_t *shards;
+    uint32_t     shard_mask;
+    uint32_t     capacity;
+} dns_shards_t;
+
+/**
+ * @brief 统计，各分片之和
+ * @param entries   : 条目数
+ * @param hits      : 命中次数
+ * @param misses    : 未命中次数
+ * @param expired   : 过期删除的条目数
+ * @param evictions : 淘汰的条目数
+ */
+typedef struct {
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t expired;
+    uint64_t evictions;
+} dns_shard_stats_t;
+
+/**
+ * @brief 初始化分片
+ * @param[out] table 分片组
+ * @param[in] shards 分片数，向上取整到2的幂，不超过DNS_SHARD_MAX
+ * @param[in] capacity 最多的条目数，平均分到各分片，每个分片的桶数不少于其容量
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_shards_init(dns_shards_t *table, uint32_t shards, uint32_t capacity);
+
+/**
+ * @brief 释放所有分片和其中的条目（对每个节点调用free）
+ * @param[in,out] table 分片组
+ */
+void dns_shards_clear(dns_shards_t *table);
+
+/**
+ * @brief 哈希值所在的分片
+ * @param[in] table 分片组
+ * @param[in] hash 键的哈希值
+ * @return dns_shard_t* 分片
+ */
+dns_shard_t *dns_shards_get(dns_shards_t *table, uint32_t hash);
+
+/**
+ * @brief 获取统计，逐个分片加锁
+ * @param[in] table 分片组
+ * @param[out] stats 统计
+ */
+void dns_shards_stats(dns_shards_t *table, dns_shard_stats_t *stats);
+
+/**
+ * @brief 哈希值所在桶的链表头，使用者沿next查找并比较自己的键
+ * @param[in] shard 分片
+ * @param[in] hash 键的哈希值
+ * @return dns_shard_node_t** 桶
+ */
+dns_shard_node_t **dns_shard_bucket(dns_shard_t *shard, uint32_t hash);
+
+/**
+ * @brief 查找指向某个节点的桶内链接
+ * @param[in] shard 分片
+ * @param[in] node 分片中的节点
+ * @return dns_shard_node_t** 链接，节点不在分片中返回NULL
+ */
+dns_shard_node_t **dns_shard_link(dns_shard_t *shard, dns_shard_node_t *node);
+
+/**
+ * @brief 加入节点，放在LRU链表头部；调用者已确认没有相同的键，并先检查容量
+ * @param[in,out] shard 分片
+ * @param[in] node 节点，hash已设置
+ */
+void dns_shard_insert(dns_shard_t *shard, dns_shard_node_t *node);
+
+/**
+ * @brief 从桶和LRU链表中摘下节点，不释放
+ * @param[in,out] shard 分片
+ * @param[in] link 指向该节点的桶内链接
+ * @return dns_shard_node_t* 摘下的节点
+ */
+dns_shard_node_t *dns_shard_remove(dns_shard_t *shard, dns_shard_node_t **link);
+
+/**
+ * @brief 命中后把节点移到LRU链表头部
+ * @param[in,out] shard 分片
+ * @param[in] node 节点
+ */
+void dns_shard_touch(dns_shard_t *shard, dns_shard_node_t *node);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 收到一个完整消息时的回调
+ * @param arg 调用者的参数
+ * @param msg 消息数据（不含2字节长度前缀），只在回调期间有效
+ * @param len 消息长度
+ * @return bool 返回true继续解析，返回false暂停，剩余数据由调用者稍后重新送入
+ */
+typedef bool (*dns_stream_callback_t)(void *arg, const uint8_t *msg, size_t len);
+
+/**
+ * @brief TCP流解码器，按RFC 1035 4.2.2的2字节长度前缀切分消息
+ * @param buf        : 拼接跨块消息的缓冲区，由调用者提供
+ * @param buf_size   : 缓冲区大小，决定可接受的最大消息
+ * @param prefix     : 已收到的长度前缀
+ * @param prefix_len : 已收到的长度前缀字节数
+ * @param expected   : 当前消息的长度，前缀收齐后有效
+ * @param buffered   : 当前消息已复制到buf的字节数
+ * @param messages   : 累计交付的消息数
+ * @param copied     : 其中因跨块而复制过的消息数
+ * @note 消息完整地落在一次送入的数据中时直接把该数据的指针交给回调，不复制
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t   buf_size;
+    uint8_t  prefix[2];
+    uint8_t  prefix_len;
+    uint16_t expected;
+    size_t   buffered;
+    uint64_t messages;
+    uint64_t copied;
+} dns_stream_t;
+
+/**
+ * @brief 初始化流解码器
+ * @param[out] stream 解码器
+ * @param[in] buf 拼接缓冲区，生命周期必须长于解码器
+ * @param[in] buf_size 缓冲区大小，不能小于DNS头部长度
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_stream_init(dns_stream_t *stream, uint8_t *buf, size_t buf_size);
+
+/**
+ * @brief 丢弃未完成的消息，回到等待长度前缀的状态
+ * @param[in,out] stream 解码器
+ */
+void dns_stream_reset(dns_stream_t *stream);
+
+/**
+ * @brief 送入一段从连接上读到的数据，每完成一个消息调用一次回调
+ * @param[in,out] stream 解码器
+ * @param[in] data 数据，长度任意
+ * @param[in] len 数据长度
+ * @param[in] callback 回调
+ * @param[in] arg 回调参数
+ * @return int 消耗的字节数，回调要求暂停时小于len；
+ *             长度非法或超过缓冲区时返回-1，连接应当关闭
+ */
+int dns_stream_feed(dns_stream_t *stream, const uint8_t *data, size_t len, dns_stream_callback_t callback, void *arg);
+
+/**
+ * @brief 是否停在消息边界上，即没有收了一半的消息
+ * @param[in] stream 解码器
+ * @return bool 没有未完成的消息返回true
+ */
+bool dns_stream_idle(const dns_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_TCP_QUERY_MAX     4096  // 可接受的最大查询长度，更长的查询会导致连接关闭
+#define DNS_TCP_READ_SIZE     65536 // 所有连接共用的读缓冲区大小
+#define DNS_TCP_PIPELINE_MAX  64    // 每个连接未回复的查询数达到该值时暂停读取
+#define DNS_TCP_EVENTS        64    // 每次epoll_wait处理的事件数
+
+typedef struct dns_tcp_server dns_tcp_server_t;
+
+/**
+ * @brief 收到一个完整查询时的回调
+ * @note 回调不必立即回复：保存token，稍后在服务线程中调用dns_tcp_server_respond，
+ *       同一连接上的多个查询可以按任意顺序回复（RFC 7766 6.2.1.1）；每个token必须恰好回复一次
+ *       或用dns_tcp_server_drop放弃，否则连接一直有未回复的查询，不会空闲超时
+ * @param arg 调用者的参数
+ * @param server 服务器
+ * @param token 标识该查询所在的连接，连接关闭后失效
+ * @param query 查询（不含长度前缀），只在回调期间有效
+ * @param len 查询长度
+ */
+typedef void (*dns_tcp_handler_t)(void *arg, dns_tcp_server_t *server, uint64_t token, const uint8_t *query, size_t len);
+
+/**
+ * @brief 一个TCP连接
+ * @param fd         : 套接字，-1表示空闲
+ * @param generation : 每次复用槽位时加一，token中带有它，防止回复写到新连接上
+ * @param pending    : 已收到还未回复的查询数
+ * @param reading    : 是否在监听可读事件，pending达到上限或对端关闭写方向时停止
+ * @param writing    : 是否在监听可写事件，写缓冲区有剩余时开启
+ * @param eof        : 对端已关闭写方向，回复完未回复的查询后关闭连接
+ * @param closing    : 写出错，等当前回调返回后关闭连接
+ * @param busy       : 正在解码该连接的数据，回调中回复时不能关闭连接
+ * @param last_active: 最近一次收发数据的时间（毫秒）
+ * @param stream     : 长度前缀解码器
+ * @param query_buf  : 跨读取的查询的拼接缓冲区
+ * @param wbuf       : 待发送的数据（带长度前缀的响应）
+ * @param wbuf_len   : 待发送数据的长度
+ * @param wbuf_off   : 已发送的字节数
+ * @param wbuf_size  : 写缓冲区大小
+ * @param next_free  : 空闲链表中的下一个槽位
+ */
+typedef struct {
+    int          fd;
+    uint32_t     generation;
+    uint32_t     pending;
+    bool         reading;
+    bool         writing;
+    bool         eof;
+    bool         closing;
+    bool         busy;
+    uint64_t     last_active;
+    dns_stream_t stream;
+    uint8_t      query_buf[DNS_TCP_QUERY_MAX];
+    uint8_t     *wbuf;
+    size_t       wbuf_len;
+    size_t       wbuf_off;
+    size_t       wbuf_size;
+    int          next_free;
+} dns_tcp_conn_t;
+
+/**
+ * @brief 基于epoll的TCP服务器，单线程使用
+ * @param listen_fd    : 监听套接字
+ * @param epoll_fd     : epoll实例
+ * @param handler      : 查询回调
+ * @param arg          : 回调参数
+ * @param running      : 初始化时为true，变为false时dns_tcp_server_run返回
+ * @param max_conns    : 最大连接数，超过时新连接被立即关闭
+ * @param idle_ms      : 空闲超时，没有未回复查询且超过该时间没有数据的连接被关闭
+ * @param conns        : 连接槽位
+ * @param free_head    : 空闲槽位链表头
+ * @param active       : 当前连接数
+ * @param last_sweep   : 上一次检查空闲连接的时间
+ * @param read_buf     : 共用的读缓冲区，完整落在其中的查询直接交给回调
+ * @param accepted/rejected/timeouts/queries/responses : 统计
+ */
+struct dns_tcp_server {
+    int               listen_fd;
+    int               epoll_fd;
+    dns_tcp_handler_t handler;
+    void             *arg;
+    atomic_bool       running;
+    int               max_conns;
+    uint32_t          idle_ms;
+    dns_tcp_conn_t   *conns;
+    int               free_head;
+    int               active;
+    uint64_t          last_sweep;
+    uint8_t           read_buf[DNS_TCP_READ_SIZE];
+    uint64_t          accepted;
+    uint64_t          rejected;
+    uint64_t          timeouts;
+    uint64_t          queries;
+    uint64_t          responses;
+};
+
+/**
+ * @brief 创建非阻塞的监听套接字
+ * @param[in] ip 本地地址，IPv4或IPv6的文本格式
+ * @param[in] port 本地端口，0表示由系统分配
+ * @return int 套接字，失败返回-1
+ */
+int dns_tcp_listen_open(const char *ip, uint16_t port);
+
+/**
+ * @brief 初始化服务器
+ * @param[out] server 服务器，结构体较大，应当放在堆上
+ * @param[in] listen_fd 监听套接字，由调用者关闭
+ * @param[in] max_conns 最大连接数
+ * @param[in] idle_ms 空闲超时（毫秒）
+ * @param[in] handler 查询回调
+ * @param[in] arg 回调参数
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_tcp_server_init(dns_tcp_server_t *server, int listen_fd, int max_conns, uint32_t idle_ms, dns_tcp_handler_t handler, void *arg);
+
+/**
+ * @brief 关闭所有连接并释放资源
+ * @param[in,out] server 服务器
+ */
+void dns_tcp_server_clear(dns_tcp_server_t *server);
+
+/**
+ * @brief 回复一个查询，响应加上长度前缀后尽量立即写出，写不完的部分等可写时继续
+ * @note 必须在服务线程中调用（回调中或两次poll之间）
+ * @param[in,out] server 服务器
+ * @param[in] token 回调收到的token
+ * @param[in] response 响应（不含长度前缀）
+ * @param[in] len 响应长度
+ * @return bool 成功返回true，连接已关闭或参数非法返回false
+ */
+bool dns_tcp_server_respond(dns_tcp_server_t *server, uint64_t token, const uint8_t *response, size_t len);
+
+/**
+ * @brief 放弃一个查询（例如无法解析），不回复，连接的未回复查询数减一
+ * @note 必须在服务线程中调用（回调中或两次poll之间）
+ * @param[in,out] server 服务器
+ * @param[in] token 回调收到的token
+ * @return bool 成功返回true，连接已关闭或参数非法返回false
+ */
+bool dns_tcp_server_drop(dns_tcp_server_t *server, uint64_t token);
+
+/**
+ * @brief 等待并处理一批事件，并关闭空闲超时的连接
+ * @param[in,out] server 服务器
+ * @param[in] timeout_ms 没有事件时最多等待的毫秒数
+ * @return int 处理的事件数，出错返回-1
+ */
+int dns_tcp_server_poll(dns_tcp_server_t *server, int timeout_ms);
+
+/**
+ * @brief 循环处理事件直到dns_tcp_server_stop被调用
+ * @param[in,out] server 服务器
+ * @return bool 正常停止返回true，出错返回false
+ */
+bool dns_tcp_server_run(dns_tcp_server_t *server);
+
+/**
+ * @brief 通知dns_tcp_server_run返回，可以在其它线程中调用
+ * @param[in,out] server 服务器
+ */
+void dns_tcp_server_stop(dns_tcp_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dns_message.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 预编译的响应模板，响应只序列化一次，每次查询只复制并修补少量字节
+ * @param wire            : 序列化（压缩）后的完整响应
+ * @param len             : 响应长度
+ * @param question_length : 问题段（名称+类型+类）的字节数，问题从偏移12开始
+ * @note 只应答与模板问题相同的查询（名称不区分大小写），
+ *       这样回显的问题与模板中的等长，模板中的压缩指针仍然有效
+ */
+typedef struct {
+    uint8_t *wire;
+    size_t   len;
+    uint16_t question_length;
+} dns_template_t;
+
+/**
+ * @brief 由一个完整的响应消息生成模板
+ * @param[out] tpl 模板
+ * @param[in] message 响应消息，必须正好有一个问题，生成后可以清除
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_template_init(dns_template_t *tpl, const dns_message_t *message);
+
+/**
+ * @brief 释放模板
+ * @param[in,out] tpl 模板
+ */
+void dns_template_clear(dns_template_t *tpl);
+
+/**
+ * @brief 判断查询是否由该模板应答：QR为0、OPCODE为QUERY、只有一个问题，且名称（不区分大小写）、类型和类都相同
+ * @param[in] tpl 模板
+ * @param[in] query 查询报文
+ * @param[in] query_len 查询长度
+ * @return bool 匹配返回true
+ */
+bool dns_template_match(const dns_template_t *tpl, const uint8_t *query, size_t query_len);
+
+/**
+ * @brief 用模板生成对查询的响应：复制模板，修补ID和RD位，并原样回显查询中的问题（保留大小写）
+ * @note buffer可以就是query所在的缓冲区，用于在收包缓冲区中原地回复
+ * @param[in] tpl 模板
+ * @param[in] query 查询报文
+ * @param[in] query_len 查询长度
+ * @param[out] buffer 响应缓冲区
+ * @param[in] buffer_size 缓冲区大小
+ * @return int 响应长度，查询与模板不匹配返回0，参数非法或缓冲区不足返回-1
+ */
+int dns_template_render(const dns_template_t *tpl, const uint8_t *query, size_t query_len, uint8_t *buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
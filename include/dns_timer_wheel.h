@@ -0,0 +1,93 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_TIMER_WHEEL_BITS   6                            // 每层槽数的位数
+#define DNS_TIMER_WHEEL_SLOTS  (1 << DNS_TIMER_WHEEL_BITS)  // 每层的槽数
+#define DNS_TIMER_WHEEL_LEVELS 4                            // 层数，共覆盖2^24个刻度
+#define DNS_TIMER_WHEEL_DUE    DNS_TIMER_WHEEL_LEVELS       // 定时器已到期、等待取出时的层号
+
+/**
+ * @brief 定时器，嵌入到使用者的结构体中，不单独分配内存
+ * @param next   : 同一个槽中的下一个定时器
+ * @param pprev  : 指向前一个定时器的next（或槽头）的指针，未加入时为NULL，用于O(1)删除
+ * @param expire : 到期时刻（刻度）
+ * @param level  : 所在的层，DNS_TIMER_WHEEL_DUE表示在到期链表中
+ */
+typedef struct dns_timer {
+    struct dns_timer  *next;
+    struct dns_timer **pprev;
+    uint32_t           expire;
+    uint8_t            level;
+} dns_timer_t;
+
+/**
+ * @brief 分层时间轮：第0层每槽1个刻度，第n层每槽64^n个刻度
+ * @note 加入和删除O(1)；较远的定时器先放在高层，每经过一个高层槽的时间才整体下移一层，
+ *       每个定时器最多移动LEVELS-1次；到期的定时器先放入到期链表，由调用者按预算逐个取出，
+ *       大量同时到期的定时器因此可以分摊到多次调用中处理。不加锁，由调用者保护
+ * @param slots   : 各层的槽，每个槽是一个定时器链表
+ * @param counts  : 各层的定时器数
+ * @param due     : 已到期还没有取出的定时器
+ * @param current : 时间轮当前的刻度，不超过最近一次传入的当前时间
+ */
+typedef struct {
+    dns_timer_t *slots[DNS_TIMER_WHEEL_LEVELS][DNS_TIMER_WHEEL_SLOTS];
+    uint32_t     counts[DNS_TIMER_WHEEL_LEVELS];
+    dns_timer_t *due;
+    uint32_t     current;
+} dns_timer_wheel_t;
+
+/**
+ * @brief 初始化时间轮
+ * @param[out] wheel 时间轮
+ * @param[in] now 当前刻度，之后传入的时间必须来自同一个时钟
+ */
+void dns_timer_wheel_init(dns_timer_wheel_t *wheel, uint32_t now);
+
+/**
+ * @brief 时间轮中是否没有任何定时器（包括已到期未取出的）
+ * @param[in] wheel 时间轮
+ * @return bool 为空返回true
+ */
+bool dns_timer_wheel_empty(const dns_timer_wheel_t *wheel);
+
+/**
+ * @brief 定时器是否在时间轮中
+ * @param[in] timer 定时器
+ * @return bool 已加入返回true
+ */
+bool dns_timer_pending(const dns_timer_t *timer);
+
+/**
+ * @brief 加入定时器，已加入的定时器先删除再重新加入
+ * @param[in,out] wheel 时间轮
+ * @param[in,out] timer 定时器
+ * @param[in] expire 到期刻度，不晚于当前刻度时在下一次取出时立即到期；超过2^24个刻度时先放在最高层，到时再重新放置
+ */
+void dns_timer_wheel_add(dns_timer_wheel_t *wheel, dns_timer_t *timer, uint32_t expire);
+
+/**
+ * @brief 删除定时器，未加入的定时器忽略
+ * @param[in,out] wheel 时间轮
+ * @param[in,out] timer 定时器
+ */
+void dns_timer_wheel_remove(dns_timer_wheel_t *wheel, dns_timer_t *timer);
+
+/**
+ * @brief 推进时间轮到now并取出一个到期的定时器
+ * @note 到期链表不为空时不推进，推进时一出现到期的定时器就停下；取出的定时器不再在时间轮中
+ * @param[in,out] wheel 时间轮
+ * @param[in] now 当前刻度
+ * @return dns_timer_t* 到期的定时器，没有时返回NULL
+ */
+dns_timer_t *dns_timer_wheel_expire(dns_timer_wheel_t *wheel, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
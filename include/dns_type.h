@@ -4,6 +4,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 
@@ -67,6 +68,13 @@ typedef enum {
 
 const char* dns_type_name(dns_type_t qtype);
 
+/**
+ * @brief 判断该类型的资源数据中是否包含可以被压缩的域名（RFC 1035/3597）
+ * @param type 资源记录类型
+ * @return bool 包含返回true，否则返回false
+ */
+bool dns_type_rdata_has_name(dns_type_t type);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_UDP_BATCH       32   // 每次recvmmsg/sendmmsg的报文数
+#define DNS_UDP_PACKET_SIZE 4096 // 每个报文缓冲区的大小，覆盖常见的EDNS缓冲区大小
+#define DNS_UDP_POLL_MS     100  // 等待报文的超时，决定dns_udp_server_stop的响应时间
+
+/**
+ * @brief 处理一个收到的报文，响应原地写回同一个缓冲区
+ * @param arg 调用者的参数
+ * @param packet 报文缓冲区，进入时是查询，返回时是响应
+ * @param len 查询长度
+ * @param size 缓冲区大小，响应不能超过它
+ * @param peer 对端地址
+ * @param peer_len 对端地址长度
+ * @return size_t 响应长度，返回0表示不回复
+ */
+typedef size_t (*dns_udp_handler_t)(void *arg, uint8_t *packet, size_t len, size_t size, const struct sockaddr *peer, socklen_t peer_len);
+
+/**
+ * @brief UDP服务器，批量收发，单线程使用
+ * @param fd       : 已绑定的UDP套接字
+ * @param handler  : 报文处理回调
+ * @param arg      : 回调参数
+ * @param running  : 初始化时为true，变为false时dns_udp_server_run返回
+ * @param received : 累计收到的报文数
+ * @param sent     : 累计发出的响应数
+ * @param dropped  : 累计因发送失败丢弃的响应数
+ * @param packets  : 收发共用的报文缓冲区
+ * @param peers    : 每个报文的对端地址
+ * @param iov      : 每个报文的iovec
+ * @param rx       : recvmmsg使用的消息头
+ * @param tx       : sendmmsg使用的消息头
+ * @note 结构体较大，应当放在堆上或静态存储中
+ */
+typedef struct {
+    int                     fd;
+    dns_udp_handler_t       handler;
+    void                   *arg;
+    atomic_bool             running;
+    uint64_t                received;
+    uint64_t                sent;
+    uint64_t                dropped;
+    uint8_t                 packets[DNS_UDP_BATCH][DNS_UDP_PACKET_SIZE];
+    struct sockaddr_storage peers[DNS_UDP_BATCH];
+    struct iovec            iov[DNS_UDP_BATCH];
+    struct mmsghdr          rx[DNS_UDP_BATCH];
+    struct mmsghdr          tx[DNS_UDP_BATCH];
+} dns_udp_server_t;
+
+/**
+ * @brief 创建并绑定非阻塞的UDP套接字
+ * @param[in] ip 本地地址，IPv4或IPv6的文本格式
+ * @param[in] port 本地端口，0表示由系统分配
+ * @param[in] reuseport 是否设置SO_REUSEPORT，多个套接字可以绑定同一端口由内核分流
+ * @return int 套接字，失败返回-1
+ */
+int dns_udp_socket_open(const char *ip, uint16_t port, bool reuseport);
+
+/**
+ * @brief 获取套接字绑定的本地端口
+ * @param[in] fd 套接字
+ * @return uint16_t 端口，失败返回0
+ */
+uint16_t dns_udp_socket_port(int fd);
+
+/**
+ * @brief 初始化服务器
+ * @param[out] server 服务器
+ * @param[in] fd 已绑定的UDP套接字，由调用者关闭
+ * @param[in] handler 报文处理回调
+ * @param[in] arg 回调参数
+ * @return bool 成功返回true，失败返回false
+ */
+bool dns_udp_server_init(dns_udp_server_t *server, int fd, dns_udp_handler_t handler, void *arg);
+
+/**
+ * @brief 等待并处理一批报文：一次recvmmsg收取，逐个回调，一次sendmmsg发出所有响应
+ * @param[in,out] server 服务器
+ * @param[in] timeout_ms 没有报文时最多等待的毫秒数
+ * @return int 本次处理的报文数，超时返回0，出错返回-1
+ */
+int dns_udp_server_poll(dns_udp_server_t *server, int timeout_ms);
+
+/**
+ * @brief 循环处理报文直到dns_udp_server_stop被调用
+ * @param[in,out] server 服务器
+ * @return bool 正常停止返回true，套接字出错返回false
+ */
+bool dns_udp_server_run(dns_udp_server_t *server);
+
+/**
+ * @brief 通知dns_udp_server_run返回，可以在其它线程中调用
+ * @param[in,out] server 服务器
+ */
+void dns_udp_server_stop(dns_udp_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif
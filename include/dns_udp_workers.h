@@ -0,0 +1,82 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dns_message.h"
+#include "dns_udp_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_UDP_WORKER_ARENA_SIZE 16384 // 每个工作线程消息分配器的大小
+#define DNS_UDP_WORKERS_MAX       256   // 最大工作线程数
+
+/**
+ * @brief 工作线程，各自拥有套接字、收发缓冲区和消息，热路径上不共享任何数据
+ * @param index   : 序号
+ * @param cpu     : 绑定的CPU，-1表示不绑定
+ * @param fd      : 本线程的SO_REUSEPORT套接字
+ * @param thread  : 线程
+ * @param server  : 本线程的批量收发服务器
+ * @param handler : 线程池的报文处理回调
+ * @param arg     : 线程池的调用者参数
+ * @param message : 本线程的消息，每个报文调用回调前都已清空，内存来自arena
+ * @param arena   : message使用的缓冲区
+ */
+typedef struct {
+    int               index;
+    int               cpu;
+    int               fd;
+    pthread_t         thread;
+    dns_udp_server_t *server;
+    dns_udp_handler_t handler;
+    void             *arg;
+    dns_message_t     message;
+    uint8_t           arena[DNS_UDP_WORKER_ARENA_SIZE];
+} dns_udp_worker_t;
+
+/**
+ * @brief 多线程UDP服务器，每个线程一个绑定同一端口的SO_REUSEPORT套接字，由内核按四元组分流
+ * @param count   : 工作线程数
+ * @param port    : 实际绑定的端口
+ * @param workers : 工作线程数组
+ */
+typedef struct {
+    int               count;
+    uint16_t          port;
+    dns_udp_worker_t *workers;
+} dns_udp_pool_t;
+
+/**
+ * @brief 创建套接字并启动工作线程
+ * @note handler收到的arg是dns_udp_worker_t*，调用者的参数在worker->arg中，
+ *       worker->message可以直接用于反序列化和构造响应
+ * @param[out] pool 线程池
+ * @param[in] ip 本地地址
+ * @param[in] port 本地端口，0表示由系统分配，所有线程使用同一个端口
+ * @param[in] count 工作线程数
+ * @param[in] pin 是否把第i个线程绑定到第i个CPU（按CPU数取模）
+ * @param[in] handler 报文处理回调
+ * @param[in] arg 调用者参数
+ * @return bool 成功返回true，失败时已创建的线程和套接字都会被回收
+ */
+bool dns_udp_pool_start(dns_udp_pool_t *pool, const char *ip, uint16_t port, int count, bool pin, dns_udp_handler_t handler, void *arg);
+
+/**
+ * @brief 停止并回收所有工作线程和套接字
+ * @param[in,out] pool 线程池
+ */
+void dns_udp_pool_stop(dns_udp_pool_t *pool);
+
+/**
+ * @brief 统计所有工作线程收到的报文数，只在停止后读取才是准确的
+ * @param[in] pool 线程池
+ * @return uint64_t 报文数
+ */
+uint64_t dns_udp_pool_received(const dns_udp_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
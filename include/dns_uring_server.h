@@ -0,0 +1,114 @@
+#pragma once
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "dns_udp_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_URING_ENTRIES     256  // 提交队列长度，完成队列是它的4倍
+#define DNS_URING_BUFFERS     256  // 提供给内核的接收缓冲区个数，必须是2的幂
+#define DNS_URING_BUFFER_SIZE 4096 // 每个接收缓冲区的大小，包含io_uring_recvmsg_out和对端地址
+#define DNS_URING_GROUP       0    // 接收缓冲区组号
+
+/**
+ * @brief io_uring UDP服务器，单线程使用，只依赖内核头文件，不需要liburing
+ * @note 用一个multishot recvmsg持续接收，报文由内核直接写入提供的缓冲区环，
+ *       回调在该缓冲区中原地生成响应，响应的sendmsg在下一次io_uring_enter时批量提交，
+ *       发送完成后缓冲区才还给内核
+ * @param ring_fd     : io_uring实例
+ * @param fd          : 已绑定的UDP套接字
+ * @param handler     : 报文处理回调，与dns_udp_server相同
+ * @param arg         : 回调参数
+ * @param running     : 初始化时为true，变为false时dns_uring_server_run返回
+ * @param recv_armed  : multishot recvmsg是否仍然有效
+ * @param to_submit   : 已填写还未提交的SQE个数
+ * @param buf_tail    : 缓冲区环的本地尾指针，批量发布给内核
+ * @param received    : 累计收到的报文数
+ * @param sent        : 累计发出的响应数
+ * @param dropped     : 累计丢弃的报文或响应数
+ * @param no_buffers  : 缓冲区耗尽导致接收暂停的次数
+ */
+typedef struct {
+    int                       ring_fd;
+    int                       fd;
+    dns_udp_handler_t         handler;
+    void                     *arg;
+    atomic_bool               running;
+    bool                      recv_armed;
+    unsigned                  to_submit;
+    uint16_t                  buf_tail;
+    uint64_t                  received;
+    uint64_t                  sent;
+    uint64_t                  dropped;
+    uint64_t                  no_buffers;
+
+    void                     *ring_ptr;
+    size_t                    ring_size;
+    unsigned                 *sq_head;
+    unsigned                 *sq_tail;
+    unsigned                  sq_mask;
+    unsigned                  sq_entries;
+    struct io_uring_sqe      *sqes;
+    size_t                    sqes_size;
+    unsigned                 *cq_head;
+    unsigned                 *cq_tail;
+    unsigned                  cq_mask;
+    struct io_uring_cqe      *cqes;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t                    buf_ring_size;
+    uint8_t                  *buffers;
+    struct msghdr             recv_msg;
+    struct msghdr             send_msg[DNS_URING_BUFFERS];
+    struct iovec              send_iov[DNS_URING_BUFFERS];
+} dns_uring_server_t;
+
+/**
+ * @brief 创建io_uring实例并注册接收缓冲区环
+ * @note 实例以SINGLE_ISSUER/DEFER_TASKRUN模式创建，必须在之后调用poll/run的线程中初始化
+ * @param[out] server 服务器
+ * @param[in] fd 已绑定的UDP套接字，由调用者关闭
+ * @param[in] handler 报文处理回调
+ * @param[in] arg 回调参数
+ * @return bool 成功返回true；内核不支持或被禁止时返回false（DNS_ERROR_IO），可退回dns_udp_server
+ */
+bool dns_uring_server_init(dns_uring_server_t *server, int fd, dns_udp_handler_t handler, void *arg);
+
+/**
+ * @brief 释放io_uring实例和缓冲区
+ * @param[in,out] server 服务器
+ */
+void dns_uring_server_clear(dns_uring_server_t *server);
+
+/**
+ * @brief 提交积压的SQE，等待并处理一批完成事件
+ * @param[in,out] server 服务器
+ * @param[in] timeout_ms 没有事件时最多等待的毫秒数
+ * @return int 本次收到的报文数，超时返回0，出错返回-1
+ */
+int dns_uring_server_poll(dns_uring_server_t *server, int timeout_ms);
+
+/**
+ * @brief 循环处理报文直到dns_uring_server_stop被调用
+ * @param[in,out] server 服务器
+ * @return bool 正常停止返回true，出错返回false
+ */
+bool dns_uring_server_run(dns_uring_server_t *server);
+
+/**
+ * @brief 通知dns_uring_server_run返回，可以在其它线程中调用
+ * @param[in,out] server 服务器
+ */
+void dns_uring_server_stop(dns_uring_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif